@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "argparse.h"
 #include "diagnostics.h"
@@ -10,27 +15,170 @@
 #include "config.h"
 #include "parser.h"
 #include "codegen.h"
+#include "allocator.h"
+#include "trace.h"
+#include "perfcounters.h"
+#include "threadpool.h"
+#include "context.h"
+#include "server.h"
+#include "objcache.h"
+#include "depfile.h"
+#include "adeclc.h"
+#include "stream.h"
 #ifdef _WIN32
 #include "getline.h"
 #endif
 
-Config config;
+static Config config;
+
+// The files to assemble and where each one's binary goes, filled by parseArgs
+static const char** infiles;
+static sds* outfiles;
+static int infileCount;
+static int failures; // Files that could not be assembled
+// Socket of `--server` or `--client`, NULL for a one-shot run
+static const char* serverPath;
+static const char* clientPath;
+// `--precompile`, the inputs are ADECL files written to `.adeclc` files instead of assembled
+static bool precompile;
+
+// The diagnostics of each file, printed once every file before it is done, so batch workers finishing in any order
+// print them the same way as one file after the other
+static diag_list_t* fileDiagnostics;
+static bool* fileDone;
+static int nextReport;
+static mutex_t reportLock = MUTEX_INITIALIZER;
+
+// Everything needed to assemble one file
+// Each worker has its own, reset instead of freed between files so that the memory is reused
+// A file that fails takes the whole workspace with it, the next file starts from a new context
+typedef struct Workspace {
+	ArxAssembler* as;
+	Lexer* lexer;
+	Parser* parser;
+	SymbolTable* symbolTable;
+	SectionTable* sectionTable;
+	StructTable* structTable;
+	DataTable* dataTable;
+	RelocTable* relocTable;
+	CodeGen* codegen;
+} Workspace;
+
+
+static bool isDirectory(const char* path) {
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// `dir/name.ao` for `some/path/name.s`, or another extension
+static sds outputName(const char* dir, const char* infile, const char* ext) {
+	const char* base = strrchr(infile, '/');
+	base = base ? base + 1 : infile;
+	const char* dot = strrchr(base, '.');
+	size_t len = dot && dot != base ? (size_t) (dot - base) : strlen(base);
+
+	sds name = sdsempty();
+	if (dir) {
+		name = sdscat(name, dir);
+		if (sdslen(name) > 0 && name[sdslen(name) - 1] != '/') name = sdscat(name, "/");
+	}
+	name = sdscatlen(name, base, len);
+	name = sdscat(name, ext);
+
+	return name;
+}
+
+// `out.d` for `out.ao`, `out.d` appended to any other name
+static sds depFileName(const char* outfile) {
+	size_t len = strlen(outfile);
+	if (len > 3 && strcmp(outfile + len - 3, ".ao") == 0) len -= 3;
+
+	return sdscat(sdsnewlen(outfile, len), ".d");
+}
+
+// argparse only knows single letter short options, the `-M` and `-f` flags are spelled the way compilers spell them
+// `-MF file` and `-MFfile` are both accepted, the latter is taken out of argv, and so are `-ferror-limit=N` and `-fsyntax-only`
+// `-f` alone is still `--enable-field-access`
+static int rewriteCompilerFlags(int argc, char const* argv[]) {
+	int kept = 0;
+	for (int i = 0; i < argc; i++) {
+		const char* arg = argv[i];
+		if (strcmp(arg, "-MD") == 0) arg = "--MD";
+		else if (strcmp(arg, "-MP") == 0) arg = "--MP";
+		else if (strcmp(arg, "-MF") == 0) arg = "--MF";
+		else if (strncmp(arg, "-MF", 3) == 0) {
+			config.depFile = arg + 3;
+			continue;
+		} else if (strncmp(arg, "-ferror-limit=", 14) == 0) {
+			char* end;
+			long limit = strtol(arg + 14, &end, 10);
+			if (end == arg + 14 || *end || limit < 0 || limit > INT_MAX) emitError(ERR_INTERNAL, NULL, "Invalid error limit `%s`.", arg + 14);
+			config.errorLimit = (int) limit;
+			continue;
+		} else if (strcmp(arg, "-fsyntax-only") == 0) {
+			config.syntaxOnly = true;
+			continue;
+		}
+		argv[kept++] = arg;
+	}
+	argv[kept] = NULL;
+
+	return kept;
+}
+
+// `-I` can be given several times, each directory is appended to the search list
+static int addIncludePath(struct argparse* self, const struct argparse_option* option) {
+	const char** temp = (const char**) memRealloc(MEM_CONTEXT, config.includePaths, sizeof(char*) * (config.includePathCount + 1));
+	if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for include paths.");
+	config.includePaths = temp;
+	config.includePaths[config.includePathCount++] = *(const char**) option->value;
+
+	return 0;
+}
 
+// What is left to do after parsing the arguments
+// parseArgs never exits, the server parses the command line of each request with it
+typedef enum {
+	ARGS_RUN, // Assemble, serve or forward to a server
+	ARGS_DONE, // The arguments only asked for information, which was printed
+	ARGS_FAILED // There is nothing to run, the usage was printed
+} argsResult;
 
-char* parseArgs(int argc, char const* argv[]) {
+static argsResult parseArgs(int argc, char const* argv[]) {
 	// Init config with defaults
 	config.useDebugSymbols = false;
 	config.warningAsFatal = false;
-	config.outbin = "out.ao";
+	config.outbin = NULL;
 	config.warnings = WARN_FLAG_ALL; // Enable all warnings by default
 	config.enhancedFeatures = FEATURE_NONE; // Disable all enhanced features by default
+	config.showMemStats = false;
+	config.traceOut = NULL;
+	config.perfCounters = false;
+	config.jobs = 1;
+	config.cacheDir = NULL;
+	config.cacheSize = 256;
+	config.cacheStats = false;
+	config.makeDeps = false;
+	config.depFile = NULL;
+	config.phonyDeps = false;
+	config.includePaths = NULL;
+	config.includePathCount = 0;
+	config.includeThreads = 0;
+	config.errorLimit = DEFAULT_ERROR_LIMIT;
+	config.syntaxOnly = false;
+	config.stream = false;
+	serverPath = NULL;
+	clientPath = NULL;
+	precompile = false;
 
 	bool warningAsFatal = false;
 	bool showVersion = false;
-	char* infile = NULL;
+	bool showHelp = false;
+	const char* includePath = NULL;
 
 	struct argparse_option options[] = {
-		OPT_STRING('o', NULL, &config.outbin, "output filename", NULL, 0, 0),
+		OPT_STRING('o', NULL, &config.outbin, "output filename, or output directory with several input files", NULL, 0, 0),
+		OPT_STRING('I', NULL, &includePath, "also look for included files in this directory, can be given several times", addIncludePath, 0, 0),
 		OPT_BOOLEAN('g', NULL, &config.useDebugSymbols, "enable debug info", NULL, 0, 0),
 		OPT_BOOLEAN('W', "no-warn", &config.warnings, "disable warnings", NULL, 0, 0),
 		OPT_BOOLEAN('F', "fatal-warning", &warningAsFatal, "treat warnings as errors", NULL, 0, 0),
@@ -39,77 +187,334 @@ char* parseArgs(int argc, char const* argv[]) {
 		OPT_BIT('m', "enable-macros", &config.enhancedFeatures, "enable macros feature", NULL, FEATURE_MACROS, 0),
 		OPT_BIT('p', "enable-ptr-deref", &config.enhancedFeatures, "enable pointer dereferencing in expressions", NULL, FEATURE_PTR_DEREF, 0),
 		OPT_BIT('f', "enable-field-access", &config.enhancedFeatures, "enable struct/array field access in expressions", NULL, FEATURE_FIELD_ACCESS, 0),
-		OPT_HELP(),
+		OPT_INTEGER('j', "jobs", &config.jobs, "number of files to assemble at once, 0 for one per cpu", NULL, 0, 0),
+		OPT_INTEGER(0, "error-limit", &config.errorLimit, "stop after this many errors, 0 for no limit (default 20, also -ferror-limit=N)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "syntax-only", &config.syntaxOnly, "only check the files for errors, nothing is written (also -fsyntax-only)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "stream", &config.stream, "assemble very large sources a chunk at a time in two passes, keeping only the symbols in memory", NULL, 0, 0),
+		OPT_INTEGER(0, "include-threads", &config.includeThreads, "threads loading included files ahead of the parse, 1 loads each in place (default: one per cpu, 1 with -j)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "mem-stats", &config.showMemStats, "report memory usage per component", NULL, 0, 0),
+		OPT_STRING(0, "trace-out", &config.traceOut, "write a timeline of the assembler phases (Trace Event Format)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "perf-counters", &config.perfCounters, "report cpu counters per phase (Linux only)", NULL, 0, 0),
+		OPT_STRING(0, "cache-dir", &config.cacheDir, "reuse the objects of files that did not change since they were assembled, kept in this directory", NULL, 0, 0),
+		OPT_INTEGER(0, "cache-size", &config.cacheSize, "size limit of the cache in MiB, least recently used objects go first (default 256)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "cache-stats", &config.cacheStats, "report the hits and misses of the cache", NULL, 0, 0),
+		OPT_BOOLEAN(0, "MD", &config.makeDeps, "also write a make rule listing the files each object depends on (-MD)", NULL, 0, 0),
+		OPT_STRING(0, "MF", &config.depFile, "where the rule of -MD goes, by default the object's name with .d (-MF)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "MP", &config.phonyDeps, "add an empty rule for each included file (-MP)", NULL, 0, 0),
+		OPT_BOOLEAN(0, "precompile", &precompile, "write the declarations of ADECL files to .adeclc files, which .include loads without lexing", NULL, 0, 0),
+		OPT_STRING(0, "server", &serverPath, "keep running, assembling the command lines sent with --client to this socket", NULL, 0, 0),
+		OPT_STRING(0, "client", &clientPath, "have the server listening on this socket assemble instead", NULL, 0, 0),
+		// argparse's own help exits
+		OPT_BOOLEAN('h', "help", &showHelp, "show this help message and exit", NULL, 0, 0),
 		OPT_END(),
 	};
 
 	const char* const usages[] = {
 		"arxsm [options] file",
+		"arxsm [options] -o outdir/ file...",
+		"arxsm [options] -MD [-MF deps.d] [-MP] file",
+		"arxsm [options] --precompile file.adecl...",
+		"arxsm [options] -fsyntax-only file...",
+		"arxsm [options] --stream file...",
+		"arxsm --server sock",
+		"arxsm --client sock [options] file...",
 		NULL
 	};
 
 	struct argparse argparse;
 	argparse_init(&argparse, options, usages, 0);
 	argparse_describe(&argparse, "Aru Assembler", NULL);
+	// argparse leaves the remaining arguments, the input files, at the start of argv
+	argc = rewriteCompilerFlags(argc, argv);
 	int nparsed = argparse_parse(&argparse, argc, argv);
 
+	if (showHelp) {
+		argparse_usage(&argparse);
+		return ARGS_DONE;
+	}
 	if (showVersion) {
-		printf("Aru Assembler version 1.0.0\n");
-		exit(0);
+		printf("Aru Assembler version %s\n", ARXSM_VERSION);
+		return ARGS_DONE;
+	}
+
+	if (serverPath) {
+		if (clientPath) emitError(ERR_INTERNAL, NULL, "`--server` and `--client` cannot be used together.");
+		if (nparsed > 0) emitError(ERR_INTERNAL, NULL, "`--server` does not take input files, they come from the clients.");
+		return ARGS_RUN;
+	}
+
+#ifdef _WIN32
+	if (config.cacheDir) emitError(ERR_INTERNAL, NULL, "`--cache-dir` is not available on Windows.");
+	if (config.stream) emitError(ERR_INTERNAL, NULL, "`--stream` is not available on Windows.");
+#endif
+	if (config.cacheStats && !config.cacheDir) emitError(ERR_INTERNAL, NULL, "`--cache-stats` needs `--cache-dir`.");
+	if (config.cacheSize < 1) emitError(ERR_INTERNAL, NULL, "`--cache-size` must be at least 1 MiB.");
+	// The statistics of a cache can be looked at without assembling anything
+	if (config.cacheStats && nparsed == 0) {
+		displayCacheStats(config.cacheDir);
+		return ARGS_DONE;
 	}
 
+	if ((config.depFile || config.phonyDeps) && !config.makeDeps) emitError(ERR_INTERNAL, NULL, "`-MF` and `-MP` need `-MD`.");
+	if (config.depFile && nparsed > 1) emitError(ERR_INTERNAL, NULL, "`-MF` cannot be used with several input files.");
+	if (precompile && config.makeDeps) emitError(ERR_INTERNAL, NULL, "`-MD` cannot be used with `--precompile`.");
+	if (config.syntaxOnly && config.makeDeps) emitError(ERR_INTERNAL, NULL, "`-MD` cannot be used with `-fsyntax-only`.");
+	if (config.syntaxOnly && precompile) emitError(ERR_INTERNAL, NULL, "`-fsyntax-only` cannot be used with `--precompile`.");
+	if (config.stream && (config.syntaxOnly || precompile)) emitError(ERR_INTERNAL, NULL, "`--stream` cannot be used with `-fsyntax-only` or `--precompile`.");
 
-	// Remaining arguments after options are input files
-	if (argc - nparsed < 1) {
+	if (nparsed < 1) {
 		fprintf(stderr, "No input file specified.\n");
 		argparse_usage(&argparse);
-		exit(-1);
+		return ARGS_FAILED;
 	}
 
-	log("Output file: %s", config.outbin);
-
 	const char* allowedExts[] = { ".s", ".as", ".ars", ".adecl" };
+	const int allowedExtCount = sizeof(allowedExts) / sizeof(allowedExts[0]);
 
 	for (int i = 0; i < nparsed; i++) {
 		const char* dot = strrchr(argv[i], '.');
-		if (!dot || dot == argv[i] || *(dot-1) == '/') continue;
+		bool valid = false;
+
+		if (dot && dot != argv[i] && *(dot-1) != '/') {
+			for (int j = 0; j < allowedExtCount && !valid; j++) {
+				valid = strcmp(dot, allowedExts[j]) == 0;
+			}
+		}
+
+		if (!valid) emitError(ERR_INTERNAL, NULL, "Input file `%s` is not a valid assembly file.", argv[i]);
+		if (precompile && strcmp(dot, ".adecl") != 0) emitError(ERR_INTERNAL, NULL, "Input file `%s` is not an ADECL file, only those can be precompiled.", argv[i]);
+	}
+
+	infiles = argv;
+	infileCount = nparsed;
+	outfiles = (sds*) memCalloc(MEM_OUTPUT, infileCount, sizeof(sds));
+	if (!outfiles) emitError(ERR_MEM, NULL, "Failed to allocate memory for output filenames.");
+
+	// A single file goes to `-o` as before, unless it names a directory
+	// Several files each go to `<name>.ao`, in the `-o` directory if given
+	bool outIsDir = config.outbin && (config.outbin[strlen(config.outbin) - 1] == '/' || isDirectory(config.outbin));
+
+	if (config.syntaxOnly) {
+		// Nothing is written, `-o` is accepted so that the flag can be added to any command line
+	} else if (infileCount == 1 && !outIsDir && (config.outbin || !precompile)) {
+		outfiles[0] = sdsnew(config.outbin ? config.outbin : "out.ao");
+	} else if (precompile && !config.outbin) {
+		// Next to their ADECL files, where `.include` looks for them
+		for (int i = 0; i < infileCount; i++) {
+			outfiles[i] = sdscat(sdsnew(infiles[i]), "c");
+		}
+	} else {
+		if (config.outbin && !isDirectory(config.outbin)) emitError(ERR_IO, NULL, "Output directory `%s` does not exist.", config.outbin);
 
-		for (int j = 0; i < 1; j++) {
-			if (strcmp(dot, allowedExts[j]) != 0) continue;
+		for (int i = 0; i < infileCount; i++) {
+			outfiles[i] = outputName(config.outbin, infiles[i], precompile ? ".adeclc" : ".ao");
 
-			infile = (char*) argv[i];
-			break;
+			for (int j = 0; j < i; j++) {
+				if (strcmp(outfiles[i], outfiles[j]) == 0) {
+					emitError(ERR_IO, NULL, "Input files `%s` and `%s` would both be written to `%s`.", infiles[j], infiles[i], outfiles[i]);
+				}
+			}
 		}
 	}
 
-	if (!infile) emitError(ERR_INTERNAL, NULL, "Input file is not a valid assembly file.");
+	for (int i = 0; i < infileCount && outfiles[i]; i++) {
+		log("Output file: %s", outfiles[i]);
+	}
+
+	if (config.jobs == 0) {
+#ifndef _WIN32
+		config.jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#else
+		config.jobs = 1;
+#endif
+	}
+	if (config.jobs < 1) config.jobs = 1;
+	if (config.jobs > infileCount) config.jobs = infileCount;
 
-	return infile;
+	return ARGS_RUN;
 }
 
-int main(int argc, char const* argv[]) {
-	initScope("main");
+static void beginPhase(asmPhase phase) {
+	traceBegin("phase", "%s", phaseName(phase));
+	perfBegin(phase);
+}
+
+static void endPhase(asmPhase phase) {
+	perfEnd(phase);
+	traceEnd();
+}
+
+// Frees what the last file left behind while keeping the structures themselves
+static void resetWorkspace(Workspace* ws) {
+	// The ASTs and tables point into the source map, so it goes last
+	resetParser(ws->parser, NULL, 0);
+	resetStructTable(ws->structTable);
+	resetSectionTable(ws->sectionTable);
+	resetSymbolTable(ws->symbolTable);
+	resetDataTable(ws->dataTable);
+	resetRelocTable(ws->relocTable);
+	if (ws->codegen) resetCodeGenerator(ws->codegen);
+	resetLexer(ws->lexer);
+	resetSourceMap(&ws->as->sources);
+}
+
+static void deinitWorkspace(Workspace* ws) {
+	if (!ws->as) return;
+
+	if (ws->lexer) deinitLexer(ws->lexer);
+	if (ws->parser) deinitParser(ws->parser);
+	if (ws->symbolTable) {
+		deinitStructTable(ws->structTable);
+		deinitSectionTable(ws->sectionTable);
+		deinitSymbolTable(ws->symbolTable);
+		deinitDataTable(ws->dataTable);
+		deinitRelocTable(ws->relocTable);
+	}
+	if (ws->codegen) deinitCodeGenerator(ws->codegen);
+	deinitAssembler(ws->as);
+
+	*ws = (Workspace) {0};
+}
+
+// After a failure nothing in the workspace can be trusted, the context frees all of it
+static void discardWorkspace(Workspace* ws) {
+	deinitAssembler(ws->as);
+	*ws = (Workspace) {0};
+}
+
+static arxStatus initTables(Workspace* ws) {
+	ArxFrame frame;
+	arxEnter(ws->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		ws->symbolTable = initSymbolTable();
+		if (ws->symbolTable) ws->symbolTable->ownsSources = config.stream; // A stream frees the tokens the symbols come from
+		ws->sectionTable = initSectionTable();
+		ws->structTable = initStructTable();
+		ws->dataTable = initDataTable();
+		ws->relocTable = initRelocTable();
+	}
 
-	char* infile = parseArgs(argc, argv);
+	return arxLeave(&frame);
+}
 
+static arxStatus lexFile(Lexer* lexer, const char* infile) {
 	FILE* source = fopen(infile, "r");
-	if (!source) emitError(ERR_IO, NULL, "Failed to open input file: %s", infile);
+	if (!source) {
+		// Reported through the context like any other error
+		ArxFrame frame;
+		arxEnter(lexer->as, &frame);
+		if (setjmp(frame.env) == 0) emitError(ERR_IO, NULL, "Failed to open input file: %s", infile);
+		return arxLeave(&frame);
+	}
 
-	Lexer* lexer = initLexer();
+	struct stat st;
+	arxStatus status = stat(infile, &st) == 0 ? reserveSource(lexer, (size_t) st.st_size) : ARX_OK;
+	if (status != ARX_OK) {
+		fclose(source);
+		return status;
+	}
 
 	char* line = NULL;
 	size_t n;
 
+	// The lines after an error are still lexed for their own errors while under the error limit
+	// The source is not parsed after an error, so what the failed line left in the tokens does not matter
 	ssize_t read = getline(&line, &n, source);
 	while (read != -1) {
-		lexLine(lexer, line);
+		if (lexLine(lexer, line) != ARX_OK) {
+			status = ARX_FAILED;
+			if (!arxRecoverable(lexer->as)) break;
+		}
 
 		read = getline(&line, &n, source);
 	}
 	free(line);
 	fclose(source);
 
-	rlog("\nLexed %d lines. Read %d tokens:", lexer->linenum, lexer->tokenCount);
+	return status;
+}
+
+// Returns whether the file was assembled, its errors have been reported through the workspace's context
+static arxStatus writeDependencies(ArxAssembler* as, const char* infile, const char* outfile, const dep_list_t* deps) {
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) {
+		sds depfile = config.depFile ? sdsnew(config.depFile) : depFileName(outfile);
+		if (!writeDepFile(depfile, outfile, infile, deps, config.phonyDeps)) emitError(ERR_IO, NULL, "Failed to write dependency file `%s`.", depfile);
+		sdsfree(depfile);
+	}
+
+	return arxLeave(&frame);
+}
+
+// On a hit the includes are the ones the cache's scan found, less those that do not exist (an `.include` in a comment)
+static arxStatus writeCachedDependencies(ArxAssembler* as, const char* infile, const char* outfile, const dep_list_t* scanned) {
+	dep_list_t deps = {0};
+	for (int i = 0; i < scanned->count; i++) {
+		struct stat st;
+		if (stat(scanned->paths[i], &st) == 0) addDependency(&deps, scanned->paths[i]);
+	}
+
+	arxStatus status = writeDependencies(as, infile, outfile, &deps);
+	freeDependencies(&deps);
+
+	return status;
+}
+
+// The workspace of a stream is the same as of a whole file, only used a chunk at a time
+static arxStatus streamWorkspace(Workspace* ws, const char* infile, const char* outfile) {
+	if (!ws->lexer) ws->lexer = initLexer(ws->as);
+	if (!ws->lexer) return ARX_FAILED;
+
+	if (!ws->parser) {
+		if (initTables(ws) != ARX_OK) return ARX_FAILED;
+		ws->parser = initParser(ws->as, NULL, 0);
+		if (!ws->parser) return ARX_FAILED;
+		setTables(ws->parser, ws->sectionTable, ws->symbolTable, ws->structTable, ws->dataTable, ws->relocTable);
+	}
+	if (!ws->codegen) ws->codegen = initCodeGenerator(ws->as, ws->sectionTable, ws->symbolTable, ws->relocTable);
+	if (!ws->codegen) return ARX_FAILED;
+
+	return streamFile(ws->lexer, ws->parser, ws->codegen, infile, outfile);
+}
+
+static bool assembleFile(Workspace* ws, const char* infile, const char* outfile, diag_list_t* diagnostics) {
+	traceSetTrack(infile);
+
+	// A file whose object is in the cache is not assembled at all
+	char key[CACHE_KEY_LEN + 1];
+	dep_list_t scanned = {0};
+	bool cacheable = config.cacheDir && !config.syntaxOnly && !config.stream && cacheKey(&config, infile, key, config.makeDeps ? &scanned : NULL);
+	bool hit = cacheable && cacheFetch(config.cacheDir, key, outfile);
+
+	if (!ws->as) {
+		ws->as = initAssembler(config, NULL);
+		if (!ws->as) emitError(ERR_MEM, NULL, "Failed to allocate memory for assembler context.");
+	}
+	ws->as->filename = infileCount > 1 ? infile : NULL;
+	setDiagnosticSink(ws->as, collectDiagnostic, diagnostics);
+	int warnings = ws->as->warningCount; // The context counts over every file of the workspace
+
+	arxStatus status = ARX_OK;
+	if (hit && config.makeDeps) status = writeCachedDependencies(ws->as, infile, outfile, &scanned);
+	freeDependencies(&scanned);
+	if (status != ARX_OK) goto failed;
+	if (hit) return true;
+
+	if (config.stream) {
+		status = streamWorkspace(ws, infile, outfile);
+		if (status != ARX_OK) goto failed;
+		goto written;
+	}
+
+	beginPhase(PHASE_LEX);
+	if (!ws->lexer) ws->lexer = initLexer(ws->as);
+	status = ws->lexer ? lexFile(ws->lexer, infile) : ARX_FAILED;
+	endPhase(PHASE_LEX);
+	if (status != ARX_OK) goto failed;
+
+	Lexer* lexer = ws->lexer;
+	rlog("\nLexed %d lines. Read %zu tokens:", lexer->linenum, lexer->tokenCount);
 	// Show contents of lexer's tokens
 	// for (int i = 0; i < lexer->tokenCount; i++) {
 	// 	printToken(lexer->tokens[i]);
@@ -117,52 +522,238 @@ int main(int argc, char const* argv[]) {
 	rlog("\n");
 
 	// Finished lexing, now parse
+	beginPhase(PHASE_PARSE);
+	if (!ws->parser) {
+		// First initialize the tables
+		status = initTables(ws);
+		if (status == ARX_OK) {
+			ws->parser = initParser(ws->as, lexer->tokens, lexer->tokenCount);
+			if (ws->parser) setTables(ws->parser, ws->sectionTable, ws->symbolTable, ws->structTable, ws->dataTable, ws->relocTable);
+			else status = ARX_FAILED;
+		}
+	} else {
+		resetParser(ws->parser, lexer->tokens, lexer->tokenCount);
+	}
+	if (status == ARX_OK) status = parse(ws->parser);
+	endPhase(PHASE_PARSE);
+	if (status != ARX_OK) goto failed;
 
-	// First initialize the tables
-	SymbolTable* symbolTable = initSymbolTable();
-	SectionTable* sectionTable = initSectionTable();
-	StructTable* structTable = initStructTable();
-	DataTable* dataTable = initDataTable();
-	RelocTable* relocTable = initRelocTable();
-
-	ParserConfig pconfig = {
-		.warningAsFatal = config.warningAsFatal,
-		.warnings = config.warnings,
-		.enhancedFeatures = config.enhancedFeatures
-	};
-	Parser* parser = initParser(lexer->tokens, lexer->tokenCount, pconfig);
-	setTables(parser, sectionTable, symbolTable, structTable, dataTable, relocTable);
-
-
-	parse(parser);
+	// Nothing of the parse points into the tokens, they are freed before the code is generated
+	resetLexer(lexer);
+	ws->parser->tokens = NULL;
+	ws->parser->tokenCount = 0;
 
+	Parser* parser = ws->parser;
 	rlog("\n\n");
-	// rlog("Parsed %d ASTs:", parser->astCount);
+	// rlog("Parsed %zu ASTs:", parser->astCount);
 	// for (int i = 0; i < parser->astCount; i++) {
 	// 	rlog("AST %d:", i);
 	// 	printAST(parser->asts[i]);
 	// }
 	rlog("\n");
 
-	CodeGen* codegen = initCodeGenerator(sectionTable, symbolTable, relocTable);
-	gencode(parser, codegen);
+	// A syntax check stops at the checks of codegen, without generating anything
+	if (config.syntaxOnly) {
+		beginPhase(PHASE_CODEGEN);
+		status = checkcode(parser);
+		endPhase(PHASE_CODEGEN);
+		if (status != ARX_OK) goto failed;
+		goto done;
+	}
+
+	beginPhase(PHASE_CODEGEN);
+	if (!ws->codegen) ws->codegen = initCodeGenerator(ws->as, ws->sectionTable, ws->symbolTable, ws->relocTable);
+	status = ws->codegen ? gencode(parser, ws->codegen) : ARX_FAILED;
+	endPhase(PHASE_CODEGEN);
+	if (status != ARX_OK) goto failed;
+
+	beginPhase(PHASE_WRITE);
+	status = writeBinary(ws->codegen, outfile);
+	endPhase(PHASE_WRITE);
+	if (status != ARX_OK) goto failed;
+
+	// Objects that came with warnings are not stored, a hit would not print them again
+	if (cacheable && ws->as->warningCount == warnings) cacheStore(config.cacheDir, (size_t) config.cacheSize << 20, key, outfile);
+
+written:
+	if (config.makeDeps) {
+		status = writeDependencies(ws->as, infile, outfile, &ws->as->dependencies);
+		clearDependencies(&ws->as->dependencies);
+		if (status != ARX_OK) goto failed;
+	}
+	// A stream keeps nothing of the source to show
+	if (config.stream) goto done;
+
+	// The tables find their lines in the source map of the context
+	ArxFrame frame;
+	arxEnter(ws->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		displaySymbolTable(ws->symbolTable);
+		displaySectionTable(ws->sectionTable);
+		displayStructTable(ws->structTable);
+		displayDataTable(ws->dataTable);
+		displayCodeGen(ws->codegen);
+		displayRelocTable(ws->relocTable);
+	}
+	arxLeave(&frame);
 
-	writeBinary(codegen, config.outbin);
+done:
+	beginPhase(PHASE_TEARDOWN);
+	resetWorkspace(ws);
+	endPhase(PHASE_TEARDOWN);
 
-	displaySymbolTable(symbolTable);
-	displaySectionTable(sectionTable);
-	displayStructTable(structTable);
-	displayDataTable(dataTable);
-	displayCodeGen(codegen);
-	displayRelocTable(relocTable);
+	return true;
 
-	deinitLexer(lexer);
-	deinitParser(parser);
-	deinitStructTable(structTable);
-	deinitSectionTable(sectionTable);
-	deinitSymbolTable(symbolTable);
-	deinitRelocTable(relocTable);
-	deinitCodeGenerator(codegen);
+failed:
+	discardWorkspace(ws);
+	return false;
+}
 
-	return 0;
+// Returns whether the file was precompiled, its errors have been reported
+static bool precompileFile(const char* infile, const char* outfile) {
+	traceSetTrack(infile);
+
+	ArxAssembler* as = initAssembler(config, NULL);
+	if (!as) emitError(ERR_MEM, NULL, "Failed to allocate memory for assembler context.");
+	as->filename = infileCount > 1 ? infile : NULL;
+
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) precompileADECL(as, infile, outfile);
+	arxStatus status = arxLeave(&frame);
+
+	deinitAssembler(as);
+
+	return status == ARX_OK;
+}
+
+// Prints the diagnostics of the files that are done, up to the first one that is not
+static void reportDiagnostics(int index) {
+	mutexLock(&reportLock);
+	fileDone[index] = true;
+	while (nextReport < infileCount && fileDone[nextReport]) printDiagnostics(&fileDiagnostics[nextReport++]);
+	mutexUnlock(&reportLock);
+}
+
+static void batchTask(int worker, int task, void* ctx) {
+	Workspace* workspaces = (Workspace*) ctx;
+	if (!assembleFile(&workspaces[worker], infiles[task], outfiles[task], &fileDiagnostics[task])) __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+	reportDiagnostics(task);
+}
+
+static void batchWorkerStart(int worker, void* ctx) {
+	// The main thread, worker 0, opened its counters in initPerfCounters
+	if (config.perfCounters && worker != 0) initThreadPerfCounters();
+}
+
+static void batchWorkerEnd(int worker, void* ctx) {
+	Workspace* workspaces = (Workspace*) ctx;
+	deinitWorkspace(&workspaces[worker]);
+
+	if (config.perfCounters && worker != 0) deinitThreadPerfCounters();
+}
+
+// Assembles the files of the parsed command line, returns the exit status
+static int assembleAll() {
+	failures = 0;
+
+	if (config.perfCounters) initPerfCounters();
+
+	fileDiagnostics = (diag_list_t*) memCalloc(MEM_CONTEXT, infileCount, sizeof(diag_list_t));
+	fileDone = (bool*) memCalloc(MEM_CONTEXT, infileCount, sizeof(bool));
+	if (!fileDiagnostics || !fileDone) emitError(ERR_MEM, NULL, "Failed to allocate memory for diagnostics.");
+	nextReport = 0;
+
+	if (precompile) {
+		// ADECL files are small, they are not worth the workers
+		for (int i = 0; i < infileCount; i++) {
+			if (!precompileFile(infiles[i], outfiles[i])) failures++;
+		}
+	} else if (config.jobs > 1) {
+		Workspace* workspaces = (Workspace*) memCalloc(MEM_CONTEXT, config.jobs, sizeof(Workspace));
+		if (!workspaces) emitError(ERR_MEM, NULL, "Failed to allocate memory for workspaces.");
+
+		ThreadPool* pool = initThreadPool(config.jobs, batchTask, batchWorkerStart, batchWorkerEnd, workspaces);
+		for (int i = 0; i < infileCount; i++) {
+			submitTask(pool, i);
+		}
+		runThreadPool(pool);
+		deinitThreadPool(pool);
+
+		memFree(workspaces);
+	} else {
+		Workspace workspace = {0};
+		for (int i = 0; i < infileCount; i++) {
+			if (!assembleFile(&workspace, infiles[i], outfiles[i], &fileDiagnostics[i])) failures++;
+			reportDiagnostics(i);
+		}
+		deinitWorkspace(&workspace);
+	}
+
+	for (int i = 0; i < infileCount; i++) {
+		sdsfree(outfiles[i]);
+	}
+	memFree(outfiles);
+	memFree(fileDiagnostics);
+	memFree(fileDone);
+
+	deinitTrace();
+
+	if (config.showMemStats) displayMemStats();
+	if (config.cacheStats) displayCacheStats(config.cacheDir);
+	if (config.perfCounters) {
+		displayPerfCounters();
+		deinitPerfCounters();
+	}
+
+	return failures ? -1 : 0;
+}
+
+// Runs a command line forwarded to the server, the same way the process would have ran it
+// The client already checked the arguments, anything still wrong with them is an error of the request rather than of the server
+static int serveRequest(int argc, char const* argv[]) {
+	initScope("main");
+
+	ArxAssembler* as = initAssembler(config, NULL);
+	if (!as) return -1;
+
+	// The output names are allocated under the context, they stay until the request is done
+	volatile argsResult args = ARGS_FAILED;
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) {
+		args = parseArgs(argc, argv);
+		if (args == ARGS_RUN && serverPath) emitError(ERR_INTERNAL, NULL, "A server cannot be started from a client.");
+		if (args == ARGS_RUN && config.traceOut) initTrace(config.traceOut);
+	}
+
+	int status = -1;
+	if (arxLeave(&frame) == ARX_OK && args != ARGS_FAILED) status = args == ARGS_RUN ? assembleAll() : 0;
+	deinitAssembler(as);
+
+	return status;
+}
+
+int main(int argc, char const* argv[]) {
+	initScope("main");
+
+	// parseArgs reorders argv, the client forwards the command line as it was given
+	char const** args = (char const**) malloc(sizeof(char*) * (argc + 1));
+	if (!args) emitError(ERR_MEM, NULL, "Failed to allocate memory for arguments.");
+	memcpy(args, argv, sizeof(char*) * (argc + 1));
+
+	argsResult parsed = parseArgs(argc, argv);
+
+	int status;
+	if (parsed != ARGS_RUN) status = parsed == ARGS_DONE ? 0 : -1;
+	else if (serverPath) status = runServer(serverPath, serveRequest);
+	else if (clientPath) status = runClient(clientPath, argc, args);
+	else {
+		if (config.traceOut) initTrace(config.traceOut);
+		status = assembleAll();
+	}
+
+	free(args);
+
+	return status;
 }
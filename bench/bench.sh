@@ -0,0 +1,58 @@
+#!/bin/bash
+# Assembles generated inputs over a ladder of sizes and records wall time and peak RSS for each
+# Ran by `make bench`, which builds arxsm, gencorpus and runstat into out/ beforehand
+#
+# Environment:
+#   BENCH_SIZES    line counts to run (default: 1000 10000 100000 1000000 10000000)
+#   BENCH_TIMEOUT  seconds before a run is killed (default: 600)
+#   BENCH_GENARGS  extra gencorpus options (default: --structs 32)
+#   BENCH_RESULTS  results file (default: out/bench/results.txt)
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=$ROOT/out
+WORK=$OUT/bench
+SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000 10000000"}
+TIMEOUT=${BENCH_TIMEOUT:-600}
+GENARGS=${BENCH_GENARGS:-"--structs 32"}
+RESULTS=${BENCH_RESULTS:-$WORK/results.txt}
+
+for bin in arxsm gencorpus runstat; do
+	if [ ! -x "$OUT/$bin" ]; then
+		echo "Missing $OUT/$bin, run \`make bench\`." >&2
+		exit 1
+	fi
+done
+
+mkdir -p "$WORK"
+
+{
+	echo "# arxsm bench $(date -u +%Y-%m-%dT%H:%M:%SZ) $(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+	echo "# gencorpus $GENARGS, timeout ${TIMEOUT}s"
+	printf "%-10s %-12s %-12s %-10s %-12s %s\n" "lines" "bytes" "status" "seconds" "maxrss_kb" "lines/s"
+} > "$RESULTS"
+
+for size in $SIZES; do
+	input=$WORK/corpus_$size.s
+	"$OUT/gencorpus" -o "$input" --lines "$size" $GENARGS
+
+	lines=$(wc -l < "$input")
+	bytes=$(wc -c < "$input")
+
+	# Includes are opened relative to the working directory
+	read -r status seconds rss < <(cd "$WORK" && "$OUT/runstat" "$TIMEOUT" "$OUT/arxsm" -t -o "$WORK/corpus_$size.ao" "$input")
+
+	rate=$(awk -v l="$lines" -v s="$seconds" 'BEGIN { if (s > 0) printf "%.0f", l / s; else print "-" }')
+	printf "%-10s %-12s %-12s %-10s %-12s %s\n" "$lines" "$bytes" "$status" "$seconds" "$rss" "$rate" | tee -a "$RESULTS"
+
+	rm -f "$input" "$WORK/corpus_$size.adecl" "$WORK/corpus_$size.ao"
+
+	# Larger sizes will not do any better
+	if [ "$status" = "timeout" ]; then
+		echo "Stopping the ladder after a timeout." | tee -a "$RESULTS"
+		break
+	fi
+done
+
+echo "Results written to $RESULTS"
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "argparse.h"
+
+
+// Synthetic corpus generator for benchmarking the assembler
+// Writes a single assembly file made of functions, each function being a run of local labels
+// with a configurable mix of instructions, optionally with data tables, extern references,
+// a `.set` chain and an `.include`d ADECL file of struct definitions.
+// The output is deterministic for a given set of options.
+
+typedef struct GenConfig {
+	int lines; // If set, overrides the function count so the output is roughly this many lines
+	int functions;
+	int labels; // Labels per function
+	int block; // Instructions per label
+	const char* mix; // Weights of R:I:M:B instructions
+	int externs; // Number of extern symbols
+	int externDensity; // Percentage of instructions that reference an extern symbol
+	int setDepth; // Length of the `.set` chain
+	int wordTable; // Entries in each function's `.word` table
+	int byteTable; // Entries in each function's `.byte` table
+	int structs; // Structs defined in the included ADECL file
+	int seed;
+	const char* outfile;
+} GenConfig;
+
+enum { MIX_R, MIX_I, MIX_M, MIX_B, MIX_COUNT };
+
+static GenConfig gen;
+static int mixWeights[MIX_COUNT];
+static int mixTotal;
+static uint64_t rngState;
+
+
+static uint32_t rng() {
+	// xorshift64*
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (uint32_t) ((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int randRange(int n) {
+	return n <= 0 ? 0 : (int) (rng() % (uint32_t) n);
+}
+
+static int randReg() {
+	return randRange(16);
+}
+
+static void parseMix(const char* mix) {
+	if (sscanf(mix, "%d:%d:%d:%d", &mixWeights[MIX_R], &mixWeights[MIX_I], &mixWeights[MIX_M], &mixWeights[MIX_B]) != 4) {
+		fprintf(stderr, "Invalid instruction mix `%s`, expected R:I:M:B weights (e.g. 40:30:20:10).\n", mix);
+		exit(-1);
+	}
+
+	mixTotal = 0;
+	for (int i = 0; i < MIX_COUNT; i++) {
+		if (mixWeights[i] < 0) mixWeights[i] = 0;
+		mixTotal += mixWeights[i];
+	}
+	if (mixTotal == 0) {
+		fprintf(stderr, "Instruction mix must have at least one non-zero weight.\n");
+		exit(-1);
+	}
+}
+
+static int pickMix() {
+	int r = randRange(mixTotal);
+	for (int i = 0; i < MIX_COUNT; i++) {
+		if (r < mixWeights[i]) return i;
+		r -= mixWeights[i];
+	}
+	return MIX_R;
+}
+
+static const char* rOps[] = { "add", "sub", "and", "or", "xor", "mul", "adds", "subs" };
+static const char* iOps[] = { "add", "sub", "lsl", "lsr", "asr", "adds" };
+static const char* mOps[] = { "ld", "ldb", "ldh", "str", "strb", "strh" };
+static const char* bOps[] = { "ub", "beq", "bne", "blt", "bgt" };
+
+#define COUNT(arr) ((int) (sizeof(arr) / sizeof(arr[0])))
+
+static void genInstruction(FILE* out, int fn) {
+	if (gen.externs > 0 && randRange(100) < gen.externDensity) {
+		int ext = randRange(gen.externs);
+		if (rng() & 1) fprintf(out, "\t\tld x%d, =EXT_%d\n", randReg(), ext);
+		else fprintf(out, "\t\tcall EXT_%d\n", ext);
+		return;
+	}
+
+	switch (pickMix()) {
+		case MIX_R:
+			fprintf(out, "\t\t%s x%d, x%d, x%d\n", rOps[randRange(COUNT(rOps))], randReg(), randReg(), randReg());
+			break;
+		case MIX_I:
+			if (gen.setDepth > 0 && randRange(8) == 0) {
+				fprintf(out, "\t\tadd x%d, x%d, K_%d\n", randReg(), randReg(), randRange(gen.setDepth));
+			} else if (gen.structs > 0 && randRange(8) == 0) {
+				fprintf(out, "\t\tadd x%d, x%d, SZ_%d\n", randReg(), randReg(), randRange(gen.structs));
+			} else {
+				fprintf(out, "\t\t%s x%d, x%d, #%d\n", iOps[randRange(COUNT(iOps))], randReg(), randReg(), randRange(0x1000));
+			}
+			break;
+		case MIX_M:
+			fprintf(out, "\t\t%s x%d, [x%d, #%d]\n", mOps[randRange(COUNT(mOps))], randReg(), randReg(), randRange(32) * 4);
+			break;
+		case MIX_B:
+			// Branch within the function, or call another one
+			if (gen.functions > 1 && randRange(4) == 0) {
+				fprintf(out, "\t\tcall fn_%d\n", randRange(gen.functions));
+			} else {
+				fprintf(out, "\t\t%s fn_%d_L%d\n", bOps[randRange(COUNT(bOps))], fn, randRange(gen.labels));
+			}
+			break;
+	}
+}
+
+static void genTable(FILE* out, const char* directive, const char* name, int fn, int entries, int maxValue) {
+	fprintf(out, "\t%s_%d:\n", name, fn);
+	for (int i = 0; i < entries; i += 8) {
+		fprintf(out, "\t\t%s ", directive);
+		for (int j = i; j < entries && j < i + 8; j++) {
+			fprintf(out, "%s0x%x", j == i ? "" : ", ", randRange(maxValue));
+		}
+		fprintf(out, "\n");
+	}
+}
+
+static void genFunction(FILE* out, int fn) {
+	if (gen.wordTable > 0 || gen.byteTable > 0) {
+		fprintf(out, ".data\n");
+		if (gen.wordTable > 0) genTable(out, ".word", "wtab", fn, gen.wordTable, 0x7fffffff);
+		if (gen.byteTable > 0) genTable(out, ".byte", "btab", fn, gen.byteTable, 0x100);
+		fprintf(out, ".text\n");
+	}
+
+	fprintf(out, "\tfn_%d:\n", fn);
+	for (int l = 0; l < gen.labels; l++) {
+		fprintf(out, "\tfn_%d_L%d:\n", fn, l);
+		for (int i = 0; i < gen.block; i++) genInstruction(out, fn);
+	}
+	if (gen.wordTable > 0) fprintf(out, "\t\tld x0, =wtab_%d\n", fn);
+	fprintf(out, "\t\tret\n");
+}
+
+static void genADECL(const char* filename) {
+	FILE* out = fopen(filename, "w");
+	if (!out) {
+		fprintf(stderr, "Failed to open %s for writing.\n", filename);
+		exit(-1);
+	}
+
+	fprintf(out, "%% Generated by gencorpus\n");
+	for (int s = 0; s < gen.structs; s++) {
+		int fields = 2 + randRange(6);
+		int size = 0;
+		fprintf(out, ".def St_%d {\n", s);
+		for (int f = 0; f < fields; f++) {
+			int fsize = (rng() & 1) ? 8 : 32;
+			fprintf(out, "\tfield%d:%d.\n", f, fsize);
+			size += fsize / 8;
+		}
+		fprintf(out, "}\n");
+		fprintf(out, ".set SZ_%d, #%d\n", s, size);
+	}
+
+	fclose(out);
+}
+
+// Lines written per function, used to size the corpus from `--lines`
+static int linesPerFunction() {
+	int lines = 2 + gen.labels * (1 + gen.block);
+	if (gen.wordTable > 0 || gen.byteTable > 0) lines += 2;
+	if (gen.wordTable > 0) lines += 2 + (gen.wordTable + 7) / 8;
+	if (gen.byteTable > 0) lines += 1 + (gen.byteTable + 7) / 8;
+	return lines;
+}
+
+int main(int argc, char const* argv[]) {
+	gen = (GenConfig) {
+		.lines = 0,
+		.functions = 10,
+		.labels = 4,
+		.block = 8,
+		.mix = "40:30:20:10",
+		.externs = 16,
+		.externDensity = 5,
+		.setDepth = 8,
+		.wordTable = 8,
+		.byteTable = 16,
+		.structs = 0,
+		.seed = 1,
+		.outfile = NULL
+	};
+
+	struct argparse_option options[] = {
+		OPT_STRING('o', NULL, &gen.outfile, "output file (an ADECL file is written next to it when --structs is used)", NULL, 0, 0),
+		OPT_INTEGER('n', "lines", &gen.lines, "approximate number of lines, overrides --functions", NULL, 0, 0),
+		OPT_INTEGER(0, "functions", &gen.functions, "number of functions", NULL, 0, 0),
+		OPT_INTEGER(0, "labels", &gen.labels, "labels per function", NULL, 0, 0),
+		OPT_INTEGER(0, "block", &gen.block, "instructions per label", NULL, 0, 0),
+		OPT_STRING(0, "mix", &gen.mix, "instruction mix as R:I:M:B weights", NULL, 0, 0),
+		OPT_INTEGER(0, "externs", &gen.externs, "number of extern symbols", NULL, 0, 0),
+		OPT_INTEGER(0, "extern-density", &gen.externDensity, "percentage of instructions referencing an extern", NULL, 0, 0),
+		OPT_INTEGER(0, "set-depth", &gen.setDepth, "length of the .set chain", NULL, 0, 0),
+		OPT_INTEGER(0, "word-table", &gen.wordTable, "entries in each function's .word table", NULL, 0, 0),
+		OPT_INTEGER(0, "byte-table", &gen.byteTable, "entries in each function's .byte table", NULL, 0, 0),
+		OPT_INTEGER(0, "structs", &gen.structs, "structs in the included ADECL file (needs arxsm -t)", NULL, 0, 0),
+		OPT_INTEGER(0, "seed", &gen.seed, "random seed", NULL, 0, 0),
+		OPT_HELP(),
+		OPT_END(),
+	};
+
+	const char* const usages[] = {
+		"gencorpus [options] -o file.s",
+		NULL
+	};
+
+	struct argparse argparse;
+	argparse_init(&argparse, options, usages, 0);
+	argparse_describe(&argparse, "Synthetic assembly corpus generator", NULL);
+	argparse_parse(&argparse, argc, argv);
+
+	if (!gen.outfile) {
+		argparse_usage(&argparse);
+		exit(-1);
+	}
+	if (gen.labels < 1) gen.labels = 1;
+	if (gen.block < 0) gen.block = 0;
+	parseMix(gen.mix);
+	rngState = 0x9E3779B97F4A7C15ULL ^ (uint64_t) gen.seed;
+
+	if (gen.lines > 0) {
+		int header = 2 + gen.externs + gen.setDepth + (gen.structs > 0 ? 1 : 0);
+		gen.functions = (gen.lines - header) / linesPerFunction();
+		if (gen.functions < 1) gen.functions = 1;
+	}
+
+	FILE* out = fopen(gen.outfile, "w");
+	if (!out) {
+		fprintf(stderr, "Failed to open %s for writing.\n", gen.outfile);
+		exit(-1);
+	}
+
+	if (gen.structs > 0) {
+		// The assembler opens includes relative to where it runs, so it has to be ran from the output's directory
+		char adeclPath[4096];
+		snprintf(adeclPath, sizeof(adeclPath), "%s", gen.outfile);
+		char* dot = strrchr(adeclPath, '.');
+		char* slash = strrchr(adeclPath, '/');
+		if (dot && (!slash || dot > slash)) *dot = '\0';
+		strncat(adeclPath, ".adecl", sizeof(adeclPath) - strlen(adeclPath) - 1);
+
+		genADECL(adeclPath);
+
+		slash = strrchr(adeclPath, '/');
+		fprintf(out, ".include \"%s\"\n", slash ? slash + 1 : adeclPath);
+	}
+
+	fprintf(out, "%% Generated by gencorpus: %d functions, %d labels, %d instructions per label\n", gen.functions, gen.labels, gen.block);
+	for (int e = 0; e < gen.externs; e++) fprintf(out, ".extern EXT_%d\n", e);
+	for (int k = 0; k < gen.setDepth; k++) {
+		if (k == 0) fprintf(out, ".set K_0, #1\n");
+		else fprintf(out, ".set K_%d, K_%d + 1\n", k, k - 1);
+	}
+	fprintf(out, ".glob fn_0\n");
+
+	fprintf(out, ".text\n");
+	for (int fn = 0; fn < gen.functions; fn++) genFunction(out, fn);
+
+	fclose(out);
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// Allocation counter meant to be preloaded into the assembler
+// Usage: LD_PRELOAD=out/libmalloccount.so MALLOCCOUNT_OUT=<file> arxsm ...
+// Every call to malloc, calloc and realloc is counted, including the ones made by the common libraries and libc itself.
+// On exit, `<allocs> <bytes>` is written to MALLOCCOUNT_OUT, or to stderr when it is not set.
+// Relies on glibc exporting the __libc_* entry points, which avoids the dlsym bootstrapping problem.
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static uint64_t allocs;
+static uint64_t bytes;
+
+
+void* malloc(size_t size) {
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&bytes, size, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&bytes, n * size, __ATOMIC_RELAXED);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+	// A realloc is a new allocation as far as the budget is concerned, shrinking or growing in place included
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&bytes, size, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+__attribute__((destructor))
+static void report() {
+	// Formatted on the stack and written directly so that reporting does not count itself
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%llu %llu\n",
+		(unsigned long long) __atomic_load_n(&allocs, __ATOMIC_RELAXED), (unsigned long long) __atomic_load_n(&bytes, __ATOMIC_RELAXED));
+
+	const char* path = getenv("MALLOCCOUNT_OUT");
+	int fd = path ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDERR_FILENO;
+	if (fd == -1) return;
+	if (write(fd, buf, len) != len) {}
+	if (path) close(fd);
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#else
+#define HAVE_CYCLES 0
+#endif
+
+#include "argparse.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "expr.h"
+#include "allocator.h"
+
+
+// Microbenchmarks for the per-instruction hot paths of code generation
+// A canned source is lexed and parsed once, then `encodeI`, `getImmediateEncoding` and `evaluateExpression`
+// are called in a tight loop on the resulting nodes.
+// Each case is warmed up, then timed over several repetitions of which the fastest is kept.
+// Reported per operation: nanoseconds, TSC cycles (x86 only) and allocations made through the allocator.
+
+static const char* source[] = {
+	".set K_0, #1\n",
+	".set K_1, K_0 + 1\n",
+	".set K_2, K_1 * 4\n",
+	".set K_3, (K_2 << 2) | 3\n",
+	".text\n",
+	"add x1, x2, #42\n",
+	"add x1, x2, #4 * #8 + #1\n",
+	"add x1, x2, #1 + #2 + #3 + #4 + #5 + #6 + #7 + #8\n",
+	"add x1, x2, K_3\n",
+	"add x1, x2, K_0 * #8 + #1\n",
+	"ret\n",
+	NULL
+};
+
+// Indices of the instructions in `source`, in order of appearance
+enum { INSTR_IMM, INSTR_EXPR, INSTR_CHAIN, INSTR_SYMB, INSTR_SYMB_EXPR, INSTR_COUNT };
+
+typedef struct Fixture {
+	ArxAssembler* as;
+	Lexer* lexer;
+	Parser* parser;
+	SymbolTable* symbolTable;
+	SectionTable* sectionTable;
+	StructTable* structTable;
+	DataTable* dataTable;
+	RelocTable* relocTable;
+
+	InstrNode* instrs[INSTR_COUNT];
+} Fixture;
+
+static Fixture fixture;
+static volatile uint32_t sink;
+
+
+static void initFixture() {
+	Config config = { .warnings = WARN_FLAG_ALL, .enhancedFeatures = FEATURE_NONE };
+	fixture.as = initAssembler(config, NULL);
+	fixture.lexer = initLexer(fixture.as);
+	for (int i = 0; source[i]; i++) lexLine(fixture.lexer, source[i]);
+
+	fixture.symbolTable = initSymbolTable();
+	fixture.sectionTable = initSectionTable();
+	fixture.structTable = initStructTable();
+	fixture.dataTable = initDataTable();
+	fixture.relocTable = initRelocTable();
+
+	fixture.parser = initParser(fixture.as, fixture.lexer->tokens, fixture.lexer->tokenCount);
+	setTables(fixture.parser, fixture.sectionTable, fixture.symbolTable, fixture.structTable, fixture.dataTable, fixture.relocTable);
+	parse(fixture.parser);
+
+	int found = 0;
+	for (int i = 0; i < fixture.parser->astCount && found < INSTR_COUNT; i++) {
+		Node* ast = fixture.parser->asts[i];
+		if (ast->nodeType == ND_INSTRUCTION && ast->nodeData.instruction->instrType == I_TYPE) fixture.instrs[found++] = ast->nodeData.instruction;
+	}
+	if (found != INSTR_COUNT) {
+		fprintf(stderr, "Expected %d I-type instructions in the canned source, found %d.\n", INSTR_COUNT, found);
+		exit(-1);
+	}
+}
+
+static void deinitFixture() {
+	deinitParser(fixture.parser);
+	deinitLexer(fixture.lexer);
+	deinitStructTable(fixture.structTable);
+	deinitSectionTable(fixture.sectionTable);
+	deinitSymbolTable(fixture.symbolTable);
+	deinitDataTable(fixture.dataTable);
+	deinitRelocTable(fixture.relocTable);
+	deinitAssembler(fixture.as);
+}
+
+
+static uint32_t benchEncodeI(InstrNode* instr) {
+	return encodeI(instr, 0x0, fixture.symbolTable, fixture.relocTable);
+}
+
+static uint32_t benchImmediate(InstrNode* instr) {
+	RelData reldata = {
+		.lp = 0x0,
+		.addend = 0,
+		.type = RELOC_TYPE_ABS,
+		.relocTable = fixture.relocTable
+	};
+	return getImmediateEncoding(instr->data.iType.imm, NTYPE_UINT14, fixture.symbolTable, &reldata);
+}
+
+static uint32_t benchEvaluate(InstrNode* instr) {
+	return (uint32_t) evaluateExpression(instr->data.iType.imm, fixture.symbolTable);
+}
+
+typedef struct BenchCase {
+	const char* name;
+	uint32_t (*fn)(InstrNode* instr);
+	int instr;
+} BenchCase;
+
+static const BenchCase cases[] = {
+	{ "encodeI/imm", benchEncodeI, INSTR_IMM },
+	{ "encodeI/expr", benchEncodeI, INSTR_EXPR },
+	{ "encodeI/symbol", benchEncodeI, INSTR_SYMB },
+	{ "getImmediateEncoding/imm", benchImmediate, INSTR_IMM },
+	{ "getImmediateEncoding/expr", benchImmediate, INSTR_EXPR },
+	{ "getImmediateEncoding/symbol", benchImmediate, INSTR_SYMB },
+	{ "evaluateExpression/expr", benchEvaluate, INSTR_EXPR },
+	{ "evaluateExpression/chain8", benchEvaluate, INSTR_CHAIN },
+	{ "evaluateExpression/symbol", benchEvaluate, INSTR_SYMB },
+	{ "evaluateExpression/symbol-expr", benchEvaluate, INSTR_SYMB_EXPR },
+};
+
+#define CASE_COUNT ((int) (sizeof(cases) / sizeof(cases[0])))
+
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t nowCycles() {
+#if HAVE_CYCLES
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static uint64_t totalAllocs() {
+	uint64_t allocs = 0;
+	for (int tag = 0; tag < MEM_TAG_COUNT; tag++) allocs += getMemStats((memTag) tag).allocs;
+	return allocs;
+}
+
+static void runCase(const BenchCase* bench, int iterations, int repeat) {
+	InstrNode* instr = fixture.instrs[bench->instr];
+
+	// Warm up caches and branch predictors, this also resolves the `.set` chain on first evaluation
+	int warmup = iterations / 10 > 1000 ? iterations / 10 : 1000;
+	for (int i = 0; i < warmup; i++) sink = bench->fn(instr);
+
+	double bestNs = 0;
+	double bestCycles = 0;
+	uint64_t allocs = 0;
+	for (int r = 0; r < repeat; r++) {
+		uint64_t allocsStart = totalAllocs();
+		uint64_t cyclesStart = nowCycles();
+		uint64_t start = nowNs();
+
+		for (int i = 0; i < iterations; i++) sink = bench->fn(instr);
+
+		uint64_t end = nowNs();
+		uint64_t cyclesEnd = nowCycles();
+		allocs += totalAllocs() - allocsStart;
+
+		double ns = (double) (end - start) / iterations;
+		double cycles = (double) (cyclesEnd - cyclesStart) / iterations;
+		if (r == 0 || ns < bestNs) {
+			bestNs = ns;
+			bestCycles = cycles;
+		}
+	}
+
+	double allocsPerOp = (double) allocs / ((double) iterations * repeat);
+	if (HAVE_CYCLES) printf("%-34s %10.2f %12.1f %12.3f\n", bench->name, bestNs, bestCycles, allocsPerOp);
+	else printf("%-34s %10.2f %12s %12.3f\n", bench->name, bestNs, "-", allocsPerOp);
+}
+
+int main(int argc, char const* argv[]) {
+	int iterations = 1000000;
+	int repeat = 5;
+	const char* filter = NULL;
+
+	struct argparse_option options[] = {
+		OPT_INTEGER('n', "iterations", &iterations, "calls per repetition", NULL, 0, 0),
+		OPT_INTEGER('r', "repeat", &repeat, "repetitions, the fastest one is reported", NULL, 0, 0),
+		OPT_STRING('f', "filter", &filter, "only run cases whose name contains this", NULL, 0, 0),
+		OPT_HELP(),
+		OPT_END(),
+	};
+
+	const char* const usages[] = {
+		"microbench [options]",
+		NULL
+	};
+
+	struct argparse argparse;
+	argparse_init(&argparse, options, usages, 0);
+	argparse_describe(&argparse, "Microbenchmarks for the instruction encoders and expression evaluator", NULL);
+	argparse_parse(&argparse, argc, argv);
+
+	if (iterations < 1) iterations = 1;
+	if (repeat < 1) repeat = 1;
+
+	initFixture();
+
+	printf("%-34s %10s %12s %12s\n", "case", "ns/op", "cycles/op", "allocs/op");
+	for (int i = 0; i < CASE_COUNT; i++) {
+		if (filter && !strstr(cases[i].name, filter)) continue;
+		runCase(&cases[i], iterations, repeat);
+	}
+
+	deinitFixture();
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+// Runs a command and reports its wall time and peak RSS, for the benchmark scripts
+// Usage: runstat <timeout seconds> <command> [args...]
+// Prints `<status> <seconds> <max rss kb>` on stdout, where status is `ok`, `exit:<code>`, `signal:<sig>` or `timeout`
+// The command's own output is discarded
+
+static volatile pid_t child = -1;
+
+static void onAlarm(int sig) {
+	(void) sig;
+	if (child > 0) kill(child, SIGKILL);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		fprintf(stderr, "Usage: runstat <timeout seconds> <command> [args...]\n");
+		return -1;
+	}
+
+	int timeout = atoi(argv[1]);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	child = fork();
+	if (child == -1) {
+		perror("fork");
+		return -1;
+	}
+
+	if (child == 0) {
+		int devnull = open("/dev/null", O_WRONLY);
+		if (devnull != -1) {
+			dup2(devnull, STDOUT_FILENO);
+			dup2(devnull, STDERR_FILENO);
+		}
+		execvp(argv[2], &argv[2]);
+		_exit(127);
+	}
+
+	signal(SIGALRM, onAlarm);
+	if (timeout > 0) alarm(timeout);
+
+	int status;
+	struct rusage usage;
+	pid_t waited;
+	do {
+		waited = wait4(child, &status, 0, &usage);
+	} while (waited == -1);
+
+	alarm(0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	char result[32];
+	if (WIFEXITED(status)) {
+		if (WEXITSTATUS(status) == 0) snprintf(result, sizeof(result), "ok");
+		else snprintf(result, sizeof(result), "exit:%d", WEXITSTATUS(status));
+	} else if (WIFSIGNALED(status)) {
+		if (WTERMSIG(status) == SIGKILL && timeout > 0 && seconds >= timeout) snprintf(result, sizeof(result), "timeout");
+		else snprintf(result, sizeof(result), "signal:%d", WTERMSIG(status));
+	} else snprintf(result, sizeof(result), "unknown");
+
+	// ru_maxrss is in kilobytes on Linux
+	printf("%s %.3f %ld\n", result, seconds, usage.ru_maxrss);
+
+	return 0;
+}
@@ -1,97 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include "adecl.h"
 #include "diagnostics.h"
+#include "allocator.h"
 #include "lexer.h"
+#include "trace.h"
+
+
+static bool isFile(const char* path) {
+	struct stat st;
+	return stat(path, &st) == 0 && !S_ISDIR(st.st_mode);
+}
+
+static bool isAbsolute(const char* path) {
 #ifdef _WIN32
-#include "getline.h"
+	if (path[0] && path[1] == ':') return true;
+	if (path[0] == '\\') return true;
+#endif
+	return path[0] == '/';
+}
+
+sds findADECLFile(const Config* config, const char* filename) {
+	if (isFile(filename)) return sdsnew(filename);
+	if (isAbsolute(filename)) return NULL;
+
+	for (int i = 0; i < config->includePathCount; i++) {
+		const char* dir = config->includePaths[i];
+		size_t len = strlen(dir);
+
+		sds path = sdsnew(dir);
+		if (len > 0 && dir[len - 1] != '/') path = sdscat(path, "/");
+		path = sdscat(path, filename);
+		if (!path) return NULL;
+
+		if (isFile(path)) return path;
+		sdsfree(path);
+	}
+
+	return NULL;
+}
+
+sds canonicalADECLPath(const char* path) {
+#ifndef _WIN32
+	char* resolved = realpath(path, NULL);
+#else
+	char* resolved = _fullpath(NULL, path, 0);
 #endif
+	if (!resolved) return NULL;
 
+	sds canonical = sdsnew(resolved);
+	free(resolved);
+	return canonical;
+}
 
-FILE* openADECLFile(sds filename) {
-	// TODO: Need to add a system of include paths, etc
-	// For now, the file must be in the same directory where the assembler is ran
-	FILE* file = fopen(filename, "r");
+FILE* openADECLFile(ArxAssembler* as, const char* path) {
+	FILE* file = fopen(path, "r");
+	if (file && as->config.makeDeps) addDependency(&as->dependencies, path);
 	return file;
 }
 
-static void validateASTS(Node** asts, int astCount) {
-	initScope("validateASTS()");
-
-	for (int i = 0; i < astCount; i++) {
-		Node* root = asts[i];
-		linedata_ctx linedata = {
-			.linenum = root->token->linenum,
-			.source = ssGetString(root->token->sstring)
-		};
-		if (root->nodeType != ND_DIRECTIVE) emitError(ERR_NOT_ALLOWED, &linedata, "Only directives are allowed in ADECL files.");
-
-		// This is where the big assumption and trust that the parser updates the token's type to the actual directive
-		// That will be used to determine what directive it is
-		if (root->token->type != TK_D_SET && root->token->type != TK_D_EXTERN &&
-				root->token->type != TK_D_TYPE && root->token->type != TK_D_SIZEOF &&
-				root->token->type != TK_D_DEF && root->token->type != TK_D_INCLUDE) {
-			emitError(ERR_INVALID_DIRECTIVE, &linedata, "Directive `%s` is not allowed in ADECL files.", root->token->lexeme);
-		}
+DEFINE_VECTOR(Chars, char, MEM_LEXER)
+
+// Reads the rest of the file into memory of the context and closes it
+// An error while lexing leaves past `lexParseADECLFile`, so it must not hold anything the context would not free
+static char* readADECLFile(FILE* file, size_t* size) {
+	char* text = NULL;
+	size_t capacity = 0;
+	size_t length = 0;
+
+	while (true) {
+		reserveChars(&text, &capacity, length + 4096);
+		size_t read = fread(text + length, 1, capacity - length - 1, file);
+		length += read;
+		if (read == 0) break;
 	}
-}
+	bool failed = ferror(file);
+	fclose(file);
+	if (failed) emitError(ERR_IO, NULL, "Failed to read ADECL file.");
 
+	text[length] = '\0';
+	*size = length;
+	return text;
+}
 
 void lexParseADECLFile(FILE* file, ADECL_ctx* context) {
 	initScope("lexParseADECLFile()");
 
-	Lexer* lexer = initLexer();
+	size_t size;
+	char* text = readADECLFile(file, &size);
+
+	traceBegin("adecl", "lex");
+	Lexer* lexer = initLexer(context->as);
 
-	char* line = NULL;
-	size_t n;
+	// Each line is ended in place for the lexer, with its newline
+	char* line = text;
+	while (line < text + size) {
+		char* newline = memchr(line, '\n', (size_t) (text + size - line));
+		char* end = newline ? newline + 1 : text + size;
 
-	ssize_t read = getline(&line, &n, file);
-	while (read != -1) {
+		char next = *end;
+		*end = '\0';
 		lexLine(lexer, line);
+		*end = next;
 
-		read = getline(&line, &n, file);
+		line = end;
 	}
-	free(line);
-	fclose(file);
+	memFree(text);
+	traceEnd();
 
-	// Now, since this reuses all of the logic as the main assembler,
-	// The lexer and parser allows instructions and directives that are not valid in ADECL files
-	// This can be fixed by either writing a new lexer and parser just for ADECL files,
-	// Or by adding a mode to the existing lexer and parser to restrict what is allowed
-	// Or just scan after the parser to check if all ASTs are valid
-	// This might be an issue since errors are not caught early, and the need to loop through everything
-	// Scanning after the parser is what will be done, for now
-
-	log("\nLexed %d lines. Read %d tokens:", lexer->linenum, lexer->tokenCount);
+	log("\nLexed %d lines. Read %zu tokens:", lexer->linenum, lexer->tokenCount);
+#ifdef DEBUG
 	// Show contents of lexer's tokens
-	for (int i = 0; i < lexer->tokenCount; i++) {
+	for (size_t i = 0; i < lexer->tokenCount; i++) {
 		printToken(lexer->tokens[i]);
 	}
+#endif
 	log("\n");
 
 	// Finished lexing, now parse
+	traceBegin("adecl", "parse");
 
 	// First initialize the tables
+	// The lexer is the same as the main assembler's, the parser only takes declarations, in a single pass that stops at
+	// the first line that is not one, so there are no sections and no data to keep track of
 	SymbolTable* symbolTable = initSymbolTable();
 	StructTable* structTable = initStructTable();
-	SectionTable* sectionTable = initSectionTable();
 
-	ParserConfig pconfig = {
-		.warningAsFatal = context->parentParserConfig.warningAsFatal,
-		.warnings = context->parentParserConfig.warnings,
-		.enhancedFeatures = context->parentParserConfig.enhancedFeatures
-	};
-	Parser* parser = initParser(lexer->tokens, lexer->tokenCount, pconfig);
-	setTables(parser, sectionTable, symbolTable, structTable, NULL, NULL);
+	Parser* parser = initParser(context->as, lexer->tokens, lexer->tokenCount);
+	parser->config.declarationsOnly = true;
+	setTables(parser, NULL, symbolTable, structTable, NULL, NULL);
 
 	parse(parser);
-
-	validateASTS(parser->asts, parser->astCount);
+	traceEnd();
 
 	context->asts = parser->asts;
 	context->astCount = parser->astCount;
 	context->astCapacity = parser->astCapacity;
 	context->symbolTable = symbolTable;
 	context->structTable = structTable;
+	context->includes = parser->included.count > 0;
 
-	free(lexer);
-	free(parser);
+	// Nothing parsed points into the tokens
+	deinitLexer(lexer);
+	freeDependencies(&parser->included);
+	memFree(parser);
 }
\ No newline at end of file
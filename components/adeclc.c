@@ -0,0 +1,657 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "adeclc.h"
+#include "diagnostics.h"
+#include "allocator.h"
+#include "expr.h"
+#include "sha256.h"
+#include "trace.h"
+#include "threadpool.h"
+
+
+#define ADECLC_MAGIC "ARXADCL" // 8 bytes with its null
+#define ADECLC_VERSION 1
+#define ADECLC_BYTE_ORDER 0x01020304 // Reads back as something else on a machine of the other byte order
+#define NO_STRING UINT32_MAX
+
+// Every part is a multiple of 4 bytes, so that the records of a mapped file can be read in place
+// Strings are offsets into the string pool that ends the file
+typedef struct ADECLCHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint8_t sourceHash[SHA256_DIGEST_LEN];
+	uint32_t features; // The enhanced features the file was parsed with
+	uint32_t symbolCount;
+	uint32_t structCount;
+	uint32_t fieldCount;
+	uint32_t stringsSize;
+} ADECLCHeader;
+
+typedef struct SymbolRecord {
+	uint32_t name;
+	uint32_t flags; // Never E_EXPR, expressions are evaluated before writing
+	uint32_t size;
+	uint32_t value;
+	int32_t structTypeIdx;
+	uint32_t source;
+	int32_t linenum;
+} SymbolRecord;
+
+typedef struct StructRecord {
+	uint32_t name;
+	uint32_t size;
+	uint32_t firstField; // The fields of each struct are consecutive
+	uint32_t fieldCount;
+	uint32_t source;
+	int32_t linenum;
+} StructRecord;
+
+typedef struct FieldRecord {
+	uint32_t name;
+	uint32_t type;
+	int32_t size;
+	int32_t offset;
+	int32_t structTypeIdx;
+	uint32_t source;
+	int32_t linenum;
+} FieldRecord;
+
+// Each distinct string is stored once, field names and types tend to repeat across structs
+typedef struct StringPool {
+	char* data;
+	uint32_t size;
+	uint32_t capacity;
+	uint32_t* slots; // Offset + 1 of the string in each slot, 0 for an empty slot
+	uint32_t slotCount; // A power of two
+	uint32_t used;
+} StringPool;
+
+typedef struct Mapping {
+	const uint8_t* data;
+	size_t size;
+} Mapping;
+
+
+static uint32_t hashString(const char* str) {
+	uint32_t hash = 2166136261u;
+	for (const char* c = str; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619u;
+
+	return hash;
+}
+
+static void growSlots(StringPool* pool) {
+	uint32_t slotCount = pool->slotCount ? pool->slotCount * 2 : 64;
+	uint32_t* slots = (uint32_t*) memCalloc(MEM_OUTPUT, slotCount, sizeof(uint32_t));
+	if (!slots) emitError(ERR_MEM, NULL, "Failed to allocate memory for precompiled strings.");
+
+	for (uint32_t i = 0; i < pool->slotCount; i++) {
+		if (!pool->slots[i]) continue;
+		uint32_t slot = hashString(pool->data + pool->slots[i] - 1) & (slotCount - 1);
+		while (slots[slot]) slot = (slot + 1) & (slotCount - 1);
+		slots[slot] = pool->slots[i];
+	}
+
+	memFree(pool->slots);
+	pool->slots = slots;
+	pool->slotCount = slotCount;
+}
+
+static uint32_t internString(StringPool* pool, const char* str) {
+	if (!str) return NO_STRING;
+	if ((pool->used + 1) * 2 > pool->slotCount) growSlots(pool);
+
+	uint32_t slot = hashString(str) & (pool->slotCount - 1);
+	while (pool->slots[slot]) {
+		if (strcmp(pool->data + pool->slots[slot] - 1, str) == 0) return pool->slots[slot] - 1;
+		slot = (slot + 1) & (pool->slotCount - 1);
+	}
+
+	size_t len = strlen(str) + 1;
+	if (pool->size + len > pool->capacity) {
+		uint32_t capacity = pool->capacity ? pool->capacity : 1024;
+		while (pool->size + len > capacity) capacity *= 2;
+		char* data = (char*) memRealloc(MEM_OUTPUT, pool->data, capacity);
+		if (!data) emitError(ERR_MEM, NULL, "Failed to allocate memory for precompiled strings.");
+		pool->data = data;
+		pool->capacity = capacity;
+	}
+
+	uint32_t offset = pool->size;
+	memcpy(pool->data + offset, str, len);
+	pool->size += len;
+	pool->slots[slot] = offset + 1;
+	pool->used++;
+
+	return offset;
+}
+
+static uint32_t internSource(StringPool* pool, srcloc_t loc) {
+	const char* source = sourceLine(loc);
+	return source ? internString(pool, source) : NO_STRING;
+}
+
+static bool hashStream(FILE* file, uint8_t digest[SHA256_DIGEST_LEN]) {
+	sha256_t sha;
+	initSHA256(&sha);
+
+	char buffer[16384];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) updateSHA256(&sha, buffer, n);
+	if (ferror(file)) return false;
+
+	finalSHA256(&sha, digest);
+	return true;
+}
+
+static uint32_t expressionValue(Node* expr) {
+	if (expr->nodeType == ND_NUMBER) return expr->nodeData.number->value.uint32Value;
+	if (expr->nodeType == ND_SYMB) return expr->nodeData.symbol->value;
+	if (expr->nodeType == ND_OPERATOR) return expr->nodeData.operator->value;
+
+	return 0;
+}
+
+// Every `.set` must come down to a value now, the symbols of the files that will include this one are not known
+static void evaluateSymbols(SymbolTable* table, const char* infile) {
+	for (uint32_t i = 0; i < table->size; i++) {
+		symb_entry_t* entry = table->entries[i];
+		if (GET_EXPRESSION(entry->flags) != E_EXPR) continue;
+
+		// A symbol that is only used has no line of its own, its first use stands in
+		srcloc_t loc = entry->loc;
+		if (loc == NO_LOC && entry->references.refcount > 0) loc = entry->references.refs[0]->loc;
+		linedata_ctx linedata = lineAt(loc);
+		linedata_ctx* where = linedata.source ? &linedata : NULL;
+
+		if (!GET_DEFINED(entry->flags) || !entry->value.expr) {
+			emitError(ERR_UNDEFINED, where, "Symbol `%s` is not defined in `%s`, it cannot be precompiled.", entry->name, infile);
+		}
+		if (!evaluateExpression(entry->value.expr, table)) {
+			emitError(ERR_INVALID_EXPRESSION, where, "Could not evaluate the expression of `%s`, it cannot be precompiled.", entry->name);
+		}
+
+		uint32_t val = expressionValue(entry->value.expr);
+		CLR_EXPRESSION(entry->flags);
+		entry->value.val = val;
+	}
+}
+
+static void copyRecords(uint8_t** pos, const void* records, size_t size) {
+	if (size == 0) return;
+	memcpy(*pos, records, size);
+	*pos += size;
+}
+
+// Lays the tables out the way a precompiled file holds them, in a single block that no context owns
+static uint8_t* buildImage(ADECLCHeader* header, ADECL_ctx* context, size_t* imageSize) {
+	SymbolTable* symbolTable = context->symbolTable;
+	StructTable* structTable = context->structTable;
+
+	uint32_t fieldCount = 0;
+	for (int i = 0; i < structTable->size; i++) fieldCount += structTable->structs[i]->fieldCount;
+
+	SymbolRecord* symbols = (SymbolRecord*) memCalloc(MEM_OUTPUT, symbolTable->size + 1, sizeof(SymbolRecord));
+	StructRecord* structs = (StructRecord*) memCalloc(MEM_OUTPUT, structTable->size + 1, sizeof(StructRecord));
+	FieldRecord* fields = (FieldRecord*) memCalloc(MEM_OUTPUT, fieldCount + 1, sizeof(FieldRecord));
+	if (!symbols || !structs || !fields) emitError(ERR_MEM, NULL, "Failed to allocate memory for precompiled records.");
+
+	StringPool pool = {0};
+
+	for (uint32_t i = 0; i < symbolTable->size; i++) {
+		symb_entry_t* entry = symbolTable->entries[i];
+		symbols[i] = (SymbolRecord) {
+			.name = internString(&pool, entry->name),
+			.flags = entry->flags,
+			.size = entry->size,
+			.value = entry->value.val,
+			.structTypeIdx = entry->structTypeIdx,
+			.source = internSource(&pool, entry->loc),
+			.linenum = lineNumber(entry->loc)
+		};
+	}
+
+	uint32_t nextField = 0;
+	for (int i = 0; i < structTable->size; i++) {
+		struct_root_t* root = structTable->structs[i];
+		structs[i] = (StructRecord) {
+			.name = internString(&pool, root->name),
+			.size = (uint32_t) root->size,
+			.firstField = nextField,
+			.fieldCount = (uint32_t) root->fieldCount,
+			.source = internSource(&pool, root->loc),
+			.linenum = lineNumber(root->loc)
+		};
+
+		for (int j = 0; j < root->fieldCount; j++) {
+			struct_field_t* field = root->fields[j];
+			fields[nextField++] = (FieldRecord) {
+				.name = internString(&pool, field->name),
+				.type = (uint32_t) field->type,
+				.size = field->size,
+				.offset = field->offset,
+				.structTypeIdx = field->structTypeIdx,
+				.source = internSource(&pool, field->loc),
+				.linenum = lineNumber(field->loc)
+			};
+		}
+	}
+
+	header->symbolCount = symbolTable->size;
+	header->structCount = (uint32_t) structTable->size;
+	header->fieldCount = fieldCount;
+	header->stringsSize = pool.size;
+
+	size_t size = sizeof(ADECLCHeader) + (size_t) header->symbolCount * sizeof(SymbolRecord) +
+		(size_t) header->structCount * sizeof(StructRecord) + (size_t) header->fieldCount * sizeof(FieldRecord) + pool.size;
+	uint8_t* image = (uint8_t*) memAllocWith(NULL, MEM_SYMTAB, size);
+	if (!image) emitError(ERR_MEM, NULL, "Failed to allocate memory for precompiled declarations.");
+
+	uint8_t* pos = image;
+	copyRecords(&pos, header, sizeof(ADECLCHeader));
+	copyRecords(&pos, symbols, (size_t) header->symbolCount * sizeof(SymbolRecord));
+	copyRecords(&pos, structs, (size_t) header->structCount * sizeof(StructRecord));
+	copyRecords(&pos, fields, (size_t) header->fieldCount * sizeof(FieldRecord));
+	copyRecords(&pos, pool.data, pool.size);
+
+	memFree(pool.slots);
+	memFree(pool.data);
+	memFree(fields);
+	memFree(structs);
+	memFree(symbols);
+
+	*imageSize = size;
+	return image;
+}
+
+static bool writeImage(const uint8_t* image, size_t size, const char* outfile) {
+	// Written aside then renamed, a process including the file never sees half of it
+	sds temp = sdscat(sdsnew(outfile), ".tmp");
+	if (!temp) return false;
+
+	FILE* file = fopen(temp, "wb");
+	bool written = file && fwrite(image, 1, size, file) == size;
+	if (file && fclose(file) != 0) written = false;
+#ifdef _WIN32
+	if (written) remove(outfile);
+#endif
+	if (written && rename(temp, outfile) != 0) written = false;
+	if (!written) remove(temp);
+
+	sdsfree(temp);
+	return written;
+}
+
+static ADECLCHeader makeHeader(uint32_t features) {
+	ADECLCHeader header = {
+		.version = ADECLC_VERSION,
+		.byteOrder = ADECLC_BYTE_ORDER,
+		.features = features
+	};
+	memcpy(header.magic, ADECLC_MAGIC, sizeof(header.magic));
+
+	return header;
+}
+
+void precompileADECL(ArxAssembler* as, const char* infile, const char* outfile) {
+	initScope("precompileADECL()");
+
+	FILE* file = fopen(infile, "r");
+	if (!file) emitError(ERR_IO, NULL, "Failed to open ADECL file `%s`.", infile);
+
+	ADECLCHeader header = makeHeader(as->config.enhancedFeatures);
+
+	bool hashed = hashStream(file, header.sourceHash);
+	if (!hashed) {
+		fclose(file);
+		emitError(ERR_IO, NULL, "Failed to read ADECL file `%s`.", infile);
+	}
+	rewind(file);
+
+	ADECL_ctx context = { .as = as };
+	lexParseADECLFile(file, &context);
+	// The hash only covers the file itself, the image could not tell when what it includes changes
+	if (context.includes) emitError(ERR_NOT_ALLOWED, NULL, "ADECL file `%s` includes other files, it cannot be precompiled.", infile);
+
+	traceBegin("adecl", "precompile %s", outfile);
+	evaluateSymbols(context.symbolTable, infile);
+	size_t size;
+	uint8_t* image = buildImage(&header, &context, &size);
+	bool written = writeImage(image, size, outfile);
+	memFree(image);
+	if (!written) emitError(ERR_IO, NULL, "Failed to write precompiled file `%s`.", outfile);
+	traceEnd();
+}
+
+
+static bool mapFile(const char* path, Mapping* map) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0) {
+		// An empty file maps to nothing, it is reported as truncated
+		close(fd);
+		map->data = NULL;
+		map->size = 0;
+		return true;
+	}
+
+	void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+
+	map->data = (const uint8_t*) data;
+	map->size = (size_t) st.st_size;
+	return true;
+#else
+	FILE* file = fopen(path, "rb");
+	if (!file) return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	rewind(file);
+
+	uint8_t* data = size > 0 ? (uint8_t*) memAlloc(MEM_OUTPUT, (size_t) size) : NULL;
+	bool read = size == 0 || (data && fread(data, 1, (size_t) size, file) == (size_t) size);
+	fclose(file);
+	if (!read) {
+		memFree(data);
+		return false;
+	}
+
+	map->data = data;
+	map->size = (size_t) size;
+	return true;
+#endif
+}
+
+static void unmapFile(Mapping* map) {
+	if (!map->data) return;
+#ifndef _WIN32
+	munmap((void*) map->data, map->size);
+#else
+	memFree((void*) map->data);
+#endif
+	map->data = NULL;
+}
+
+static bool validString(uint32_t offset, uint32_t stringsSize, bool optional) {
+	return offset < stringsSize || (optional && offset == NO_STRING);
+}
+
+// Checks that every count, string and index stays inside the file, returns why the file cannot be used or NULL
+static const char* validatePrecompiled(const uint8_t* data, size_t size) {
+	if (size < sizeof(ADECLCHeader)) return "it is truncated";
+
+	const ADECLCHeader* header = (const ADECLCHeader*) data;
+	if (memcmp(header->magic, ADECLC_MAGIC, sizeof(header->magic)) != 0) return "it is not a precompiled ADECL file";
+	if (header->version != ADECLC_VERSION || header->byteOrder != ADECLC_BYTE_ORDER) return "it was made by another version of the assembler or on another kind of machine";
+
+	uint64_t expected = sizeof(ADECLCHeader) + (uint64_t) header->symbolCount * sizeof(SymbolRecord) +
+		(uint64_t) header->structCount * sizeof(StructRecord) + (uint64_t) header->fieldCount * sizeof(FieldRecord) +
+		header->stringsSize;
+	if (expected != size) return "its size does not match its header";
+
+	const SymbolRecord* symbols = (const SymbolRecord*) (data + sizeof(ADECLCHeader));
+	const StructRecord* structs = (const StructRecord*) (symbols + header->symbolCount);
+	const FieldRecord* fields = (const FieldRecord*) (structs + header->structCount);
+	const char* strings = (const char*) (fields + header->fieldCount);
+	uint32_t stringsSize = header->stringsSize;
+	int32_t structCount = (int32_t) header->structCount;
+
+	// With the pool ending in a null, any offset inside it is a terminated string
+	if (stringsSize > 0 && strings[stringsSize - 1] != '\0') return "its strings are not terminated";
+
+	for (uint32_t i = 0; i < header->symbolCount; i++) {
+		const SymbolRecord* symbol = &symbols[i];
+		if (!validString(symbol->name, stringsSize, false) || !validString(symbol->source, stringsSize, true)) return "a symbol is corrupted";
+		if (symbol->structTypeIdx < -1 || symbol->structTypeIdx >= structCount) return "a symbol is corrupted";
+		if (GET_EXPRESSION(symbol->flags) == E_EXPR) return "a symbol is corrupted";
+	}
+
+	for (uint32_t i = 0; i < header->structCount; i++) {
+		const StructRecord* root = &structs[i];
+		if (!validString(root->name, stringsSize, false) || !validString(root->source, stringsSize, true)) return "a struct is corrupted";
+		if ((uint64_t) root->firstField + root->fieldCount > header->fieldCount) return "a struct is corrupted";
+	}
+
+	for (uint32_t i = 0; i < header->fieldCount; i++) {
+		const FieldRecord* field = &fields[i];
+		if (!validString(field->name, stringsSize, false) || !validString(field->source, stringsSize, true)) return "a struct field is corrupted";
+		if (field->type > UNION_FT || field->structTypeIdx < -1 || field->structTypeIdx >= structCount) return "a struct field is corrupted";
+	}
+
+	return NULL;
+}
+
+// The lines of an image are kept in the source map as lines of a file of their own
+static srcloc_t loadSource(SourceMap* sources, uint32_t file, const char* strings, uint32_t offset, int32_t linenum) {
+	if (linenum <= 0) return NO_LOC;
+
+	srcloc_t loc = sourceLoc(sources, file, linenum);
+	if (offset != NO_STRING) keepSourceLine(sources, loc, strings + offset);
+
+	return loc;
+}
+
+// The records are already checked, each one becomes a table entry the same way the parser would have made it
+static void loadTables(ADECL_ctx* context, const uint8_t* data) {
+	const ADECLCHeader* header = (const ADECLCHeader*) data;
+	const SymbolRecord* symbols = (const SymbolRecord*) (data + sizeof(ADECLCHeader));
+	const StructRecord* structs = (const StructRecord*) (symbols + header->symbolCount);
+	const FieldRecord* fields = (const FieldRecord*) (structs + header->structCount);
+	const char* strings = (const char*) (fields + header->fieldCount);
+
+	SymbolTable* symbolTable = initSymbolTable();
+	StructTable* structTable = initStructTable();
+	SourceMap* sources = &context->as->sources;
+	uint32_t file = addSourceFile(sources);
+
+	for (uint32_t i = 0; i < header->structCount; i++) {
+		const StructRecord* record = &structs[i];
+		struct_root_t* root = initStruct(strings + record->name);
+		root->size = (int) record->size;
+		root->loc = loadSource(sources, file, strings, record->source, record->linenum);
+
+		for (uint32_t j = record->firstField; j < record->firstField + record->fieldCount; j++) {
+			const FieldRecord* fieldRecord = &fields[j];
+			struct_field_t* field = initStructField(strings + fieldRecord->name, (structFieldType) fieldRecord->type,
+				fieldRecord->size, fieldRecord->offset, fieldRecord->structTypeIdx);
+			field->loc = loadSource(sources, file, strings, fieldRecord->source, fieldRecord->linenum);
+			addStructField(root, field);
+		}
+
+		addStruct(structTable, root);
+	}
+
+	for (uint32_t i = 0; i < header->symbolCount; i++) {
+		const SymbolRecord* record = &symbols[i];
+		symb_entry_t* entry = initSymbolEntry(strings + record->name, record->flags, NULL, record->value,
+			loadSource(sources, file, strings, record->source, record->linenum));
+		entry->size = record->size;
+		entry->structTypeIdx = record->structTypeIdx;
+		addSymbolEntry(symbolTable, entry);
+	}
+
+	context->symbolTable = symbolTable;
+	context->structTable = structTable;
+	context->asts = NULL;
+	context->astCount = 0;
+	context->astCapacity = 0;
+}
+
+// Loads a precompiled file given directly to `.include`, which must then be usable, or the sibling of an ADECL file of the given hash
+static bool loadPrecompiled(ADECL_ctx* context, const char* path, const uint8_t* sourceHash) {
+	ArxAssembler* as = context->as;
+	bool direct = sourceHash == NULL;
+
+	Mapping map;
+	if (!mapFile(path, &map)) {
+		if (direct) emitError(ERR_IO, NULL, "Failed to open precompiled file `%s` for `.include` directive.", path);
+		return false;
+	}
+
+	const char* problem = validatePrecompiled(map.data, map.size);
+	const ADECLCHeader* header = (const ADECLCHeader*) map.data;
+	if (!problem && header->features != as->config.enhancedFeatures) problem = "it was made with other enhanced features";
+	if (!problem && !direct && memcmp(sourceHash, header->sourceHash, SHA256_DIGEST_LEN) != 0) problem = "it is out of date";
+
+	if (problem) {
+		unmapFile(&map);
+		if (direct) emitError(ERR_IO, NULL, "Precompiled file `%s` cannot be used, %s.", path, problem);
+		log("Not using `%s`, %s.", path, problem);
+		return false;
+	}
+
+	traceBegin("adecl", "load %s", path);
+	loadTables(context, map.data);
+	unmapFile(&map);
+	traceEnd();
+
+	if (as->config.makeDeps) addDependency(&as->dependencies, path);
+
+	return true;
+}
+
+
+// The declarations the process already read, by the hash of their ADECL file and the features it was parsed with
+// Each one is the image a precompiled file would hold, allocated outside of any context and never changed or freed once stored,
+// so batch workers and server requests share them, and read them without holding the lock
+typedef struct CachedImage {
+	const uint8_t* data;
+	size_t size;
+	struct CachedImage* next;
+} CachedImage;
+
+#define MEMO_BUCKETS 256 // Picked by the first byte of the hash
+#define MEMO_LIMIT ((size_t) 64 << 20) // Bytes, files read once the cache is full are lexed each time
+
+static CachedImage* memo[MEMO_BUCKETS];
+static size_t memoSize;
+static mutex_t memoLock = MUTEX_INITIALIZER;
+
+static const CachedImage* lookupImage(const uint8_t sourceHash[SHA256_DIGEST_LEN], uint32_t features) {
+	const CachedImage* image = memo[sourceHash[0]];
+	while (image) {
+		const ADECLCHeader* header = (const ADECLCHeader*) image->data;
+		if (header->features == features && memcmp(header->sourceHash, sourceHash, SHA256_DIGEST_LEN) == 0) break;
+		image = image->next;
+	}
+
+	return image;
+}
+
+static const uint8_t* findImage(const uint8_t sourceHash[SHA256_DIGEST_LEN], uint32_t features) {
+	mutexLock(&memoLock);
+	const CachedImage* image = lookupImage(sourceHash, features);
+	mutexUnlock(&memoLock);
+
+	return image ? image->data : NULL;
+}
+
+// Takes the image, which is dropped if the same file got stored meanwhile or the cache is full
+static void storeImage(uint8_t* data, size_t size) {
+	const ADECLCHeader* header = (const ADECLCHeader*) data;
+	CachedImage* image = (CachedImage*) memAllocWith(NULL, MEM_SYMTAB, sizeof(CachedImage));
+
+	bool stored = false;
+	mutexLock(&memoLock);
+	if (image && memoSize + size <= MEMO_LIMIT && !lookupImage(header->sourceHash, header->features)) {
+		*image = (CachedImage) { .data = data, .size = size, .next = memo[header->sourceHash[0]] };
+		memo[header->sourceHash[0]] = image;
+		memoSize += size;
+		stored = true;
+	}
+	mutexUnlock(&memoLock);
+
+	if (!stored) {
+		memFree(image);
+		memFree(data);
+	}
+}
+
+// Keeps the declarations of a file that was just lexed, once its `.set`s are evaluated
+static void rememberParsed(ADECL_ctx* context, const uint8_t sourceHash[SHA256_DIGEST_LEN], const char* path) {
+	SymbolTable* table = context->symbolTable;
+
+	// Its hash would not cover the files it includes
+	if (context->includes) return;
+
+	// A file using symbols it does not define can only be evaluated along with what includes it
+	for (uint32_t i = 0; i < table->size; i++) {
+		symb_entry_t* entry = table->entries[i];
+		if (!GET_DEFINED(entry->flags)) return;
+		if (GET_EXPRESSION(entry->flags) == E_EXPR && !entry->value.expr) return;
+	}
+
+	evaluateSymbols(table, path);
+
+	ADECLCHeader header = makeHeader(context->as->config.enhancedFeatures);
+	memcpy(header.sourceHash, sourceHash, SHA256_DIGEST_LEN);
+
+	size_t size;
+	uint8_t* image = buildImage(&header, context, &size);
+	storeImage(image, size);
+}
+
+bool loadADECL(ADECL_ctx* context, const char* path) {
+	initScope("loadADECL()");
+
+	ArxAssembler* as = context->as;
+	size_t len = strlen(path);
+	if (len > 7 && strcmp(path + len - 7, ".adeclc") == 0) return loadPrecompiled(context, path, NULL);
+
+	FILE* file = openADECLFile(as, path);
+	if (!file) return false;
+
+	uint8_t digest[SHA256_DIGEST_LEN];
+	if (!hashStream(file, digest)) {
+		fclose(file);
+		emitError(ERR_IO, NULL, "Failed to read ADECL file `%s`.", path);
+	}
+
+	// The ADECL file was only read to check that the precompiled or cached declarations are still its own
+	sds sibling = sdscat(sdsnew(path), "c");
+	if (!sibling) emitError(ERR_MEM, NULL, "Failed to allocate memory for a precompiled file name.");
+	bool loaded = loadPrecompiled(context, sibling, digest);
+	sdsfree(sibling);
+
+	if (!loaded) {
+		const uint8_t* image = findImage(digest, as->config.enhancedFeatures);
+		if (image) {
+			traceBegin("adecl", "reuse %s", path);
+			loadTables(context, image);
+			traceEnd();
+			loaded = true;
+		}
+	}
+	if (loaded) {
+		fclose(file);
+		return true;
+	}
+
+	rewind(file);
+	int diagnostics = as->errorCount + as->warningCount;
+	lexParseADECLFile(file, context);
+
+	// Reusing declarations skips their diagnostics, so only files without any are kept
+	if (as->errorCount + as->warningCount == diagnostics) rememberParsed(context, digest, path);
+
+	return true;
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "allocator.h"
+
+
+// Every block is prefixed with a small header holding its size and tag,
+// so frees and reallocations can be accounted without the caller passing them in
+// It also keeps the hooks the block came from, a block may be freed after its owner stopped being current
+// Blocks allocated under an owner are also linked into the owner's list,
+// `pprev` points at whatever points at the block so that unlinking does not need the owner
+// The union keeps the payload aligned the same way malloc would
+typedef union BlockHeader {
+	struct {
+		size_t size;
+		memTag tag;
+		const mem_hooks_t* hooks; // NULL for malloc
+		union BlockHeader* next;
+		union BlockHeader** pprev; // NULL when the block has no owner
+	};
+	max_align_t _align;
+} block_hdr_t;
+
+static _Thread_local mem_owner_t* currentOwner = NULL;
+
+static mem_stats_t stats[MEM_TAG_COUNT];
+static mem_stats_t total;
+
+static const char* tagnames[MEM_TAG_COUNT] = {
+	"lexer",
+	"tokens",
+	"ast",
+	"symtab",
+	"datatab",
+	"reloc",
+	"codegen",
+	"output",
+	"pool",
+	"context",
+	"strings"
+};
+
+
+// Workers allocate concurrently in batch mode, so every counter is updated atomically
+static void accountResize(mem_stats_t* stat, size_t oldSize, size_t newSize) {
+	// Unsigned wrap around makes this work for shrinking as well
+	size_t live = __atomic_add_fetch(&stat->live, newSize - oldSize, __ATOMIC_RELAXED);
+
+	size_t peak = __atomic_load_n(&stat->peak, __ATOMIC_RELAXED);
+	while (live > peak && !__atomic_compare_exchange_n(&stat->peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void accountAlloc(memTag tag, size_t size) {
+	accountResize(&stats[tag], 0, size);
+	accountResize(&total, 0, size);
+	__atomic_add_fetch(&stats[tag].allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&total.allocs, 1, __ATOMIC_RELAXED);
+}
+
+static void accountFree(memTag tag, size_t size) {
+	__atomic_sub_fetch(&stats[tag].live, size, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&total.live, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats[tag].frees, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&total.frees, 1, __ATOMIC_RELAXED);
+}
+
+static void unlinkBlock(block_hdr_t* hdr) {
+	if (!hdr->pprev) return;
+
+	*hdr->pprev = hdr->next;
+	if (hdr->next) hdr->next->pprev = hdr->pprev;
+	hdr->next = NULL;
+	hdr->pprev = NULL;
+}
+
+static void releaseBlock(block_hdr_t* hdr) {
+	accountFree(hdr->tag, hdr->size);
+
+	if (hdr->hooks) hdr->hooks->free(hdr, hdr->hooks->userData);
+	else free(hdr);
+}
+
+void* memAllocWith(const mem_hooks_t* hooks, memTag tag, size_t size) {
+	if (size > SIZE_MAX - sizeof(block_hdr_t)) return NULL;
+
+	block_hdr_t* hdr;
+	if (hooks) hdr = (block_hdr_t*) hooks->alloc(sizeof(block_hdr_t) + size, hooks->userData);
+	else hdr = (block_hdr_t*) malloc(sizeof(block_hdr_t) + size);
+	if (!hdr) return NULL;
+
+	hdr->size = size;
+	hdr->tag = tag;
+	hdr->hooks = hooks;
+	hdr->next = NULL;
+	hdr->pprev = NULL;
+	accountAlloc(tag, size);
+
+	return hdr + 1;
+}
+
+void* memAlloc(memTag tag, size_t size) {
+	mem_owner_t* owner = currentOwner;
+
+	void* ptr = memAllocWith(owner ? owner->hooks : NULL, tag, size);
+	if (!ptr || !owner) return ptr;
+
+	block_hdr_t* hdr = ((block_hdr_t*) ptr) - 1;
+	block_hdr_t** head = (block_hdr_t**) &owner->blocks;
+	hdr->next = *head;
+	if (hdr->next) hdr->next->pprev = &hdr->next;
+	hdr->pprev = head;
+	*head = hdr;
+
+	return ptr;
+}
+
+void* memCalloc(memTag tag, size_t count, size_t size) {
+	if (size && count > SIZE_MAX / size) return NULL;
+
+	void* ptr = memAlloc(tag, count * size);
+	if (ptr) memset(ptr, 0, count * size);
+
+	return ptr;
+}
+
+void* memRealloc(memTag tag, void* ptr, size_t size) {
+	if (!ptr) return memAlloc(tag, size);
+	if (size > SIZE_MAX - sizeof(block_hdr_t)) return NULL;
+
+	block_hdr_t* hdr = ((block_hdr_t*) ptr) - 1;
+	size_t oldSize = hdr->size;
+	memTag oldTag = hdr->tag;
+	const mem_hooks_t* hooks = hdr->hooks;
+
+	block_hdr_t* temp;
+	if (hooks) temp = (block_hdr_t*) hooks->realloc(hdr, sizeof(block_hdr_t) + size, hooks->userData);
+	else temp = (block_hdr_t*) realloc(hdr, sizeof(block_hdr_t) + size);
+	if (!temp) return NULL;
+
+	temp->size = size;
+
+	// The block may have moved, what pointed at it has to follow
+	if (temp->pprev) {
+		*temp->pprev = temp;
+		if (temp->next) temp->next->pprev = &temp->next;
+	}
+
+	accountResize(&stats[oldTag], oldSize, size);
+	accountResize(&total, oldSize, size);
+
+	return temp + 1;
+}
+
+char* memStrdup(memTag tag, const char* str) {
+	size_t len = strlen(str) + 1;
+
+	char* dup = (char*) memAlloc(tag, len);
+	if (dup) memcpy(dup, str, len);
+
+	return dup;
+}
+
+void memFree(void* ptr) {
+	if (!ptr) return;
+
+	block_hdr_t* hdr = ((block_hdr_t*) ptr) - 1;
+	unlinkBlock(hdr);
+	releaseBlock(hdr);
+}
+
+void memDisown(void* ptr) {
+	if (!ptr) return;
+
+	unlinkBlock(((block_hdr_t*) ptr) - 1);
+}
+
+void memAdoptOwner(mem_owner_t* owner, mem_owner_t* from) {
+	block_hdr_t* first = (block_hdr_t*) from->blocks;
+	if (!first) return;
+
+	// The blocks of `from` go in front of the owner's
+	block_hdr_t* last = first;
+	while (last->next) last = last->next;
+	last->next = (block_hdr_t*) owner->blocks;
+	if (last->next) last->next->pprev = &last->next;
+	first->pprev = (block_hdr_t**) &owner->blocks;
+	owner->blocks = first;
+	from->blocks = NULL;
+}
+
+mem_owner_t* memSetOwner(mem_owner_t* owner) {
+	mem_owner_t* previous = currentOwner;
+	currentOwner = owner;
+	return previous;
+}
+
+void memReleaseOwner(mem_owner_t* owner) {
+	block_hdr_t* hdr = (block_hdr_t*) owner->blocks;
+	while (hdr) {
+		block_hdr_t* next = hdr->next;
+		releaseBlock(hdr);
+		hdr = next;
+	}
+	owner->blocks = NULL;
+}
+
+// The common libraries are linked with malloc, free and friends renamed to these (see `hookedlibs` in the Makefile)
+// Their blocks go under the current owner, so a failed assembly releases its strings along with the rest
+
+void* memLibMalloc(size_t size) {
+	return memAlloc(MEM_STRINGS, size);
+}
+
+void* memLibCalloc(size_t count, size_t size) {
+	return memCalloc(MEM_STRINGS, count, size);
+}
+
+void* memLibRealloc(void* ptr, size_t size) {
+	return memRealloc(MEM_STRINGS, ptr, size);
+}
+
+void memLibFree(void* ptr) {
+	memFree(ptr);
+}
+
+char* memLibStrdup(const char* str) {
+	return memStrdup(MEM_STRINGS, str);
+}
+
+char* memLibStrndup(const char* str, size_t n) {
+	size_t len = strnlen(str, n);
+
+	char* dup = (char*) memAlloc(MEM_STRINGS, len + 1);
+	if (dup) {
+		memcpy(dup, str, len);
+		dup[len] = '\0';
+	}
+
+	return dup;
+}
+
+mem_stats_t getMemStats(memTag tag) {
+	return stats[tag];
+}
+
+void displayMemStats() {
+	fprintf(stderr, "Memory usage:\n");
+	fprintf(stderr, "  %-8s %12s %12s %10s %10s\n", "tag", "live", "peak", "allocs", "frees");
+	for (int i = 0; i < MEM_TAG_COUNT; i++) {
+		mem_stats_t* stat = &stats[i];
+		fprintf(stderr, "  %-8s %12zu %12zu %10llu %10llu\n", tagnames[i], stat->live, stat->peak,
+			(unsigned long long) stat->allocs, (unsigned long long) stat->frees);
+	}
+	fprintf(stderr, "  %-8s %12zu %12zu %10llu %10llu\n", "total", total.live, total.peak,
+		(unsigned long long) total.allocs, (unsigned long long) total.frees);
+}
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arxsm.h"
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "allocator.h"
+
+
+// Everything one call builds, so that it can be torn down in one place
+typedef struct Assembly {
+	ArxAssembler* as;
+	Lexer* lexer;
+	Parser* parser;
+	SymbolTable* symbolTable;
+	SectionTable* sectionTable;
+	StructTable* structTable;
+	DataTable* dataTable;
+	RelocTable* relocTable;
+	CodeGen* codegen;
+} Assembly;
+
+
+// Feeds the buffer to the lexer line by line, each line keeping its newline like getline would
+static arxStatus lexBuffer(Lexer* lexer, const char* src, size_t len) {
+	arxStatus status = reserveSource(lexer, len);
+	if (status != ARX_OK) return status;
+
+	char* line = NULL;
+	size_t capacity = 0;
+
+	// Like the command line, the lines after an error are lexed for their own errors while under the error limit
+	size_t pos = 0;
+	while (pos < len && (status == ARX_OK || arxRecoverable(lexer->as))) {
+		const char* newline = memchr(src + pos, '\n', len - pos);
+		size_t lineLen = newline ? (size_t) (newline - (src + pos)) + 1 : len - pos;
+
+		if (lineLen + 1 > capacity) {
+			capacity = lineLen + 1;
+			// The buffer is allocated outside of any frame, so it takes the hooks of the context explicitly
+			char* temp;
+			if (line) temp = (char*) memRealloc(MEM_LEXER, line, capacity);
+			else temp = (char*) memAllocWith(lexer->as->memory.hooks, MEM_LEXER, capacity);
+			if (!temp) {
+				status = ARX_FAILED;
+				break;
+			}
+			line = temp;
+		}
+		memcpy(line, src + pos, lineLen);
+		line[lineLen] = '\0';
+
+		if (lexLine(lexer, line) != ARX_OK) status = ARX_FAILED;
+		pos += lineLen;
+	}
+
+	memFree(line);
+
+	return status;
+}
+
+static arxStatus initTables(Assembly* assembly) {
+	ArxFrame frame;
+	arxEnter(assembly->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		assembly->symbolTable = initSymbolTable();
+		assembly->sectionTable = initSectionTable();
+		assembly->structTable = initStructTable();
+		assembly->dataTable = initDataTable();
+		assembly->relocTable = initRelocTable();
+	}
+
+	return arxLeave(&frame);
+}
+
+static arxStatus run(Assembly* assembly, const char* src, size_t len, ArxOutput* output) {
+	ArxAssembler* as = assembly->as;
+
+	assembly->lexer = initLexer(as);
+	if (!assembly->lexer) return ARX_FAILED;
+	if (lexBuffer(assembly->lexer, src, len) != ARX_OK) return ARX_FAILED;
+
+	if (initTables(assembly) != ARX_OK) return ARX_FAILED;
+	assembly->parser = initParser(as, assembly->lexer->tokens, assembly->lexer->tokenCount);
+	if (!assembly->parser) return ARX_FAILED;
+	setTables(assembly->parser, assembly->sectionTable, assembly->symbolTable, assembly->structTable, assembly->dataTable, assembly->relocTable);
+	if (parse(assembly->parser) != ARX_OK) return ARX_FAILED;
+
+	// Nothing of the parse points into the tokens, they are freed before the code is generated
+	deinitLexer(assembly->lexer);
+	assembly->lexer = NULL;
+	assembly->parser->tokens = NULL;
+	assembly->parser->tokenCount = 0;
+
+	assembly->codegen = initCodeGenerator(as, assembly->sectionTable, assembly->symbolTable, assembly->relocTable);
+	if (!assembly->codegen) return ARX_FAILED;
+	if (gencode(assembly->parser, assembly->codegen) != ARX_OK) return ARX_FAILED;
+
+	if (writeBinaryToBuffer(assembly->codegen, &output->image, &output->size) != ARX_OK) return ARX_FAILED;
+	// The image belongs to the caller now, it must survive the context
+	memDisown(output->image);
+
+	return ARX_OK;
+}
+
+arxStatus arxsm_assemble(const char* src, size_t len, const ArxOptions* options, ArxOutput* output) {
+	*output = (ArxOutput) {0};
+
+	Config config = {
+		.useDebugSymbols = options ? options->useDebugSymbols : false,
+		.warningAsFatal = options ? options->warningAsFatal : false,
+		.warnings = options ? options->warnings : WARN_FLAG_ALL,
+		.enhancedFeatures = options ? options->enhancedFeatures : FEATURE_NONE,
+		.errorLimit = options ? options->errorLimit : DEFAULT_ERROR_LIMIT
+	};
+
+	Assembly assembly = {0};
+	assembly.as = initAssembler(config, options ? options->allocator : NULL);
+	if (!assembly.as) return ARX_FAILED;
+
+	if (options) {
+		assembly.as->filename = options->name;
+		setDiagnosticSink(assembly.as, options->sink, options->sinkCtx);
+	}
+
+	arxStatus status = run(&assembly, src, len, output);
+
+	output->errorCount = assembly.as->errorCount;
+	output->warningCount = assembly.as->warningCount;
+
+	if (status == ARX_OK) {
+		deinitCodeGenerator(assembly.codegen);
+		deinitParser(assembly.parser);
+		deinitStructTable(assembly.structTable);
+		deinitSectionTable(assembly.sectionTable);
+		deinitSymbolTable(assembly.symbolTable);
+		deinitDataTable(assembly.dataTable);
+		deinitRelocTable(assembly.relocTable);
+		if (assembly.lexer) deinitLexer(assembly.lexer);
+	}
+	// After a failure the structures are left to the context
+	deinitAssembler(assembly.as);
+
+	return status;
+}
+
+void arxsm_free_output(ArxOutput* output) {
+	memFree(output->image);
+	output->image = NULL;
+	output->size = 0;
+}
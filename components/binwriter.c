@@ -4,14 +4,62 @@
 
 #include "codegen.h"
 #include "diagnostics.h"
+#include "allocator.h"
 #include "aoef.h"
+#include "trace.h"
 
 
+// Where the image goes, either straight to a file or into a buffer that grows as it is written
+typedef struct Output {
+	FILE* file;
+	uint8_t* buffer;
+	size_t size;
+	size_t capacity;
+} Output;
 
 
-static uint32_t getSymbolStringsSize(SymbolTable* symbTable) {
-	uint32_t totalSize = 16; // Table has ending string of size 16
-	for (uint32_t i = 0; i < symbTable->size; i++) {
+static void emit(Output* out, const void* data, size_t size, size_t count) {
+	size_t bytes = size * count;
+
+	if (out->file) {
+		if (fwrite(data, size, count, out->file) != count) emitError(ERR_IO, NULL, "Failed to write output file.");
+		return;
+	}
+
+	if (out->size + bytes > out->capacity) {
+		size_t capacity = out->capacity ? out->capacity : 1024;
+		while (capacity < out->size + bytes) capacity *= 2;
+
+		uint8_t* temp = (uint8_t*) memRealloc(MEM_OUTPUT, out->buffer, capacity);
+		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for output image.");
+		out->buffer = temp;
+		out->capacity = capacity;
+	}
+
+	memcpy(out->buffer + out->size, data, bytes);
+	out->size += bytes;
+}
+
+// The part of a section that `spillCode` moved out of the buffers, it comes first
+static void emitSpilled(Output* out, FILE* spill) {
+	if (!spill) return;
+
+	uint8_t block[8192];
+	size_t read;
+	rewind(spill);
+	while ((read = fread(block, sizeof(uint8_t), sizeof(block), spill)) > 0) emit(out, block, sizeof(uint8_t), read);
+	if (ferror(spill)) emitError(ERR_IO, NULL, "Failed to read back a spilled section.");
+}
+
+// Counts, sizes and offsets are 64 bits until they go in the object, whose fields only have 32
+static uint32_t fitAOEFF(size_t value, const char* what) {
+	if (value > UINT32_MAX) emitError(ERR_UNSUPPORTED, NULL, "The %s (%zu) does not fit in the 32 bits of an AOEFF object.", what, value);
+	return (uint32_t) value;
+}
+
+static size_t getSymbolStringsSize(SymbolTable* symbTable) {
+	size_t totalSize = 16; // Table has ending string of size 16
+	for (size_t i = 0; i < symbTable->size; i++) {
 		symb_entry_t* entry = symbTable->entries[i];
 		totalSize += strlen(entry->name) + 1; // +1 for null terminator
 	}
@@ -37,24 +85,6 @@ static char* nstrcat(char* dest, const char* src) {
 	return dest;
 }
 
-/**
- * Like `strncat` but preserves the previous null byte instead.
- * @param dest
- * @param src
- */
-static char* nstrncat(char* dest, const char* src, size_t n) {
-	for (size_t i = 0; i < n && src[i] != '\0'; i++) {
-		*dest = src[i];
-		dest++;
-	}
-
-	*dest = '\0';
-	dest++;
-
-	return dest;
-}
-
-
 static AOEFFSectHdr* generateSectionHeaders(SectionTable* sectTable, uint32_t sectOff) {
 	int sectEntries = 0;
 	for (int i = 0; i < 6; i++) {
@@ -62,19 +92,19 @@ static AOEFFSectHdr* generateSectionHeaders(SectionTable* sectTable, uint32_t se
 	}
 	sectEntries++; // ending blank entry
 
-	AOEFFSectHdr* headers = (AOEFFSectHdr*) calloc(sectEntries, sizeof(AOEFFSectHdr));
+	AOEFFSectHdr* headers = (AOEFFSectHdr*) memCalloc(MEM_OUTPUT, sectEntries, sizeof(AOEFFSectHdr));
 	if (!headers) emitError(ERR_MEM, NULL, "Failed to allocate memory for section headers.");
 
 	// Offset where all sections start at, basically the end of the relocation table
 	uint32_t baseOffset = sectOff;
 	rlog("Base offset for all section data: 0x%x\n", baseOffset);
-	uint32_t sectOffset = baseOffset;
+	size_t sectOffset = baseOffset;
 	for (int i = 0, hdrIdx = 0; i < 6; i++) {
 		if (sectTable->entries[i].size == 0) continue;
 
 		headers[hdrIdx] = (AOEFFSectHdr) {
 			.shSectName = {0},
-			.shSectOff = sectOffset,
+			.shSectOff = fitAOEFF(sectOffset, "section offset"),
 			.shSectSize = sectTable->entries[i].size,
 		};
 
@@ -92,7 +122,7 @@ static AOEFFSectHdr* generateSectionHeaders(SectionTable* sectTable, uint32_t se
 		}
 		strncpy(headers[hdrIdx].shSectName, sectName, 8);
 
-		log("Section %s starts at 0x%x\n", sectName, sectOffset);
+		log("Section %s starts at 0x%zx\n", sectName, sectOffset);
 
 		if (i != BSS_SECT_N) sectOffset += sectTable->entries[i].size;
 		hdrIdx++;
@@ -101,30 +131,30 @@ static AOEFFSectHdr* generateSectionHeaders(SectionTable* sectTable, uint32_t se
 	return headers;
 }
 
-static AOEFFSymEnt* generateSymbolTable(SymbolTable* symbTable, uint32_t strTabSize, char** outStrTab) {
-	uint32_t symbTableSize = symbTable->size;
+static AOEFFSymEnt* generateSymbolTable(SymbolTable* symbTable, size_t strTabSize, char** outStrTab) {
+	size_t symbTableSize = symbTable->size;
 	// Including empty ending symbol
 	symbTableSize++;
 
-	AOEFFSymEnt* entries = (AOEFFSymEnt*) malloc(sizeof(AOEFFSymEnt) * symbTableSize);
+	AOEFFSymEnt* entries = (AOEFFSymEnt*) memAlloc(MEM_OUTPUT, sizeof(AOEFFSymEnt) * symbTableSize);
 	if (!entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol table.");
 
 	// Build string table at the same time
-	char* strTab = (char*) malloc(sizeof(char) * strTabSize);
+	char* strTab = (char*) memAlloc(MEM_OUTPUT, sizeof(char) * strTabSize);
 	if (!strTab) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol string table.");
 
 	char* stStrs = strTab;
 
-	uint32_t stridx = 0;
+	size_t stridx = 0;
 
-	for (uint32_t i = 0; i < symbTable->size; i++) {
+	for (size_t i = 0; i < symbTable->size; i++) {
 		symb_entry_t* symb = symbTable->entries[i];
 
 		uint32_t sect = GET_SECTION(symb->flags);
 		if (sect == S_UNDEF) sect = SE_SECT_UNDEF; // Undefined section in AOEFF
 
 		entries[i] = (AOEFFSymEnt) {
-			.seSymbName = stridx,
+			.seSymbName = (uint32_t) stridx, // Below the size of the string table, which was checked
 			.seSymbSize = symb->size,
 			.seSymbVal = symb->value.val,
 			.seSymbInfo = SE_SET_INFO(GET_MAIN_TYPE(symb->flags), GET_LOCALITY(symb->flags)),
@@ -134,7 +164,8 @@ static AOEFFSymEnt* generateSymbolTable(SymbolTable* symbTable, uint32_t strTabS
 		stridx += strlen(symb->name) + 1;
 	}
 
-	nstrncat(stStrs, "END_AOEFF_STRS\0", 16);
+	// All 16 bytes of the terminator, copying up to the first null would leave the last byte uninitialized
+	memcpy(stStrs, "END_AOEFF_STRS\0", 16);
 
 	// Add end blank entry
 	entries[symbTableSize-1] = (AOEFFSymEnt) {
@@ -151,14 +182,14 @@ static AOEFFSymEnt* generateSymbolTable(SymbolTable* symbTable, uint32_t strTabS
 }
 
 static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelStrTab, uint32_t* outRelStrSize, uint32_t* outRelTabCount) {
-	AOEFFTRelTab* relocTables = (AOEFFTRelTab*) malloc(sizeof(AOEFFTRelTab) * 4);
+	AOEFFTRelTab* relocTables = (AOEFFTRelTab*) memAlloc(MEM_OUTPUT, sizeof(AOEFFTRelTab) * 4);
 	if (!relocTables) emitError(ERR_MEM, NULL, "Failed to allocate memory for relocation tables.");
 
 
 	// Names are:
 	// ".trel.text", ".trel.data", ".trel.const", ".trel.evt"
 	// Allocate space for all four but only report what was used
-	char* relStrTab = (char*) malloc( sizeof(char) * (strlen(".trel.text") + 1 + strlen(".trel.data") + 1 + strlen(".trel.const") + 1 + strlen(".trel.evt") + 1) );
+	char* relStrTab = (char*) memAlloc(MEM_OUTPUT,  sizeof(char) * (strlen(".trel.text") + 1 + strlen(".trel.data") + 1 + strlen(".trel.const") + 1 + strlen(".trel.evt") + 1) );
 	if (!relStrTab) emitError(ERR_MEM, NULL, "Failed to allocate memory for relocation string table.");
 
 	char* rstStrs = relStrTab;
@@ -170,8 +201,8 @@ static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelSt
 		AOEFFTRelTab* textRelTab = &relocTables[relocTableCount];
 		textRelTab->relSect = TEXT_SECT_N;
 		textRelTab->relTabName = stridx;
-		textRelTab->relCount = relocTable->textRelocTable.entryCount;
-		textRelTab->relEntries = (AOEFFTRelEnt*) malloc(sizeof(AOEFFTRelEnt) * textRelTab->relCount);
+		textRelTab->relCount = fitAOEFF(relocTable->textRelocTable.entryCount, "count of relocations");
+		textRelTab->relEntries = (AOEFFTRelEnt*) memAlloc(MEM_OUTPUT, sizeof(AOEFFTRelEnt) * textRelTab->relCount);
 		if (!textRelTab->relEntries) emitError(ERR_MEM, NULL, "Failed to allocate memory for text relocation entries.");
 
 		for (uint32_t i = 0; i < textRelTab->relCount; i++) {
@@ -196,8 +227,8 @@ static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelSt
 		AOEFFTRelTab* dataRelTab = &relocTables[relocTableCount];
 		dataRelTab->relSect = DATA_SECT_N;
 		dataRelTab->relTabName = stridx;
-		dataRelTab->relCount = relocTable->dataRelocTable.entryCount;
-		dataRelTab->relEntries = (AOEFFTRelEnt*) malloc(sizeof(AOEFFTRelEnt) * dataRelTab->relCount);
+		dataRelTab->relCount = fitAOEFF(relocTable->dataRelocTable.entryCount, "count of relocations");
+		dataRelTab->relEntries = (AOEFFTRelEnt*) memAlloc(MEM_OUTPUT, sizeof(AOEFFTRelEnt) * dataRelTab->relCount);
 		if (!dataRelTab->relEntries) emitError(ERR_MEM, NULL, "Failed to allocate memory for data relocation entries.");
 
 		for (uint32_t i = 0; i < dataRelTab->relCount; i++) {
@@ -222,8 +253,8 @@ static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelSt
 		AOEFFTRelTab* constRelTab = &relocTables[relocTableCount];
 		constRelTab->relSect = CONST_SECT_N;
 		constRelTab->relTabName = stridx;
-		constRelTab->relCount = relocTable->constRelocTable.entryCount;
-		constRelTab->relEntries = (AOEFFTRelEnt*) malloc(sizeof(AOEFFTRelEnt) * constRelTab->relCount);
+		constRelTab->relCount = fitAOEFF(relocTable->constRelocTable.entryCount, "count of relocations");
+		constRelTab->relEntries = (AOEFFTRelEnt*) memAlloc(MEM_OUTPUT, sizeof(AOEFFTRelEnt) * constRelTab->relCount);
 		if (!constRelTab->relEntries) emitError(ERR_MEM, NULL, "Failed to allocate memory for const relocation entries.");
 
 		for (uint32_t i = 0; i < constRelTab->relCount; i++) {
@@ -248,8 +279,8 @@ static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelSt
 		AOEFFTRelTab* evtRelTab = &relocTables[relocTableCount];
 		evtRelTab->relSect = EVT_SECT_N;
 		evtRelTab->relTabName = stridx;
-		evtRelTab->relCount = relocTable->evtRelocTable.entryCount;
-		evtRelTab->relEntries = (AOEFFTRelEnt*) malloc(sizeof(AOEFFTRelEnt) * evtRelTab->relCount);
+		evtRelTab->relCount = fitAOEFF(relocTable->evtRelocTable.entryCount, "count of relocations");
+		evtRelTab->relEntries = (AOEFFTRelEnt*) memAlloc(MEM_OUTPUT, sizeof(AOEFFTRelEnt) * evtRelTab->relCount);
 		if (!evtRelTab->relEntries) emitError(ERR_MEM, NULL, "Failed to allocate memory for evt relocation entries.");
 
 		for (uint32_t i = 0; i < evtRelTab->relCount; i++) {
@@ -280,14 +311,14 @@ static AOEFFTRelTab* generateRelocTables(RelocTable* relocTable, char** outRelSt
 	return relocTables;
 }
 
-static uint32_t getRelTabSize(AOEFFTRelTab* relocTables, uint32_t relTabCount) {
+static size_t getRelTabSize(AOEFFTRelTab* relocTables, uint32_t relTabCount) {
 	// Number of bytes that the whole relocation stuff uses
 	// This means that there is the size of relSect + relTabName first
 	// The after that, there is the array of entries, which is takes up number of entries (relCount) * size of each entry 
 	// relCount then follows that array
 	// All of this is per table with relTabCount tables
 
-	uint32_t totalSize = 0;
+	size_t totalSize = 0;
 
 	for (uint32_t i = 0; i < relTabCount; i++) {
 		AOEFFTRelTab* tab = &relocTables[i];
@@ -302,36 +333,34 @@ static uint32_t getRelTabSize(AOEFFTRelTab* relocTables, uint32_t relTabCount) {
 	return totalSize;
 }
 
-void writeBinary(CodeGen* codegen, const char* filename) {
+static void writeAOEFF(CodeGen* codegen, Output* out) {
 	initScope("writeBinary");
 
-	FILE* outfile = fopen(filename, "wb");
-	if (!outfile) emitError(ERR_IO, NULL, "Failed to open output file %s for writing.", filename);
-
+	traceBegin("section", "headers and tables");
 	int sectEntries = 0;
 	for (int i = 0; i < 6; i++) {
 		if (codegen->sectionTable->entries[i].size != 0) sectEntries++;
 	}
 	sectEntries++; // ending blank entry
 
-	uint32_t symbTableSize = codegen->symbolTable->size;
+	size_t symbTableSize = codegen->symbolTable->size;
 	// Including empty ending symbol
 	symbTableSize++;
 
-	uint32_t symbOff = sizeof(AOEFFhdr) + (sizeof(AOEFFSectHdr) * sectEntries);
+	size_t symbOff = sizeof(AOEFFhdr) + (sizeof(AOEFFSectHdr) * sectEntries);
 
-	uint32_t strTabOff = symbOff + (sizeof(AOEFFSymEnt) * symbTableSize);
-	uint32_t strTabSize = getSymbolStringsSize(codegen->symbolTable);
+	size_t strTabOff = symbOff + (sizeof(AOEFFSymEnt) * symbTableSize);
+	size_t strTabSize = getSymbolStringsSize(codegen->symbolTable);
 
-	uint32_t relStrOff = strTabOff + strTabSize;
+	size_t relStrOff = strTabOff + strTabSize;
 	uint32_t relStrSize = 0;
 	uint32_t relTabCount = 0; // how many relocation tables there are
 	AOEFFRelStrTab relocStrTab;
 	relocStrTab.rstStrs = NULL;
 	AOEFFTRelTab* relocTables = generateRelocTables(codegen->relocTable, &relocStrTab.rstStrs, &relStrSize, &relTabCount);
-	uint32_t relTabOff = relStrOff + relStrSize;
-	uint32_t relTabSize = getRelTabSize(relocTables, relTabCount);
-	rlog("relTabOff: 0x%x; relTabSize: %d\n", relTabOff, relTabSize);
+	size_t relTabOff = relStrOff + relStrSize;
+	size_t relTabSize = getRelTabSize(relocTables, relTabCount);
+	rlog("relTabOff: 0x%zx; relTabSize: %zu\n", relTabOff, relTabSize);
 
 	// Write header info
 	AOEFFhdr header = {
@@ -340,13 +369,13 @@ void writeBinary(CodeGen* codegen, const char* filename) {
 		.hEntry = 0, // No entry point for object files
 		.hSectOff = sizeof(AOEFFhdr),
 		.hSectSize = sectEntries,
-		.hSymbOff = symbOff,
-		.hSymbSize = symbTableSize,
-		.hStrTabOff = strTabOff,
-		.hStrTabSize = strTabSize,
-		.hRelStrTabOff = relStrOff,
+		.hSymbOff = fitAOEFF(symbOff, "symbol table offset"),
+		.hSymbSize = fitAOEFF(symbTableSize, "count of symbols"),
+		.hStrTabOff = fitAOEFF(strTabOff, "string table offset"),
+		.hStrTabSize = fitAOEFF(strTabSize, "string table size"),
+		.hRelStrTabOff = fitAOEFF(relStrOff, "relocation string table offset"),
 		.hRelStrTabSize = relStrSize,
-		.hTRelTabOff = relTabOff,
+		.hTRelTabOff = fitAOEFF(relTabOff, "relocation table offset"),
 		.hTRelTabSize = relTabCount,
 		.hDRelTabOff = 0, // No dynamic stuff, so the stuff from here down is 0
 		.hDRelTabSize = 0,
@@ -359,27 +388,27 @@ void writeBinary(CodeGen* codegen, const char* filename) {
 		.hExportTabOff = 0,
 		.hExportTabSize = 0
 	};
-	fwrite(&header, sizeof(AOEFFhdr), 1, outfile);
+	emit(out, &header, sizeof(AOEFFhdr), 1);
 
 	// Write section headers
-	AOEFFSectHdr* sectHeaders = generateSectionHeaders(codegen->sectionTable, relTabOff + relTabSize);
-	fwrite(sectHeaders, sizeof(AOEFFSectHdr), sectEntries, outfile);
-	free(sectHeaders);
+	AOEFFSectHdr* sectHeaders = generateSectionHeaders(codegen->sectionTable, fitAOEFF(relTabOff + relTabSize, "section offset"));
+	emit(out, sectHeaders, sizeof(AOEFFSectHdr), sectEntries);
+	memFree(sectHeaders);
 
 	// Write symbol table
 	AOEFFStrTab stringTable;
 	stringTable.stStrs = NULL;
 	AOEFFSymEnt* symbEntries = generateSymbolTable(codegen->symbolTable, strTabSize, &stringTable.stStrs);
-	fwrite(symbEntries, sizeof(AOEFFSymEnt), symbTableSize, outfile);
-	free(symbEntries);
+	emit(out, symbEntries, sizeof(AOEFFSymEnt), symbTableSize);
+	memFree(symbEntries);
 
 	// Write string table
-	fwrite(stringTable.stStrs, sizeof(char), strTabSize, outfile);
-	free(stringTable.stStrs);
+	emit(out, stringTable.stStrs, sizeof(char), strTabSize);
+	memFree(stringTable.stStrs);
 
 	// Write relocation string table
-	fwrite(relocStrTab.rstStrs, sizeof(char), relStrSize, outfile);
-	free(relocStrTab.rstStrs);
+	emit(out, relocStrTab.rstStrs, sizeof(char), relStrSize);
+	memFree(relocStrTab.rstStrs);
 
 	uint8_t zeroBufferPadding[4] = {0, 0, 0, 0};
 
@@ -387,36 +416,74 @@ void writeBinary(CodeGen* codegen, const char* filename) {
 	for (uint32_t i = 0; i < relTabCount; i++) {
 		AOEFFTRelTab* tab = &relocTables[i];
 		rlog("Writing relocation table for section %d with %d entries.\n", tab->relSect, tab->relCount);
-		fwrite(&tab->relSect, sizeof(uint8_t), 1, outfile);
-		fwrite(zeroBufferPadding, sizeof(uint8_t), 3, outfile); // padding
-		fwrite(&tab->relTabName, sizeof(uint32_t), 1, outfile);
-		fwrite(&tab->relCount, sizeof(uint32_t), 1, outfile);
-		fwrite(zeroBufferPadding, sizeof(uint8_t), 4, outfile); // padding
-		fwrite(tab->relEntries, sizeof(AOEFFTRelEnt), tab->relCount, outfile);
-		free(tab->relEntries);
+		emit(out, &tab->relSect, sizeof(uint8_t), 1);
+		emit(out, zeroBufferPadding, sizeof(uint8_t), 3); // padding
+		emit(out, &tab->relTabName, sizeof(uint32_t), 1);
+		emit(out, &tab->relCount, sizeof(uint32_t), 1);
+		emit(out, zeroBufferPadding, sizeof(uint8_t), 4); // padding
+		emit(out, tab->relEntries, sizeof(AOEFFTRelEnt), tab->relCount);
+		memFree(tab->relEntries);
 	}
-	free(relocTables);
+	memFree(relocTables);
+	traceEnd();
 
 	// Write the payload
+	static const char* sectNames[6] = { "data", "const", "bss", "text", "evt", "ivt" };
 	for (int i = 0; i < 6; i++) {
 		if (codegen->sectionTable->entries[i].size == 0) continue;
 		if (i == BSS_SECT_N) continue; // Ignore bss
+
+		traceBegin("section", "write %s", sectNames[i]);
+		emitSpilled(out, codegen->spills[i]);
 		if (i == DATA_SECT_N) {
 			log("Writing data section...");
-			fwrite(codegen->data.data, sizeof(uint8_t), codegen->data.dataCount, outfile);
+			emit(out, codegen->data.data, sizeof(uint8_t), codegen->data.dataCount);
 		} else if (i == CONST_SECT_N) {
 			log("Writing const section...");
-			fwrite(codegen->consts.data, sizeof(uint8_t), codegen->consts.dataCount, outfile);
+			emit(out, codegen->consts.data, sizeof(uint8_t), codegen->consts.dataCount);
 		} else if (i == TEXT_SECT_N) {
 			log("Writing text section...");
-			fwrite(codegen->text.instructions, sizeof(uint32_t), codegen->text.instructionCount, outfile);
+			emit(out, codegen->text.instructions, sizeof(uint32_t), codegen->text.instructionCount);
 		} else if (i == EVT_SECT_N) {
 			log("Writing evt section...");
-			fwrite(codegen->evt.data, sizeof(uint8_t), codegen->evt.dataCount, outfile);
+			emit(out, codegen->evt.data, sizeof(uint8_t), codegen->evt.dataCount);
 		} else {
 			emitError(ERR_INTERNAL, NULL, "Section %d has data but is not handled in writeBinary.", i);
 		}
+		traceEnd();
+	}
+}
+
+arxStatus writeBinary(CodeGen* codegen, const char* filename) {
+	// Opened before the frame so that it can still be closed after an error
+	FILE* file = fopen(filename, "wb");
+
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		if (!file) emitError(ERR_IO, NULL, "Failed to open output file %s for writing.", filename);
+
+		Output out = { .file = file };
+		writeAOEFF(codegen, &out);
+	}
+	if (file) fclose(file);
+
+	return arxLeave(&frame);
+}
+
+arxStatus writeBinaryToBuffer(CodeGen* codegen, uint8_t** image, size_t* size) {
+	Output out = {0};
+	*image = NULL;
+	*size = 0;
+
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		writeAOEFF(codegen, &out);
+
+		*image = out.buffer;
+		*size = out.size;
 	}
 
-	fclose(outfile);
+	return arxLeave(&frame);
 }
\ No newline at end of file
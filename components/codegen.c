@@ -3,58 +3,92 @@
 #include "codegen.h"
 #include "expr.h"
 #include "diagnostics.h"
+#include "allocator.h"
+#include "trace.h"
 
 
-CodeGen* initCodeGenerator(SectionTable* sectionTable, SymbolTable* symbolTable, RelocTable* relocTable) {
-	CodeGen* codegen = (CodeGen*) malloc(sizeof(CodeGen));
+static CodeGen* createCodeGenerator(ArxAssembler* as, SectionTable* sectionTable, SymbolTable* symbolTable, RelocTable* relocTable) {
+	CodeGen* codegen = (CodeGen*) memAlloc(MEM_CODEGEN, sizeof(CodeGen));
 	if (!codegen) emitError(ERR_MEM, NULL, "Failed to allocate memory for code generator.");
 
-	codegen->text.instructions = (uint32_t*) malloc(sizeof(uint32_t) * 16);
-	if (!codegen->text.instructions) emitError(ERR_MEM, NULL, "Failed to allocate memory for text section instructions.");
+	codegen->text.instructions = NULL;
 	codegen->text.instructionCount = 0;
-	codegen->text.instructionCapacity = 16;
+	codegen->text.instructionCapacity = 0;
+	reserveEncodings(&codegen->text.instructions, &codegen->text.instructionCapacity, 16);
 
-	codegen->data.data = (uint8_t*) malloc(sizeof(uint8_t) * 16);
-	if (!codegen->data.data) emitError(ERR_MEM, NULL, "Failed to allocate memory for data section.");
+	codegen->data.data = NULL;
 	codegen->data.dataCount = 0;
-	codegen->data.dataCapacity = 16;
+	codegen->data.dataCapacity = 0;
+	reserveBytes(&codegen->data.data, &codegen->data.dataCapacity, 16);
 
-	codegen->consts.data = (uint8_t*) malloc(sizeof(uint8_t) * 16);
-	if (!codegen->consts.data) emitError(ERR_MEM, NULL, "Failed to allocate memory for const section.");
+	codegen->consts.data = NULL;
 	codegen->consts.dataCount = 0;
-	codegen->consts.dataCapacity = 16;
+	codegen->consts.dataCapacity = 0;
+	reserveBytes(&codegen->consts.data, &codegen->consts.dataCapacity, 16);
 
-	codegen->evt.data = (uint8_t*) malloc(sizeof(uint8_t) * 16);
-	if (!codegen->evt.data) emitError(ERR_MEM, NULL, "Failed to allocate memory for evt section.");
+	codegen->evt.data = NULL;
 	codegen->evt.dataCount = 0;
-	codegen->evt.dataCapacity = 16;
+	codegen->evt.dataCapacity = 0;
+	reserveBytes(&codegen->evt.data, &codegen->evt.dataCapacity, 16);
+
+	for (int i = 0; i < 6; i++) {
+		codegen->spills[i] = NULL;
+		codegen->spilled[i] = 0;
+	}
 
 	codegen->sectionTable = sectionTable;
 	codegen->symbolTable = symbolTable;
 	codegen->relocTable = relocTable;
 
+	codegen->as = as;
+
 	return codegen;
 }
 
+CodeGen* initCodeGenerator(ArxAssembler* as, SectionTable* sectionTable, SymbolTable* symbolTable, RelocTable* relocTable) {
+	CodeGen* codegen = NULL;
+
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) codegen = createCodeGenerator(as, sectionTable, symbolTable, relocTable);
+
+	return arxLeave(&frame) == ARX_OK ? codegen : NULL;
+}
+
+static void closeSpills(CodeGen* codegen) {
+	for (int i = 0; i < 6; i++) {
+		if (codegen->spills[i]) fclose(codegen->spills[i]);
+		codegen->spills[i] = NULL;
+		codegen->spilled[i] = 0;
+	}
+}
+
 void deinitCodeGenerator(CodeGen* codegen) {	
-	free(codegen->text.instructions);
-	free(codegen->data.data);
-	free(codegen->consts.data);
-	free(codegen->evt.data);
-	free(codegen);
+	closeSpills(codegen);
+	memFree(codegen->text.instructions);
+	memFree(codegen->data.data);
+	memFree(codegen->consts.data);
+	memFree(codegen->evt.data);
+	memFree(codegen);
+}
+
+void resetCodeGenerator(CodeGen* codegen) {
+	// The buffers keep their capacity
+	codegen->text.instructionCount = 0;
+	codegen->data.dataCount = 0;
+	codegen->consts.dataCount = 0;
+	codegen->evt.dataCount = 0;
+	closeSpills(codegen);
 }
 
 
-static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, SymbolTable* symbTable, RelData* reldata) {
+uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, SymbolTable* symbTable, RelData* reldata) {
 	initScope("getImmediateEncoding");
 
-	log("Getting immediate encoding for %s", (immNode->token ? immNode->token->lexeme : "unknown"));
+	log("Getting immediate encoding for %s", (immNode->lexeme ? immNode->lexeme : "unknown"));
 	printAST(immNode);
 	bool evald = evaluateExpression(immNode, symbTable);
-	linedata_ctx linedata = {
-		.linenum = immNode->token ? immNode->token->linenum : -1,
-		.source = immNode->token ? ssGetString(immNode->token->sstring) : NULL
-	};
+	linedata_ctx linedata = lineAt(immNode->loc);
 	// evald is false when the immediate expression uses an extern symbol
 	// In that case, the immediate is set to 0 and a relocation entry is added
 	if (!evald) {
@@ -63,15 +97,12 @@ static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, Symbol
 
 		Node* externSymbol = getExternSymbol(immNode);
 		if (!externSymbol) {
-			linedata_ctx linedata = {
-				.linenum = immNode->token->linenum,
-				.source = ssGetString(immNode->token->sstring)
-			};
+			linedata_ctx linedata = lineAt(immNode->loc);
 			emitError(ERR_INVALID_EXPRESSION, &linedata, "Failed to get extern symbol for immediate.");
 		}
 
 		// Make sure the symbol is extern
-		symb_entry_t* symbEntry = getSymbolEntry(symbTable, externSymbol->token->lexeme);
+		symb_entry_t* symbEntry = getSymbolEntry(symbTable, externSymbol->lexeme);
 		if (!symbEntry) {
 			// If no entry at this point (all symbols should have been collected)
 			// Something went horribly wrong
@@ -80,7 +111,7 @@ static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, Symbol
 
 		uint8_t sect = GET_SECTION(symbEntry->flags);
 		if (sect != S_UNDEF) {
-			emitError(ERR_INVALID_EXPRESSION, &linedata, "Undefined symbol `%s` used in immediate is not declared extern.", externSymbol->token->lexeme);
+			emitError(ERR_INVALID_EXPRESSION, &linedata, "Undefined symbol `%s` used in immediate is not declared extern.", externSymbol->lexeme);
 		}
 		
 		int32_t addend = 0;
@@ -104,6 +135,8 @@ static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, Symbol
 		}
 
 		reldata->addend = addend;
+		// Only checking (`checkcode`), there is no table to add the relocation to
+		if (!reldata->relocTable) return 0x0;
 		RelocEnt* reloc = initRelocEntry(reldata->lp, symbEntry->symbTableIndex, reldata->type, addend);
 
 		// Some relocation types affect certain sections
@@ -152,7 +185,7 @@ static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, Symbol
 			SymbNode* symbData = (SymbNode*) immNode->nodeData.symbol;
 			if (!symbData) emitError(ERR_INTERNAL, NULL, "Symbol node data is NULL.");
 			int idx = symbData->symbTableIndex;
-			if (idx < 0 || idx >= (int)symbTable->size) emitError(ERR_INTERNAL, NULL, "Symbol index %d out of bounds in symbol table.", idx);
+			if (idx < 0 || (size_t) idx >= symbTable->size) emitError(ERR_INTERNAL, NULL, "Symbol index %d out of bounds in symbol table.", idx);
 			symb_entry_t* entry = symbTable->entries[idx];
 			if (!entry) emitError(ERR_INTERNAL, NULL, "Symbol table entry at index %d is NULL.", idx);
 			value = entry->value.val;
@@ -180,7 +213,7 @@ static uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, Symbol
 }
 
 
-static uint32_t encodeI(InstrNode* data, uint32_t lp, SymbolTable* symbTable, RelocTable* relocTable) {
+uint32_t encodeI(InstrNode* data, uint32_t lp, SymbolTable* symbTable, RelocTable* relocTable) {
 	initScope("encodeI");
 
 	uint32_t encoding = 0x00000000;
@@ -496,8 +529,9 @@ static void gentext(Parser* parser, CodeGen* codegen, Node* ast) {
 
 	uint32_t lp = 0x0;
 	// Since instructions can be in text or in evt, the lp must change accordingly
-	if (ast->nodeData.instruction->section == TEXT_SECT_N) lp = codegen->text.instructionCount * 4;
-	else if (ast->nodeData.instruction->section == EVT_SECT_N) lp = codegen->evt.dataCount;
+	// What was spilled already comes before the buffers
+	if (ast->nodeData.instruction->section == TEXT_SECT_N) lp = codegen->spilled[TEXT_SECT_N] + codegen->text.instructionCount * 4;
+	else if (ast->nodeData.instruction->section == EVT_SECT_N) lp = codegen->spilled[EVT_SECT_N] + codegen->evt.dataCount;
 
 	/**
 	 * Major note regarding LP in evt
@@ -532,30 +566,16 @@ static void gentext(Parser* parser, CodeGen* codegen, Node* ast) {
 
 	if (ast->nodeData.instruction->section == TEXT_SECT_N) {
 		log("Writing instruction to text section.");
-		if (codegen->text.instructionCount == codegen->text.instructionCapacity) {
-			codegen->text.instructionCapacity += 5;
-			uint32_t* temp = (uint32_t*) realloc(codegen->text.instructions, codegen->text.instructionCapacity * sizeof(uint32_t));
-			if (!temp) emitError(ERR_MEM, NULL, "Could not reallocate memory of instruction encodings.");
-			// log("New instruction array: %p", temp);
-			codegen->text.instructions = temp;
-		}
-		log("Writing 0x%x to index %d (address %p)", encoding, codegen->text.instructionCount, &codegen->text.instructions[codegen->text.instructionCount]);
-		codegen->text.instructions[codegen->text.instructionCount] = encoding;
-		log("Wrote 0x%x\n", codegen->text.instructions[codegen->text.instructionCount]);
-		codegen->text.instructionCount++;
+		log("Writing 0x%x to index %zu (address %p)", encoding, codegen->text.instructionCount, &codegen->text.instructions[codegen->text.instructionCount]);
+		pushEncodings(&codegen->text.instructions, &codegen->text.instructionCount, &codegen->text.instructionCapacity, encoding);
+		log("Wrote 0x%x\n", codegen->text.instructions[codegen->text.instructionCount - 1]);
 		return;
 	}
 
 	// Else, it is EVT section
 	log("Writing instruction to evt section.");
-	// Ensure enough capacity
-	if (codegen->evt.dataCount + 4 >= codegen->evt.dataCapacity) {
-		codegen->evt.dataCapacity += 5;
-		uint8_t* temp = (uint8_t*) realloc(codegen->evt.data, codegen->evt.dataCapacity * sizeof(uint8_t));
-		if (!temp) emitError(ERR_MEM, NULL, "Could not reallocate memory of evt data.");
-		codegen->evt.data = temp;
-	}
-	log("Writing 0x%x to evt data at index %d (address %p)\n", encoding, codegen->evt.dataCount, &codegen->evt.data[codegen->evt.dataCount]);
+	reserveBytes(&codegen->evt.data, &codegen->evt.dataCapacity, codegen->evt.dataCount + 4);
+	log("Writing 0x%x to evt data at index %zu (address %p)\n", encoding, codegen->evt.dataCount, &codegen->evt.data[codegen->evt.dataCount]);
 	// Write the instruction as 4 bytes, little-endian
 	codegen->evt.data[codegen->evt.dataCount + 0] = (uint8_t) ((encoding >> 0) & 0xFF);
 	codegen->evt.data[codegen->evt.dataCount + 1] = (uint8_t) ((encoding >> 8) & 0xFF);
@@ -575,7 +595,7 @@ static void gentext(Parser* parser, CodeGen* codegen, Node* ast) {
  * @param _idx The current index in the entries array
  * @param isData Whether the data is to be written to codegen data or const
  */
-static void genString(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genString(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genString");
 
 	// log("  Generating string data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
@@ -584,18 +604,18 @@ static void genString(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 	// Make sure that the node is indeed a string node
 	if (stringNode->nodeType != ND_STRING) emitError(ERR_INTERNAL, NULL, "Data entry for .string directive does not contain a string node.");
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
@@ -603,26 +623,15 @@ static void genString(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 	}
 
 	// Write the bytes (including null terminator) to the appropriate section
-	for (int i = 0; i < entry->size; i++) {
+	for (uint32_t i = 0; i < entry->size; i++) {
 		StrNode* strData = stringNode->nodeData.string;
 		if (!strData) emitError(ERR_INTERNAL, NULL, "String node data is NULL.");
 
-		// Ensure enough capacity
-		if (*codegenDataCount == *codegenDataCapacity) {
-			*codegenDataCapacity *= 2;
-			uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-			if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-			codegenData = temp;
-			if (section == DATA_SECT_N) codegen->data.data = codegenData;
-			else codegen->consts.data = codegenData; // No check for const since at this point, it should have been checked that .string is not in evt
-		}
-
 		uint8_t byteValue = 0x00;
-		if (i < strData->length) byteValue = (uint8_t) strData->value[i]; 
+		if (i < (uint32_t) strData->length) byteValue = (uint8_t) strData->value[i]; 
 		else byteValue = 0x00; // Null terminator
 
-		codegenData[*codegenDataCount] = byteValue;
-		(*codegenDataCount)++;
+		pushBytes(codegenData, codegenDataCount, codegenDataCapacity, byteValue);
 		// log("    Wrote byte 0x%02X to %s section in codegen.", byteValue, isData ? "data" : "const");
 	}
 }
@@ -637,33 +646,30 @@ static void genString(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
  * @param _idx The current index in the entries array
  * @param isData Whether the data is to be written to codegen data or const
  */
-static void genBytes(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genBytes(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genBytes");
 
 	log("  Generating bytes data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	linedata_ctx linedata = {
-		.linenum = entry->linenum,
-		.source = ssGetString(entry->source)
-	};
+	linedata_ctx linedata = lineAt(entry->loc);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
 		case EVT_SECT_N:
-			codegenData = codegen->evt.data;
+			codegenData = &codegen->evt.data;
 			codegenDataCount = &codegen->evt.dataCount;
 			codegenDataCapacity = &codegen->evt.dataCapacity;
 			break;
@@ -671,18 +677,7 @@ static void genBytes(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 	}
 
 	// Write the bytes to the appropriate section
-	for (int i = 0; i < entry->size; i++) {
-		// Ensure enough capacity
-		if (*codegenDataCount == *codegenDataCapacity) {
-			*codegenDataCapacity *= 2;
-			uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-			if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-			codegenData = temp;
-			if (section == DATA_SECT_N) codegen->data.data = codegenData;
-			else if (section == CONST_SECT_N) codegen->consts.data = codegenData;
-			else if (section == EVT_SECT_N) codegen->evt.data = codegenData;
-		}
-
+	for (uint32_t i = 0; i < entry->size; i++) {
 		Node* byteExpr = entry->data[i];
 
 		// Need to evaluate the expression
@@ -730,39 +725,35 @@ static void genBytes(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 				emitError(ERR_INTERNAL, &linedata, "Data entry expression is of invalid type.");
 		}
 
-		codegenData[*codegenDataCount] = byteValue;
-		(*codegenDataCount)++;
+		pushBytes(codegenData, codegenDataCount, codegenDataCapacity, byteValue);
 		log("    Wrote byte 0x%02X to %s section in codegen.", byteValue, (section == DATA_SECT_N) ? "data" : (section == CONST_SECT_N) ? "const" : "evt");
 	}
 }
 
-static void genHwords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genHwords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genHwords");
 
 	log("  Generating halfword data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	linedata_ctx linedata = {
-		.linenum = entry->linenum,
-		.source = ssGetString(entry->source)
-	};
+	linedata_ctx linedata = lineAt(entry->loc);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
 		case EVT_SECT_N:
-			codegenData = codegen->evt.data;
+			codegenData = &codegen->evt.data;
 			codegenDataCount = &codegen->evt.dataCount;
 			codegenDataCapacity = &codegen->evt.dataCapacity;
 			break;
@@ -770,7 +761,7 @@ static void genHwords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 	}
 
 	// Write the halfwords to the appropriate section
-	for (int i = 0; i < entry->size / 2; i++) {
+	for (uint32_t i = 0; i < entry->size / 2; i++) {
 		Node* hwordExpr = entry->data[i];
 
 		// Need to evaluate the expression
@@ -818,53 +809,37 @@ static void genHwords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 				emitError(ERR_INTERNAL, &linedata, "Data entry expression is of invalid type.");
 		}
 		// Write the halfword in little-endian
-		// Ensure enough capacity for 2 bytes
 		for (int b = 0; b < 2; b++) {
-			if (*codegenDataCount == *codegenDataCapacity) {
-				*codegenDataCapacity *= 2;
-				uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-				if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-				codegenData = temp;
-
-				if (section == DATA_SECT_N) codegen->data.data = codegenData;
-				else if (section == CONST_SECT_N) codegen->consts.data = codegenData;
-				else if (section == EVT_SECT_N) codegen->evt.data = codegenData;
-			}
-
-			codegenData[*codegenDataCount] = (hwordValue >> (8 * b)) & 0xFF;
-			(*codegenDataCount)++;
+			pushBytes(codegenData, codegenDataCount, codegenDataCapacity, (hwordValue >> (8 * b)) & 0xFF);
 		}
 		log("    Wrote halfword 0x%04X to %s section in codegen.", hwordValue, (section == DATA_SECT_N) ? "data" : (section == CONST_SECT_N) ? "const" : "evt");
 	}
 }
 
-static void genWords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genWords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genWords");
 
 	log("  Generating word data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	linedata_ctx linedata = {
-		.linenum = entry->linenum,
-		.source = ssGetString(entry->source)
-	};
+	linedata_ctx linedata = lineAt(entry->loc);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
 		case EVT_SECT_N:
-			codegenData = codegen->evt.data;
+			codegenData = &codegen->evt.data;
 			codegenDataCount = &codegen->evt.dataCount;
 			codegenDataCapacity = &codegen->evt.dataCapacity;
 			break;
@@ -872,7 +847,7 @@ static void genWords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 	}
 
 	// Write the words to the appropriate section
-	for (int i = 0; i < entry->size / 4; i++) {
+	for (uint32_t i = 0; i < entry->size / 4; i++) {
 		Node* wordExpr = entry->data[i];
 
 		// Need to evaluate the expression
@@ -920,10 +895,7 @@ static void genWords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 					// The symbol can only be relocated if it is a simple +/- expression
 					Node* symb = getExternSymbol(wordExpr);
 					if (!symb) {
-						linedata_ctx linedata = {
-							.linenum = wordExpr->token->linenum,
-							.source = ssGetString(wordExpr->token->sstring)
-						};
+						linedata_ctx linedata = lineAt(wordExpr->loc);
 						emitError(ERR_INVALID_EXPRESSION, &linedata, "Invalid expression for relocation.");
 					}
 
@@ -950,46 +922,32 @@ static void genWords(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 				emitError(ERR_INTERNAL, &linedata, "Data entry expression is of invalid type.");
 		}
 		// Write the word in little-endian
-		// Ensure enough capacity for 4 bytes
 		for (int b = 0; b < 4; b++) {
-			if (*codegenDataCount == *codegenDataCapacity) {
-				*codegenDataCapacity *= 2;
-				uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-				if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-				codegenData = temp;
-				if (section == DATA_SECT_N) codegen->data.data = codegenData;
-				else if (section == CONST_SECT_N) codegen->consts.data = codegenData;
-				else if (section == EVT_SECT_N) codegen->evt.data = codegenData;
-			}
-			codegenData[*codegenDataCount] = (wordValue >> (8 * b)) & 0xFF;
-			(*codegenDataCount)++;
+			pushBytes(codegenData, codegenDataCount, codegenDataCapacity, (wordValue >> (8 * b)) & 0xFF);
 		}
 		log("    Wrote word 0x%08X to %s section in codegen.", wordValue, (section == DATA_SECT_N) ? "data" : (section == CONST_SECT_N) ? "const" : "evt");
 	}
 }
 
-static void genFloats(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genFloats(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genFloats");
 
 	log("  Generating float data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	linedata_ctx linedata = {
-		.linenum = entry->linenum,
-		.source = ssGetString(entry->source)
-	};
+	linedata_ctx linedata = lineAt(entry->loc);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
@@ -997,7 +955,7 @@ static void genFloats(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 	}
 
 	// Write the floats to the appropriate section
-	for (int i = 0; i < entry->size / 4; i++) {
+	for (uint32_t i = 0; i < entry->size / 4; i++) {
 		Node* floatExpr = entry->data[i];
 
 		// Need to evaluate the expression
@@ -1052,45 +1010,35 @@ static void genFloats(CodeGen* codegen, data_entry_t* entry, data_entry_t** entr
 		// Write the float in little-endian
 		uint32_t floatAsInt = 0;
 		memcpy(&floatAsInt, &floatValue, sizeof(float));
-		// Ensure enough capacity for 4 bytes
 		for (int b = 0; b < 4; b++) {
-			if (*codegenDataCount == *codegenDataCapacity) {
-				*codegenDataCapacity *= 2;
-				uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-				if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-				codegenData = temp;
-				if (section == DATA_SECT_N) codegen->data.data = codegenData;
-				else codegen->consts.data = codegenData; // Same as string, float does not happen in evt
-			}
-			codegenData[*codegenDataCount] = (floatAsInt >> (8 * b)) & 0xFF;
-			(*codegenDataCount)++;
+			pushBytes(codegenData, codegenDataCount, codegenDataCapacity, (floatAsInt >> (8 * b)) & 0xFF);
 		}
 		log("    Wrote float %f to %s section in codegen.", floatValue, (section == DATA_SECT_N) ? "data" : "const");
 	}
 }
 
-static void genZeros(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genZeros(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genZeros");
 
 	log("  Generating zero/fill data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
 		case EVT_SECT_N:
-			codegenData = codegen->evt.data;
+			codegenData = &codegen->evt.data;
 			codegenDataCount = &codegen->evt.dataCount;
 			codegenDataCapacity = &codegen->evt.dataCapacity;
 			break;
@@ -1098,46 +1046,34 @@ static void genZeros(CodeGen* codegen, data_entry_t* entry, data_entry_t** entri
 	}
 
 	// Write zeros to the appropriate section
-	for (int i = 0; i < entry->size; i++) {
-		// Ensure enough capacity
-		if (*codegenDataCount == *codegenDataCapacity) {
-			*codegenDataCapacity *= 2;
-			uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-			if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-			codegenData = temp;
-			if (section == DATA_SECT_N) codegen->data.data = codegenData;
-			else if (section == CONST_SECT_N) codegen->consts.data = codegenData;
-			else if (section == EVT_SECT_N) codegen->evt.data = codegenData;
-		}
-
-		codegenData[*codegenDataCount] = 0x00;
-		(*codegenDataCount)++;
+	for (uint32_t i = 0; i < entry->size; i++) {
+		pushBytes(codegenData, codegenDataCount, codegenDataCapacity, 0x00);
 		// log("    Wrote zero byte to %s section in codegen.", (section == DATA_SECT_N) ? "data" : (section == CONST_SECT_N) ? "const" : "evt");
 	}
 }
 
-static void genFill(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, int* _entriesSize, int* _entriesCapacity, int* _idx, sect_table_n section) {
+static void genFill(CodeGen* codegen, data_entry_t* entry, data_entry_t** entries, size_t* _entriesSize, size_t* _entriesCapacity, size_t* _idx, sect_table_n section) {
 	initScope("genFill");
 
 	log("  Generating fill data entry at address 0x%08X with size %d bytes.", entry->addr, entry->size);
 
-	uint8_t* codegenData= NULL;
-	int* codegenDataCount = NULL;
-	int* codegenDataCapacity = NULL;
+	uint8_t** codegenData = NULL;
+	size_t* codegenDataCount = NULL;
+	size_t* codegenDataCapacity = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
-			codegenData = codegen->data.data;
+			codegenData = &codegen->data.data;
 			codegenDataCount = &codegen->data.dataCount;
 			codegenDataCapacity = &codegen->data.dataCapacity;
 			break;
 		case CONST_SECT_N:
-			codegenData = codegen->consts.data;
+			codegenData = &codegen->consts.data;
 			codegenDataCount = &codegen->consts.dataCount;
 			codegenDataCapacity = &codegen->consts.dataCapacity;
 			break;
 		case EVT_SECT_N:
-			codegenData = codegen->evt.data;
+			codegenData = &codegen->evt.data;
 			codegenDataCount = &codegen->evt.dataCount;
 			codegenDataCapacity = &codegen->evt.dataCapacity;
 			break;
@@ -1152,52 +1088,40 @@ static void genFill(CodeGen* codegen, data_entry_t* entry, data_entry_t** entrie
 
 	uint8_t fillByte = (uint8_t) entry->data[1]->nodeData.number->value.int8Value;
 
-	for (int i = 0; i < entry->size; i++) {
-		// Ensure enough capacity
-		if (*codegenDataCount == *codegenDataCapacity) {
-			*codegenDataCapacity *= 2;
-			uint8_t* temp = (uint8_t*) realloc(codegenData, sizeof(uint8_t) * (*codegenDataCapacity));
-			if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for data/const section.");
-			codegenData = temp;
-			if (section == DATA_SECT_N) codegen->data.data = codegenData;
-			else if (section == CONST_SECT_N) codegen->consts.data = codegenData;
-			else if (section == EVT_SECT_N) codegen->evt.data = codegenData;
-		}
-
-		codegenData[*codegenDataCount] = fillByte;
-		(*codegenDataCount)++;
+	for (uint32_t i = 0; i < entry->size; i++) {
+		pushBytes(codegenData, codegenDataCount, codegenDataCapacity, fillByte);
 		// log("    Wrote fill byte 0x%02X to %s section in codegen.", fillByte, (section == DATA_SECT_N) ? "data" : (section == CONST_SECT_N) ? "const" : "evt");
 	}
 }
 
-static void gendata(Parser* parser, Node* ast, CodeGen* codegen, int* dataIdx, int* constIdx, int* evtIdx) {
+static void gendata(Parser* parser, Node* ast, CodeGen* codegen, size_t* dataIdx, size_t* constIdx, size_t* evtIdx) {
 	initScope("gendata");
 
 	sect_table_n section = ast->nodeData.directive->section;
 
 	data_entry_t** entries = NULL;
-	int* entriesSize = NULL;
-	int* entriesCapacity = NULL;
-	int* idx = NULL;
+	size_t* entriesSize = NULL;
+	size_t* entriesCapacity = NULL;
+	size_t* idx = NULL;
 
 	switch (section) {
 		case DATA_SECT_N:
 			entries = parser->dataTable->dataEntries;
-			entriesSize = (int*)&parser->dataTable->dSize;
-			entriesCapacity = (int*)&parser->dataTable->dCapacity;
+			entriesSize = &parser->dataTable->dSize;
+			entriesCapacity = &parser->dataTable->dCapacity;
 			idx = dataIdx;
 			break;
 		case CONST_SECT_N:
 			entries = parser->dataTable->constEntries;
-			entriesSize = (int*)&parser->dataTable->cSize;
-			entriesCapacity = (int*)&parser->dataTable->cCapacity;
+			entriesSize = &parser->dataTable->cSize;
+			entriesCapacity = &parser->dataTable->cCapacity;
 			idx = constIdx;
 			break;
 		case BSS_SECT_N: return; // No data to generate for BSS
 		case EVT_SECT_N:
 			entries = parser->dataTable->evtEntries;
-			entriesSize = (int*)&parser->dataTable->eSize;
-			entriesCapacity = (int*)&parser->dataTable->eCapacity;
+			entriesSize = &parser->dataTable->eSize;
+			entriesCapacity = &parser->dataTable->eCapacity;
 			idx = evtIdx;
 			break;
 		case IVT_SECT_N:
@@ -1225,9 +1149,9 @@ static void gendata(Parser* parser, Node* ast, CodeGen* codegen, int* dataIdx, i
 	 */
 
 	data_entry_t* entry = entries[*idx];
-	if (!entry) emitError(ERR_INTERNAL, NULL, "Data entry at index %d is NULL.", *idx);
+	if (!entry) emitError(ERR_INTERNAL, NULL, "Data entry at index %zu is NULL.", *idx);
 
-	log("  Generating data entry %d of type %d at address 0x%08X with size %d bytes.", *idx, entry->type, entry->addr, entry->size);
+	log("  Generating data entry %zu of type %d at address 0x%08X with size %d bytes.", *idx, entry->type, entry->addr, entry->size);
 
 	// Intercept zero and fill since those have a difference structure
 	// Especially .zero
@@ -1235,11 +1159,11 @@ static void gendata(Parser* parser, Node* ast, CodeGen* codegen, int* dataIdx, i
 	// And converting the simple AST (.zero -> size) to x nodes is too much for just zeros
 	// Maybe it is worth it for .fill, but in the case that the number is 0, it might apply the same as .zero
 
-	if (ast->token->type == TK_D_ZERO) {
+	if (ast->type == TK_D_ZERO) {
 		genZeros(codegen, entry, entries, entriesSize, entriesCapacity, idx, section);
 		(*idx)++;
 		return;
-	} else if (ast->token->type == TK_D_FILL) {
+	} else if (ast->type == TK_D_FILL) {
 		genFill(codegen, entry, entries, entriesSize, entriesCapacity, idx, section);
 		(*idx)++;
 		return;
@@ -1265,20 +1189,19 @@ static void gendata(Parser* parser, Node* ast, CodeGen* codegen, int* dataIdx, i
 static void resolveSymbols(SymbolTable* symbTable) {
 	initScope("resolveSymbols");
 
-	for (int i = 0; i < symbTable->size; i++) {
+	for (size_t i = 0; i < symbTable->size; i++) {
 		symb_entry_t* entry = symbTable->entries[i];
 
 		// If the symbol is defined but not used, check if it is expression-less
 		// Note that since externs are set as undef, it is fine
 		if (GET_DEFINED(entry->flags) == D_DEF && GET_REFERENCED(entry->flags) == R_NREF && GET_MAIN_TYPE(entry->flags) == M_ABS) {
-			linedata_ctx linedata = {
-				.linenum = entry->linenum,
-				.source = ssGetString(entry->source)
-			};
+			linedata_ctx linedata = lineAt(entry->loc);
 
 			emitWarning(WARN_UNUSED, NULL, "Symbol `%s` defined at `%s` but not used.", entry->name, linedata.source);
+			// Symbols from a precompiled ADECL file come already evaluated
+			if (GET_EXPRESSION(entry->flags) == E_VAL) continue;
 
-			log("Resolving defined but unused symbol `%s` at index %d.", entry->name, i);
+			log("Resolving defined but unused symbol `%s` at index %zu.", entry->name, i);
 			// Evaluate the symbol's expression
 			bool evald = evaluateExpression(entry->value.expr, symbTable);
 			if (!evald) {
@@ -1299,20 +1222,39 @@ static void resolveSymbols(SymbolTable* symbTable) {
 	}
 }
 
-void gencode(Parser* parser, CodeGen* codegen) {
+static const char* sectNames[6] = { "data", "const", "bss", "text", "evt", "ivt" };
+
+// Sections can be switched back and forth in the source, so each contiguous run of the same section gets its own span
+static void traceSection(Node* ast, int* tracedSection) {
+	int section;
+	if (ast->nodeType == ND_INSTRUCTION && ast->nodeData.instruction) section = ast->nodeData.instruction->section;
+	else if (ast->nodeType == ND_DIRECTIVE && ast->nodeData.directive) section = ast->nodeData.directive->section;
+	else return;
+
+	// Only data directives generate anything
+	if (ast->nodeType == ND_DIRECTIVE && (ast->type < TK_D_STRING || ast->type > TK_D_ALIGN)) return;
+
+	if (section == *tracedSection || section < 0 || section > IVT_SECT_N) return;
+
+	if (*tracedSection != -1) traceEnd();
+	traceBegin("section", "gen %s", sectNames[section]);
+	*tracedSection = section;
+}
+
+static void generateASTs(Parser* parser, CodeGen* codegen) {
 	initScope("gencode");
 
-	int dataIdx = 0;
-	int constIdx = 0;
-	int evtIdx = 0;
-	for (int i = 0; i < parser->astCount; i++) {
+	size_t dataIdx = 0;
+	size_t constIdx = 0;
+	size_t evtIdx = 0;
+	int tracedSection = -1;
+	for (size_t i = 0; i < parser->astCount; i++) {
 		Node* ast = parser->asts[i];
-		log("Generating code for AST %d (%p):", i, ast);
+		log("Generating code for AST %zu (%p):", i, ast);
+
+		if (traceEnabled()) traceSection(ast, &tracedSection);
 
-		// linedata_ctx linedata = {
-		// 	.linenum = ast->token->linenum,
-		// 	.source = ssGetString(ast->token->sstring)
-		// };
+		// linedata_ctx linedata = lineAt(ast->loc);
 
 		// Each ast root will be either a label, instruction, or directive
 		// Labels can be ignored
@@ -1342,13 +1284,13 @@ void gencode(Parser* parser, CodeGen* codegen) {
 				// log("  Directive");
 				// Certain directives are useless
 				// The directives to care about all the data ones
-				if (ast->token->type < TK_D_STRING || ast->token->type > TK_D_ALIGN) {
-					log("    Ignoring directive %s", ast->token->lexeme);
+				if (ast->type < TK_D_STRING || ast->type > TK_D_ALIGN) {
+					log("    Ignoring directive %s", ast->lexeme);
 					break;
 				}
 
 				// Data directives are stored in the data table
-				log("    Processing directive %s", ast->token->lexeme);
+				log("    Processing directive %s", ast->lexeme);
 				gendata(parser, ast, codegen, &dataIdx, &constIdx, &evtIdx);
 				break;
 			default:
@@ -1356,29 +1298,253 @@ void gencode(Parser* parser, CodeGen* codegen) {
 				break;
 		}
 	}
+	if (tracedSection != -1) traceEnd();
+}
+
+// The parse laid the sections out, so the buffers can take all of their code at once
+static void reserveSections(Parser* parser, CodeGen* codegen) {
+	section_entry_t* entries = parser->sectionTable->entries;
+
+	reserveEncodings(&codegen->text.instructions, &codegen->text.instructionCapacity, entries[TEXT_SECT_N].size / 4);
+	reserveBytes(&codegen->data.data, &codegen->data.dataCapacity, entries[DATA_SECT_N].size);
+	reserveBytes(&codegen->consts.data, &codegen->consts.dataCapacity, entries[CONST_SECT_N].size);
+	reserveBytes(&codegen->evt.data, &codegen->evt.dataCapacity, entries[EVT_SECT_N].size);
+}
 
+static void generateCode(Parser* parser, CodeGen* codegen) {
+	reserveSections(parser, codegen);
+	generateASTs(parser, codegen);
+
+	traceBegin("phase", "resolve symbols");
 	resolveSymbols(parser->symbolTable);
+	traceEnd();
+}
+
+arxStatus gencode(Parser* parser, CodeGen* codegen) {
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) generateCode(parser, codegen);
+
+	return arxLeave(&frame);
+}
+
+arxStatus gencodeChunk(Parser* parser, CodeGen* codegen) {
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) generateASTs(parser, codegen);
+
+	return arxLeave(&frame);
+}
+
+arxStatus resolveCode(CodeGen* codegen) {
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		traceBegin("phase", "resolve symbols");
+		resolveSymbols(codegen->symbolTable);
+		traceEnd();
+	}
+
+	return arxLeave(&frame);
+}
+
+static void spillSection(CodeGen* codegen, sect_table_n section, const void* data, size_t size) {
+	if (size == 0) return;
+
+	if (!codegen->spills[section]) {
+		codegen->spills[section] = tmpfile();
+		if (!codegen->spills[section]) emitError(ERR_IO, NULL, "Failed to create a temporary file for the %s section.", sectNames[section]);
+	}
+	if (fwrite(data, 1, size, codegen->spills[section]) != size) emitError(ERR_IO, NULL, "Failed to write the %s section to a temporary file.", sectNames[section]);
+	codegen->spilled[section] += (uint32_t) size;
+}
+
+arxStatus spillCode(CodeGen* codegen) {
+	ArxFrame frame;
+	arxEnter(codegen->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		spillSection(codegen, DATA_SECT_N, codegen->data.data, (size_t) codegen->data.dataCount);
+		codegen->data.dataCount = 0;
+		spillSection(codegen, CONST_SECT_N, codegen->consts.data, (size_t) codegen->consts.dataCount);
+		codegen->consts.dataCount = 0;
+		spillSection(codegen, TEXT_SECT_N, codegen->text.instructions, sizeof(uint32_t) * codegen->text.instructionCount);
+		codegen->text.instructionCount = 0;
+		spillSection(codegen, EVT_SECT_N, codegen->evt.data, (size_t) codegen->evt.dataCount);
+		codegen->evt.dataCount = 0;
+	}
+
+	return arxLeave(&frame);
+}
+
+
+// The checks of the encoders, for `checkcode`
+// The immediates and data values are evaluated and checked the same way, in the same order, but nothing is encoded or relocated
+
+static void checkImmediate(Node* immNode, NumType expectedType, reloc_type_t type, SymbolTable* symbTable) {
+	// Without a relocation table, an extern is only checked to be one
+	RelData reldata = {
+		.lp = 0,
+		.addend = 0,
+		.type = type,
+		.relocTable = NULL
+	};
+	getImmediateEncoding(immNode, expectedType, symbTable, &reldata);
+}
+
+static void checkInstruction(InstrNode* data, SymbolTable* symbTable) {
+	switch (data->instrType) {
+		case I_TYPE:
+			if (data->data.iType.imm) checkImmediate(data->data.iType.imm, NTYPE_UINT14, RELOC_TYPE_ABS, symbTable);
+			break;
+		case M_TYPE:
+			if (data->data.mType.imm) checkImmediate(data->data.mType.imm, NTYPE_INT9, RELOC_TYPE_MEM, symbTable);
+			break;
+		case BC_TYPE: checkImmediate(data->data.bcType.offset, NTYPE_INT19, RELOC_TYPE_IR19, symbTable); break;
+		case BI_TYPE: checkImmediate(data->data.biType.offset, NTYPE_INT19, RELOC_TYPE_IR24, symbTable); break;
+		default: break;
+	}
+}
+
+/**
+ * Checks a value of a data directive like `genBytes`, `genHwords`, `genWords` and `genFloats` do.
+ * @param expr The expression of the value
+ * @param type The widest type the value is allowed to be, NTYPE_FLOAT for floats only
+ * @param typeName The name of the type in the errors
+ * @param relocatable Whether an address can be relocated, only words can
+ * @param symbTable The symbol table
+ * @param linedata The line of the directive
+ */
+static void checkDataValue(Node* expr, NumType type, const char* typeName, bool relocatable, SymbolTable* symbTable, linedata_ctx* linedata) {
+	bool evald = evaluateExpression(expr, symbTable);
+	if (!evald) emitError(ERR_INVALID_EXPRESSION, linedata, "Could not evaluate immediate expression.");
+
+	switch (expr->nodeType) {
+		case ND_NUMBER: {
+			NumType valueType = expr->nodeData.number->type;
+			if (type == NTYPE_FLOAT ? valueType != NTYPE_FLOAT : valueType > type) {
+				emitError(ERR_INVALID_TYPE, linedata, "Data entry number node is not of %s type.", typeName);
+			}
+			break;
+		}
+		case ND_OPERATOR: {
+			NumType valueType = expr->nodeData.operator->valueType;
+			if (type == NTYPE_FLOAT ? valueType != NTYPE_FLOAT : valueType > type) {
+				emitError(ERR_INVALID_TYPE, linedata, "Data entry operator node is not of %s type.", typeName);
+			}
+			break;
+		}
+		case ND_SYMB: {
+			int idx = expr->nodeData.symbol->symbTableIndex;
+			if (idx < 0 || (size_t) idx >= symbTable->size) emitError(ERR_INTERNAL, NULL, "Symbol index %d out of bounds in symbol table.", idx);
+			symb_entry_t* symbEntry = symbTable->entries[idx];
+
+			if (relocatable && GET_MAIN_TYPE(symbEntry->flags) != M_ABS && !getExternSymbol(expr)) {
+				linedata_ctx exprLinedata = lineAt(expr->loc);
+				emitError(ERR_INVALID_EXPRESSION, &exprLinedata, "Invalid expression for relocation.");
+			}
+			break;
+		}
+		default:
+			emitError(ERR_INTERNAL, linedata, "Data entry expression is of invalid type.");
+	}
+}
+
+static void checkData(Node* ast, SymbolTable* symbTable) {
+	DirctvNode* directive = ast->nodeData.directive;
+
+	switch (directive->section) {
+		case DATA_SECT_N: case CONST_SECT_N: case EVT_SECT_N: break;
+		case BSS_SECT_N: return;
+		case IVT_SECT_N:
+			emitWarning(WARN_UNIMPLEMENTED, NULL, "Data generation for IVT section not yet implemented.");
+			return;
+		default:
+			emitError(ERR_INTERNAL, NULL, "Data generation in invalid section %d.", directive->section);
+	}
+
+	// `.string`, `.zero` and `.fill` have nothing left to check, their sizes were computed by the parse
+	NumType type;
+	const char* typeName;
+	switch (ast->type) {
+		case TK_D_BYTE: type = NTYPE_INT8; typeName = "byte"; break;
+		case TK_D_HWORD: type = NTYPE_INT16; typeName = "halfword"; break;
+		case TK_D_WORD: type = NTYPE_INT32; typeName = "word"; break;
+		case TK_D_FLOAT:
+			// Same as `genFloats`, floats are not generated in evt
+			if (directive->section == EVT_SECT_N) return;
+			type = NTYPE_FLOAT;
+			typeName = "float";
+			break;
+		default: return;
+	}
+
+	// The line is the one of the values, like the data entry takes it
+	Node* first = directive->nary.exprs[0];
+	linedata_ctx linedata = lineAt(first->loc);
+
+	for (size_t i = 0; i < directive->nary.exprCount; i++) {
+		checkDataValue(directive->nary.exprs[i], type, typeName, ast->type == TK_D_WORD, symbTable, &linedata);
+	}
+}
+
+static void checkCode(Parser* parser) {
+	initScope("checkcode");
+
+	for (size_t i = 0; i < parser->astCount; i++) {
+		Node* ast = parser->asts[i];
+
+		switch (ast->nodeType) {
+			case ND_INSTRUCTION: {
+				InstrNode* data = ast->nodeData.instruction;
+				// Like `generateCode`, a LD imm/move is checked through its decomposition
+				if (data->instruction == LD && !data->data.mType.xb) {
+					for (int j = 0; j < 7; j++) {
+						Node* expandedInstr = data->data.mType.expanded[j];
+						if (expandedInstr) checkInstruction(expandedInstr->nodeData.instruction, parser->symbolTable);
+					}
+				} else checkInstruction(data, parser->symbolTable);
+				break;
+			}
+			case ND_DIRECTIVE:
+				if (ast->type < TK_D_STRING || ast->type > TK_D_ALIGN) break;
+				checkData(ast, parser->symbolTable);
+				break;
+			default: break;
+		}
+	}
+
+	traceBegin("phase", "resolve symbols");
+	resolveSymbols(parser->symbolTable);
+	traceEnd();
+}
+
+arxStatus checkcode(Parser* parser) {
+	ArxFrame frame;
+	arxEnter(parser->as, &frame);
+	if (setjmp(frame.env) == 0) checkCode(parser);
+
+	return arxLeave(&frame);
 }
 
 
 void displayCodeGen(CodeGen* codegen) {
 	rlog("CodeGen State:");
 
-	rlog("Text Section: %d instructions", codegen->text.instructionCount);
-	for (int i = 0; i < codegen->text.instructionCount; i++) {
-		rlog("  [%04d] 0x%08X", i*4, codegen->text.instructions[i]);
+	rlog("Text Section: %zu instructions", codegen->text.instructionCount);
+	for (size_t i = 0; i < codegen->text.instructionCount; i++) {
+		rlog("  [%04zu] 0x%08X", i*4, codegen->text.instructions[i]);
 	}
 
-	rlog("Data Section: %d bytes", codegen->data.dataCount);
-	for (int i = 0; i < codegen->data.dataCount; i++) {
-		if (i % 16 == 0) rlog("  [%04d] ", i);
+	rlog("Data Section: %zu bytes", codegen->data.dataCount);
+	for (size_t i = 0; i < codegen->data.dataCount; i++) {
+		if (i % 16 == 0) rlog("  [%04zu] ", i);
 		rlog("%02X ", codegen->data.data[i]);
 		if (i % 16 == 15 || i == codegen->data.dataCount - 1) rlog("\n");
 	}
 
-	rlog("Const Section: %d bytes", codegen->consts.dataCount);
-	for (int i = 0; i < codegen->consts.dataCount; i++) {
-		if (i % 16 == 0) rlog("  [%04d] ", i);
+	rlog("Const Section: %zu bytes", codegen->consts.dataCount);
+	for (size_t i = 0; i < codegen->consts.dataCount; i++) {
+		if (i % 16 == 0) rlog("  [%04zu] ", i);
 		rlog("%02X ", codegen->consts.data[i]);
 		if (i % 16 == 15 || i == codegen->consts.dataCount - 1) rlog("\n");
 	}
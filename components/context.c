@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "context.h"
+#include "trace.h"
+
+
+static _Thread_local ArxAssembler* current = NULL;
+#ifndef _WIN32
+static bool exiting = false; // Set by the first error that exits
+#endif
+
+
+ArxAssembler* initAssembler(Config config, const mem_hooks_t* hooks) {
+	// The context is not under its own owner, releasing the owner would free it
+	ArxAssembler* as = (ArxAssembler*) memAllocWith(hooks, MEM_CONTEXT, sizeof(ArxAssembler));
+	if (!as) return NULL;
+
+	*as = (ArxAssembler) {0};
+	as->config = config;
+	as->memory.hooks = hooks;
+
+	return as;
+}
+
+void deinitAssembler(ArxAssembler* as) {
+	freeDependencies(&as->dependencies);
+	memReleaseOwner(&as->memory);
+	memFree(as);
+}
+
+void setDiagnosticSink(ArxAssembler* as, diagSink sink, void* ctx) {
+	as->sink = sink;
+	as->sinkCtx = ctx;
+}
+
+ArxAssembler* arxCurrent() {
+	return current;
+}
+
+void arxEnter(ArxAssembler* as, ArxFrame* frame) {
+	frame->as = as;
+	frame->status = ARX_OK;
+	frame->outermost = as->frame == NULL;
+
+	// Inner frames only mark the entry point, errors go past them
+	if (!frame->outermost) return;
+
+	as->frame = frame;
+	frame->traceDepth = traceDepth();
+	frame->previous = current;
+	current = as;
+	frame->previousOwner = memSetOwner(&as->memory);
+}
+
+arxStatus arxLeave(ArxFrame* frame) {
+	if (frame->outermost) {
+		traceUnwind(frame->traceDepth);
+		frame->as->frame = NULL;
+		current = frame->previous;
+		memSetOwner(frame->previousOwner);
+	}
+
+	return frame->status;
+}
+
+bool arxRecoverable(ArxAssembler* as) {
+	if (as->error == ERR_MEM || as->error == ERR_INTERNAL) return false;
+
+	return as->config.errorLimit == 0 || as->errorCount < as->config.errorLimit;
+}
+
+void arxFail(errType err) {
+	ArxAssembler* as = current;
+
+	if (as && as->frame) {
+		as->error = err;
+		as->frame->status = ARX_FAILED;
+		if (as->recovery && arxRecoverable(as)) longjmp(*as->recovery, 1);
+		longjmp(as->frame->env, 1);
+	}
+
+	// Only the first error exits, a thread erroring at the same time waits for the process to go away
+	// Calling exit from two threads at once is undefined
+#ifndef _WIN32
+	if (__atomic_test_and_set(&exiting, __ATOMIC_ACQ_REL)) {
+		while (true) pause();
+	}
+#endif
+	exit(-1);
+}
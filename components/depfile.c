@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "depfile.h"
+#include "allocator.h"
+#include "sds.h"
+
+
+static uint32_t hashPath(const char* path) {
+	uint32_t hash = 2166136261u;
+	for (const char* c = path; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619u;
+
+	return hash;
+}
+
+static void placePath(dep_list_t* deps, int position) {
+	uint32_t mask = deps->slotCount - 1;
+	uint32_t slot = hashPath(deps->paths[position]) & mask;
+	while (deps->slots[slot]) slot = (slot + 1) & mask;
+	deps->slots[slot] = (uint32_t) position + 1;
+}
+
+static bool growSlots(dep_list_t* deps) {
+	uint32_t slotCount = deps->slotCount ? deps->slotCount * 2 : 16;
+	uint32_t* slots = (uint32_t*) memCalloc(MEM_CONTEXT, slotCount, sizeof(uint32_t));
+	if (!slots) return false;
+
+	memFree(deps->slots);
+	deps->slots = slots;
+	deps->slotCount = slotCount;
+	for (int i = 0; i < deps->count; i++) placePath(deps, i);
+
+	return true;
+}
+
+bool addDependency(dep_list_t* deps, const char* path) {
+	if ((uint32_t) (deps->count + 1) * 2 > deps->slotCount && !growSlots(deps)) return false;
+
+	uint32_t mask = deps->slotCount - 1;
+	for (uint32_t slot = hashPath(path) & mask; deps->slots[slot]; slot = (slot + 1) & mask) {
+		if (strcmp(deps->paths[deps->slots[slot] - 1], path) == 0) return false;
+	}
+
+	if (deps->count == deps->capacity) {
+		int capacity = deps->capacity ? deps->capacity * 2 : 8;
+		char** temp = (char**) memRealloc(MEM_CONTEXT, deps->paths, sizeof(char*) * capacity);
+		if (!temp) return false;
+		deps->paths = temp;
+		deps->capacity = capacity;
+	}
+
+	sds copy = sdsnew(path);
+	if (!copy) return false;
+	deps->paths[deps->count++] = copy;
+	placePath(deps, deps->count - 1);
+
+	return true;
+}
+
+int findDependency(const dep_list_t* deps, const char* path) {
+	if (!deps->slotCount) return -1;
+
+	uint32_t mask = deps->slotCount - 1;
+	for (uint32_t slot = hashPath(path) & mask; deps->slots[slot]; slot = (slot + 1) & mask) {
+		int position = (int) deps->slots[slot] - 1;
+		if (strcmp(deps->paths[position], path) == 0) return position;
+	}
+
+	return -1;
+}
+
+void clearDependencies(dep_list_t* deps) {
+	for (int i = 0; i < deps->count; i++) sdsfree(deps->paths[i]);
+	deps->count = 0;
+	if (deps->slots) memset(deps->slots, 0, sizeof(uint32_t) * deps->slotCount);
+}
+
+void freeDependencies(dep_list_t* deps) {
+	clearDependencies(deps);
+	memFree(deps->paths);
+	memFree(deps->slots);
+	*deps = (dep_list_t) {0};
+}
+
+// Spaces and `#` are escaped with a backslash, `$` is doubled, the way make reads them back
+static void writeEscaped(FILE* file, const char* path) {
+	for (const char* c = path; *c; c++) {
+		if (*c == ' ' || *c == '#') fputc('\\', file);
+		else if (*c == '$') fputc('$', file);
+		fputc(*c, file);
+	}
+}
+
+bool writeDepFile(const char* depfile, const char* target, const char* source, const dep_list_t* deps, bool phony) {
+	FILE* file = fopen(depfile, "w");
+	if (!file) return false;
+
+	writeEscaped(file, target);
+	fputs(": ", file);
+	writeEscaped(file, source);
+	for (int i = 0; i < deps->count; i++) {
+		fputs(" \\\n  ", file);
+		writeEscaped(file, deps->paths[i]);
+	}
+	fputc('\n', file);
+
+	if (phony) {
+		for (int i = 0; i < deps->count; i++) {
+			fputc('\n', file);
+			writeEscaped(file, deps->paths[i]);
+			fputs(":\n", file);
+		}
+	}
+
+	bool failed = ferror(file);
+	if (fclose(file) != 0) failed = true;
+
+	return !failed;
+}
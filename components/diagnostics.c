@@ -1,18 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <stdbool.h>
 
 #include "diagnostics.h"
-#include "config.h"
+#include "context.h"
+#include "allocator.h"
 
-static char FN_SCOPE[64];
-static char buffer[164];
-static Config config;
-bool doWarn; // Whether to emit warnings
-
-// Treating warnings as error preceeds doWarn
-// Ie if `arxsm -W -F`, `-W` is ignored
+// Scratch space, per thread since several contexts can report at once
+static _Thread_local char FN_SCOPE[64];
+static _Thread_local char buffer[164];
 
 static char* errnames[ERR_MISALIGNMENT + 1] = {
 	"INTERNAL ERROR",
@@ -47,21 +45,106 @@ static void formatMessage(const char* fmsg, va_list args) {
 	vsnprintf(buffer, sizeof(buffer), fmsg, args);
 }
 
+// Sends to the context's sink, or prints to stderr
+static void report(Diagnostic* diag) {
+	ArxAssembler* as = arxCurrent();
+	if (as) {
+		diag->filename = as->filename;
+		if (diag->isError) as->errorCount++;
+		else as->warningCount++;
+
+		if (as->sink) {
+			as->sink(diag, as->sinkCtx);
+			return;
+		}
+	}
+
+	printDiagnostic(diag);
+}
+
+void printDiagnostic(const Diagnostic* diag) {
+	const char* color = diag->isError ? RED : YELLOW;
+	if (diag->filename) fprintf(stderr, "%s%s: ", color, diag->filename);
+	if (diag->source) fprintf(stderr, "%s[%s] at `%s` (%d): %s%s\n", color, diag->name, diag->source, diag->linenum, diag->message, RESET);
+	else fprintf(stderr, "%s[%s]: %s%s\n", color, diag->name, diag->message, RESET);
+}
+
+static char* copyString(const char* str) {
+	if (!str) return NULL;
+
+	size_t len = strlen(str) + 1;
+	char* copy = (char*) memAllocWith(NULL, MEM_CONTEXT, len);
+	if (copy) memcpy(copy, str, len);
+
+	return copy;
+}
+
+void collectDiagnostic(const Diagnostic* diag, void* ctx) {
+	diag_list_t* list = (diag_list_t*) ctx;
+
+	if (list->count == list->capacity) {
+		int capacity = list->capacity ? list->capacity * 2 : 8;
+		Diagnostic* temp = (Diagnostic*) memAllocWith(NULL, MEM_CONTEXT, sizeof(Diagnostic) * capacity);
+		if (!temp) {
+			// Out of order rather than lost
+			printDiagnostic(diag);
+			return;
+		}
+		if (list->count) memcpy(temp, list->entries, sizeof(Diagnostic) * list->count);
+		memFree(list->entries);
+		list->entries = temp;
+		list->capacity = capacity;
+	}
+
+	// The names are static, everything else only lives for the call
+	Diagnostic copy = *diag;
+	copy.filename = copyString(diag->filename);
+	copy.source = copyString(diag->source);
+	copy.message = copyString(diag->message);
+	if ((diag->filename && !copy.filename) || (diag->source && !copy.source) || !copy.message) {
+		memFree((void*) copy.filename);
+		memFree((void*) copy.source);
+		memFree((void*) copy.message);
+		printDiagnostic(diag);
+		return;
+	}
+	list->entries[list->count++] = copy;
+}
+
+void printDiagnostics(diag_list_t* list) {
+	for (int i = 0; i < list->count; i++) {
+		Diagnostic* diag = &list->entries[i];
+		printDiagnostic(diag);
+		memFree((void*) diag->filename);
+		memFree((void*) diag->source);
+		memFree((void*) diag->message);
+	}
+	memFree(list->entries);
+	*list = (diag_list_t) {0};
+}
+
 void emitError(errType err, linedata_ctx* linedata, const char* fmsg, ...) {
 	va_list args;
 	va_start(args, fmsg);
 
 	formatMessage(fmsg, args);
 
-	if (linedata) fprintf(stderr, RED "[%s] at `%s` (%d): %s%s\n", errnames[err], linedata->source, linedata->linenum, buffer, RESET);
-	else fprintf(stderr, RED "[%s]: %s%s\n", errnames[err], buffer, RESET);
-	exit(-1);
+	Diagnostic diag = {
+		.isError = true,
+		.type = err,
+		.name = errnames[err],
+		.filename = NULL,
+		.source = linedata ? linedata->source : NULL,
+		.linenum = linedata ? linedata->linenum : 0,
+		.message = buffer
+	};
+	report(&diag);
+
+	arxFail(err);
 }
 
 
 void emitWarning(warnType warn, linedata_ctx* linedata, const char* fmsg, ...) {
-	// if (!doWarn) return;
-
 	// Allow filtering of warning types
 
 	va_list args;
@@ -69,8 +152,16 @@ void emitWarning(warnType warn, linedata_ctx* linedata, const char* fmsg, ...) {
 
 	formatMessage(fmsg, args);
 
-	if (linedata) fprintf(stderr, YELLOW "[%s] at `%s` (%d): %s%s\n", warnnames[warn], linedata->source, linedata->linenum, buffer, RESET);
-	else fprintf(stderr, YELLOW "[%s]: %s%s\n", warnnames[warn], buffer, RESET);
+	Diagnostic diag = {
+		.isError = false,
+		.type = warn,
+		.name = warnnames[warn],
+		.filename = NULL,
+		.source = linedata ? linedata->source : NULL,
+		.linenum = linedata ? linedata->linenum : 0,
+		.message = buffer
+	};
+	report(&diag);
 }
 
 void initScope(const char* fxnName) {
@@ -1,20 +1,22 @@
+#include <stdlib.h>
 #include <ctype.h>
 
 #include "handlers.h"
 #include "diagnostics.h"
+#include "allocator.h"
 #include "expr.h"
 #include "reserved.h"
 #include "adecl.h"
+#include "adeclc.h"
+#include "prefetch.h"
 #include "StructTable.h"
+#include "trace.h"
 
 
 void handleData(Parser* parser) {
 	// `.data` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .data directive at line %d", directiveToken->linenum);
 
@@ -30,10 +32,7 @@ void handleData(Parser* parser) {
 void handleConst(Parser* parser) {
 	// `.const` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .const directive at line %d", directiveToken->linenum);
 
@@ -48,10 +47,7 @@ void handleConst(Parser* parser) {
 void handleBss(Parser* parser) {
 	// `.bss` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .bss directive at line %d", directiveToken->linenum);
 
@@ -66,10 +62,7 @@ void handleBss(Parser* parser) {
 void handleText(Parser* parser) {
 	// `.text` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .text directive at line %d", directiveToken->linenum);
 
@@ -84,10 +77,7 @@ void handleText(Parser* parser) {
 void handleEvt(Parser* parser) {
 	// `.evt` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .evt directive at line %d", directiveToken->linenum);
 
@@ -102,10 +92,7 @@ void handleEvt(Parser* parser) {
 void handleIvt(Parser* parser) {
 	// `.ivt` must not be followed by anything on the same line
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .ivt directive at line %d", directiveToken->linenum);
 
@@ -137,10 +124,7 @@ void handleSet(Parser* parser, Node* directiveRoot) {
 	initScope("handleSet");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_SET;
 
@@ -165,7 +149,7 @@ void handleSet(Parser* parser, Node* directiveRoot) {
 
 	symb_entry_t* symbEntry = getSymbolEntry(parser->symbolTable, nextToken->lexeme);
 	if (symbEntry && GET_DEFINED(symbEntry->flags)) {
-		emitError(ERR_REDEFINED, &linedata, "Symbol redefinition: `%s`. First defined at `%s`", nextToken->lexeme, ssGetString(symbEntry->source));
+		emitError(ERR_REDEFINED, &linedata, "Symbol redefinition: `%s`. First defined at `%s`", nextToken->lexeme, sourceLine(symbEntry->loc));
 	}
 	if (symbEntry && GET_SECTION(symbEntry->flags) == S_UNDEF) {
 		// This means that this symbol got extern
@@ -197,8 +181,8 @@ void handleSet(Parser* parser, Node* directiveRoot) {
 		symbEntry->flags = SET_MAIN_TYPE(symbEntry->flags, M_ABS);
 		symbEntry->value.expr = exprRoot;
 	} else {
-		SYMBFLAGS flags = CREATE_FLAGS(M_ABS, T_NONE, E_EXPR, parser->sectionTable->activeSection, L_LOC, R_NREF, D_DEF);
-		symbEntry = initSymbolEntry(symbToken->lexeme, flags, exprRoot, 0, symbToken->sstring, symbToken->linenum);
+		SYMBFLAGS flags = CREATE_FLAGS(M_ABS, T_NONE, E_EXPR, currentSection(parser), L_LOC, R_NREF, D_DEF);
+		symbEntry = initSymbolEntry(symbToken->lexeme, flags, exprRoot, 0, symbToken->loc);
 		
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
@@ -214,10 +198,7 @@ void handleGlob(Parser* parser, Node* directiveRoot) {
 	initScope("handleGlob");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_GLOB;
 
@@ -246,11 +227,11 @@ void handleGlob(Parser* parser, Node* directiveRoot) {
 		// Just go with defaults/assumptions that it is absolute, no type, and value
 		// The assumption is that most commonly, addresses are made global
 		SYMBFLAGS flags = CREATE_FLAGS(M_ABS, T_NONE, E_VAL, parser->sectionTable->activeSection, L_GLOB, R_REF, D_UNDEF);
-		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->sstring, symbToken->linenum);
+		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->loc);
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
 	}
-	addSymbolReference(symbEntry, symbToken->sstring, symbToken->linenum);
+	addSymbolReference(parser->symbolTable, symbEntry, symbToken->loc);
 
 	// Make sure there is nothing else afterwards except for newline
 	parser->currentTokenIndex++; // Consume the symbol token
@@ -286,18 +267,18 @@ static void validateSection(Parser* parser, Token* directive, linedata_ctx* line
 
 	if (directiveType == TK_D_STRING || directiveType == TK_D_FLOAT) {
 		if (activeSection != DATA_SECT_N && activeSection != CONST_SECT_N) {
-			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", ssGetString(directive->sstring), sectionStr);
+			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", sourceLine(directive->loc), sectionStr);
 		}
 	} else if (directiveType == TK_D_BYTE || directiveType == TK_D_HWORD || directiveType == TK_D_WORD) {
 		if (activeSection != DATA_SECT_N && activeSection != CONST_SECT_N &&
 				activeSection != EVT_SECT_N && activeSection != IVT_SECT_N) {
-			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", ssGetString(directive->sstring), sectionStr);
+			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", sourceLine(directive->loc), sectionStr);
 		}
 	} else if (directiveType == TK_D_ZERO) {
 		if (activeSection != DATA_SECT_N && activeSection != CONST_SECT_N &&
 				activeSection != BSS_SECT_N &&
 				activeSection != EVT_SECT_N && activeSection != IVT_SECT_N) {
-			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", ssGetString(directive->sstring), sectionStr);
+			emitError(ERR_DIRECTIVE_NOT_ALLOWED, linedata, "The `%s` directive is not allowed in the %s section.", sourceLine(directive->loc), sectionStr);
 		}
 		if (activeSection != BSS_SECT_N) {
 			emitWarning(WARN_UNEXPECTED, linedata, "Consider using the `.zero` directive in the `.bss` section instead of `%s`.", sectionStr);
@@ -305,14 +286,32 @@ static void validateSection(Parser* parser, Token* directive, linedata_ctx* line
 	}
 }
 
+// Only codegen reads the data table, a syntax check (`-fsyntax-only`) builds none: values are counted, not collected
+
+// Adds a value to the data of an entry being built
+static void addDataValue(Parser* parser, Node*** array, size_t* capacity, size_t* count, Node* node) {
+	if (parser->config.syntaxOnly) {
+		(*count)++;
+		return;
+	}
+
+	pushNodes(array, count, capacity, node);
+}
+
+static void addData(Parser* parser, data_t type, uint32_t addr, uint32_t size, Node** data, size_t dataCount, size_t dataCapacity) {
+	if (parser->config.syntaxOnly) return;
+
+	// The values stay until the code is generated, the room left to grow into is given back
+	shrinkNodes(&data, dataCount, &dataCapacity);
+	data_entry_t* dataEntry = initDataEntry(type, addr, size, data, dataCount, dataCapacity);
+	addDataEntry(parser->dataTable, dataEntry, parser->sectionTable->activeSection);
+}
+
 void handleString(Parser* parser, Node* directiveRoot) {
 	initScope("handleString");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_STRING;
 
@@ -330,16 +329,14 @@ void handleString(Parser* parser, Node* directiveRoot) {
 	if (nextToken->type != TK_STRING) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.string` directive must be followed by a string, got `%s`.", nextToken->lexeme);
 
 	// Although there is only the need to hold a single string, the way that the data table is set up, it requires an array
-	Node** stringArray = newNodeArray(1);
-	if (!stringArray) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.string` directive string.");
-	int stringArrayCapacity = 1;
-	int stringArrayCount = 0;
+	Node** stringArray = NULL;
+	size_t stringArrayCapacity = 0;
+	size_t stringArrayCount = 0;
 
 	Node* stringNode = initASTNode(AST_LEAF, ND_STRING, nextToken, directiveRoot);
 	setUnaryDirectiveData(directiveData, stringNode);
 
-	stringArray = nodeArrayInsert(stringArray, &stringArrayCapacity, &stringArrayCount, stringNode);
-	if (!stringArray) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.string` directive string.");
+	addDataValue(parser, &stringArray, &stringArrayCapacity, &stringArrayCount, stringNode);
 
 	StrNode* strData = initStringNode(nextToken->lexeme, sdslen(nextToken->lexeme));
 	setNodeData(stringNode, strData, ND_STRING);
@@ -348,9 +345,8 @@ void handleString(Parser* parser, Node* directiveRoot) {
 	uint32_t dataAddr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
 	uint32_t dataSize = strData->length + 1; // +1 for the null terminator
 	// Set the data for the data table
-	data_entry_t* stringDataEntry = initDataEntry(STRING_TYPE, dataAddr, dataSize, stringArray, stringArrayCount, stringArrayCapacity);
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
-	addDataEntry(parser->dataTable, stringDataEntry, parser->sectionTable->activeSection);
+	advanceLP(parser->sectionTable, dataSize, &linedata);
+	addData(parser, STRING_TYPE, dataAddr, dataSize, stringArray, stringArrayCount, stringArrayCapacity);
 
 	// Need to make sure there is nothing else afterwards except for newline
 
@@ -364,10 +360,7 @@ void handleByte(Parser* parser, Node* directiveRoot) {
 	initScope("handleByte");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_BYTE;
 
@@ -392,10 +385,9 @@ void handleByte(Parser* parser, Node* directiveRoot) {
 	if (nextToken->type == TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.byte` directive must be followed by at least one expression.");
 
 	// This array is for the data table to hold, read the comment in DataTable.h for more info
-	Node** byteArray = newNodeArray(2);
-	if (!byteArray) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.byte` directive expressions.");
-	int byteArrayCapacity = 2;
-	int byteArrayCount = 0;
+	Node** byteArray = NULL;
+	size_t byteArrayCapacity = 0;
+	size_t byteArrayCount = 0;
 	// The number of bytes that the data will occupy is just the number of expressions (since each expr is 1 byte)
 	// So the size is just the count
 
@@ -406,8 +398,7 @@ void handleByte(Parser* parser, Node* directiveRoot) {
 		addNaryDirectiveData(directiveData, exprRoot);
 		exprRoot->parent = directiveRoot;
 
-		byteArray = nodeArrayInsert(byteArray, &byteArrayCapacity, &byteArrayCount, exprRoot);
-		if (!byteArray) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.byte` directive expressions.");
+		addDataValue(parser, &byteArray, &byteArrayCapacity, &byteArrayCount, exprRoot);
 
 		// Assume currentTokenIndex was updated in parseExpression for now
 		nextToken = parser->tokens[parser->currentTokenIndex]; // This better be the comma or newline
@@ -427,11 +418,10 @@ void handleByte(Parser* parser, Node* directiveRoot) {
 	}
 
 	uint32_t dataAddr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
-	uint32_t dataSize = byteArrayCount; // Each expr is 1 byte
+	size_t dataSize = byteArrayCount; // Each expr is 1 byte
 	// Set the data for the data table
-	data_entry_t* bytesDataEntry = initDataEntry(BYTES_TYPE, dataAddr, dataSize, byteArray, byteArrayCount, byteArrayCapacity);
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += byteArrayCount;
-	addDataEntry(parser->dataTable, bytesDataEntry, parser->sectionTable->activeSection);
+	advanceLP(parser->sectionTable, byteArrayCount, &linedata);
+	addData(parser, BYTES_TYPE, dataAddr, dataSize, byteArray, byteArrayCount, byteArrayCapacity);
 }
 
 void handleHword(Parser* parser, Node* directiveRoot) {
@@ -439,10 +429,7 @@ void handleHword(Parser* parser, Node* directiveRoot) {
 	initScope("handleHword");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_HWORD;
 
@@ -456,10 +443,9 @@ void handleHword(Parser* parser, Node* directiveRoot) {
 	Token* nextToken = parser->tokens[parser->currentTokenIndex];
 	if (nextToken->type == TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.hword` directive must be followed by at least one expression.");
 
-	Node** hwordArray = newNodeArray(2);
-	if (!hwordArray) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.hword` directive expressions.");
-	int hwordArrayCapacity = 2;
-	int hwordArrayCount = 0;
+	Node** hwordArray = NULL;
+	size_t hwordArrayCapacity = 0;
+	size_t hwordArrayCount = 0;
 
 	while (true) {
 		// Make the exception that single-value expressions do not need to contain '#'
@@ -468,8 +454,7 @@ void handleHword(Parser* parser, Node* directiveRoot) {
 		addNaryDirectiveData(directiveData, exprRoot);
 		exprRoot->parent = directiveRoot;
 
-		hwordArray = nodeArrayInsert(hwordArray, &hwordArrayCapacity, &hwordArrayCount, exprRoot);
-		if (!hwordArray) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.hword` directive expressions.");
+		addDataValue(parser, &hwordArray, &hwordArrayCapacity, &hwordArrayCount, exprRoot);
 
 		nextToken = parser->tokens[parser->currentTokenIndex];
 		if (nextToken->type == TK_NEWLINE) {
@@ -486,10 +471,9 @@ void handleHword(Parser* parser, Node* directiveRoot) {
 	}
 
 	uint32_t dataAddr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
-	uint32_t dataSize = hwordArrayCount * 2; // Each expr is 2 bytes
-	data_entry_t* hwordsDataEntry = initDataEntry(HWORDS_TYPE, dataAddr, dataSize, hwordArray, hwordArrayCount, hwordArrayCapacity);
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
-	addDataEntry(parser->dataTable, hwordsDataEntry, parser->sectionTable->activeSection);
+	size_t dataSize = hwordArrayCount * 2; // Each expr is 2 bytes
+	advanceLP(parser->sectionTable, dataSize, &linedata);
+	addData(parser, HWORDS_TYPE, dataAddr, dataSize, hwordArray, hwordArrayCount, hwordArrayCapacity);
 }
 
 void handleWord(Parser* parser, Node* directiveRoot) {
@@ -497,10 +481,7 @@ void handleWord(Parser* parser, Node* directiveRoot) {
 	initScope("handleWord");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_WORD;
 
@@ -514,10 +495,9 @@ void handleWord(Parser* parser, Node* directiveRoot) {
 	Token* nextToken = parser->tokens[parser->currentTokenIndex];
 	if (nextToken->type == TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.word` directive must be followed by at least one expression.");
 
-	Node** wordArray = newNodeArray(2);
-	if (!wordArray) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.word` directive expressions.");
-	int wordArrayCapacity = 2;
-	int wordArrayCount = 0;
+	Node** wordArray = NULL;
+	size_t wordArrayCapacity = 0;
+	size_t wordArrayCount = 0;
 
 	while (true) {
 		// Make the exception that single-value expressions do not need to contain '#'
@@ -526,8 +506,7 @@ void handleWord(Parser* parser, Node* directiveRoot) {
 		addNaryDirectiveData(directiveData, exprRoot);
 		exprRoot->parent = directiveRoot;
 
-		wordArray = nodeArrayInsert(wordArray, &wordArrayCapacity, &wordArrayCount, exprRoot);
-		if (!wordArray) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.word` directive expressions.");
+		addDataValue(parser, &wordArray, &wordArrayCapacity, &wordArrayCount, exprRoot);
 
 		nextToken = parser->tokens[parser->currentTokenIndex];
 		if (nextToken->type == TK_NEWLINE) {
@@ -544,20 +523,16 @@ void handleWord(Parser* parser, Node* directiveRoot) {
 	}
 
 	uint32_t dataAddr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
-	uint32_t dataSize = wordArrayCount * 4; // Each expr is 4 bytes
-	data_entry_t* wordsDataEntry = initDataEntry(WORDS_TYPE, dataAddr, dataSize, wordArray, wordArrayCount, wordArrayCapacity);
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
-	addDataEntry(parser->dataTable, wordsDataEntry, parser->sectionTable->activeSection);
+	size_t dataSize = wordArrayCount * 4; // Each expr is 4 bytes
+	advanceLP(parser->sectionTable, dataSize, &linedata);
+	addData(parser, WORDS_TYPE, dataAddr, dataSize, wordArray, wordArrayCount, wordArrayCapacity);
 }
 
 void handleFloat(Parser* parser, Node* directiveRoot) {
 	initScope("handleFloat");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_FLOAT;
 
@@ -576,10 +551,9 @@ void handleFloat(Parser* parser, Node* directiveRoot) {
 	if (nextToken->type == TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.float` directive must be followed by at least one float.");
 	if (nextToken->type != TK_FLOAT) emitError(ERR_INVALID_SYNTAX, &linedata, "The `.float` directive must be followed by a float, got `%s`.", nextToken->lexeme);
 
-	Node** floatArray = newNodeArray(2);
-	if (!floatArray) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.float` directive floats.");
-	int floatArrayCapacity = 2;
-	int floatArrayCount = 0;
+	Node** floatArray = NULL;
+	size_t floatArrayCapacity = 0;
+	size_t floatArrayCount = 0;
 
 	while (true) {
 		Node* floatNode = initASTNode(AST_LEAF, ND_NUMBER, nextToken, directiveRoot);
@@ -587,8 +561,7 @@ void handleFloat(Parser* parser, Node* directiveRoot) {
 		addNaryDirectiveData(directiveData, floatNode);
 		setNodeData(floatNode, numData, ND_NUMBER);
 
-		floatArray = nodeArrayInsert(floatArray, &floatArrayCapacity, &floatArrayCount, floatNode);
-		if (!floatArray) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.float` directive floats.");
+		addDataValue(parser, &floatArray, &floatArrayCapacity, &floatArrayCount, floatNode);
 
 		parser->currentTokenIndex++; // Consume the float token
 		nextToken = parser->tokens[parser->currentTokenIndex];
@@ -607,20 +580,16 @@ void handleFloat(Parser* parser, Node* directiveRoot) {
 	}
 
 	uint32_t dataAddr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
-	uint32_t dataSize = floatArrayCount * 4; // Each float is 4 bytes
-	data_entry_t* floatsDataEntry = initDataEntry(FLOATS_TYPE, dataAddr, dataSize, floatArray, floatArrayCount, floatArrayCapacity);
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
-	addDataEntry(parser->dataTable, floatsDataEntry, parser->sectionTable->activeSection);
+	size_t dataSize = floatArrayCount * 4; // Each float is 4 bytes
+	advanceLP(parser->sectionTable, dataSize, &linedata);
+	addData(parser, FLOATS_TYPE, dataAddr, dataSize, floatArray, floatArrayCount, floatArrayCapacity);
 }
 
 void handleZero(Parser* parser, Node* directiveRoot) {
 	initScope("handleZero");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_ZERO;
 
@@ -669,28 +638,22 @@ void handleZero(Parser* parser, Node* directiveRoot) {
 	rlog("exprEvalResult: 0x%x", exprEvalResult);
 
 	uint32_t dataSize = exprEvalResult;
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
+	advanceLP(parser->sectionTable, dataSize, &linedata);
 
-	Node** arr = newNodeArray(1);
-	if (!arr) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.zero` directive.");
-	int arrCapacity = 2;
-	int arrCount = 0;
-	arr = nodeArrayInsert(arr, &arrCapacity, &arrCount, exprRoot);
-	if (!arr) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.zero` directive.");
+	Node** arr = NULL;
+	size_t arrCapacity = 0;
+	size_t arrCount = 0;
+	addDataValue(parser, &arr, &arrCapacity, &arrCount, exprRoot);
 
 	// Set the data for the data table
-	data_entry_t* zeroDataEntry = initDataEntry(BYTES_TYPE, dataAddr, dataSize, arr, arrCount, arrCapacity);
-	addDataEntry(parser->dataTable, zeroDataEntry, parser->sectionTable->activeSection);
+	addData(parser, BYTES_TYPE, dataAddr, dataSize, arr, arrCount, arrCapacity);
 }
 
 void handleFill(Parser* parser, Node* directiveRoot) {
 	initScope("handleFill");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_FILL;
 
@@ -751,19 +714,15 @@ void handleFill(Parser* parser, Node* directiveRoot) {
 	rlog("exprEvalResult: 0x%x", exprEvalResult);
 
 	uint32_t dataSize = exprEvalResult;
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += dataSize;
-
-	Node** arr = newNodeArray(2);
-	if (!arr) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.fill` directive.");
-	int arrCapacity = 2;
-	int arrCount = 0;
-	arr = nodeArrayInsert(arr, &arrCapacity, &arrCount, lenExprRoot);
-	if (!arr) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.fill` directive.");
-	arr = nodeArrayInsert(arr, &arrCapacity, &arrCount, numExprRoot);
-	if (!arr) emitError(ERR_MEM, NULL, "Failed to reallocate memory for `.fill` directive.");
-
-	data_entry_t* fillDataEntry = initDataEntry(BYTES_TYPE, dataAddr, dataSize, arr, arrCount, arrCapacity);
-	addDataEntry(parser->dataTable, fillDataEntry, parser->sectionTable->activeSection);
+	advanceLP(parser->sectionTable, dataSize, &linedata);
+
+	Node** arr = NULL;
+	size_t arrCapacity = 0;
+	size_t arrCount = 0;
+	addDataValue(parser, &arr, &arrCapacity, &arrCount, lenExprRoot);
+	addDataValue(parser, &arr, &arrCapacity, &arrCount, numExprRoot);
+
+	addData(parser, BYTES_TYPE, dataAddr, dataSize, arr, arrCount, arrCapacity);
 }
 
 
@@ -773,10 +732,7 @@ void handleSize(Parser* parser, Node* directiveRoot) {
 	emitWarning(WARN_UNIMPLEMENTED, NULL, "The `.size` directive is not yet implemented.");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_SIZE;
 
@@ -834,13 +790,13 @@ void handleSize(Parser* parser, Node* directiveRoot) {
 		symbEntry->size = symbSize;
 	} else {
 		SYMBFLAGS flags = CREATE_FLAGS(M_ABS, T_NONE, E_EXPR, 0, L_LOC, R_REF, D_UNDEF);
-		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->sstring, symbToken->linenum);
+		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->loc);
 		symbEntry->size = symbSize;
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
 
 		// This is also a reference
-		addSymbolReference(symbEntry, directiveToken->sstring, directiveToken->linenum);
+		addSymbolReference(parser->symbolTable, symbEntry, directiveToken->loc);
 	}
 
 	Node* symbNode = initASTNode(AST_LEAF, ND_SYMB, symbToken, directiveRoot);
@@ -853,10 +809,7 @@ void handleType(Parser* parser, Node* directiveRoot) {
 	initScope("handleType");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	// Disallow when types feature is disabled
 	if (!FEATURE_ENABLED(parser->config, FEATURE_TYPES)) emitError(ERR_UNSUPPORTED, &linedata, "The `.type` directive is not supported because types feature is disabled.");
@@ -889,7 +842,7 @@ void handleType(Parser* parser, Node* directiveRoot) {
 		// Just go with defaults/assumptions that it is absolute, no type, and value
 		// Also, since this is just a directive, there will be no activeSection info
 		SYMBFLAGS flags = CREATE_FLAGS(M_ABS, T_NONE, E_VAL, S_UNDEF, L_LOC, R_NREF, D_UNDEF);
-		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, NULL, -1);
+		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, NO_LOC);
 		addSymbolEntry(parser->symbolTable, symbEntry);
 	}
 	symbEntry->structTypeIdx = -1; // This might be changed later on encountering the tag token
@@ -1012,10 +965,7 @@ void handleExtern(Parser* parser, Node* directiveRoot) {
 	initScope("handleExtern");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	directiveToken->type = TK_D_GLOB;
 
@@ -1044,7 +994,7 @@ void handleExtern(Parser* parser, Node* directiveRoot) {
 	if (symbEntry) {
 		// Symbol exists, check for redefinition
 		// Extern technically is a definition
-		if (GET_DEFINED(symbEntry->flags)) emitError(ERR_REDEFINED, &linedata, "Symbol definition from `.extern` directive: `%s`. First defined at `%s`.", symbToken->lexeme, ssGetString(symbEntry->source));
+		if (GET_DEFINED(symbEntry->flags)) emitError(ERR_REDEFINED, &linedata, "Symbol definition from `.extern` directive: `%s`. First defined at `%s`.", symbToken->lexeme, sourceLine(symbEntry->loc));
 		// Update locality to global
 		SET_LOCALITY(symbEntry->flags);
 		symbEntry->flags = SET_MAIN_TYPE(symbEntry->flags, M_NONE);
@@ -1056,12 +1006,12 @@ void handleExtern(Parser* parser, Node* directiveRoot) {
 		// Create new entry
 		// Although extern is a definition, it is also not one since many things depend on it being defined
 		SYMBFLAGS flags = CREATE_FLAGS(M_NONE, T_NONE, E_VAL, S_UNDEF, L_GLOB, R_NREF, D_UNDEF);
-		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->sstring, symbToken->linenum);
+		symbEntry = initSymbolEntry(symbToken->lexeme, flags, NULL, 0, symbToken->loc);
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
 	}
 	// Should it be a symbol reference??
-	// addSymbolReference(symbEntry, symbToken->sstring, symbToken->linenum);
+	// addSymbolReference(parser->symbolTable, symbEntry, symbToken->loc);
 
 	// Make sure there is nothing else afterwards except for newline
 	parser->currentTokenIndex++; // Consume the symbol token
@@ -1079,10 +1029,7 @@ void handleInclude(Parser* parser) {
 	initScope("handleInclude");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	log("Handling .include directive at line %d", directiveToken->linenum);
 
@@ -1094,98 +1041,122 @@ void handleInclude(Parser* parser) {
 	sds filename = sdsnewlen(nextToken->lexeme + 1, sdslen(nextToken->lexeme) - 2);
 	if (!filename) emitError(ERR_MEM, NULL, "Failed to allocate memory for `.include` directive filename.");
 
-	// Leave the rest to the adecl module thing
-	FILE* adeclFile = openADECLFile(filename);
-	if (!adeclFile) emitError(ERR_IO, &linedata, "Failed to open file `%s` for `.include` directive.", filename);
-	
+	sds path = findADECLFile(&parser->as->config, filename);
+	if (!path) emitError(ERR_IO, &linedata, "Failed to open file `%s` for `.include` directive.", filename);
+
+	// However the file is reached (another spelling, another `-I` directory, a link), it is only included the first time
+	sds canonical = canonicalADECLPath(path);
+	if (!canonical) emitError(ERR_IO, &linedata, "Failed to open file `%s` for `.include` directive.", filename);
+	bool first = addDependency(&parser->included, canonical);
+	if (!first) {
+		log("`%s` was already included, skipping.", path);
+		sdsfree(canonical);
+		sdsfree(path);
+		sdsfree(filename);
+		return;
+	}
+
+	traceBegin("adecl", "include %s", path);
+
 	ADECL_ctx context = {
-		.parentParserConfig = parser->config,
+		.as = parser->as,
 		.symbolTable = parser->symbolTable,
 		.structTable = parser->structTable,
 		.asts = NULL,
 		.astCapacity = 0,
 		.astCount = 0
 	};
-	lexParseADECLFile(adeclFile, &context);
+
+	// A file a worker loaded ahead is taken over, with its diagnostics reported here
+	// Precompiled or already read declarations come without lexing or parsing anything
+	// Otherwise leave the rest to the adecl module thing
+	bool found;
+	if (!takePrefetched(parser, canonical, &context, &found)) found = loadADECL(&context, path);
+	sdsfree(canonical);
+	if (!found) emitError(ERR_IO, &linedata, "Failed to open file `%s` for `.include` directive.", filename);
 
 	// Now, merge the ASTs, symbol table, and struct table
+	// The tables of the included file were made for this include only, their structs and entries are moved over rather than copied
+	traceBegin("adecl", "merge");
 
-	for (int i = 0; i < context.astCount; i++) {
-		parser->asts = nodeArrayInsert(parser->asts, &parser->astCapacity, &parser->astCount, context.asts[i]);
-		if (!parser->asts) emitError(ERR_MEM, NULL, "Failed to reallocate memory for ASTs after processing `.include` directive.");
-	}
+	reserveNodes(&parser->asts, &parser->astCapacity, parser->astCount + context.astCount);
+	for (size_t i = 0; i < context.astCount; i++) pushNodes(&parser->asts, &parser->astCount, &parser->astCapacity, context.asts[i]);
 
-	for (int i = 0; i < context.symbolTable->size; i++) {
-		symb_entry_t* entry = context.symbolTable->entries[i];
-		symb_entry_t* existingEntry = getSymbolEntry(parser->symbolTable, entry->name);
-		if (existingEntry) {
-			// If the existing entry is defined and the new one is also defined, error
-			if (GET_DEFINED(existingEntry->flags) && GET_DEFINED(entry->flags)) {
-				emitError(ERR_REDEFINED, &linedata, "Symbol redefinition from `.include` directive: `%s`. First defined at `%s`", entry->name, ssGetString(existingEntry->source));
-			}
-			// Otherwise, merge the entries
-			// If the new entry is defined, update the existing one to be defined
-			if (GET_DEFINED(entry->flags)) {
-				SET_DEFINED(existingEntry->flags);
-				existingEntry->value = entry->value;
-				existingEntry->linenum = entry->linenum;
-				existingEntry->source = entry->source;
-			}
-			// If the new entry is global, update the existing one to be global
-			if (GET_LOCALITY(entry->flags) == L_GLOB) {
-				SET_LOCALITY(existingEntry->flags);
-			}
-			// Merge references
-			for (int j = 0; j < entry->references.refcount; j++) {
-				addSymbolReference(existingEntry, entry->references.refs[j]->source, entry->references.refs[j]->linenum);
-			}
-		} else {
-			// Just add the new entry as is
-			symb_entry_t* newEntry = initSymbolEntry(entry->name, entry->flags, entry->value.expr, entry->value.val, entry->source, entry->linenum);
-			for (int j = 0; j < entry->references.refcount; j++) {
-				addSymbolReference(newEntry, entry->references.refs[j]->source, entry->references.refs[j]->linenum);
-			}
-			addSymbolEntry(parser->symbolTable, newEntry);
-		}
-	}
-	// Safe to free the table????
-	deinitSymbolTable(context.symbolTable);
+	// The structs get new indices in the parent table, what refers to them by index follows
+	int* structIndices = (int*) memCalloc(MEM_SYMTAB, context.structTable->size + 1, sizeof(int));
+	if (!structIndices) emitError(ERR_MEM, NULL, "Failed to allocate memory for merging structs after processing `.include` directive.");
 
 	for (int i = 0; i < context.structTable->size; i++) {
 		struct_root_t* structRoot = context.structTable->structs[i];
 		struct_root_t* existingStruct = getStructByName(parser->structTable, structRoot->name);
 		if (existingStruct) {
-			emitError(ERR_REDEFINED, &linedata, "Struct redefinition from `.include` directive: `%s`. First defined at `%s`", structRoot->name, ssGetString(existingStruct->source));
-		} else {
-			// Just add the new struct as is
-			struct_root_t* newStruct = initStruct(structRoot->name);
-			for (int j = 0; j < structRoot->fieldCount; j++) {
-				struct_field_t* field = structRoot->fields[j];
-				struct_field_t* newField = initStructField(field->name, field->type, field->size, field->offset, field->structTypeIdx);
-				newField->source = field->source;
-				newField->linenum = field->linenum;
-				addStructField(newStruct, newField);
-			}
-			newStruct->size = structRoot->size;
-			newStruct->source = structRoot->source;
-			newStruct->linenum = structRoot->linenum;
-			addStruct(parser->structTable, newStruct);
+			emitError(ERR_REDEFINED, &linedata, "Struct redefinition from `.include` directive: `%s`. First defined at `%s`", structRoot->name, sourceLine(existingStruct->loc));
 		}
-		
+
+		// Fields can only be of structs defined before theirs, which are already mapped
+		for (int j = 0; j < structRoot->fieldCount; j++) {
+			struct_field_t* field = structRoot->fields[j];
+			if (field->structTypeIdx >= 0) field->structTypeIdx = structIndices[field->structTypeIdx];
+		}
+		structIndices[i] = addStruct(parser->structTable, structRoot);
 	}
+	// The structs now belong to the parent table
+	context.structTable->size = 0;
 	deinitStructTable(context.structTable);
 
-	free(context.asts);
+	reserveSymbolEntries(&parser->symbolTable->entries, &parser->symbolTable->capacity, parser->symbolTable->size + context.symbolTable->size);
+	for (size_t i = 0; i < context.symbolTable->size; i++) {
+		symb_entry_t* entry = context.symbolTable->entries[i];
+		symb_entry_t* existingEntry = getSymbolEntry(parser->symbolTable, entry->name);
+		if (!existingEntry) {
+			if (entry->structTypeIdx >= 0) entry->structTypeIdx = structIndices[entry->structTypeIdx];
+			addSymbolEntry(parser->symbolTable, entry);
+			continue;
+		}
+
+		// If the existing entry is defined and the new one is also defined, error
+		if (GET_DEFINED(existingEntry->flags) && GET_DEFINED(entry->flags)) {
+			emitError(ERR_REDEFINED, &linedata, "Symbol redefinition from `.include` directive: `%s`. First defined at `%s`", entry->name, sourceLine(existingEntry->loc));
+		}
+		// Otherwise, merge the entries
+		// If the new entry is defined, update the existing one to be defined
+		if (GET_DEFINED(entry->flags)) {
+			SET_DEFINED(existingEntry->flags);
+			existingEntry->flags = SET_MAIN_TYPE(existingEntry->flags, GET_MAIN_TYPE(entry->flags));
+			// Precompiled and evaluated entries hold a value rather than an expression
+			if (GET_EXPRESSION(entry->flags) == E_EXPR) SET_EXPRESSION(existingEntry->flags);
+			else CLR_EXPRESSION(existingEntry->flags);
+			existingEntry->value = entry->value;
+			setSymbolSource(parser->symbolTable, existingEntry, entry->loc);
+		}
+		// If the new entry is global, update the existing one to be global
+		if (GET_LOCALITY(entry->flags) == L_GLOB) {
+			SET_LOCALITY(existingEntry->flags);
+		}
+		// Merge references
+		for (size_t j = 0; j < entry->references.refcount; j++) {
+			addSymbolReference(parser->symbolTable, existingEntry, entry->references.refs[j]->loc);
+		}
+		deinitSymbolEntry(entry);
+	}
+	// The entries were either moved to the parent table or merged and freed
+	context.symbolTable->size = 0;
+	deinitSymbolTable(context.symbolTable);
+	memFree(structIndices);
+
+	memFree(context.asts);
+	traceEnd();
+
+	traceEnd();
+	sdsfree(path);
+	sdsfree(filename);
 }
 
 void handleDef(Parser* parser, Node* directiveRoot) {
 	initScope("handleDef");
 
 	Token* directiveToken = parser->tokens[parser->currentTokenIndex++];
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	// Disallow when types feature is disabled
 	if (!FEATURE_ENABLED(parser->config, FEATURE_TYPES)) emitError(ERR_UNSUPPORTED, &linedata, "The `.def` directive is not supported because types feature is disabled.");
@@ -1209,10 +1180,9 @@ void handleDef(Parser* parser, Node* directiveRoot) {
 
 	struct_root_t* defStruct = getStructByName(parser->structTable, structNameToken->lexeme);
 	// Make sure it has not be defined
-	if (defStruct) emitError(ERR_REDEFINED, &linedata, "Struct redefinition: `%s`. First defined at `%s`", structNameToken->lexeme, ssGetString(defStruct->source));
+	if (defStruct) emitError(ERR_REDEFINED, &linedata, "Struct redefinition: `%s`. First defined at `%s`", structNameToken->lexeme, sourceLine(defStruct->loc));
 	defStruct = initStruct(structNameToken->lexeme);
-	defStruct->source = structNameToken->sstring;
-	defStruct->linenum = structNameToken->linenum;
+	defStruct->loc = structNameToken->loc;
 
 	parser->currentTokenIndex++; // Consume the struct name token
 
@@ -1226,8 +1196,7 @@ void handleDef(Parser* parser, Node* directiveRoot) {
 		parser->currentTokenIndex++; // Consume the newline
 		nextToken = parser->tokens[parser->currentTokenIndex];
 	}
-	linedata.linenum = nextToken->linenum;
-	linedata.source = ssGetString(nextToken->sstring);
+	linedata = lineAt(nextToken->loc);
 
 	// Now to loop "forever" to get the fields
 	// However, need some way to stop. What if `}` is missing
@@ -1245,8 +1214,7 @@ void handleDef(Parser* parser, Node* directiveRoot) {
 			nextToken = parser->tokens[parser->currentTokenIndex];
 
 			// Update linedata
-			linedata.linenum = nextToken->linenum;
-			linedata.source = ssGetString(nextToken->sstring);
+			linedata = lineAt(nextToken->loc);
 			continue;
 		}
 
@@ -1307,8 +1275,7 @@ void handleDef(Parser* parser, Node* directiveRoot) {
 		}
 
 		struct_field_t* newField = initStructField(fieldNameToken->lexeme, fieldType, size, defStruct->size, structTypeIdx);
-		newField->source = fieldNameToken->sstring;
-		newField->linenum = fieldNameToken->linenum;
+		newField->loc = fieldNameToken->loc;
 		bool added = addStructField(defStruct, newField);
 		if (!added) emitError(ERR_REDEFINED, &linedata, "Redefinition of field `%s` in struct `%s`.", fieldNameToken->lexeme, structNameToken->lexeme);
 
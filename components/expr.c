@@ -170,13 +170,13 @@ static Node* parsePrimary(Parser* parser) {
 
 			symb_entry_t* symbEntry = getSymbolEntry(parser->symbolTable, token->lexeme);
 			if (!symbEntry) {
-				sect_table_n sect = parser->sectionTable->activeSection;
+				sect_table_n sect = currentSection(parser);
 
 				SYMBFLAGS flags = CREATE_FLAGS(M_NONE, T_NONE, E_EXPR, sect, L_LOC, R_REF, D_UNDEF);
-				symbEntry = initSymbolEntry(token->lexeme, flags, NULL, 0, NULL, -1);
+				symbEntry = initSymbolEntry(token->lexeme, flags, NULL, 0, NO_LOC);
 				addSymbolEntry(parser->symbolTable, symbEntry);
 			}
-			addSymbolReference(symbEntry, token->sstring, token->linenum);
+			addSymbolReference(parser->symbolTable, symbEntry, token->loc);
 			SET_REFERENCED(symbEntry->flags);
 
 			SymbNode* symbData = initSymbolNode(symbEntry->symbTableIndex, 0);
@@ -184,6 +184,10 @@ static Node* parsePrimary(Parser* parser) {
 			parser->currentTokenIndex++;
 			break;
 		case TK_LP: // @
+			if (parser->config.declarationsOnly) {
+				linedata_ctx linedata = lineAt(token->loc);
+				emitError(ERR_NOT_ALLOWED, &linedata, "The location pointer `@` cannot be used in ADECL files, they have no sections.");
+			}
 			// Need to solidify the actual
 			node = initASTNode(AST_LEAF, ND_NUMBER, token, NULL);
 			numData = initNumberNode(NTYPE_UINT32, parser->sectionTable->entries[parser->sectionTable->activeSection].lp, 0.0f);
@@ -196,18 +200,12 @@ static Node* parsePrimary(Parser* parser) {
 			if (parser->tokens[parser->currentTokenIndex]->type == TK_RPAREN) {
 				parser->currentTokenIndex++; // consume ')'
 			} else {
-				linedata_ctx linedata = {
-					.linenum = token->linenum,
-					.source = ssGetString(token->sstring)
-				};
+				linedata_ctx linedata = lineAt(token->loc);
 				emitError(ERR_INVALID_SYNTAX, &linedata, "Expected ')' in expression");
 			}
 			break;
 		default: {
-			linedata_ctx linedata = {
-				.linenum = token->linenum,
-				.source = ssGetString(token->sstring)
-			};
+			linedata_ctx linedata = lineAt(token->loc);
 			emitError(ERR_INVALID_SYNTAX, &linedata, "Unexpected token in expression: %s", token->lexeme);
 			break;
 		}
@@ -266,18 +264,15 @@ static Node* parseBinary(Parser* parser, int minPrec) {
 // Parse an expression (entry point)
 Node* parseExpression(Parser* parser) {
 	// Save the starting token index
-	int startIdx = parser->currentTokenIndex;
+	size_t startIdx = parser->currentTokenIndex;
 	Node* expr = parseBinary(parser, 1);
 
 	// Check if this is a single-token expression
-	int endIdx = parser->currentTokenIndex;
+	size_t endIdx = parser->currentTokenIndex;
 	if (endIdx - startIdx == 1) {
 		Token* tok = parser->tokens[startIdx];
 		if (tok->type == TK_INTEGER || tok->type == TK_FLOAT) {
-			linedata_ctx linedata = {
-				.linenum = tok->linenum,
-				.source = ssGetString(tok->sstring)
-			};
+			linedata_ctx linedata = lineAt(tok->loc);
 			emitError(ERR_INVALID_SYNTAX, &linedata, "A single-number expression must use '#' (immediate), not a plain number.");
 		}
 	}
@@ -435,7 +430,7 @@ bool evaluateExpression(Node* exprRoot, SymbolTable* symbTable) {
 			}
 			// Apply operator
 			if (resultType == NTYPE_FLOAT) {
-				switch (exprRoot->token->type) {
+				switch (exprRoot->type) {
 					case TK_PLUS: fres = lfval + rfval; break;
 					case TK_MINUS:
 						if (right) fres = lfval - rfval;
@@ -448,7 +443,7 @@ bool evaluateExpression(Node* exprRoot, SymbolTable* symbTable) {
 				opData->valueType = NTYPE_FLOAT;
 				opData->value = (uint32_t) fres;
 			} else {
-				switch (exprRoot->token->type) {
+				switch (exprRoot->type) {
 					case TK_PLUS: result = lval + rval; break;
 					case TK_MINUS:
 						if (right) result = lval - rval;
@@ -490,7 +485,7 @@ Node* getExternSymbol(Node* exprRoot) { // TODO: change name, better indicate if
 	Node* right = opData->data.binary.right;
 	if (!left || !right) return NULL;
 	// This makes sure that the only expression form is `symb|number +/- number|symb`
-	if (exprRoot->token->type != TK_PLUS && exprRoot->token->type != TK_MINUS) return NULL;
+	if (exprRoot->type != TK_PLUS && exprRoot->type != TK_MINUS) return NULL;
 
 	if (left->nodeType == ND_SYMB && right->nodeType == ND_NUMBER) return left;
 	else if (left->nodeType == ND_NUMBER && right->nodeType == ND_SYMB) return right;
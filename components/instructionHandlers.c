@@ -75,10 +75,7 @@ void handleIR(Parser* parser, Node* instrRoot) {
 	initScope("handleIR");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling IR instruction at line %d", instrToken->linenum);
 
@@ -254,10 +251,7 @@ void handleI(Parser* parser, Node* instrRoot) {
 	initScope("handleI");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling I instruction at line %d", instrToken->linenum);
 
@@ -283,10 +277,7 @@ void handleR(Parser* parser, Node* instrRoot) {
 	initScope("handleR");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling R instruction at line %d", instrToken->linenum);
 
@@ -357,10 +348,7 @@ static Node* parseMemberAccess(Parser* parser) {
 	//                           |- ... and so on
 
 	Token* symbolToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = symbolToken->linenum,
-		.source = ssGetString(symbolToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(symbolToken->loc);
 
 	// Need to get the symbol itself and the type
 	symb_entry_t* symbol = getSymbolEntry(parser->symbolTable, symbolToken->lexeme);
@@ -382,10 +370,7 @@ void handleM(Parser* parser, Node* instrRoot) {
 	initScope("handleM");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	// log("Handling M instruction at line %d", instrToken->linenum);
 
@@ -593,7 +578,7 @@ void handleM(Parser* parser, Node* instrRoot) {
 		// Even though decomposition did not occur, pretend it did
 		// Increment the LP accordingly
 		// 7 instructions were added but the LP will be increased for this LD, so it takes care of one
-		parser->sectionTable->entries[parser->sectionTable->activeSection].lp += (4 * 6);
+		advanceLP(parser->sectionTable, 4 * 6, &linedata);
 
 		nextToken = parser->tokens[parser->currentTokenIndex];
 		if (nextToken->type != TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "Expected newline after immediate expression, got `%s`.", nextToken->lexeme);
@@ -624,7 +609,7 @@ void handleM(Parser* parser, Node* instrRoot) {
 		// Even though decomposition did not occur, pretend it did
 		// Increment the LP accordingly
 		// 6 instructions were added but the LP will be increased for this LD, so it takes care of one
-		parser->sectionTable->entries[parser->sectionTable->activeSection].lp += (4 * 5);
+		advanceLP(parser->sectionTable, 4 * 5, &linedata);
 
 		nextToken = parser->tokens[parser->currentTokenIndex];
 		if (nextToken->type != TK_NEWLINE) emitError(ERR_INVALID_SYNTAX, &linedata, "Expected newline after immediate expression, got `%s`.", nextToken->lexeme);
@@ -639,10 +624,7 @@ void handleBi(Parser* parser, Node* instrRoot) {
 	initScope("handleBi");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling Bi instruction at line %d", instrToken->linenum);
 
@@ -673,7 +655,7 @@ void handleBi(Parser* parser, Node* instrRoot) {
 	if (!symbEntry) {
 		// Not found, create an empty entry, also mark a reference
 		SYMBFLAGS flags = CREATE_FLAGS(M_NONE, T_NONE, E_EXPR, S_UNDEF, L_LOC, R_REF, D_UNDEF);
-		symbEntry = initSymbolEntry(nextToken->lexeme, flags, symbNode, 0, NULL, -1);
+		symbEntry = initSymbolEntry(nextToken->lexeme, flags, symbNode, 0, NO_LOC);
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
 	} else {
@@ -683,7 +665,7 @@ void handleBi(Parser* parser, Node* instrRoot) {
 	}
 
 	// Add a reference to this location
-	addSymbolReference(symbEntry, instrToken->sstring, instrToken->linenum);
+	addSymbolReference(parser->symbolTable, symbEntry, instrToken->loc);
 
 	// Set the node data
 	SymbNode* symbData = initSymbolNode(symbTableIndex, value);
@@ -704,10 +686,7 @@ void handleBu(Parser* parser, Node* instrRoot) {
 	initScope("handleBu");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling Bu instruction at line %d", instrToken->linenum);
 
@@ -752,10 +731,7 @@ void handleBc(Parser* parser, Node* instrRoot) {
 	initScope("handleBc");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling Bc instruction at line %d", instrToken->linenum);
 
@@ -799,7 +775,7 @@ void handleBc(Parser* parser, Node* instrRoot) {
 	if (!symbEntry) {
 		// Not found, create an empty entry, also mark a reference
 		SYMBFLAGS flags = CREATE_FLAGS(M_NONE, T_NONE, E_EXPR, S_UNDEF, L_LOC, R_REF, D_UNDEF);
-		symbEntry = initSymbolEntry(nextToken->lexeme, flags, symbNode, 0, NULL, -1);
+		symbEntry = initSymbolEntry(nextToken->lexeme, flags, symbNode, 0, NO_LOC);
 		addSymbolEntry(parser->symbolTable, symbEntry);
 		symbTableIndex = parser->symbolTable->size - 1;
 	} else {
@@ -809,7 +785,7 @@ void handleBc(Parser* parser, Node* instrRoot) {
 	}
 
 	// Add a reference to this location
-	addSymbolReference(symbEntry, instrToken->sstring, instrToken->linenum);
+	addSymbolReference(parser->symbolTable, symbEntry, instrToken->loc);
 
 	// Set the node data
 	SymbNode* symbData = initSymbolNode(symbTableIndex, value);
@@ -830,10 +806,7 @@ void handleS(Parser* parser, Node* instrRoot) {
 	initScope("handleS");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	log("Handling S instruction at line %d", instrToken->linenum);
 
@@ -879,10 +852,7 @@ void handleF(Parser* parser, Node* instrRoot) {
 	initScope("handleF");
 
 	Token* instrToken = parser->tokens[parser->currentTokenIndex];
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(instrToken->loc);
 
 	emitWarning(WARN_UNIMPLEMENTED, &linedata, "F-type instruction `%s` not yet implemented.", instrToken->lexeme);
 	// log("Handling F instruction at line %d", instrToken->linenum);
@@ -892,11 +862,7 @@ void decomposeLD(Node* ldInstrNode, Node* xdNode, Node* immNode) {
 	initScope("decomposeLD");
 
 
-	Token* instrToken = ldInstrNode->token;
-	linedata_ctx linedata = {
-		.linenum = instrToken->linenum,
-		.source = ssGetString(instrToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(ldInstrNode->loc);
 
 	// This will create the following instructions:
 	// `mv reg, imm[31:18]`
@@ -1044,7 +1010,7 @@ void decomposeLD(Node* ldInstrNode, Node* xdNode, Node* immNode) {
 	// To check if `=`, the token needs to be accessed as the node type being operator means nothing
 	// since there is a (high) chance that imm may hold an expression tree with an operator as its root
 
-	if (literalNode->token->type != TK_LITERAL) {
+	if (literalNode->type != TK_LITERAL) {
 		// Make `ld reg, [reg]`
 		ldInstruction = initASTNode(AST_ROOT, ND_INSTRUCTION, NULL, NULL);
 		InstrNode* ldData = initInstructionNode(LD, section);
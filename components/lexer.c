@@ -6,52 +6,68 @@
 
 #include "lexer.h"
 #include "diagnostics.h"
+#include "allocator.h"
 #include "sds.h"
-#include "libsecuredstring.h"
 
 
-Lexer* initLexer() {
-	Lexer* lexer = (Lexer*) malloc(sizeof(Lexer));
+static Lexer* createLexer(ArxAssembler* as) {
+	Lexer* lexer = (Lexer*) memAlloc(MEM_LEXER, sizeof(Lexer));
 	if (!lexer) emitError(ERR_MEM, NULL, "Failed to allocate memory for lexer.");
 
 	lexer->linenum = 0;
+	lexer->file = 0;
+	lexer->loc = NO_LOC;
 	lexer->currentPos = 0;
 	lexer->currentChar = '\0';
 	lexer->peekedChar = '\0';
 	lexer->prevToken = NULL;
 	lexer->inScope = false;
 
-	Token** tokens = (Token**) malloc(sizeof(Token*) * 64);
-	if (!tokens) emitError(ERR_MEM, NULL, "Failed to allocate memory for token array.");
-
-	lexer->tokens = tokens;
-	lexer->tokenCap = 64;
+	lexer->tokens = NULL;
+	lexer->tokenCap = 0;
 	lexer->tokenCount = 0;
+	reserveTokens(&lexer->tokens, &lexer->tokenCap, 64);
+
+	lexer->as = as;
 
 	return lexer;
 }
 
+Lexer* initLexer(ArxAssembler* as) {
+	Lexer* lexer = NULL;
+
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) lexer = createLexer(as);
+
+	return arxLeave(&frame) == ARX_OK ? lexer : NULL;
+}
+
 void deinitLexer(Lexer* lexer) {
-	for (int i = 0; i < lexer->tokenCount; i++) {
+	for (size_t i = 0; i < lexer->tokenCount; i++) {
 		// log("Freeing token %d: %s (%p)", i, lexer->tokens[i]->lexeme, lexer->tokens[i]->lexeme);
-		sdsfree(lexer->tokens[i]->lexeme);
-		free(lexer->tokens[i]);
+		deleteToken(lexer->tokens[i]);
 	}
-	free(lexer->tokens);
-	free(lexer);
+	memFree(lexer->tokens);
+	memFree(lexer);
+}
+
+arxStatus reserveSource(Lexer* lexer, size_t size) {
+	size_t estimate = size / SOURCE_BYTES_PER_TOKEN;
+	if (estimate > SOURCE_RESERVE_MAX_TOKENS) estimate = SOURCE_RESERVE_MAX_TOKENS;
+
+	ArxFrame frame;
+	arxEnter(lexer->as, &frame);
+	if (setjmp(frame.env) == 0) reserveTokens(&lexer->tokens, &lexer->tokenCap, lexer->tokenCount + estimate);
+
+	return arxLeave(&frame);
 }
 
 static void addToken(Lexer* lexer, Token* token) {
-	if (lexer->tokenCount == lexer->tokenCap) {
-		lexer->tokenCap *= 2;
-		Token** newTokens = (Token**) realloc(lexer->tokens, sizeof(Token*) * lexer->tokenCap);
-		if (!newTokens) emitError(ERR_MEM, NULL, "Failed to reallocate memory for token array.");
-		lexer->tokens = newTokens;
-	}
-	lexer->tokens[lexer->tokenCount++] = token;
+	pushTokens(&lexer->tokens, &lexer->tokenCount, &lexer->tokenCap, token);
 
 	token->linenum = lexer->linenum;
-	token->sstring = ssCreateSecuredString(lexer->line);
+	token->loc = lexer->loc;
 }
 
 static void advance(Lexer* lexer) {
@@ -62,12 +78,11 @@ static void advance(Lexer* lexer) {
 	lexer->peekedChar = lexer->line[lexer->currentPos + 1];
 }
 
-void lexLine(Lexer* lexer, const char* line) {
+static void tokenizeLine(Lexer* lexer, const char* line) {
 	initScope("lexLine");
 
 	// The lexer needs the newline at the end to properly insert the NEWLINE token
-	// However, each token uses a copy of the lexer's line as the source, which includes the newline
-	// To keep the newline but also ignore it, temporaries will be used
+	// However, the source map keeps the line without it, so the source line is a trimmed copy
 	// It also helps making a new string for the source line as `line` is managed by `getline`
 	
 	const char* originalLine = line; // The line that has the newline
@@ -75,9 +90,14 @@ void lexLine(Lexer* lexer, const char* line) {
 
 	// log("Lexing line %d: `%s`", lexer->linenum, sourceLine);
 
-	// Since the lexer first uses the line to get the tokens, it needs the original for the newline
+	// The file is numbered once it has a line
+	SourceMap* sources = &lexer->as->sources;
+	if (!lexer->file) lexer->file = addSourceFile(sources);
+
+	// Since the lexer uses the line to get the tokens, it needs the original for the newline
 	lexer->line = (sds) originalLine;
 	lexer->linenum++;
+	lexer->loc = addSourceLine(sources, lexer->file, lexer->linenum, sourceLine);
 	lexer->currentPos = -1;
 	lexer->prevToken = NULL;
 	advance(lexer);
@@ -109,14 +129,10 @@ void lexLine(Lexer* lexer, const char* line) {
 			break;
 		}
 
-		// addToken now needs the source line without the newline
-		lexer->line = sourceLine;
 		addToken(lexer, tok);
 		// printToken(tok);
 
 		lexer->prevToken = tok;
-		// Lexer needs the original
-		lexer->line = (sds) originalLine;
 
 		tok = getNextToken(lexer, &linedata);
 	}
@@ -125,14 +141,21 @@ void lexLine(Lexer* lexer, const char* line) {
 	// Treat EOF as a newline so there's no `if type == TK_NEWLINE && TK_EOF` many times later
 	if (tok && (tok->type == TK_NEWLINE || tok->type == TK_EOF)) {
 		if (tok->type == TK_EOF) tok->type = TK_NEWLINE; // No need to change everything else since stuff uses ->type
-		lexer->line = sourceLine;
 		addToken(lexer, tok);
 		// printToken(tok);
 	} else if (tok) deleteToken(tok);
 
-	// The line is ephemeral, `line` is managed by getline, and `sourceLine` is managed by the tokens and
-	//   the lexer loses ownership of it at the end of the line
+	// The line is ephemeral, `line` is managed by getline, and the source map has its own copy of `sourceLine`
 	lexer->line = NULL;
+	sdsfree(sourceLine);
+}
+
+arxStatus lexLine(Lexer* lexer, const char* line) {
+	ArxFrame frame;
+	arxEnter(lexer->as, &frame);
+	if (setjmp(frame.env) == 0) tokenizeLine(lexer, line);
+
+	return arxLeave(&frame);
 }
 
 static void getString(Lexer* lexer, Token* token, linedata_ctx* linedata) {
@@ -235,11 +258,11 @@ bool isRegister(sds lexeme) {
 }
 
 Token* getNextToken(Lexer* lexer, linedata_ctx* linedata) {
-	Token* token = (Token*) malloc(sizeof(Token));
+	Token* token = (Token*) memAlloc(MEM_TOKENS, sizeof(Token));
 	if (!token) emitError(ERR_MEM, NULL, "Failed to allocate memory for token.");
 	token->lexeme = NULL;
 	token->type = TK_UNKNOWN;
-	token->sstring = NULL;
+	token->loc = NO_LOC;
 	token->linenum = -1;
 
 	while (isblank(lexer->currentChar)) {
@@ -735,15 +758,14 @@ void printToken(Token* token) {
 	rlog("Token(type=%s, lexeme=`%s`, line=%d)", typeStr, token->lexeme, token->linenum);
 }
 
-Token* getToken(Lexer* lexer, int index) {
-	if (index < 0 || index >= lexer->tokenCount) return NULL;
+Token* getToken(Lexer* lexer, size_t index) {
+	if (index >= lexer->tokenCount) return NULL;
 	return lexer->tokens[index];
 }
 
 void resetLexer(Lexer* lexer) {
-	for (int i = 0; i < lexer->tokenCount; i++) {
-		sdsfree(lexer->tokens[i]->lexeme);
-		free(lexer->tokens[i]);
+	for (size_t i = 0; i < lexer->tokenCount; i++) {
+		deleteToken(lexer->tokens[i]);
 	}
 	// Even though tokens were freed, capacity is to remain
 
@@ -752,6 +774,8 @@ void resetLexer(Lexer* lexer) {
 	lexer->peekedChar = '\0';
 	lexer->inScope = false;
 	lexer->linenum = 0;
+	lexer->file = 0;
+	lexer->loc = NO_LOC;
 	lexer->line = NULL;
 
 	// prevToken and currentPos are already reset in lexLine
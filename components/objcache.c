@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+
+#include "objcache.h"
+#include "sha256.h"
+#include "allocator.h"
+#include "sds.h"
+#include "adecl.h"
+
+
+#ifndef _WIN32
+
+// Bumped whenever what goes into a key changes
+#define CACHE_FORMAT "arxsm object cache 1"
+
+typedef struct Entry {
+	sds path;
+	time_t mtime;
+	unsigned long long size;
+} Entry;
+
+
+// Reads a whole file, NULL if it cannot be read
+static char* readFile(const char* path, size_t* len) {
+	FILE* file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	size_t capacity = 4096;
+	size_t size = 0;
+	char* data = (char*) memAlloc(MEM_OUTPUT, capacity);
+	while (data) {
+		size += fread(data + size, 1, capacity - size, file);
+		if (size < capacity) break;
+
+		capacity *= 2;
+		char* temp = (char*) memRealloc(MEM_OUTPUT, data, capacity);
+		if (!temp) {
+			memFree(data);
+			data = NULL;
+		} else data = temp;
+	}
+
+	bool failed = ferror(file);
+	fclose(file);
+	if (failed) {
+		memFree(data);
+		return NULL;
+	}
+
+	*len = size;
+	return data;
+}
+
+// Every piece is preceded by its length, so that no two different sets of pieces hash the same
+static void hashPiece(sha256_t* sha, const void* data, size_t len) {
+	uint64_t len64 = len;
+	updateSHA256(sha, &len64, sizeof(len64));
+	updateSHA256(sha, data, len);
+}
+
+static bool hashFile(sha256_t* sha, const Config* config, const char* path, dep_list_t* visited);
+
+// Hashes whatever `.include "file"` in the text names, in the order they appear, found the way `.include` finds them
+static void hashIncludes(sha256_t* sha, const Config* config, const char* text, size_t len, dep_list_t* visited) {
+	static const char directive[] = ".include";
+	const size_t directiveLen = sizeof(directive) - 1;
+
+	const char* end = text + len;
+	const char* pos = text;
+	while ((pos = memchr(pos, '.', end - pos)) != NULL) {
+		if ((size_t) (end - pos) < directiveLen || memcmp(pos, directive, directiveLen) != 0) {
+			pos++;
+			continue;
+		}
+		pos += directiveLen;
+
+		while (pos < end && (*pos == ' ' || *pos == '\t')) pos++;
+		if (pos == end || *pos != '"') continue;
+
+		const char* name = ++pos;
+		while (pos < end && *pos != '"' && *pos != '\n') pos++;
+		if (pos == end || *pos != '"') continue;
+
+		sds filename = sdsnewlen(name, pos - name);
+		sds path = findADECLFile(config, filename);
+		if (path) sdsfree(filename);
+		else path = filename;
+
+		if (addDependency(visited, path)) {
+			hashPiece(sha, path, sdslen(path));
+			// A missing include fails the assembly, nothing gets stored under this key anyway
+			if (!hashFile(sha, config, path, visited)) hashPiece(sha, "missing", 7);
+		}
+		sdsfree(path);
+		pos++;
+	}
+}
+
+static bool hashFile(sha256_t* sha, const Config* config, const char* path, dep_list_t* visited) {
+	size_t len;
+	char* text = readFile(path, &len);
+	if (!text) return false;
+
+	hashPiece(sha, text, len);
+	hashIncludes(sha, config, text, len, visited);
+	memFree(text);
+
+	return true;
+}
+
+bool cacheKey(const Config* config, const char* infile, char key[CACHE_KEY_LEN + 1], dep_list_t* includes) {
+	sha256_t sha;
+	initSHA256(&sha);
+
+	hashPiece(&sha, CACHE_FORMAT, strlen(CACHE_FORMAT));
+	hashPiece(&sha, ARXSM_VERSION, strlen(ARXSM_VERSION));
+	uint8_t flags[4] = { config->useDebugSymbols, config->warningAsFatal, config->warnings, config->enhancedFeatures };
+	hashPiece(&sha, flags, sizeof(flags));
+
+	dep_list_t visited = {0};
+	bool read = hashFile(&sha, config, infile, &visited);
+
+	if (read && includes) {
+		for (int i = 0; i < visited.count; i++) addDependency(includes, visited.paths[i]);
+	}
+	freeDependencies(&visited);
+	if (!read) return false;
+
+	uint8_t digest[SHA256_DIGEST_LEN];
+	finalSHA256(&sha, digest);
+	for (int i = 0; i < SHA256_DIGEST_LEN; i++) sprintf(key + i * 2, "%02x", digest[i]);
+
+	return true;
+}
+
+
+static sds entryDir(const char* dir, const char* key) {
+	return sdscatprintf(sdsempty(), "%s/%.2s", dir, key);
+}
+
+static sds entryPath(const char* dir, const char* key) {
+	return sdscatprintf(sdsempty(), "%s/%.2s/%s.ao", dir, key, key + 2);
+}
+
+static bool makeDir(const char* path) {
+	return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
+static bool copyFile(const char* from, int toFd) {
+	int fromFd = open(from, O_RDONLY);
+	if (fromFd < 0) return false;
+
+	char buffer[8192];
+	bool copied = true;
+	ssize_t n;
+	while (copied && (n = read(fromFd, buffer, sizeof(buffer))) != 0) {
+		if (n < 0) {
+			copied = errno == EINTR;
+			continue;
+		}
+		for (ssize_t done = 0; copied && done < n; ) {
+			ssize_t w = write(toFd, buffer + done, n - done);
+			if (w < 0 && errno == EINTR) continue;
+			if (w <= 0) copied = false;
+			else done += w;
+		}
+	}
+	close(fromFd);
+
+	return copied;
+}
+
+// Held while the statistics are read and written, and while entries are added or evicted
+static int lockCache(const char* dir) {
+	sds path = sdscatprintf(sdsempty(), "%s/lock", dir);
+	int fd = open(path, O_RDWR | O_CREAT, 0666);
+	sdsfree(path);
+
+	if (fd >= 0) flock(fd, LOCK_EX);
+
+	return fd;
+}
+
+static void unlockCache(int fd) {
+	if (fd < 0) return;
+
+	flock(fd, LOCK_UN);
+	close(fd);
+}
+
+cache_stats_t getCacheStats(const char* dir) {
+	cache_stats_t stats = {0};
+
+	sds path = sdscatprintf(sdsempty(), "%s/stats", dir);
+	FILE* file = fopen(path, "r");
+	sdsfree(path);
+	if (!file) return stats;
+
+	cache_stats_t read;
+	if (fscanf(file, "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nfiles %llu\nsize %llu\n",
+			&read.hits, &read.misses, &read.stores, &read.evictions, &read.files, &read.size) == 6) {
+		stats = read;
+	}
+	fclose(file);
+
+	return stats;
+}
+
+static void writeStats(const char* dir, const cache_stats_t* stats) {
+	sds path = sdscatprintf(sdsempty(), "%s/stats", dir);
+	FILE* file = fopen(path, "w");
+	sdsfree(path);
+	if (!file) return;
+
+	fprintf(file, "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nfiles %llu\nsize %llu\n",
+		stats->hits, stats->misses, stats->stores, stats->evictions, stats->files, stats->size);
+	fclose(file);
+}
+
+bool cacheFetch(const char* dir, const char* key, const char* outfile) {
+	sds path = entryPath(dir, key);
+
+	bool hit = false;
+	if (access(path, R_OK) == 0) {
+		int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (out >= 0) {
+			hit = copyFile(path, out);
+			if (close(out) != 0) hit = false;
+		}
+		// The entry was just used, eviction goes by modification time
+		if (hit) utime(path, NULL);
+	}
+	sdsfree(path);
+
+	int lock = makeDir(dir) ? lockCache(dir) : -1;
+	if (lock >= 0) {
+		cache_stats_t stats = getCacheStats(dir);
+		if (hit) stats.hits++;
+		else stats.misses++;
+		writeStats(dir, &stats);
+	}
+	unlockCache(lock);
+
+	return hit;
+}
+
+static int compareEntries(const void* a, const void* b) {
+	time_t ta = ((const Entry*) a)->mtime;
+	time_t tb = ((const Entry*) b)->mtime;
+	return (ta > tb) - (ta < tb);
+}
+
+// Rescans every entry, so the counts also recover from entries removed by hand,
+// then removes the oldest ones until the cache is back to 90% of the limit, leaving room before the next eviction
+static void evict(const char* dir, size_t maxSize, cache_stats_t* stats) {
+	Entry* entries = NULL;
+	int count = 0;
+	int capacity = 0;
+	unsigned long long total = 0;
+
+	for (int i = 0; i < 256; i++) {
+		sds sub = sdscatprintf(sdsempty(), "%s/%02x", dir, i);
+		DIR* d = opendir(sub);
+		struct dirent* ent;
+		while (d && (ent = readdir(d)) != NULL) {
+			size_t len = strlen(ent->d_name);
+			if (len != CACHE_KEY_LEN - 2 + 3 || strcmp(ent->d_name + len - 3, ".ao") != 0) continue;
+
+			sds path = sdscatprintf(sdsempty(), "%s/%s", sub, ent->d_name);
+			struct stat st;
+			if (stat(path, &st) != 0) {
+				sdsfree(path);
+				continue;
+			}
+
+			if (count == capacity) {
+				capacity = capacity ? capacity * 2 : 64;
+				Entry* temp = (Entry*) memRealloc(MEM_OUTPUT, entries, sizeof(Entry) * capacity);
+				if (!temp) {
+					sdsfree(path);
+					break;
+				}
+				entries = temp;
+			}
+			entries[count++] = (Entry) { .path = path, .mtime = st.st_mtime, .size = (unsigned long long) st.st_size };
+			total += (unsigned long long) st.st_size;
+		}
+		if (d) closedir(d);
+		sdsfree(sub);
+	}
+
+	qsort(entries, count, sizeof(Entry), compareEntries);
+
+	unsigned long long target = (unsigned long long) maxSize / 10 * 9;
+	int kept = count;
+	for (int i = 0; i < count && total > target; i++) {
+		if (unlink(entries[i].path) != 0) continue;
+		total -= entries[i].size;
+		kept--;
+		stats->evictions++;
+	}
+
+	for (int i = 0; i < count; i++) sdsfree(entries[i].path);
+	memFree(entries);
+
+	stats->files = kept;
+	stats->size = total;
+}
+
+void cacheStore(const char* dir, size_t maxSize, const char* key, const char* outfile) {
+	sds sub = entryDir(dir, key);
+	sds path = entryPath(dir, key);
+	// Written next to the entry then renamed over it, readers never see half an object
+	sds temp = sdscat(sdsdup(path), ".XXXXXX");
+
+	int fd = -1;
+	if (makeDir(dir) && makeDir(sub)) fd = mkstemp(temp);
+	if (fd >= 0) {
+		bool written = copyFile(outfile, fd);
+		if (close(fd) != 0) written = false;
+
+		int lock = written ? lockCache(dir) : -1;
+		struct stat old;
+		bool replaced = stat(path, &old) == 0;
+		struct stat st;
+		if (lock >= 0 && stat(temp, &st) == 0 && rename(temp, path) == 0) {
+			cache_stats_t stats = getCacheStats(dir);
+			stats.stores++;
+			stats.size += (unsigned long long) st.st_size;
+			if (replaced) stats.size -= (unsigned long long) old.st_size;
+			else stats.files++;
+
+			if (stats.size > maxSize) evict(dir, maxSize, &stats);
+			writeStats(dir, &stats);
+		} else unlink(temp);
+		unlockCache(lock);
+	}
+
+	sdsfree(temp);
+	sdsfree(path);
+	sdsfree(sub);
+}
+
+void displayCacheStats(const char* dir) {
+	cache_stats_t stats = getCacheStats(dir);
+	unsigned long long lookups = stats.hits + stats.misses;
+
+	fprintf(stderr, "Object cache (%s):\n", dir);
+	fprintf(stderr, "  %-10s %12llu\n", "hits", stats.hits);
+	fprintf(stderr, "  %-10s %12llu\n", "misses", stats.misses);
+	fprintf(stderr, "  %-10s %11.1f%%\n", "hit rate", lookups ? 100.0 * stats.hits / lookups : 0.0);
+	fprintf(stderr, "  %-10s %12llu\n", "stores", stats.stores);
+	fprintf(stderr, "  %-10s %12llu\n", "evictions", stats.evictions);
+	fprintf(stderr, "  %-10s %12llu\n", "files", stats.files);
+	fprintf(stderr, "  %-10s %12llu\n", "size", stats.size);
+}
+
+#else
+
+bool cacheKey(const Config* config, const char* infile, char key[CACHE_KEY_LEN + 1], dep_list_t* includes) {
+	return false;
+}
+
+bool cacheFetch(const char* dir, const char* key, const char* outfile) {
+	return false;
+}
+
+void cacheStore(const char* dir, size_t maxSize, const char* key, const char* outfile) {
+}
+
+cache_stats_t getCacheStats(const char* dir) {
+	return (cache_stats_t) {0};
+}
+
+void displayCacheStats(const char* dir) {
+}
+
+#endif
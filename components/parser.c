@@ -3,35 +3,59 @@
 
 #include "parser.h"
 #include "diagnostics.h"
+#include "allocator.h"
 #include "reserved.h"
 #include "handlers.h"
 #include "expr.h"
+#include "trace.h"
+#include "prefetch.h"
 
 
-Parser* initParser(Token** tokens, int tokenCount, ParserConfig config) {
-	Parser* parser = (Parser*) malloc(sizeof(Parser));
+static Parser* createParser(ArxAssembler* as, Token** tokens, size_t tokenCount) {
+	Parser* parser = (Parser*) memAlloc(MEM_AST, sizeof(Parser));
 	if (!parser) emitError(ERR_MEM, NULL, "Failed to allocate memory for parser.");
 
 	parser->tokens = tokens;
 	parser->tokenCount = tokenCount;
 	parser->currentTokenIndex = 0;
+	parser->statementStart = 0;
 
-	parser->asts = (Node**) malloc(sizeof(Node*) * 4);
-	if (!parser->asts) emitError(ERR_MEM, NULL, "Failed to allocate memory for parser ASTs.");
-
+	parser->asts = NULL;
 	parser->astCount = 0;
-	parser->astCapacity = 4;
+	parser->astCapacity = 0;
+	reserveNodes(&parser->asts, &parser->astCapacity, 4);
 
 	parser->ldimmList = NULL;
 	parser->ldimmTail = NULL;
 
-	parser->config = config;
+	parser->included = (dep_list_t) {0};
+	parser->prefetch = NULL;
+
+	parser->config = (ParserConfig) {
+		.warningAsFatal = as->config.warningAsFatal,
+		.warnings = as->config.warnings,
+		.enhancedFeatures = as->config.enhancedFeatures,
+		.syntaxOnly = as->config.syntaxOnly,
+		.streamPass = 0
+	};
 
 	parser->processing = true;
 
+	parser->as = as;
+
 	return parser;
 }
 
+Parser* initParser(ArxAssembler* as, Token** tokens, size_t tokenCount) {
+	Parser* parser = NULL;
+
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) parser = createParser(as, tokens, tokenCount);
+
+	return arxLeave(&frame) == ARX_OK ? parser : NULL;
+}
+
 void setTables(Parser* parser, SectionTable* sectionTable, SymbolTable* symbolTable, StructTable* structTable, DataTable* dataTable, RelocTable* relocTable) {
 	parser->sectionTable = sectionTable;
 	parser->symbolTable = symbolTable;
@@ -40,35 +64,88 @@ void setTables(Parser* parser, SectionTable* sectionTable, SymbolTable* symbolTa
 	parser->relocTable = relocTable;	
 }
 
+static void freeLDList(Parser* parser) {
+	struct LDIMM* current = parser->ldimmList;
+	while (current) {
+		struct LDIMM* next = current->next;
+		memFree(current);
+		current = next;
+	}
+	parser->ldimmList = NULL;
+	parser->ldimmTail = NULL;
+}
+
 void deinitParser(Parser* parser) {
-	for (int i = 0; i < parser->astCount; i++) {
+	for (size_t i = 0; i < parser->astCount; i++) {
 		freeAST(parser->asts[i]);
 	}
-	free(parser->asts);
+	memFree(parser->asts);
+	freeLDList(parser);
+	freeDependencies(&parser->included);
 
-	free(parser);
+	memFree(parser);
 }
 
-static void addAst(Parser* parser, Node* ast) {
-	if (parser->astCount == parser->astCapacity) {
-		parser->astCapacity += 2;
-		Node** temp = (Node**) realloc(parser->asts, sizeof(Node*) * parser->astCapacity);
-		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for parser ASTs.");
-		parser->asts = temp;
+void resetParserChunk(Parser* parser, Token** tokens, size_t tokenCount) {
+	for (size_t i = 0; i < parser->astCount; i++) {
+		freeAST(parser->asts[i]);
 	}
-	parser->asts[parser->astCount++] = ast;
+	// The AST array keeps its capacity
+	parser->astCount = 0;
+	freeLDList(parser);
+
+	parser->tokens = tokens;
+	parser->tokenCount = tokenCount;
+	parser->currentTokenIndex = 0;
+	parser->statementStart = 0;
+}
+
+void resetParser(Parser* parser, Token** tokens, size_t tokenCount) {
+	for (size_t i = 0; i < parser->astCount; i++) {
+		freeAST(parser->asts[i]);
+	}
+	// The AST array keeps its capacity
+	parser->astCount = 0;
+	freeLDList(parser);
+	clearDependencies(&parser->included);
+
+	parser->tokens = tokens;
+	parser->tokenCount = tokenCount;
+	parser->currentTokenIndex = 0;
+	parser->statementStart = 0;
+	parser->processing = true;
+}
+
+static void addAst(Parser* parser, Node* ast) {
+	pushNodes(&parser->asts, &parser->astCount, &parser->astCapacity, ast);
+}
+
+// A statement is at most a line, the lines left to parse are the most ASTs there can be
+static void reserveAsts(Parser* parser) {
+	if (parser->currentTokenIndex >= parser->tokenCount) return;
+
+	int first = parser->tokens[parser->currentTokenIndex]->linenum;
+	int last = parser->tokens[parser->tokenCount - 1]->linenum;
+	reserveNodes(&parser->asts, &parser->astCapacity, parser->astCount + (size_t) (last - first + 1));
 }
 
 
 static void parseLabel(Parser* parser) {
 	Token* labelToken = parser->tokens[parser->currentTokenIndex++];
 
+	// The first pass of a stream defined it already, at the same location pointer as now
+	if (parser->config.streamPass == 2) {
+		symb_entry_t* entry = getSymbolEntry(parser->symbolTable, labelToken->lexeme);
+		if (!entry || !GET_DEFINED(entry->flags) || entry->value.val != parser->sectionTable->entries[parser->sectionTable->activeSection].lp) {
+			linedata_ctx linedata = lineAt(labelToken->loc);
+			emitError(ERR_INTERNAL, &linedata, "Label `%s` is not where the first pass put it.", labelToken->lexeme);
+		}
+		return;
+	}
+
 	// Make sure the label is valid
 	if (labelToken->lexeme[0] != '_' && !isalpha(labelToken->lexeme[0])) {
-		linedata_ctx linedata = {
-			.linenum = labelToken->linenum,
-			.source = ssGetString(labelToken->sstring)
-		};
+		linedata_ctx linedata = lineAt(labelToken->loc);
 		emitError(ERR_INVALID_LABEL, &linedata, "Label must start with an alphabetic character or underscore: `%s`", labelToken->lexeme);
 	}
 	
@@ -79,10 +156,7 @@ static void parseLabel(Parser* parser) {
 	if (indexOf(REGISTERS, sizeof(REGISTERS)/sizeof(REGISTERS[0]), labelToken->lexeme) != -1 ||
 			indexOf(DIRECTIVES, sizeof(DIRECTIVES)/sizeof(DIRECTIVES[0]), labelToken->lexeme) != -1 ||
 			indexOf(INSTRUCTIONS, sizeof(INSTRUCTIONS)/sizeof(INSTRUCTIONS[0]), labelToken->lexeme) != -1) {
-		linedata_ctx linedata = {
-			.linenum = labelToken->linenum,
-			.source = ssGetString(labelToken->sstring)
-		};
+		linedata_ctx linedata = lineAt(labelToken->loc);
 		emitError(ERR_INVALID_LABEL, &linedata, "Label cannot be a reserved word: `%s`", labelToken->lexeme);
 	}
 
@@ -92,11 +166,8 @@ static void parseLabel(Parser* parser) {
 
 	symb_entry_t* existingEntry = getSymbolEntry(parser->symbolTable, labelToken->lexeme);
 	if (existingEntry && GET_DEFINED(existingEntry->flags)) {
-		linedata_ctx linedata = {
-			.linenum = labelToken->linenum,
-			.source = ssGetString(labelToken->sstring)
-		};
-		emitError(ERR_REDEFINED, &linedata, "Symbol redefinition: `%s`. First defined at `%s`", labelToken->lexeme, ssGetString(existingEntry->source));
+		linedata_ctx linedata = lineAt(labelToken->loc);
+		emitError(ERR_REDEFINED, &linedata, "Symbol redefinition: `%s`. First defined at `%s`", labelToken->lexeme, sourceLine(existingEntry->loc));
 	} else if (existingEntry) {
 		// Update the existing entry to be defined now
 		SET_DEFINED(existingEntry->flags);
@@ -114,8 +185,7 @@ static void parseLabel(Parser* parser) {
 		existingEntry->flags = SET_MAIN_TYPE(existingEntry->flags, mainType);
 		// And the section
 		existingEntry->flags = SET_SECTION(existingEntry->flags, parser->sectionTable->activeSection);
-		existingEntry->linenum = labelToken->linenum;
-		existingEntry->source = labelToken->sstring; // Maybe have the entry use its own copy of SString
+		setSymbolSource(parser->symbolTable, existingEntry, labelToken->loc);
 		existingEntry->value.val = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
 	} else {
 		uint8_t mainType = 0;
@@ -129,7 +199,7 @@ static void parseLabel(Parser* parser) {
 
 		SYMBFLAGS flags = CREATE_FLAGS(mainType, T_NONE, E_VAL, parser->sectionTable->activeSection, L_LOC, R_NREF, D_DEF);
 		uint32_t addr = parser->sectionTable->entries[parser->sectionTable->activeSection].lp;
-		symb_entry_t* symbEntry = initSymbolEntry(labelToken->lexeme, flags, NULL, addr, labelToken->sstring, labelToken->linenum);
+		symb_entry_t* symbEntry = initSymbolEntry(labelToken->lexeme, flags, NULL, addr, labelToken->loc);
 		if (!symbEntry) emitError(ERR_MEM, NULL, "Failed to create symbol table entry for label.");
 
 		// Add the symbol entry to the symbol table
@@ -146,10 +216,7 @@ static void parseIdentifier(Parser* parser) {
 
 	Node* instructionRoot = initASTNode(AST_ROOT, ND_INSTRUCTION, idToken, NULL);
 
-	linedata_ctx linedata = {
-		.linenum = idToken->linenum,
-		.source = ssGetString(idToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(idToken->loc);
 
 	// Ensure it is an instruction
 
@@ -160,6 +227,7 @@ static void parseIdentifier(Parser* parser) {
 	if (index == -1) emitError(ERR_INVALID_INSTRUCTION, &linedata, "Unknown instruction: `%s`", idToken->lexeme);
 
 	idToken->type = TK_INSTRUCTION;
+	instructionRoot->type = TK_INSTRUCTION;
 
 	// Make sure current section is either text, evt, or ivt
 	if (parser->sectionTable->activeSection != TEXT_SECT_N && 
@@ -194,7 +262,17 @@ static void parseIdentifier(Parser* parser) {
 	else if (instruction >= S_TYPE_IDX && instruction < F_TYPE_IDX) handleS(parser, instructionRoot);
 	else if (instruction >= F_TYPE_IDX) handleF(parser, instructionRoot);
 
-	parser->sectionTable->entries[parser->sectionTable->activeSection].lp += 4;
+	advanceLP(parser->sectionTable, 4, &linedata);
+}
+
+// Moves past a declaration that was already parsed, a `.def` goes on to the line of its closing bracket
+static void skipDeclaration(Parser* parser, bool scoped) {
+	size_t index = parser->currentTokenIndex;
+	if (scoped) {
+		while (index < parser->tokenCount && parser->tokens[index]->type != TK_RBRACKET) index++;
+	}
+	while (index < parser->tokenCount && parser->tokens[index]->type != TK_NEWLINE) index++;
+	parser->currentTokenIndex = index < parser->tokenCount ? index + 1 : index;
 }
 
 static void parseDirective(Parser* parser) {
@@ -205,10 +283,7 @@ static void parseDirective(Parser* parser) {
 	Node* directiveRoot = initASTNode(AST_ROOT, ND_DIRECTIVE, directiveToken, NULL);
 	if (!directiveRoot) emitError(ERR_MEM, NULL, "Failed to create AST node for directive.");
 
-	linedata_ctx linedata = {
-		.linenum = directiveToken->linenum,
-		.source = ssGetString(directiveToken->sstring)
-	};
+	linedata_ctx linedata = lineAt(directiveToken->loc);
 
 	// Since the lexer bunched all directives as TK_DIRECTIVE, the actual directive needs to be determined
 	// The token field will also be updated to reflect the actual directive
@@ -220,6 +295,19 @@ static void parseDirective(Parser* parser) {
 	// To properly identify the directive
 	enum Directives directive = (enum Directives) index;
 
+	if (parser->config.declarationsOnly && directive != SET && directive != EXTERN && directive != TYPE &&
+			directive != SIZEOF && directive != DEF && directive != INCLUDE) {
+		emitError(ERR_INVALID_DIRECTIVE, &linedata, "Directive `%s` is not allowed in ADECL files.", directiveToken->lexeme);
+	}
+
+	// The declarations were all taken by the first pass of a stream, and generate nothing
+	if (parser->config.streamPass == 2 && (directive == SET || directive == GLOB || directive == EXTERN || directive == SIZE ||
+			directive == TYPE || directive == DEF || directive == INCLUDE)) {
+		freeAST(directiveRoot);
+		skipDeclaration(parser, directive == DEF);
+		return;
+	}
+
 	// log("Parsing directive: `%s`. Set type to `%s`", directiveToken->lexeme, DIRECTIVES[directive]);
 
 	// The actions depend on the specific directive
@@ -266,7 +354,9 @@ static void parseDirective(Parser* parser) {
 			break;
 	}
 
-	if (directiveRoot->nodeData.directive) directiveRoot->nodeData.directive->section = parser->sectionTable->activeSection;
+	if (directiveRoot->nodeData.directive) directiveRoot->nodeData.directive->section = currentSection(parser);
+	// The handler gave the token the type of its directive
+	directiveRoot->type = directiveToken->type;
 
 	addAst(parser, directiveRoot);
 }
@@ -299,7 +389,7 @@ static void handleLDImmMove(Parser* parser, Node* ldInstrNode, uint32_t lp) {
 	// Since this could be either =imm or imm, check whether the first node is =
 	// In that case, the true imm is its child
 	Node* immNode = NULL;
-	if (literalOrImmNode->token->type == TK_LITERAL) immNode = literalOrImmNode->nodeData.operator->data.unary.operand;
+	if (literalOrImmNode->type == TK_LITERAL) immNode = literalOrImmNode->nodeData.operator->data.unary.operand;
 	else immNode = literalOrImmNode;
 
 	bool evald = evaluateExpression(immNode, parser->symbolTable);
@@ -310,10 +400,7 @@ static void handleLDImmMove(Parser* parser, Node* ldInstrNode, uint32_t lp) {
 	// The symbol has been declared extern
 	// It needs to also apply to local address even thought it is not extern
 
-	linedata_ctx linedata = {
-		.linenum = ldInstrNode->token->linenum,
-		.source = ssGetString(ldInstrNode->token->sstring)
-	};
+	linedata_ctx linedata = lineAt(ldInstrNode->loc);
 
 	Node* externSymbol = getExternSymbol(immNode);
 	bool isLocalAddress = false;
@@ -328,14 +415,11 @@ static void handleLDImmMove(Parser* parser, Node* ldInstrNode, uint32_t lp) {
 
 	if (!evald || isLocalAddress) {
 		if (!externSymbol) {
-			linedata_ctx linedata = {
-				.linenum = ldInstrNode->token->linenum,
-				.source = ssGetString(ldInstrNode->token->sstring)
-			};
+			linedata_ctx linedata = lineAt(ldInstrNode->loc);
 			emitError(ERR_INVALID_EXPRESSION, &linedata, "Failed to get extern symbol for LD immediate form instruction.");
 		}
 
-		symb_entry_t* symbEntry = getSymbolEntry(parser->symbolTable, externSymbol->token->lexeme);
+		symb_entry_t* symbEntry = getSymbolEntry(parser->symbolTable, externSymbol->lexeme);
 		if (!symbEntry) {
 			// If no entry at this point (all symbols should have been collected)
 			// Something went horribly wrong
@@ -346,7 +430,7 @@ static void handleLDImmMove(Parser* parser, Node* ldInstrNode, uint32_t lp) {
 		if (!evald) {
 			uint8_t sect = GET_SECTION(symbEntry->flags);
 			if (sect != S_UNDEF) {
-				emitError(ERR_INVALID_EXPRESSION, &linedata, "Undefined symbol `%s` used in LD move form instruction is not declared extern.", externSymbol->token->lexeme);
+				emitError(ERR_INVALID_EXPRESSION, &linedata, "Undefined symbol `%s` used in LD move form instruction is not declared extern.", externSymbol->lexeme);
 			}
 		}
 
@@ -379,14 +463,19 @@ static void handleLDImmMove(Parser* parser, Node* ldInstrNode, uint32_t lp) {
 	decomposeLD(ldInstrNode, ldInstrNode->nodeData.instruction->data.mType.xds, immNode);
 }
 
-void parse(Parser* parser) {
-	initScope("parse");
-
-	int currentTokenIndex = 0;
+// Statements from the current token up to the end or a `.end`
+static void parseStatements(Parser* parser) {
+	size_t currentTokenIndex = parser->currentTokenIndex;
 
 	while (currentTokenIndex < parser->tokenCount) {
 		Token* token = parser->tokens[currentTokenIndex];
 		parser->currentTokenIndex = currentTokenIndex;
+		parser->statementStart = currentTokenIndex;
+
+		if (parser->config.declarationsOnly && (token->type == TK_LABEL || token->type == TK_IDENTIFIER)) {
+			linedata_ctx linedata = lineAt(token->loc);
+			emitError(ERR_NOT_ALLOWED, &linedata, "Only directives are allowed in ADECL files.");
+		}
 
 		switch (token->type) {
 			case TK_LABEL:
@@ -437,10 +526,7 @@ void parse(Parser* parser) {
 			// All of these token types typically follow a directive, an identifier, or a label
 			// So these are to be parsed in their respective contexts
 			// Encountering them at the top level is an issue
-			linedata_ctx linedata = {
-				.linenum = token->linenum,
-				.source = ssGetString(token->sstring)
-			};
+			linedata_ctx linedata = lineAt(token->loc);
 			emitError(ERR_INVALID_SYNTAX, &linedata, "Unexpected token: `%s`", token->lexeme);
 			break;
 			case TK_NEWLINE:
@@ -459,15 +545,61 @@ void parse(Parser* parser) {
 			break;
 		}
 	}
+}
 
-	// rlog("Parsing complete. Will now fix any LD imm instructions.");
-	// All symbols have been gathered
-	// Try to fix the LD imm/move instructions
-	struct LDIMM* current = parser->ldimmList;
-	while (current) {
-		handleLDImmMove(parser, current->ldInstr, current->lp);
+// Moves past the line an error was reported on
+// The handler may have stopped anywhere in its statement, or already taken the newline, so the line is the one of the last token it took
+static void skipErrorLine(Parser* parser) {
+	size_t index = parser->currentTokenIndex > parser->statementStart ? parser->currentTokenIndex - 1 : parser->statementStart;
+	if (index >= parser->tokenCount) {
+		parser->currentTokenIndex = parser->tokenCount;
+		return;
+	}
+
+	int linenum = parser->tokens[index]->linenum;
+	while (index < parser->tokenCount && parser->tokens[index]->linenum <= linenum) index++;
+	parser->currentTokenIndex = index;
+}
+
+static void parseTokens(Parser* parser, bool recover) {
+	initScope("parse");
+
+	reserveAsts(parser);
+
+	int errors = parser->as->errorCount;
+	if (recover) {
+		// While under the error limit, an error in a statement comes back here and the parse picks up at the next line
+		// Whatever the statement left half done is never used, the parse fails in the end
+		jmp_buf recovery;
+		int depth = traceDepth();
+		parser->as->recovery = &recovery;
+		if (setjmp(recovery) != 0) {
+			traceUnwind(depth);
+			skipErrorLine(parser);
+		}
+		parseStatements(parser);
+		parser->as->recovery = NULL;
+	} else {
+		parseStatements(parser);
+	}
 
-		current = current->next;
+	// Declarations have no instructions or sections
+	// After an error nothing is generated, so there is nothing to resolve for
+	if (parser->config.declarationsOnly || parser->as->errorCount > errors) return;
+
+	// The first pass of a stream has only some of the symbols, each chunk of the second fixes its own
+	if (parser->config.streamPass != 1) {
+		// rlog("Parsing complete. Will now fix any LD imm instructions.");
+		// All symbols have been gathered
+		// Try to fix the LD imm/move instructions
+		traceBegin("phase", "ld fixup");
+		struct LDIMM* current = parser->ldimmList;
+		while (current) {
+			handleLDImmMove(parser, current->ldInstr, current->lp);
+
+			current = current->next;
+		}
+		traceEnd();
 	}
 
 	// Set each section's size to be the LP
@@ -476,15 +608,35 @@ void parse(Parser* parser) {
 	}
 }
 
+arxStatus parse(Parser* parser) {
+	ArxFrame frame;
+	arxEnter(parser->as, &frame);
+	if (setjmp(frame.env) == 0) {
+		// Included files are only loaded ahead when any error comes back here, where the workers are waited for
+		// The second pass of a stream skips the `.include`s
+		if (frame.outermost && !parser->config.declarationsOnly && parser->config.streamPass != 2) startPrefetch(parser);
+		// Only the outermost parse recovers from errors, an included file's goes back to the line of its `.include`
+		parseTokens(parser, frame.outermost);
+	}
+	if (frame.outermost) parser->as->recovery = NULL;
+	finishPrefetch(parser);
+
+	return arxLeave(&frame);
+}
+
 void showParserConfig(Parser* parser) {
 	log("Parser Configuration");
 
 }
 
+sect_table_n currentSection(Parser* parser) {
+	return parser->sectionTable ? parser->sectionTable->activeSection : DATA_SECT_N;
+}
+
 void addLD(Parser* parser, Node* ldInstrNode) {
 	// Adds a ld immediate/move possible decomposition to the parser's list
 	// Use ldimmTail to make this O(1)
-	struct LDIMM* newLDIMM = (struct LDIMM*) malloc(sizeof(struct LDIMM));
+	struct LDIMM* newLDIMM = (struct LDIMM*) memAlloc(MEM_AST, sizeof(struct LDIMM));
 	if (!newLDIMM) emitError(ERR_MEM, NULL, "Failed to allocate memory for LDIMM node.");
 	newLDIMM->ldInstr = ldInstrNode;
 	newLDIMM->next = NULL;
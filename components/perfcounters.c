@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "perfcounters.h"
+#include "diagnostics.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+static const char* phaseNames[PHASE_COUNT] = {
+	"lex",
+	"parse",
+	"codegen",
+	"write",
+	"teardown"
+};
+
+const char* phaseName(asmPhase phase) {
+	return phaseNames[phase];
+}
+
+typedef enum {
+	CTR_CYCLES,
+	CTR_INSTRUCTIONS,
+	CTR_CACHE_MISSES,
+	CTR_BRANCH_MISSES,
+	CTR_PAGE_FAULTS,
+	CTR_TASK_CLOCK,
+	CTR_COUNT
+} counterType;
+
+static const char* counterNames[CTR_COUNT] = {
+	"cycles",
+	"instructions",
+	"cache-misses",
+	"branch-misses",
+	"page-faults",
+	"task-clock(ms)"
+};
+
+static bool enabled = false;
+static bool available[CTR_COUNT]; // Which counters could be opened by `initPerfCounters`
+static uint64_t totals[PHASE_COUNT][CTR_COUNT];
+
+// perf_event_open counts a single thread, so batch mode workers open their own
+static _Thread_local bool threadOpened = false;
+static _Thread_local int fds[CTR_COUNT];
+static _Thread_local uint64_t startValues[PHASE_COUNT][CTR_COUNT];
+
+
+#ifdef __linux__
+static const struct {
+	uint32_t type;
+	uint64_t config;
+} counterEvents[CTR_COUNT] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }
+};
+
+static int openCounter(counterType ctr) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counterEvents[ctr].type;
+	attr.config = counterEvents[ctr].config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// Counters get multiplexed when there are more than the PMU can hold, the times allow scaling back
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// Only the calling thread, on any cpu
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t readCounter(counterType ctr) {
+	struct {
+		uint64_t value;
+		uint64_t timeEnabled;
+		uint64_t timeRunning;
+	} data;
+
+	if (read(fds[ctr], &data, sizeof(data)) != sizeof(data)) return 0;
+	if (data.timeRunning == 0) return 0;
+	if (data.timeRunning == data.timeEnabled) return data.value;
+
+	return (uint64_t) ((double) data.value * data.timeEnabled / data.timeRunning);
+}
+#endif
+
+bool initPerfCounters() {
+#ifdef __linux__
+	// The server records each request that asks for counters from zero
+	memset(totals, 0, sizeof(totals));
+
+	int opened = 0;
+	bool hardware = false;
+	for (int i = 0; i < CTR_COUNT; i++) {
+		fds[i] = openCounter(i);
+		available[i] = fds[i] != -1;
+		if (fds[i] == -1) continue;
+
+		opened++;
+		if (counterEvents[i].type == PERF_TYPE_HARDWARE) hardware = true;
+	}
+	threadOpened = true;
+
+	if (opened == 0) {
+		emitWarning(WARN_UNEXPECTED, NULL, "Could not open any perf counters (check /proc/sys/kernel/perf_event_paranoid).");
+		return false;
+	}
+	if (!hardware) emitWarning(WARN_UNEXPECTED, NULL, "Hardware perf counters are unavailable, only software counters are recorded.");
+
+	enabled = true;
+	return true;
+#else
+	emitWarning(WARN_UNIMPLEMENTED, NULL, "Perf counters are only supported on Linux.");
+	return false;
+#endif
+}
+
+void deinitPerfCounters() {
+#ifdef __linux__
+	if (!enabled) return;
+
+	deinitThreadPerfCounters();
+	enabled = false;
+#endif
+}
+
+void initThreadPerfCounters() {
+#ifdef __linux__
+	if (!enabled || threadOpened) return;
+
+	// Only the counters the main thread could open, so that every total is made of the same threads
+	for (int i = 0; i < CTR_COUNT; i++) fds[i] = available[i] ? openCounter(i) : -1;
+	threadOpened = true;
+#endif
+}
+
+void deinitThreadPerfCounters() {
+#ifdef __linux__
+	if (!threadOpened) return;
+
+	for (int i = 0; i < CTR_COUNT; i++) {
+		if (fds[i] != -1) close(fds[i]);
+	}
+	threadOpened = false;
+#endif
+}
+
+void perfBegin(asmPhase phase) {
+#ifdef __linux__
+	if (!enabled || !threadOpened) return;
+
+	for (int i = 0; i < CTR_COUNT; i++) {
+		if (fds[i] != -1) startValues[phase][i] = readCounter(i);
+	}
+#endif
+}
+
+void perfEnd(asmPhase phase) {
+#ifdef __linux__
+	if (!enabled || !threadOpened) return;
+
+	for (int i = 0; i < CTR_COUNT; i++) {
+		if (fds[i] != -1) __atomic_add_fetch(&totals[phase][i], readCounter(i) - startValues[phase][i], __ATOMIC_RELAXED);
+	}
+#endif
+}
+
+void displayPerfCounters() {
+	if (!enabled) return;
+
+	fprintf(stderr, "Perf counters:\n");
+	fprintf(stderr, "  %-9s", "phase");
+	for (int i = 0; i < CTR_COUNT; i++) fprintf(stderr, " %15s", counterNames[i]);
+	fprintf(stderr, " %6s\n", "IPC");
+
+	for (int p = 0; p < PHASE_COUNT; p++) {
+		fprintf(stderr, "  %-9s", phaseNames[p]);
+		for (int i = 0; i < CTR_COUNT; i++) {
+			if (!available[i]) fprintf(stderr, " %15s", "-");
+			// task-clock counts nanoseconds
+			else if (i == CTR_TASK_CLOCK) fprintf(stderr, " %15.3f", totals[p][i] / 1e6);
+			else fprintf(stderr, " %15llu", (unsigned long long) totals[p][i]);
+		}
+
+		if (available[CTR_CYCLES] && available[CTR_INSTRUCTIONS] && totals[p][CTR_CYCLES] != 0) {
+			fprintf(stderr, " %6.2f\n", (double) totals[p][CTR_INSTRUCTIONS] / totals[p][CTR_CYCLES]);
+		} else fprintf(stderr, " %6s\n", "-");
+	}
+}
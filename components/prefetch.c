@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "prefetch.h"
+#include "adeclc.h"
+#include "threadpool.h"
+#include "allocator.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "sds.h"
+
+
+typedef enum {
+	JOB_PENDING, // No one got to it yet
+	JOB_RUNNING, // A worker is loading it
+	JOB_DONE, // Loaded, waiting for the parse
+	JOB_TAKEN // The parse took it over, or loaded it in place
+} jobState;
+
+// A diagnostic of a file loaded ahead, reported once the parse gets to the file
+typedef struct HeldDiagnostic {
+	bool isError;
+	int type;
+	char* source; // NULL when there is no line
+	int linenum;
+	char* message;
+} held_diag_t;
+
+typedef struct IncludeJob {
+	sds path; // As found by `findADECLFile`
+	jobState state;
+
+	ArxAssembler* as; // The context the file was loaded in, NULL if it could not be made
+	ADECL_ctx context;
+	bool found;
+	arxStatus status;
+
+	held_diag_t* diagnostics;
+	int diagnosticCount;
+	int diagnosticCapacity;
+} include_job_t;
+
+typedef struct Prefetch {
+	ArxAssembler* as; // The context of the parse
+	dep_list_t files; // Canonical paths, the job of a file is at the same position
+	include_job_t* jobs;
+
+	mutex_t lock; // Guards the job states and `nextJob`
+	cond_t done; // Signaled whenever a job is done
+	int nextJob; // The next job a worker looks at
+	bool stopping; // The parse is over, workers do not start anything else
+
+#ifndef _WIN32
+	pthread_t* threads;
+#endif
+	int threadCount;
+} Prefetch;
+
+
+// The number of threads loading files, the parse's own included
+static int prefetchThreads(const Config* config) {
+	if (config->includeThreads > 0) return config->includeThreads;
+
+	// Batch workers already have a file each
+	if (config->jobs > 1) return 1;
+#ifndef _WIN32
+	return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	return 1;
+#endif
+}
+
+// The sink of the contexts files are loaded in, runs on the worker
+static void holdDiagnostic(const Diagnostic* diag, void* ctx) {
+	include_job_t* job = (include_job_t*) ctx;
+
+	// Running out of memory here only loses the diagnostic, an error still fails the file through its status
+	if (job->diagnosticCount == job->diagnosticCapacity) {
+		int capacity = job->diagnosticCapacity ? job->diagnosticCapacity * 2 : 4;
+		held_diag_t* temp = (held_diag_t*) memRealloc(MEM_CONTEXT, job->diagnostics, sizeof(held_diag_t) * capacity);
+		if (!temp) return;
+		job->diagnostics = temp;
+		job->diagnosticCapacity = capacity;
+	}
+
+	held_diag_t* held = &job->diagnostics[job->diagnosticCount];
+	held->isError = diag->isError;
+	held->type = diag->type;
+	held->source = diag->source ? memStrdup(MEM_CONTEXT, diag->source) : NULL;
+	held->linenum = diag->linenum;
+	held->message = memStrdup(MEM_CONTEXT, diag->message);
+	if (!held->message || (diag->source && !held->source)) return;
+
+	job->diagnosticCount++;
+}
+
+static void runJob(Prefetch* prefetch, include_job_t* job) {
+	ArxAssembler* as = initAssembler(prefetch->as->config, NULL);
+	if (!as) return;
+	setDiagnosticSink(as, holdDiagnostic, job);
+	// Its files get numbers of the parse's map, whose locations then hold as they are once adopted
+	shareSourceNumbering(&as->sources, &prefetch->as->sources);
+
+	job->context = (ADECL_ctx) { .as = as };
+
+	ArxFrame frame;
+	arxEnter(as, &frame);
+	if (setjmp(frame.env) == 0) job->found = loadADECL(&job->context, job->path);
+	job->status = arxLeave(&frame);
+
+	job->as = as;
+}
+
+#ifndef _WIN32
+static void* prefetchWorker(void* arg) {
+	Prefetch* prefetch = (Prefetch*) arg;
+	traceSetTrack("includes");
+
+	mutexLock(&prefetch->lock);
+	while (!prefetch->stopping) {
+		// The parse may have loaded the next files in place already
+		while (prefetch->nextJob < prefetch->files.count && prefetch->jobs[prefetch->nextJob].state != JOB_PENDING) prefetch->nextJob++;
+		if (prefetch->nextJob == prefetch->files.count) break;
+
+		include_job_t* job = &prefetch->jobs[prefetch->nextJob++];
+		job->state = JOB_RUNNING;
+		mutexUnlock(&prefetch->lock);
+
+		runJob(prefetch, job);
+
+		mutexLock(&prefetch->lock);
+		job->state = JOB_DONE;
+		condBroadcast(&prefetch->done);
+	}
+	mutexUnlock(&prefetch->lock);
+
+	return NULL;
+}
+#endif
+
+void startPrefetch(Parser* parser) {
+	initScope("startPrefetch()");
+
+#ifndef _WIN32
+	ArxAssembler* as = parser->as;
+	if (as->memory.hooks) return;
+
+	int threads = prefetchThreads(&as->config);
+	if (threads < 2) return;
+
+	// Only the files, each once, in the order the parse will get to them
+	// What cannot be found is left for the parse to report
+	dep_list_t files = {0};
+	sds* paths = NULL;
+	int capacity = 0;
+	for (size_t i = 0; i + 1 < parser->tokenCount; i++) {
+		Token* token = parser->tokens[i];
+		Token* next = parser->tokens[i + 1];
+		if (token->type != TK_DIRECTIVE || strcasecmp(token->lexeme + 1, "include") != 0 || next->type != TK_STRING) continue;
+
+		sds filename = sdsnewlen(next->lexeme + 1, sdslen(next->lexeme) - 2);
+		if (!filename) emitError(ERR_MEM, NULL, "Failed to allocate memory for an included filename.");
+		sds path = findADECLFile(&as->config, filename);
+		sdsfree(filename);
+		if (!path) continue;
+
+		sds canonical = canonicalADECLPath(path);
+		bool added = canonical && addDependency(&files, canonical);
+		sdsfree(canonical);
+		if (!added) {
+			sdsfree(path);
+			continue;
+		}
+
+		if (files.count > capacity) {
+			capacity = capacity ? capacity * 2 : 8;
+			sds* temp = (sds*) memRealloc(MEM_CONTEXT, paths, sizeof(sds) * capacity);
+			if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for included files.");
+			paths = temp;
+		}
+		paths[files.count - 1] = path;
+	}
+
+	// A single file leaves nothing to overlap, the parse gets to it right away
+	if (files.count < 2) {
+		for (int i = 0; i < files.count; i++) sdsfree(paths[i]);
+		memFree(paths);
+		freeDependencies(&files);
+		return;
+	}
+
+	Prefetch* prefetch = (Prefetch*) memAlloc(MEM_CONTEXT, sizeof(Prefetch));
+	if (!prefetch) emitError(ERR_MEM, NULL, "Failed to allocate memory for loading included files.");
+	include_job_t* jobs = (include_job_t*) memCalloc(MEM_CONTEXT, files.count, sizeof(include_job_t));
+	// The parse loads files as well, the rest of the threads are workers
+	int workerCount = (threads < files.count ? threads : files.count) - 1;
+	pthread_t* workers = (pthread_t*) memAlloc(MEM_CONTEXT, sizeof(pthread_t) * workerCount);
+	if (!jobs || !workers) emitError(ERR_MEM, NULL, "Failed to allocate memory for loading included files.");
+
+	for (int i = 0; i < files.count; i++) {
+		jobs[i].path = paths[i];
+		jobs[i].state = JOB_PENDING;
+	}
+	memFree(paths);
+
+	*prefetch = (Prefetch) {
+		.as = as,
+		.files = files,
+		.jobs = jobs,
+		.nextJob = 0,
+		.stopping = false,
+		.threads = workers,
+		.threadCount = 0
+	};
+	mutexInit(&prefetch->lock);
+	condInit(&prefetch->done);
+	parser->prefetch = prefetch;
+
+	// Fewer workers only means more files loaded in place
+	for (int i = 0; i < workerCount; i++) {
+		if (pthread_create(&workers[prefetch->threadCount], NULL, prefetchWorker, prefetch) == 0) prefetch->threadCount++;
+	}
+	log("Loading %d included files on %d workers.", files.count, prefetch->threadCount);
+#endif
+}
+
+bool takePrefetched(Parser* parser, const char* canonical, ADECL_ctx* context, bool* found) {
+	Prefetch* prefetch = parser->prefetch;
+	if (!prefetch) return false;
+
+	int index = findDependency(&prefetch->files, canonical);
+	if (index < 0) return false;
+	include_job_t* job = &prefetch->jobs[index];
+
+	mutexLock(&prefetch->lock);
+	bool ready = false;
+	if (job->state == JOB_PENDING) job->state = JOB_TAKEN;
+	else {
+		while (job->state == JOB_RUNNING) condWait(&prefetch->done, &prefetch->lock);
+		ready = job->state == JOB_DONE;
+		job->state = JOB_TAKEN;
+	}
+	mutexUnlock(&prefetch->lock);
+	if (!ready || !job->as) return false;
+
+	// Everything the file allocated now belongs to the parse, as if it had been loaded in place
+	ArxAssembler* as = parser->as;
+	ArxAssembler* loaded = job->as;
+	job->as = NULL;
+	memAdoptOwner(&as->memory, &loaded->memory);
+	adoptSourceMap(&as->sources, &loaded->sources);
+	for (int i = 0; i < loaded->dependencies.count; i++) addDependency(&as->dependencies, loaded->dependencies.paths[i]);
+	errType error = loaded->error;
+	deinitAssembler(loaded);
+
+	*found = job->found;
+	context->symbolTable = job->context.symbolTable;
+	context->structTable = job->context.structTable;
+	context->asts = job->context.asts;
+	context->astCount = job->context.astCount;
+	context->astCapacity = job->context.astCapacity;
+	context->includes = job->context.includes;
+
+	// The diagnostics come now, where loading in place would have given them
+	// Loading in place stops at the first error, so the warnings before it come, then it, and nothing the file gave after it
+	held_diag_t* firstError = NULL;
+	for (int i = 0; i < job->diagnosticCount && !firstError; i++) {
+		held_diag_t* held = &job->diagnostics[i];
+		if (held->isError) firstError = held;
+		else {
+			linedata_ctx linedata = {
+				.linenum = held->linenum,
+				.source = held->source
+			};
+			emitWarning((warnType) held->type, held->source ? &linedata : NULL, "%s", held->message);
+		}
+	}
+	// The error returns past here, what is still held then goes with the context
+	if (firstError) {
+		linedata_ctx linedata = {
+			.linenum = firstError->linenum,
+			.source = firstError->source
+		};
+		emitError((errType) firstError->type, firstError->source ? &linedata : NULL, "%s", firstError->message);
+	}
+
+	for (int i = 0; i < job->diagnosticCount; i++) {
+		memFree(job->diagnostics[i].source);
+		memFree(job->diagnostics[i].message);
+	}
+	memFree(job->diagnostics);
+	job->diagnostics = NULL;
+	job->diagnosticCount = 0;
+
+	// Only when the error itself was lost, held diagnostics are dropped when out of memory
+	if (job->status != ARX_OK) emitError(error, NULL, "Failed to load included file `%s`.", job->path);
+
+	return true;
+}
+
+void finishPrefetch(Parser* parser) {
+	Prefetch* prefetch = parser->prefetch;
+	if (!prefetch) return;
+	parser->prefetch = NULL;
+
+#ifndef _WIN32
+	mutexLock(&prefetch->lock);
+	prefetch->stopping = true;
+	mutexUnlock(&prefetch->lock);
+	for (int i = 0; i < prefetch->threadCount; i++) pthread_join(prefetch->threads[i], NULL);
+	memFree(prefetch->threads);
+#endif
+
+	// What was not taken is dropped whole, its context holds all of its memory
+	for (int i = 0; i < prefetch->files.count; i++) {
+		include_job_t* job = &prefetch->jobs[i];
+		if (job->as) deinitAssembler(job->as);
+		sdsfree(job->path);
+	}
+	memFree(prefetch->jobs);
+	freeDependencies(&prefetch->files);
+
+	mutexDestroy(&prefetch->lock);
+	condDestroy(&prefetch->done);
+	memFree(prefetch);
+}
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "server.h"
+#include "diagnostics.h"
+#include "allocator.h"
+
+
+#ifndef _WIN32
+
+// A request is a header, sent along with the client's stdout and stderr, followed by `size` bytes of strings:
+// the working directory then every argument, each null terminated
+// The answer is the exit status as an int32_t
+#define REQUEST_MAGIC 0x41525853 // "ARXS"
+#define REQUEST_MAX_SIZE (1 << 20)
+
+typedef struct RequestHeader {
+	uint32_t magic;
+	uint32_t argc;
+	uint32_t size;
+} RequestHeader;
+
+static volatile sig_atomic_t stopping = 0;
+
+
+static void stop(int sig) {
+	stopping = 1;
+}
+
+static bool setSocketPath(struct sockaddr_un* addr, const char* path) {
+	if (strlen(path) >= sizeof(addr->sun_path)) return false;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+
+	return true;
+}
+
+static bool readAll(int fd, void* buf, size_t len) {
+	char* bytes = (char*) buf;
+	while (len > 0) {
+		ssize_t n = read(fd, bytes, len);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		bytes += n;
+		len -= (size_t) n;
+	}
+
+	return true;
+}
+
+static bool writeAll(int fd, const void* buf, size_t len) {
+	const char* bytes = (const char*) buf;
+	while (len > 0) {
+		ssize_t n = write(fd, bytes, len);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		bytes += n;
+		len -= (size_t) n;
+	}
+
+	return true;
+}
+
+// Reads the header of a request along with the two descriptors passed with it
+static bool receiveHeader(int conn, RequestHeader* header, int fds[2]) {
+	char control[CMSG_SPACE(sizeof(int) * 2)];
+	struct iovec iov = { .iov_base = header, .iov_len = sizeof(RequestHeader) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control)
+	};
+
+	ssize_t n;
+	do {
+		n = recvmsg(conn, &msg, 0);
+	} while (n < 0 && errno == EINTR);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	bool passed = cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+		cmsg->cmsg_len == CMSG_LEN(sizeof(int) * 2);
+	if (passed) memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+
+	if (n != sizeof(RequestHeader) || !passed || header->magic != REQUEST_MAGIC) {
+		if (passed) {
+			close(fds[0]);
+			close(fds[1]);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+// Splits the strings of a request, returns the number of them or -1 if they are not what the header announced
+static int splitStrings(char* strings, uint32_t size, const char** out, uint32_t count) {
+	uint32_t found = 0;
+	uint32_t start = 0;
+	for (uint32_t i = 0; i < size; i++) {
+		if (strings[i] != '\0') continue;
+		if (found == count) return -1;
+		out[found++] = strings + start;
+		start = i + 1;
+	}
+
+	return found == count && start == size ? (int) found : -1;
+}
+
+// Runs the request with the client's working directory, stdout and stderr in place of the server's
+static int runRequest(requestHandler handler, const char* cwd, int argc, const char** argv, int fds[2]) {
+	int serverDir = open(".", O_RDONLY);
+	int savedOut = dup(STDOUT_FILENO);
+	int savedErr = dup(STDERR_FILENO);
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(fds[0], STDOUT_FILENO);
+	dup2(fds[1], STDERR_FILENO);
+
+	int status;
+	if (chdir(cwd) == 0) {
+		status = handler(argc, argv);
+	} else {
+		fprintf(stderr, "Could not enter the working directory `%s` in the server.\n", cwd);
+		status = -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(savedOut, STDOUT_FILENO);
+	dup2(savedErr, STDERR_FILENO);
+	close(savedOut);
+	close(savedErr);
+
+	if (serverDir >= 0) {
+		if (fchdir(serverDir) != 0) emitError(ERR_IO, NULL, "Could not return to the working directory of the server.");
+		close(serverDir);
+	}
+
+	return status;
+}
+
+// A malformed request is dropped without an answer, the client reports the server as unreachable
+static void serveConnection(int conn, requestHandler handler) {
+	RequestHeader header;
+	int fds[2];
+	if (!receiveHeader(conn, &header, fds)) return;
+
+	char* strings = NULL;
+	const char** args = NULL;
+	if (header.size == 0 || header.size > REQUEST_MAX_SIZE || header.argc == 0 || header.argc > header.size) goto done;
+
+	strings = (char*) memAlloc(MEM_CONTEXT, header.size);
+	// The working directory, the arguments, then a NULL like a real argv
+	args = (const char**) memAlloc(MEM_CONTEXT, sizeof(char*) * (header.argc + 2));
+	if (!strings || !args) goto done;
+	if (!readAll(conn, strings, header.size)) goto done;
+	if (splitStrings(strings, header.size, args, header.argc + 1) < 0) goto done;
+	args[header.argc + 1] = NULL;
+
+	int32_t status = runRequest(handler, args[0], (int) header.argc, args + 1, fds);
+	writeAll(conn, &status, sizeof(status));
+
+done:
+	memFree(args);
+	memFree(strings);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+// Whether a server is answering on the socket
+static bool isListening(const struct sockaddr_un* addr) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return false;
+
+	bool listening = connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) == 0;
+	close(fd);
+
+	return listening;
+}
+
+int runServer(const char* path, requestHandler handler) {
+	struct sockaddr_un addr;
+	if (!setSocketPath(&addr, path)) emitError(ERR_IO, NULL, "Socket path `%s` is too long.", path);
+
+	if (isListening(&addr)) emitError(ERR_IO, NULL, "A server is already listening on `%s`.", path);
+	unlink(path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) emitError(ERR_IO, NULL, "Failed to create the server socket.");
+	if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0) emitError(ERR_IO, NULL, "Failed to bind the server socket to `%s`.", path);
+	if (listen(sock, 16) != 0) emitError(ERR_IO, NULL, "Failed to listen on `%s`.", path);
+
+	// Without SA_RESTART, so that a signal gets accept out of waiting
+	struct sigaction action = { .sa_handler = stop };
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	// A client going away while its request runs must not take the server with it
+	signal(SIGPIPE, SIG_IGN);
+
+	while (!stopping) {
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			emitError(ERR_IO, NULL, "Failed to accept a connection on `%s`.", path);
+		}
+
+		serveConnection(conn, handler);
+		close(conn);
+	}
+
+	close(sock);
+	unlink(path);
+
+	return 0;
+}
+
+int runClient(const char* path, int argc, char const* argv[]) {
+	struct sockaddr_un addr;
+	if (!setSocketPath(&addr, path)) emitError(ERR_IO, NULL, "Socket path `%s` is too long.", path);
+
+	char* cwd = getcwd(NULL, 0);
+	if (!cwd) emitError(ERR_IO, NULL, "Failed to get the working directory.");
+
+	size_t size = strlen(cwd) + 1;
+	for (int i = 0; i < argc; i++) size += strlen(argv[i]) + 1;
+	if (size > REQUEST_MAX_SIZE) emitError(ERR_INTERNAL, NULL, "Command line is too long to be forwarded.");
+
+	char* strings = (char*) memAlloc(MEM_CONTEXT, size);
+	if (!strings) emitError(ERR_MEM, NULL, "Failed to allocate memory for the request.");
+	size_t pos = 0;
+	size_t len = strlen(cwd) + 1;
+	memcpy(strings, cwd, len);
+	pos += len;
+	for (int i = 0; i < argc; i++) {
+		len = strlen(argv[i]) + 1;
+		memcpy(strings + pos, argv[i], len);
+		pos += len;
+	}
+	free(cwd);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || connect(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		emitError(ERR_IO, NULL, "Could not connect to the server at `%s`.", path);
+	}
+
+	RequestHeader header = { .magic = REQUEST_MAGIC, .argc = (uint32_t) argc, .size = (uint32_t) size };
+	int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control)
+	};
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	// Whatever the client printed so far comes before what the server writes to the same descriptors
+	fflush(stdout);
+	fflush(stderr);
+
+	ssize_t sent;
+	do {
+		sent = sendmsg(sock, &msg, 0);
+	} while (sent < 0 && errno == EINTR);
+
+	int32_t status;
+	bool answered = sent == sizeof(header) && writeAll(sock, strings, size) && readAll(sock, &status, sizeof(status));
+	memFree(strings);
+	close(sock);
+
+	if (!answered) emitError(ERR_IO, NULL, "The server at `%s` did not answer the request.", path);
+
+	return status;
+}
+
+#else
+
+int runServer(const char* path, requestHandler handler) {
+	emitError(ERR_INTERNAL, NULL, "`--server` is not available on Windows.");
+	return -1;
+}
+
+int runClient(const char* path, int argc, char const* argv[]) {
+	emitError(ERR_INTERNAL, NULL, "`--client` is not available on Windows.");
+	return -1;
+}
+
+#endif
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "stream.h"
+#include "diagnostics.h"
+#include "allocator.h"
+#include "perfcounters.h"
+#include "trace.h"
+#include "sds.h"
+
+
+typedef enum {
+	KEEP_NONE,
+	KEEP_LINE, // Up to the end of the line
+	KEEP_SCOPE // Up to the end of the line of the closing bracket
+} keepState;
+
+typedef struct Stream {
+	Lexer* lexer;
+	Parser* parser;
+	CodeGen* codegen;
+	ArxAssembler* as;
+
+	const char* data; // The mapped source
+	size_t size;
+	size_t pos; // Where the next chunk starts
+	size_t released; // The pages before it were given back
+	sds line;
+
+	size_t base; // The first token of the chunk, the ones before it are of chunks that failed
+
+	// What outlives its chunk in the first pass
+	Node** roots;
+	size_t rootCount;
+	size_t rootCapacity;
+} Stream;
+
+// Where the second pass sends the errors of its parse
+typedef struct Forward {
+	diagSink sink;
+	void* ctx;
+} Forward;
+
+
+static void beginPhase(asmPhase phase) {
+	traceBegin("phase", "%s", phaseName(phase));
+	perfBegin(phase);
+}
+
+static void endPhase(asmPhase phase) {
+	perfEnd(phase);
+	traceEnd();
+}
+
+static bool mapSource(Stream* stream, const char* path) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		stream->data = NULL;
+		stream->size = 0;
+		return true;
+	}
+
+	void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+
+	stream->data = (const char*) data;
+	stream->size = (size_t) st.st_size;
+	return true;
+#else
+	FILE* file = fopen(path, "rb");
+	if (!file) return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	rewind(file);
+
+	char* data = size > 0 ? (char*) memAlloc(MEM_OUTPUT, (size_t) size) : NULL;
+	bool read = size == 0 || (data && fread(data, 1, (size_t) size, file) == (size_t) size);
+	fclose(file);
+	if (!read) {
+		memFree(data);
+		return false;
+	}
+
+	stream->data = data;
+	stream->size = (size_t) size;
+	return true;
+#endif
+}
+
+static void unmapSource(Stream* stream) {
+	if (!stream->data) return;
+#ifndef _WIN32
+	munmap((void*) stream->data, stream->size);
+#else
+	memFree((void*) stream->data);
+#endif
+	stream->data = NULL;
+}
+
+// The pages of the lines already lexed are given back, the next pass reads them from the file again
+static void releaseSource(Stream* stream) {
+#ifndef _WIN32
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	size_t end = stream->pos / page * page;
+	if (end > stream->released) madvise((void*) (stream->data + stream->released), end - stream->released, MADV_DONTNEED);
+	stream->released = end;
+#endif
+}
+
+// Lexes the lines of a chunk, it only ends outside of a `.def`
+// The lines after an error are still lexed for their own errors while under the error limit
+static arxStatus lexChunk(Stream* stream) {
+	arxStatus status = ARX_OK;
+
+	int lines = 0;
+	while (stream->pos < stream->size && (lines < STREAM_CHUNK_LINES || stream->lexer->inScope)) {
+		const char* start = stream->data + stream->pos;
+		const char* newline = (const char*) memchr(start, '\n', stream->size - stream->pos);
+		size_t len = newline ? (size_t) (newline - start) + 1 : stream->size - stream->pos;
+
+		sdsclear(stream->line);
+		stream->line = sdscatlen(stream->line, start, len);
+		stream->pos += len;
+		lines++;
+
+		if (lexLine(stream->lexer, stream->line) != ARX_OK) {
+			status = ARX_FAILED;
+			if (!arxRecoverable(stream->as)) {
+				stream->pos = stream->size;
+				break;
+			}
+		}
+	}
+	releaseSource(stream);
+
+	return status;
+}
+
+// Frees the tokens and the lines of the chunk, but the lines of its `.set` and `.def` statements when `keep`
+// The tokens of a chunk that failed stay, the lines its symbols are on were kept by the symbol table
+static void dropTokens(Stream* stream, bool keep) {
+	Lexer* lexer = stream->lexer;
+	SourceMap* sources = &stream->as->sources;
+
+	keepState state = KEEP_NONE;
+	for (size_t i = stream->base; i < lexer->tokenCount; i++) {
+		Token* token = lexer->tokens[i];
+		if (keep && state == KEEP_NONE) {
+			if (token->type == TK_D_SET) state = KEEP_LINE;
+			else if (token->type == TK_D_DEF) state = KEEP_SCOPE;
+		}
+		if (state != KEEP_NONE) {
+			keepSourceLine(sources, token->loc, NULL);
+			if (state == KEEP_SCOPE && token->type == TK_RBRACKET) state = KEEP_LINE;
+			else if (state == KEEP_LINE && token->type == TK_NEWLINE) state = KEEP_NONE;
+		}
+		deleteToken(token);
+	}
+	lexer->tokenCount = stream->base;
+	if (lexer->file) dropSourceLines(sources, lexer->file);
+}
+
+// Takes what outlives a chunk of the first pass out of it, the rest is freed with the next chunk
+// The symbols first seen in the chunk and still undefined point into it, they do not anymore
+static void keepDeclarations(Stream* stream, uint32_t symbols) {
+	Parser* parser = stream->parser;
+
+	// The roots of included files' declarations came along with them
+	size_t count = 0;
+	for (size_t i = 0; i < parser->astCount; i++) {
+		Node* ast = parser->asts[i];
+		if (ast->type == TK_D_SET || ast->type == TK_D_DEF) pushNodes(&stream->roots, &stream->rootCount, &stream->rootCapacity, ast);
+		else parser->asts[count++] = ast;
+	}
+	parser->astCount = count;
+
+	for (uint32_t i = symbols; i < parser->symbolTable->size; i++) {
+		symb_entry_t* entry = parser->symbolTable->entries[i];
+		if (!GET_DEFINED(entry->flags) && GET_EXPRESSION(entry->flags) == E_EXPR) entry->value.expr = NULL;
+	}
+
+	dropTokens(stream, true);
+}
+
+static arxStatus endChunk(Stream* stream, uint32_t symbols) {
+	ArxFrame frame;
+	arxEnter(stream->as, &frame);
+	if (setjmp(frame.env) == 0) keepDeclarations(stream, symbols);
+
+	return arxLeave(&frame);
+}
+
+static arxStatus firstPass(Stream* stream) {
+	Lexer* lexer = stream->lexer;
+	Parser* parser = stream->parser;
+
+	arxStatus status = ARX_OK;
+	bool lexed = true; // No line failed to lex so far
+
+	parser->config.streamPass = 1;
+	parser->config.syntaxOnly = true;
+	while (stream->pos < stream->size) {
+		beginPhase(PHASE_LEX);
+		if (lexChunk(stream) != ARX_OK) {
+			status = ARX_FAILED;
+			lexed = false;
+		}
+		endPhase(PHASE_LEX);
+
+		// After an error while lexing or the `.end`, the rest is only lexed for its own errors
+		if (!lexed || !parser->processing) {
+			dropTokens(stream, false);
+			continue;
+		}
+
+		beginPhase(PHASE_PARSE);
+		uint32_t symbols = parser->symbolTable->size;
+		resetParserChunk(parser, lexer->tokens + stream->base, lexer->tokenCount - stream->base);
+		arxStatus chunk = parse(parser);
+		endPhase(PHASE_PARSE);
+
+		// Symbols may point into a chunk that failed, it stays as it is for the context to free
+		// The parse goes on at the next chunk while it can, the way it goes on at the next line
+		if (chunk != ARX_OK) {
+			status = ARX_FAILED;
+			parser->astCount = 0;
+			stream->base = lexer->tokenCount;
+			if (!arxRecoverable(stream->as)) break;
+			continue;
+		}
+
+		if (endChunk(stream, symbols) != ARX_OK) return ARX_FAILED;
+	}
+
+	return status;
+}
+
+static void dropWarnings(const Diagnostic* diag, void* ctx) {
+	Forward* forward = (Forward*) ctx;
+	if (!diag->isError) return;
+
+	if (forward->sink) forward->sink(diag, forward->ctx);
+	else printDiagnostic(diag);
+}
+
+static arxStatus secondPass(Stream* stream, bool syntaxOnly) {
+	Lexer* lexer = stream->lexer;
+	Parser* parser = stream->parser;
+	ArxAssembler* as = stream->as;
+
+	// The lines are read again as the same file, the ones kept by the first pass are still theirs
+	uint32_t file = lexer->file;
+	resetLexer(lexer);
+	lexer->file = file;
+	resetSectionTable(parser->sectionTable);
+	parser->config.streamPass = 2;
+	parser->config.syntaxOnly = syntaxOnly;
+	parser->processing = true;
+	stream->pos = 0;
+	stream->released = 0;
+
+	// The first pass gave the warnings of the parse already
+	Forward forward = {
+		.sink = as->sink,
+		.ctx = as->sinkCtx
+	};
+
+	arxStatus status = ARX_OK;
+	while (status == ARX_OK && stream->pos < stream->size && parser->processing) {
+		beginPhase(PHASE_LEX);
+		status = lexChunk(stream);
+		endPhase(PHASE_LEX);
+		if (status != ARX_OK) break;
+
+		beginPhase(PHASE_PARSE);
+		resetParserChunk(parser, lexer->tokens, lexer->tokenCount);
+		setDiagnosticSink(as, dropWarnings, &forward);
+		status = parse(parser);
+		setDiagnosticSink(as, forward.sink, forward.ctx);
+		endPhase(PHASE_PARSE);
+		if (status != ARX_OK) break;
+
+		beginPhase(PHASE_CODEGEN);
+		status = gencodeChunk(parser, stream->codegen);
+		if (status == ARX_OK) status = spillCode(stream->codegen);
+		endPhase(PHASE_CODEGEN);
+		if (status != ARX_OK) break;
+
+		// The data entries point into the ASTs
+		resetDataTable(parser->dataTable);
+		resetParserChunk(parser, NULL, 0);
+		dropTokens(stream, false);
+	}
+
+	return status;
+}
+
+static void freeDeclarations(Stream* stream) {
+	for (size_t i = 0; i < stream->rootCount; i++) freeAST(stream->roots[i]);
+	memFree(stream->roots);
+}
+
+arxStatus streamFile(Lexer* lexer, Parser* parser, CodeGen* codegen, const char* infile, const char* outfile) {
+	Stream stream = {
+		.lexer = lexer,
+		.parser = parser,
+		.codegen = codegen,
+		.as = lexer->as
+	};
+
+	if (!mapSource(&stream, infile)) {
+		// Reported through the context like any other error
+		ArxFrame frame;
+		arxEnter(stream.as, &frame);
+		if (setjmp(frame.env) == 0) emitError(ERR_IO, NULL, "Failed to open input file: %s", infile);
+		return arxLeave(&frame);
+	}
+	stream.line = sdsempty();
+
+	bool syntaxOnly = parser->config.syntaxOnly;
+
+	traceBegin("stream", "layout");
+	arxStatus status = firstPass(&stream);
+	traceEnd();
+
+	if (status == ARX_OK) {
+		traceBegin("stream", "generate");
+		status = secondPass(&stream, syntaxOnly);
+		traceEnd();
+	}
+	parser->config.streamPass = 0;
+	parser->config.syntaxOnly = syntaxOnly;
+
+	if (status == ARX_OK) {
+		beginPhase(PHASE_CODEGEN);
+		status = resolveCode(codegen);
+		endPhase(PHASE_CODEGEN);
+	}
+	if (status == ARX_OK) {
+		beginPhase(PHASE_WRITE);
+		status = writeBinary(codegen, outfile);
+		endPhase(PHASE_WRITE);
+	}
+
+	// After a failure, what was kept goes along with everything else of the context
+	if (status == ARX_OK) freeDeclarations(&stream);
+	sdsfree(stream.line);
+	unmapSource(&stream);
+
+	return status;
+}
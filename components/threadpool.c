@@ -0,0 +1,154 @@
+#include <stdlib.h>
+
+#include "threadpool.h"
+#include "diagnostics.h"
+#include "allocator.h"
+
+
+typedef struct Worker {
+	ThreadPool* pool;
+	int index;
+} Worker;
+
+
+ThreadPool* initThreadPool(int workerCount, taskFn task, workerFn workerStart, workerFn workerEnd, void* ctx) {
+	ThreadPool* pool = (ThreadPool*) memAlloc(MEM_POOL, sizeof(ThreadPool));
+	if (!pool) emitError(ERR_MEM, NULL, "Failed to allocate memory for thread pool.");
+
+#ifdef _WIN32
+	// No threads on Windows, the calling thread runs everything
+	workerCount = 1;
+#endif
+	if (workerCount < 1) workerCount = 1;
+
+	pool->workerCount = workerCount;
+	pool->deques = (TaskDeque*) memAlloc(MEM_POOL, sizeof(TaskDeque) * workerCount);
+	if (!pool->deques) emitError(ERR_MEM, NULL, "Failed to allocate memory for thread pool queues.");
+
+	for (int i = 0; i < workerCount; i++) {
+		TaskDeque* deque = &pool->deques[i];
+		deque->tasks = (int*) memAlloc(MEM_POOL, sizeof(int) * 8);
+		if (!deque->tasks) emitError(ERR_MEM, NULL, "Failed to allocate memory for thread pool queue.");
+		deque->head = 0;
+		deque->tail = 0;
+		deque->capacity = 8;
+		mutexInit(&deque->lock);
+	}
+	pool->nextDeque = 0;
+
+	pool->task = task;
+	pool->workerStart = workerStart;
+	pool->workerEnd = workerEnd;
+	pool->ctx = ctx;
+
+	return pool;
+}
+
+void deinitThreadPool(ThreadPool* pool) {
+	for (int i = 0; i < pool->workerCount; i++) {
+		memFree(pool->deques[i].tasks);
+		mutexDestroy(&pool->deques[i].lock);
+	}
+	memFree(pool->deques);
+	memFree(pool);
+}
+
+void submitTask(ThreadPool* pool, int task) {
+	TaskDeque* deque = &pool->deques[pool->nextDeque];
+	pool->nextDeque = (pool->nextDeque + 1) % pool->workerCount;
+
+	if (deque->tail == deque->capacity) {
+		deque->capacity *= 2;
+		int* temp = (int*) memRealloc(MEM_POOL, deque->tasks, sizeof(int) * deque->capacity);
+		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for thread pool queue.");
+		deque->tasks = temp;
+	}
+	deque->tasks[deque->tail++] = task;
+}
+
+// The owner takes from the back, so the tasks it was handed run in reverse submission order
+static bool takeTask(TaskDeque* deque, int* task) {
+	bool found = false;
+
+	mutexLock(&deque->lock);
+	if (deque->head < deque->tail) {
+		*task = deque->tasks[--deque->tail];
+		found = true;
+	}
+	mutexUnlock(&deque->lock);
+
+	return found;
+}
+
+// Thieves take from the front, away from where the owner works
+static bool stealTask(TaskDeque* deque, int* task) {
+	bool found = false;
+
+	mutexLock(&deque->lock);
+	if (deque->head < deque->tail) {
+		*task = deque->tasks[deque->head++];
+		found = true;
+	}
+	mutexUnlock(&deque->lock);
+
+	return found;
+}
+
+static void* workerLoop(void* arg) {
+	Worker* worker = (Worker*) arg;
+	ThreadPool* pool = worker->pool;
+
+	if (pool->workerStart) pool->workerStart(worker->index, pool->ctx);
+
+	int task;
+	while (true) {
+		if (takeTask(&pool->deques[worker->index], &task)) {
+			pool->task(worker->index, task, pool->ctx);
+			continue;
+		}
+
+		// Nothing is submitted while running, so once every deque is empty the work is done
+		bool stole = false;
+		for (int i = 1; i < pool->workerCount && !stole; i++) {
+			TaskDeque* victim = &pool->deques[(worker->index + i) % pool->workerCount];
+			stole = stealTask(victim, &task);
+		}
+		if (!stole) break;
+
+		pool->task(worker->index, task, pool->ctx);
+	}
+
+	if (pool->workerEnd) pool->workerEnd(worker->index, pool->ctx);
+
+	return NULL;
+}
+
+void runThreadPool(ThreadPool* pool) {
+	Worker* workers = (Worker*) memAlloc(MEM_POOL, sizeof(Worker) * pool->workerCount);
+	if (!workers) emitError(ERR_MEM, NULL, "Failed to allocate memory for thread pool workers.");
+
+	for (int i = 0; i < pool->workerCount; i++) {
+		workers[i].pool = pool;
+		workers[i].index = i;
+	}
+
+#ifndef _WIN32
+	pthread_t* threads = (pthread_t*) memAlloc(MEM_POOL, sizeof(pthread_t) * pool->workerCount);
+	if (!threads) emitError(ERR_MEM, NULL, "Failed to allocate memory for thread pool threads.");
+
+	// Worker 0 is the calling thread
+	for (int i = 1; i < pool->workerCount; i++) {
+		if (pthread_create(&threads[i], NULL, workerLoop, &workers[i]) != 0) {
+			emitError(ERR_INTERNAL, NULL, "Failed to start thread pool worker %d.", i);
+		}
+	}
+	workerLoop(&workers[0]);
+	for (int i = 1; i < pool->workerCount; i++) pthread_join(threads[i], NULL);
+
+	memFree(threads);
+#else
+	workerLoop(&workers[0]);
+#endif
+
+	memFree(workers);
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "trace.h"
+#include "diagnostics.h"
+#include "threadpool.h"
+
+
+static FILE* traceFile = NULL;
+static struct timespec traceStart;
+static bool firstEvent = true;
+
+// Batch mode workers record concurrently, each event is written whole under the lock
+static mutex_t traceLock = MUTEX_INITIALIZER;
+
+// Each thread records on its own track, the main thread's being 0
+static _Thread_local int currentTrack = 0;
+static _Thread_local int openSpans = 0;
+static int nextTrack = 1;
+
+
+static double elapsedMicros() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - traceStart.tv_sec) * 1e6 + (now.tv_nsec - traceStart.tv_nsec) / 1e3;
+}
+
+// Names come from file names and such, so they need escaping before going in a JSON string
+static void writeEscaped(const char* str) {
+	for (const char* c = str; *c; c++) {
+		switch (*c) {
+			case '"': fputs("\\\"", traceFile); break;
+			case '\\': fputs("\\\\", traceFile); break;
+			case '\n': fputs("\\n", traceFile); break;
+			case '\t': fputs("\\t", traceFile); break;
+			default:
+				if ((unsigned char) *c < 0x20) fprintf(traceFile, "\\u%04x", *c);
+				else fputc(*c, traceFile);
+				break;
+		}
+	}
+}
+
+static void startEvent() {
+	fputs(firstEvent ? "\n" : ",\n", traceFile);
+	firstEvent = false;
+}
+
+static void writeMetadata(const char* kind, int tid, const char* name) {
+	startEvent();
+	fprintf(traceFile, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", kind, tid);
+	writeEscaped(name);
+	fputs("\"}}", traceFile);
+}
+
+void initTrace(const char* filename) {
+	traceFile = fopen(filename, "w");
+	if (!traceFile) emitError(ERR_IO, NULL, "Failed to open trace file %s for writing.", filename);
+
+	clock_gettime(CLOCK_MONOTONIC, &traceStart);
+	// The server traces every request that asks for it into its own file
+	firstEvent = true;
+	openSpans = 0;
+	nextTrack = 1;
+
+	fputs("[", traceFile);
+	writeMetadata("process_name", 0, "arxsm");
+	writeMetadata("thread_name", 0, "main");
+
+	// Errors exit the process, this makes sure the trace up to the error is still usable
+	static bool registered = false;
+	if (!registered) atexit(deinitTrace);
+	registered = true;
+}
+
+void deinitTrace() {
+	if (!traceFile) return;
+
+	mutexLock(&traceLock);
+	fputs("\n]\n", traceFile);
+	fclose(traceFile);
+	traceFile = NULL;
+	mutexUnlock(&traceLock);
+}
+
+bool traceEnabled() {
+	return traceFile != NULL;
+}
+
+void traceSetTrack(const char* name) {
+	if (!traceFile) return;
+
+	currentTrack = __atomic_fetch_add(&nextTrack, 1, __ATOMIC_RELAXED);
+
+	mutexLock(&traceLock);
+	if (traceFile) writeMetadata("thread_name", currentTrack, name);
+	mutexUnlock(&traceLock);
+}
+
+void traceBegin(const char* category, const char* fname, ...) {
+	if (!traceFile) return;
+
+	char name[256];
+	va_list args;
+	va_start(args, fname);
+	vsnprintf(name, sizeof(name), fname, args);
+	va_end(args);
+
+	mutexLock(&traceLock);
+	// Checked again, the trace may have been finalized by an error exiting from another thread
+	if (traceFile) {
+		startEvent();
+		fputs("{\"name\":\"", traceFile);
+		writeEscaped(name);
+		fprintf(traceFile, "\",\"cat\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", category, elapsedMicros(), currentTrack);
+		openSpans++;
+	}
+	mutexUnlock(&traceLock);
+}
+
+void traceEnd() {
+	if (!traceFile) return;
+
+	mutexLock(&traceLock);
+	if (traceFile) {
+		startEvent();
+		fprintf(traceFile, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", elapsedMicros(), currentTrack);
+		if (openSpans > 0) openSpans--;
+	}
+	mutexUnlock(&traceLock);
+}
+
+int traceDepth() {
+	return traceFile ? openSpans : 0;
+}
+
+void traceUnwind(int depth) {
+	while (traceFile && openSpans > depth) traceEnd();
+}
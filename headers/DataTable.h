@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 
-#include "libsecuredstring.h"
+#include "SourceMap.h"
 #include "ast.h"
 
 
@@ -28,35 +28,36 @@ typedef struct DataEntry {
 	// Additionally, since the directive AST nodes already hold the array of ASTs for the data (except for unary and binary directive),
 	// there is no need to create a new array; however, unary and binary directives do not use an array so there is still a need to create an array.
 	Node** data; // The ASTs representing the data, owned by the parser
-	int dataCount;
-	int dataCapacity;
+	size_t dataCount;
+	size_t dataCapacity;
 
-	SString* source;
-	int linenum;
+	srcloc_t loc;
 } data_entry_t;
 
 typedef struct DataTable {
 	data_entry_t** dataEntries;
-	uint32_t dSize;
-	uint32_t dCapacity;
+	size_t dSize;
+	size_t dCapacity;
 
 	data_entry_t** constEntries;
-	uint32_t cSize;
-	uint32_t cCapacity;
+	size_t cSize;
+	size_t cCapacity;
 
 	data_entry_t** bssEntries;
-	uint32_t bSize;
-	uint32_t bCapacity;
+	size_t bSize;
+	size_t bCapacity;
 
 	data_entry_t** evtEntries;
-	uint32_t eSize;
-	uint32_t eCapacity;
+	size_t eSize;
+	size_t eCapacity;
 
 	data_entry_t** ivtEntries;
-	uint32_t iSize;
-	uint32_t iCapacity;
+	size_t iSize;
+	size_t iCapacity;
 } DataTable;
 
+DEFINE_VECTOR(DataEntries, data_entry_t*, MEM_DATATAB)
+
 typedef enum {
 	DATA_SECT,
 	CONST_SECT,
@@ -74,11 +75,16 @@ typedef enum {
 DataTable* initDataTable();
 
 void deinitDataTable(DataTable* dataTable);
+/**
+ * Frees every entry while keeping the memory of the entry arrays, for assembling another file with the same table.
+ * @param dataTable The data table
+ */
+void resetDataTable(DataTable* dataTable);
 
 
 /**
- * Creates a data entry for the data table with the given information. Note that the source line and line number 
- * are in the node(s) representing the data, so the information can be extracted from there.
+ * Creates a data entry for the data table with the given information. Note that the location of the line
+ * is in the node(s) representing the data, so the information can be extracted from there.
  * @param type The type of data
  * @param addr The address in which the data is located at relative to its section, aka the LP
  * @param size The total size that the data occupies in bytes
@@ -87,7 +93,7 @@ void deinitDataTable(DataTable* dataTable);
  * @param dataCapacity The capacity of the data array
  * @return The new data entry
  */
-data_entry_t* initDataEntry(data_t type, uint32_t addr, uint32_t size, Node** data, int dataCount, int dataCapacity);
+data_entry_t* initDataEntry(data_t type, uint32_t addr, uint32_t size, Node** data, size_t dataCount, size_t dataCapacity);
 
 /**
  * 
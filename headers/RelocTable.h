@@ -2,6 +2,9 @@
 #define _RELOC_TABLE_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "Vector.h"
 
 
 typedef enum RelocType {
@@ -26,29 +29,31 @@ typedef struct RelocEntry {
 typedef struct RelocTable {
 	struct {
 		RelocEnt** entries;
-		uint32_t entryCount;
-		uint32_t entryCapacity;
+		size_t entryCount;
+		size_t entryCapacity;
 	} textRelocTable;
 
 	struct {
 		RelocEnt** entries;
-		uint32_t entryCount;
-		uint32_t entryCapacity;
+		size_t entryCount;
+		size_t entryCapacity;
 	} dataRelocTable;
 
 	struct {
 		RelocEnt** entries;
-		uint32_t entryCount;
-		uint32_t entryCapacity;
+		size_t entryCount;
+		size_t entryCapacity;
 	} constRelocTable;
 
 	struct {
 		RelocEnt** entries;
-		uint32_t entryCount;
-		uint32_t entryCapacity;
+		size_t entryCount;
+		size_t entryCapacity;
 	} evtRelocTable;
 } RelocTable;
 
+DEFINE_VECTOR(RelocEntries, RelocEnt*, MEM_RELOC)
+
 // For use when passing relocation data to getting immediate encoding from encoding functions
 // In order to avoid passing multiple arguments
 typedef struct RelocationData {
@@ -61,6 +66,8 @@ typedef struct RelocationData {
 
 RelocTable* initRelocTable();
 void deinitRelocTable(RelocTable* relocTable);
+// Frees every entry while keeping the memory of the entry arrays, for assembling another file with the same table
+void resetRelocTable(RelocTable* relocTable);
 
 RelocEnt* initRelocEntry(uint32_t offset, uint32_t symbolIdx, reloc_type_t type, int32_t addend);
 
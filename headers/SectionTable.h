@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "diagnostics.h"
 
 
 typedef enum {
@@ -28,6 +31,17 @@ typedef struct SectionTable {
 
 SectionTable* initSectionTable();
 void deinitSectionTable(SectionTable* sectTable);
+// Brings every section back to empty, for assembling another file with the same table
+void resetSectionTable(SectionTable* sectTable);
+
+/**
+ * Moves the location pointer of the active section past what was laid out at it.
+ * The offsets and sizes of AOEFF sections are 32 bits, a section going past 4 GiB is an error.
+ * @param sectTable The section table
+ * @param size The number of bytes laid out
+ * @param linedata The line that laid them out
+ */
+void advanceLP(SectionTable* sectTable, size_t size, linedata_ctx* linedata);
 
 void displaySectionTable(SectionTable* sectTable);
 
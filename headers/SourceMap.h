@@ -0,0 +1,161 @@
+#ifndef _SOURCE_MAP_H_
+#define _SOURCE_MAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "diagnostics.h"
+
+
+// What is kept of the sources once their tokens are freed: the text of the lines, for diagnostics, and the names
+// A location is a line in 32 bits, tokens, AST nodes and table entries only hold that. 0 is nowhere
+// The lines of a file are split into segments of 4096 lines, a location is the number of a segment and a line in it
+// Segments are numbered as the files reach them, so a file only takes up the segments it has lines in
+// A file keeps every line it lexed, unless its lines are dropped (`--stream`, see stream.h), then only the lines kept with
+// `keepSourceLine` stay. Names are interned, a name has a single copy in a map, but a name from an adopted map is another copy
+// The map of a context is reset with its assembly, and everything in it is allocated under the context
+// The contexts loading included files ahead (see prefetch.h) number their files and segments from the map of the parse,
+// so that theirs can be adopted as they are
+
+typedef uint32_t srcloc_t;
+
+#define SRC_SEGMENT_BITS 12
+#define SRC_SEGMENT_LINES (1 << SRC_SEGMENT_BITS)
+#define SRC_MAX_SEGMENTS ((1u << (32 - SRC_SEGMENT_BITS)) - 1)
+#define NO_LOC 0
+
+// Text is copied into blocks that never move, so a line or a name stays where it is until its block is freed
+typedef struct SourceBlock {
+	struct SourceBlock* next;
+	uint32_t used;
+	uint32_t size;
+	char text[];
+} src_block_t;
+
+typedef struct SourceFile {
+	const char** lines; // From `firstLine` on, NULL for a line that was not lexed
+	int firstLine;
+	int lineCount;
+	int lineCapacity;
+	src_block_t* blocks; // The first one is being filled
+
+	uint32_t* segments; // The segment of each 4096 lines, 0 for none yet
+	int segmentCount;
+} src_file_t;
+
+typedef struct SourceSegment {
+	uint32_t file; // 0 for the segments of other maps
+	int firstLine;
+} src_segment_t;
+
+typedef struct KeptLine {
+	srcloc_t loc;
+	const char* text;
+} kept_line_t;
+
+typedef struct SourceMap {
+	struct SourceMap* numbering; // The map giving out the file and segment numbers, NULL for this one
+	uint32_t lastFile; // The last file number given out
+	uint32_t lastSegment; // The last segment number given out
+
+	src_file_t** files; // By file number, NULL for the files of other maps
+	uint32_t fileCapacity;
+
+	src_segment_t* segments; // By segment number
+	uint32_t segmentCapacity;
+
+	// Lines outliving the lines of their file, open addressing by location
+	kept_line_t* kept;
+	uint32_t keptCount;
+	uint32_t keptCapacity; // A power of two, at least twice `keptCount`
+
+	// Interned names, open addressing by hash
+	const char** names;
+	uint32_t nameCount;
+	uint32_t nameCapacity; // A power of two, at least twice `nameCount`
+
+	src_block_t* blocks; // The text of the kept lines and the names, the first one is being filled
+} SourceMap;
+
+
+/**
+ * Frees everything in the map, which can then be used for the next assembly. A zeroed map is empty.
+ * @param map The map
+ */
+void resetSourceMap(SourceMap* map);
+/**
+ * Has the map number its files and segments from another map, whose numbers must then outlive it.
+ * @param map The map, still empty
+ * @param numbering The map giving out the numbers
+ */
+void shareSourceNumbering(SourceMap* map, SourceMap* numbering);
+/**
+ * Starts a new file.
+ * @param map The map
+ * @return The number of the file
+ */
+uint32_t addSourceFile(SourceMap* map);
+/**
+ * Gets the location of a line of a file, whether or not its text is known.
+ * @param map The map
+ * @param file The number of the file
+ * @param line The line number, from 1
+ * @return The location
+ */
+srcloc_t sourceLoc(SourceMap* map, uint32_t file, int line);
+/**
+ * Keeps the text of a line of a file. Lines come in order, after a `dropSourceLines` they start again from any line.
+ * @param map The map
+ * @param file The number of the file
+ * @param line The line number, from 1
+ * @param text The line
+ * @return The location of the line
+ */
+srcloc_t addSourceLine(SourceMap* map, uint32_t file, int line, const char* text);
+/**
+ * Keeps a line past `dropSourceLines`.
+ * @param map The map
+ * @param loc The location of the line
+ * @param text The line, NULL for the one given to `addSourceLine`
+ */
+void keepSourceLine(SourceMap* map, srcloc_t loc, const char* text);
+/**
+ * Drops the lines of a file, but the ones kept with `keepSourceLine`. Their locations stay.
+ * @param map The map
+ * @param file The number of the file
+ */
+void dropSourceLines(SourceMap* map, uint32_t file);
+/**
+ * Takes over the files, segments, kept lines and text of another map, which must number them from this one. The other map is left empty.
+ * The memory of the other map must be adopted along with it (`memAdoptOwner`).
+ * @param map The map
+ * @param from The map to take from
+ */
+void adoptSourceMap(SourceMap* map, SourceMap* from);
+
+/**
+ * Gets the text of a line in the map of the current context.
+ * @param loc The location of the line
+ * @return The line, NULL if it is not known
+ */
+const char* sourceLine(srcloc_t loc);
+/**
+ * Gets the number of a line in the map of the current context.
+ * @param loc The location of the line
+ * @return The line number, 0 if it is not known
+ */
+int lineNumber(srcloc_t loc);
+/**
+ * Gets where a line is, for a diagnostic, in the map of the current context.
+ * @param loc The location of the line
+ * @return The line data, without a source if the line is not known
+ */
+linedata_ctx lineAt(srcloc_t loc);
+/**
+ * Interns a name in the map of the current context.
+ * @param name The name
+ * @return The copy of the name in the map, which lives as long as the map
+ */
+const char* internName(const char* name);
+
+#endif
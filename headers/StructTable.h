@@ -3,7 +3,7 @@
 
 #include <stdbool.h>
 
-#include "libsecuredstring.h"
+#include "SourceMap.h"
 
 typedef enum {
 	BYTE_FT,
@@ -20,8 +20,7 @@ typedef struct StructField {
 	int offset; // The offset of the field from the start
 	int structTypeIdx; // If field is struct, the index of that type in the struct table
 
-	SString* source; // The source file where the field was defined
-	int linenum; // The line number where the field was defined
+	srcloc_t loc; // The line where the field was defined
 } struct_field_t;
 
 typedef struct StructRoot {
@@ -32,8 +31,7 @@ typedef struct StructRoot {
 	int fieldCount;
 	int fieldCapacity;
 
-	SString* source; // The source file where the struct was defined
-	int linenum; // The line number where the struct was defined
+	srcloc_t loc; // The line where the struct was defined
 
 	int index; // The index of this struct in the table
 } struct_root_t;
@@ -47,6 +45,8 @@ typedef struct StructDefTable {
 
 StructTable* initStructTable();
 void deinitStructTable(StructTable* structTable);
+// Frees every struct while keeping the memory of the struct array, for assembling another file with the same table
+void resetStructTable(StructTable* structTable);
 
 struct_root_t* initStruct(const char* name);
 void deinitStruct(struct_root_t* structDef);
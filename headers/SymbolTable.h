@@ -2,15 +2,15 @@
 #define _SYMBOL_TABLE_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "ast.h"
-#include "libsecuredstring.h"
+#include "SourceMap.h"
 
 typedef uint32_t SYMBFLAGS;
 
 typedef struct SymbolEntryReference {
-	SString* source; // The source line where the symbol is referenced
-	int linenum; // The line where the symbol is referenced
+	srcloc_t loc; // The line where the symbol is referenced
 } symb_entry_ref_t;
 
 typedef struct SymbolEntry {
@@ -18,8 +18,7 @@ typedef struct SymbolEntry {
 	SYMBFLAGS flags;
 	uint32_t size; // The size of the symbol in bytes, it can either be explicitly set (via .size) or inferred
 
-	SString* source; // The source line where the symbol is defined
-	int linenum; // The line where the symbol is defined
+	srcloc_t loc; // The line where the symbol is defined, NO_LOC if not known
 
 	union {
 		Node* expr; // If the symbol is defined as an expression, the root of the expression AST
@@ -28,8 +27,8 @@ typedef struct SymbolEntry {
 
 	struct References {
 		symb_entry_ref_t** refs;
-		int refcount;
-		int refcap;
+		size_t refcount;
+		size_t refcap;
 	} references;
 
 	// In the case that the symbol is typed to be a specific struct/union. -1 for none
@@ -40,10 +39,19 @@ typedef struct SymbolEntry {
 
 typedef struct SymbolTable {
 	symb_entry_t** entries; // Symbol entries
-	uint32_t size; // Number of entries
-	uint32_t capacity;
+	size_t size; // Number of entries
+	size_t capacity;
+	// Position + 1 of an entry in each slot, 0 for an empty slot, so that looking a name up does not scan the entries
+	uint32_t* index;
+	uint32_t indexSize; // A power of two, at least twice the number of entries
+	// The lines of the entries are kept in the source map, as the lines of their files are dropped as they go (`--stream`, see stream.h)
+	// Such a table only keeps the first reference of each symbol, the rest would grow with the source rather than the symbols
+	bool ownsSources;
 } SymbolTable;
 
+DEFINE_VECTOR(SymbolEntries, symb_entry_t*, MEM_SYMTAB)
+DEFINE_VECTOR(SymbolRefs, symb_entry_ref_t*, MEM_SYMTAB)
+
 
 /**
 	| 15-12 | 11 | 10 | 9 | 8 | 7 | 6 | 5 | 4 | 3 | 2 | 1 | 0 |
@@ -106,12 +114,27 @@ typedef struct SymbolTable {
 
 SymbolTable* initSymbolTable();
 void deinitSymbolTable(SymbolTable* table);
+// Frees every entry while keeping the memory of the entry array, for assembling another file with the same table
+void resetSymbolTable(SymbolTable* table);
 
-symb_entry_t* initSymbolEntry(const char* name, SYMBFLAGS flags, Node* expr, uint32_t val, SString* source, int linenum);
+symb_entry_t* initSymbolEntry(const char* name, SYMBFLAGS flags, Node* expr, uint32_t val, srcloc_t loc);
 void deinitSymbolEntry(symb_entry_t* entry);
 
 void addSymbolEntry(SymbolTable* table, symb_entry_t* entry);
-void addSymbolReference(symb_entry_t* entry, SString* source, int linenum);
+/**
+ * Records where a symbol is referenced.
+ * @param table The table of the entry, which decides whether the line is kept
+ * @param entry The entry
+ * @param loc The line of the reference
+ */
+void addSymbolReference(SymbolTable* table, symb_entry_t* entry, srcloc_t loc);
+/**
+ * Sets where a symbol is defined, when it was already in the table from a reference or another file.
+ * @param table The table of the entry, which decides whether the line is kept
+ * @param entry The entry
+ * @param loc The line of the definition
+ */
+void setSymbolSource(SymbolTable* table, symb_entry_t* entry, srcloc_t loc);
 
 symb_entry_t* getSymbolEntry(SymbolTable* table, const char* name);
 
@@ -0,0 +1,52 @@
+#ifndef _VECTOR_H_
+#define _VECTOR_H_
+
+#include <stddef.h>
+
+#include "allocator.h"
+
+
+// Arrays that grow geometrically, each growth at least doubles the capacity, so n pushes copy O(n) items in all
+// An array is its items, a count and a capacity, which stay fields of whatever holds the array, under their own names
+// `DEFINE_VECTOR(Name, type, tag)` makes the functions for arrays of a type, allocated under a component:
+//   reserveName(&items, &capacity, n) - room for n items in all, from an estimate of the count the array will reach
+//   pushName(&items, &count, &capacity, item)
+//   shrinkName(&items, count, &capacity) - gives back what is past the count, an empty array is freed and NULL
+// Failing to allocate is an error (ERR_MEM), an array is never left NULL with items in it
+
+#define VECTOR_MIN_CAPACITY 4
+
+/**
+ * Grows an array to hold at least the given number of items. It at least doubles when it grows, but from empty it takes the number as it is.
+ * @param tag The component that owns the array
+ * @param items The array, NULL for none yet
+ * @param capacity The capacity of the array, updated
+ * @param itemSize The size of an item
+ * @param needed The number of items the array must hold
+ * @return The array, moved or not
+ */
+void* growVector(memTag tag, void* items, size_t* capacity, size_t itemSize, size_t needed);
+/**
+ * Shrinks an array to its count.
+ * @param tag The component that owns the array
+ * @param items The array
+ * @param count The number of items in it
+ * @param capacity The capacity of the array, updated
+ * @param itemSize The size of an item
+ * @return The array, NULL once empty
+ */
+void* shrinkVector(memTag tag, void* items, size_t count, size_t* capacity, size_t itemSize);
+
+#define DEFINE_VECTOR(Name, type, tag) \
+	static inline void reserve##Name(type** items, size_t* capacity, size_t needed) { \
+		if (needed > *capacity) *items = (type*) growVector(tag, *items, capacity, sizeof(type), needed); \
+	} \
+	static inline void push##Name(type** items, size_t* count, size_t* capacity, type item) { \
+		if (*count == *capacity) *items = (type*) growVector(tag, *items, capacity, sizeof(type), *count < VECTOR_MIN_CAPACITY ? VECTOR_MIN_CAPACITY : *count + 1); \
+		(*items)[(*count)++] = item; \
+	} \
+	static inline void shrink##Name(type** items, size_t count, size_t* capacity) { \
+		*items = (type*) shrinkVector(tag, *items, count, capacity, sizeof(type)); \
+	}
+
+#endif
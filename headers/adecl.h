@@ -2,6 +2,7 @@
 #define _ADECL_H_
 
 #include <stdio.h>
+#include <stdbool.h>
 
 #include "ast.h"
 #include "sds.h"
@@ -14,17 +15,42 @@ typedef struct ADECLContext {
 	// The "module" needs to be aware of the config and data that the assembler is working with
 	// So it can add symbols to the symbol table and structs to the struct table, and report back
 	// The ASTs it creates will be added to the parser's AST list, so that needs to be returned
-	ParserConfig parentParserConfig;
+	ArxAssembler* as; // The context of the including assembly, errors in the ADECL file fail the whole assembly
 	SymbolTable* symbolTable;
 	StructTable* structTable;
 	// Note that data directives are not allowed in ADECL files, so the data table is not needed here
 	// Same with section table as there is no concept of sections in ADECL files
 	Node** asts; // The ASTs created from the ADECL file, the parent parser now takes ownership of these
-	int astCount;
-	int astCapacity;
+	size_t astCount;
+	size_t astCapacity;
+	bool includes; // The file includes other files, so its declarations depend on more than its own content
 } ADECL_ctx;
 
-FILE* openADECLFile(sds filename);
+/**
+ * Finds an included file, as given (from the current directory when relative) then in each `-I` directory in order.
+ * @param config The configuration holding the `-I` directories
+ * @param filename The name given to `.include`
+ * @return The path of the file, NULL if it is in none of them
+ */
+sds findADECLFile(const Config* config, const char* filename);
+/**
+ * Gets the absolute path of a file with every link and `.` or `..` resolved, which names the file the same way however it was reached.
+ * @param path The file, which must exist
+ * @return The canonical path, NULL on failure
+ */
+sds canonicalADECLPath(const char* path);
+/**
+ * Opens an included ADECL file, recording it as a dependency of the assembly when asked to (`-MD`).
+ * @param as The context of the including assembly
+ * @param path The file, as found by `findADECLFile`
+ * @return The file, NULL if it could not be opened
+ */
+FILE* openADECLFile(ArxAssembler* as, const char* path);
+/**
+ * Lexes and parses the declarations of an ADECL file. The file is read whole and closed before anything is lexed.
+ * @param file The file, closed once read
+ * @param context Receives the ASTs and the tables
+ */
 void lexParseADECLFile(FILE* file, ADECL_ctx* context);
 
 #endif
\ No newline at end of file
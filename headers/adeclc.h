@@ -0,0 +1,36 @@
+#ifndef _ADECLC_H_
+#define _ADECLC_H_
+
+#include <stdbool.h>
+
+#include "adecl.h"
+
+
+// Precompiled ADECL files (`.adeclc`, made with `arxsm --precompile types.adecl`)
+// They hold the declarations of an ADECL file already lexed, parsed and evaluated, laid out to be mapped and read in place:
+// a header, the symbol, struct and field records, then the names and source lines the records point to, each null terminated
+// The header has the SHA-256 of the ADECL file, `.include "types.adecl"` uses `types.adeclc` next to it only while the hash
+// and the enhanced features match, and lexes the ADECL file otherwise
+// `.set` expressions are evaluated when precompiling, so they can only use the symbols of their own file
+// The declarations of ADECL files that were lexed are also kept in memory in that same form, by the hash of the file,
+// so a file included again by the same process (another file of a batch, another request of a server) is not lexed again
+
+
+/**
+ * Precompiles an ADECL file.
+ * @param as The context, the errors of the ADECL file are reported through it
+ * @param infile The ADECL file
+ * @param outfile Where the precompiled file goes
+ */
+void precompileADECL(ArxAssembler* as, const char* infile, const char* outfile);
+/**
+ * Loads the declarations of an included file, recording what it read as dependencies (`-MD`).
+ * A `.adeclc` file given directly must be valid. An ADECL file is loaded from its `.adeclc` sibling when that is up to date,
+ * from memory when the process already lexed the same contents, and lexed otherwise.
+ * @param context Receives the tables the way `lexParseADECLFile` fills them, with ASTs only when the file was lexed
+ * @param path The file, as found by `findADECLFile`
+ * @return False if the file could not be opened
+ */
+bool loadADECL(ADECL_ctx* context, const char* path);
+
+#endif
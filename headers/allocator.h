@@ -0,0 +1,146 @@
+#ifndef _ALLOCATOR_H_
+#define _ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Every allocation made by the assembler goes through these functions
+// Each allocation is tagged with the component that owns it, so that live bytes,
+// peak bytes and allocation counts can be reported per component (`--mem-stats`)
+// Memory obtained from these functions must be released with `memFree`, never `free`
+// Accounting is atomic, so the functions can be used from the batch mode workers
+// A thread can also set an owner, every block it allocates is then recorded by that owner until freed,
+// which lets an assembly that failed half way release everything it allocated at once
+// An owner can also carry allocation hooks, its blocks then come from the hooks instead of malloc
+// The common libraries (sds, securedstring) are linked with their allocations redirected to `memLib*`,
+// so their strings are accounted, owned and hooked like everything else
+
+typedef enum {
+	MEM_LEXER,
+	MEM_TOKENS,
+	MEM_AST,
+	MEM_SYMTAB,
+	MEM_DATATAB,
+	MEM_RELOC,
+	MEM_CODEGEN,
+	MEM_OUTPUT,
+	MEM_POOL,
+	MEM_CONTEXT,
+	MEM_STRINGS,
+	MEM_TAG_COUNT
+} memTag;
+
+typedef struct MemStats {
+	size_t live; // Bytes currently allocated
+	size_t peak; // Highest value `live` has reached
+	uint64_t allocs; // Number of allocations (reallocations of existing blocks are not counted)
+	uint64_t frees; // Number of frees
+} mem_stats_t;
+
+// Where the memory of an owner comes from, for instance an arena of the program embedding the assembler
+// `realloc` gets NULL for new blocks and `free` is never given NULL
+// An arena that frees everything at once can make `free` do nothing
+typedef struct MemHooks {
+	void* (*alloc)(size_t size, void* userData);
+	void* (*realloc)(void* ptr, size_t size, void* userData);
+	void (*free)(void* ptr, void* userData);
+	void* userData;
+} mem_hooks_t;
+
+typedef struct MemOwner {
+	void* blocks; // Blocks allocated under this owner and not freed yet
+	const mem_hooks_t* hooks; // NULL for malloc, must outlive every block allocated under the owner
+} mem_owner_t;
+
+
+/**
+ * Allocates memory for the given component.
+ * @param tag The component that owns the memory
+ * @param size The number of bytes to allocate
+ * @return The allocated memory, NULL on failure
+ */
+void* memAlloc(memTag tag, size_t size);
+/**
+ * Allocates zeroed memory for the given component.
+ * @param tag The component that owns the memory
+ * @param count The number of elements
+ * @param size The size of each element
+ * @return The allocated memory, NULL on failure
+ */
+void* memCalloc(memTag tag, size_t count, size_t size);
+/**
+ * Resizes memory previously obtained from the allocator. The block keeps the tag it was allocated with.
+ * A NULL `ptr` behaves like `memAlloc`.
+ * @param tag The component that owns the memory, only used when `ptr` is NULL
+ * @param ptr The memory to resize
+ * @param size The new size in bytes
+ * @return The resized memory, NULL on failure (in which case `ptr` is left untouched)
+ */
+void* memRealloc(memTag tag, void* ptr, size_t size);
+/**
+ * Duplicates a string for the given component.
+ * @param tag The component that owns the memory
+ * @param str The string to duplicate
+ * @return The duplicated string, NULL on failure
+ */
+char* memStrdup(memTag tag, const char* str);
+/**
+ * Frees memory previously obtained from the allocator. NULL is ignored.
+ * @param ptr The memory to free
+ */
+void memFree(void* ptr);
+
+/**
+ * Sets the owner of the blocks the calling thread allocates from now on.
+ * @param owner The owner, NULL for none
+ * @return The previous owner of the thread
+ */
+mem_owner_t* memSetOwner(mem_owner_t* owner);
+/**
+ * Removes a block from its owner, so that it outlives the owner being released. It must still be freed with `memFree`.
+ * @param ptr The block
+ */
+void memDisown(void* ptr);
+/**
+ * Moves every block recorded by an owner to another, as if they had been allocated under it.
+ * Both owners must have the same hooks, and neither can be allocating on another thread meanwhile.
+ * @param owner The owner taking the blocks
+ * @param from The owner giving them up, left without any
+ */
+void memAdoptOwner(mem_owner_t* owner, mem_owner_t* from);
+/**
+ * Frees every block still recorded by an owner. The owner can be used again afterwards.
+ * @param owner The owner
+ */
+void memReleaseOwner(mem_owner_t* owner);
+
+/**
+ * Allocates a block with the given hooks, without recording it under any owner.
+ * @param hooks The hooks, NULL for malloc
+ * @param tag The component that owns the memory
+ * @param size The number of bytes to allocate
+ * @return The allocated memory, NULL on failure
+ */
+void* memAllocWith(const mem_hooks_t* hooks, memTag tag, size_t size);
+
+// What the common libraries call instead of the C allocation functions, tagged MEM_STRINGS
+void* memLibMalloc(size_t size);
+void* memLibCalloc(size_t count, size_t size);
+void* memLibRealloc(void* ptr, size_t size);
+void memLibFree(void* ptr);
+char* memLibStrdup(const char* str);
+char* memLibStrndup(const char* str, size_t n);
+
+/**
+ * Gets the accounting of a component.
+ * @param tag The component
+ * @return The stats of the component
+ */
+mem_stats_t getMemStats(memTag tag);
+/**
+ * Prints the accounting of every component to stderr.
+ */
+void displayMemStats();
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _ARXSM_H_
+#define _ARXSM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "context.h"
+#include "allocator.h"
+
+
+// Library entry point (libarxsm), assembles a source held in memory into an AOEFF image held in memory
+// Nothing touches the filesystem except `.include` directives, which are still resolved from the working directory
+// Each call uses its own assembler context, calls from different threads do not interfere
+// All the memory of a call, the image included, can come from the caller's allocator (`ArxOptions.allocator`)
+
+typedef struct ArxOptions {
+	FLAGS8 warnings; // WarningFlags
+	FLAGS8 enhancedFeatures; // EnhancedFeatures
+	bool warningAsFatal;
+	bool useDebugSymbols;
+	int errorLimit; // The assembly goes on past errors until there are this many, 0 for no limit
+
+	const char* name; // Shown in diagnostics, NULL for none
+	diagSink sink; // Receives the diagnostics, NULL prints them to stderr
+	void* sinkCtx;
+
+	// Where every allocation of the call comes from, NULL for malloc
+	// Must outlive the output, the image is freed with it by `arxsm_free_output`
+	// With an arena, the whole call can be dropped at once by resetting the arena instead of freeing the output
+	const mem_hooks_t* allocator;
+} ArxOptions;
+
+typedef struct ArxOutput {
+	uint8_t* image; // The object, NULL on failure
+	size_t size;
+	int errorCount;
+	int warningCount;
+} ArxOutput;
+
+
+/**
+ * Assembles a source buffer.
+ * @param src The source, does not need to be null terminated
+ * @param len The length of the source in bytes
+ * @param options The options, NULL for the same defaults as the command line
+ * @param output Filled with the image and diagnostic counts, release it with `arxsm_free_output`
+ * @return ARX_FAILED if the source has errors
+ */
+arxStatus arxsm_assemble(const char* src, size_t len, const ArxOptions* options, ArxOutput* output);
+/**
+ * Frees the image of an output. NULL images are ignored.
+ * @param output The output filled by `arxsm_assemble`
+ */
+void arxsm_free_output(ArxOutput* output);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "token.h"
 #include "reserved.h"
+#include "Vector.h"
 
 
 typedef enum {
@@ -111,8 +112,8 @@ typedef struct DirectiveNode {
 
 	struct {
 		struct ASTNode** exprs;
-		int exprCount;
-		int exprCapacity;
+		size_t exprCount;
+		size_t exprCapacity;
 	} nary;
 
 	uint8_t section;
@@ -220,7 +221,10 @@ typedef struct TypeNode {
 typedef struct ASTNode {
 	astNode_t astNodeType;
 
-	Token* token;
+	// What the node needs of its token, which is freed after the parse
+	tokenType type; // TK_UNKNOWN for nodes without a token, like those of a LD imm/move decomposition
+	srcloc_t loc; // NO_LOC for nodes without a token
+	const char* lexeme; // Interned, NULL for strings (their value is in `StrNode`) and nodes without a token
 
 	node_t nodeType;
 	// The children of this node will depend on the type
@@ -246,7 +250,7 @@ typedef struct ASTNode {
  * That will be supplied by the specified `nodeData`.
  * @param astNodeType The type of AST node (leaf, internal, root)
  * @param nodeType The type that this node will represent
- * @param token The token associated
+ * @param token The token the node is made from, which it does not keep, NULL for none
  * @param parent The parent node, NULL if root
  * @return The AST node
  */
@@ -261,30 +265,15 @@ void setNodeData(Node* node, void* nodeData, node_t nodeType);
 void freeAST(Node* root);
 void printAST(Node* root);
 
-// Dynamic array functionality
+// Dynamic array functionality, the ASTs of the parser, the values of n-ary directives and data entries
+DEFINE_VECTOR(Nodes, Node*, MEM_AST)
 
-/**
- * Creates a new dynamic array of AST nodes with the given initial capacity.
- * @param initialCapacity The initial capacity of the array
- * @return The new array of AST nodes or NULL if memory allocation failed
- */
-Node** newNodeArray(int initialCapacity);
 /**
  * Frees the given array of nodes. Note that this does not free the nodes themselves as they are owned by the parser.
  * @param array The array of nodes to free
  */
 void freeNodeArray(Node** array);
 
-/**
- * Inserts a node into the array, resizing if necessary.
- * @param array The array of nodes
- * @param capacity The capacity of the array, updated if resized
- * @param count The current count of nodes in the array, updated after insertion
- * @param node The node to add
- * @return The (possibly reallocated) array of nodes or NULL if memory reallocation failed
- */
-Node** nodeArrayInsert(Node** array, int* capacity, int* count, Node* node);
-
 
 
 InstrNode* initInstructionNode(enum Instructions instruction, uint8_t section);
@@ -2,73 +2,151 @@
 #define _CODEGEN_H_
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "parser.h"
 #include "SectionTable.h"
 #include "SymbolTable.h"
 #include "RelocTable.h"
+#include "context.h"
 
 typedef struct CodeGenerator {
 	struct {
 		uint32_t* instructions;
-		int instructionCount;
-		int instructionCapacity;
+		size_t instructionCount;
+		size_t instructionCapacity;
 	} text;
 
 	struct {
 		uint8_t* data;
-		int dataCount;
-		int dataCapacity;
+		size_t dataCount;
+		size_t dataCapacity;
 	} data;
 
 	struct {
 		uint8_t* data;
-		int dataCount;
-		int dataCapacity;
+		size_t dataCount;
+		size_t dataCapacity;
 	} consts;
 
 	struct {
 		uint8_t* data; // for both data and instructions
-		int dataCount;
-		int dataCapacity;
+		size_t dataCount;
+		size_t dataCapacity;
 	} evt;
 
+	// `--stream`: what `spillCode` moved out of the buffers of each section, written before what they hold (see stream.h)
+	FILE* spills[6]; // NULL until a section spills
+	size_t spilled[6]; // Bytes
+
 	SectionTable* sectionTable;
 	SymbolTable* symbolTable;
 	RelocTable* relocTable;
+
+	ArxAssembler* as;
 } CodeGen;
 
+DEFINE_VECTOR(Encodings, uint32_t, MEM_CODEGEN)
+DEFINE_VECTOR(Bytes, uint8_t, MEM_CODEGEN)
+
 
 /**
  * @brief 
+ * @param as The assembler context the code generator reports to
  * @param sectionTable 
  * @param symbolTable
  * @param relocTable
- * @return 
+ * @return The code generator, NULL on failure
  */
-CodeGen* initCodeGenerator(SectionTable* sectionTable, SymbolTable* symbolTable, RelocTable* relocTable);
+CodeGen* initCodeGenerator(ArxAssembler* as, SectionTable* sectionTable, SymbolTable* symbolTable, RelocTable* relocTable);
 /**
  * @brief 
  * @param codegen 
  */
 void deinitCodeGenerator(CodeGen* codegen);
+/**
+ * Empties the generated sections, keeping their memory, for generating another file with the same tables.
+ * @param codegen 
+ */
+void resetCodeGenerator(CodeGen* codegen);
 
 /**
  * @brief 
  * @param parser 
  * @param codegen 
+ * @return ARX_FAILED if code could not be generated
+ */
+arxStatus gencode(Parser* parser, CodeGen* codegen);
+/**
+ * Checks the ASTs the way `gencode` does without a code generator, for `-fsyntax-only`.
+ * Immediates and data values are evaluated and checked for their types, externs and relocatable expressions,
+ * and unused symbols are resolved, but nothing is encoded and no relocation is added.
+ * @param parser The parser, after a successful parse
+ * @return ARX_FAILED if gencode would have failed on a check
+ */
+arxStatus checkcode(Parser* parser);
+/**
+ * Generates the code of a chunk of a streamed source, after what was generated for the chunks before it (see stream.h).
+ * Unlike `gencode`, the symbols are not resolved, `resolveCode` does it once the last chunk is generated.
+ * @param parser The parser, after parsing the chunk
+ * @param codegen The code generator
+ * @return ARX_FAILED if code could not be generated
+ */
+arxStatus gencodeChunk(Parser* parser, CodeGen* codegen);
+/**
+ * Resolves the symbols after the last chunk of a streamed source, the way `gencode` does at its end.
+ * @param codegen The code generator
+ * @return ARX_FAILED if a symbol could not be resolved
  */
-void gencode(Parser* parser, CodeGen* codegen);
+arxStatus resolveCode(CodeGen* codegen);
+/**
+ * Moves the generated sections out of memory into temporary files, emptying the buffers for the next chunk.
+ * The location pointers and the written binary are the same as if the code had stayed in the buffers.
+ * @param codegen The code generator
+ * @return ARX_FAILED if a temporary file could not be created or written
+ */
+arxStatus spillCode(CodeGen* codegen);
 
 void displayCodeGen(CodeGen* codegen);
 
+// The following are used by gencode, they are exposed for the microbenchmarks in bench/
+
+/**
+ * Gets the encoding of the immediate expression of an instruction, evaluating it if needed.
+ * If the expression uses an extern symbol, a relocation entry is added and 0 is returned.
+ * @param immNode The root of the immediate expression
+ * @param expectedType The widest type the immediate is allowed to be
+ * @param symbTable The symbol table
+ * @param reldata The relocation data in case of an extern symbol
+ * @return The encoded immediate
+ */
+uint32_t getImmediateEncoding(Node* immNode, NumType expectedType, SymbolTable* symbTable, RelData* reldata);
+/**
+ * Encodes an I-type instruction.
+ * @param data The instruction node
+ * @param lp The location pointer of the instruction
+ * @param symbTable The symbol table
+ * @param relocTable The relocation table
+ * @return The encoded instruction
+ */
+uint32_t encodeI(InstrNode* data, uint32_t lp, SymbolTable* symbTable, RelocTable* relocTable);
+
 
 /**
  * @brief 
  * @param codegen 
  * @param filename 
+ * @return ARX_FAILED if the file could not be written
+ */
+arxStatus writeBinary(CodeGen* codegen, const char* filename);
+/**
+ * Builds the AOEFF image in memory instead of writing a file.
+ * @param codegen 
+ * @param image Set to the image, allocated under the context like everything else (see `memDisown` to keep it)
+ * @param size Set to the size of the image in bytes
+ * @return ARX_FAILED if the image could not be built, `image` is then NULL
  */
-void writeBinary(CodeGen* codegen, const char* filename);
+arxStatus writeBinaryToBuffer(CodeGen* codegen, uint8_t** image, size_t* size);
 
 
 
@@ -12,6 +12,23 @@
 // Output filename
 // Whether to enable entire enhanced typing features
 // Which enhanced typing features to enable/disable
+// Whether to report memory usage per component
+// Where to write the trace timeline, if any
+// Whether to report cpu counters per phase
+// How many files to assemble at once in batch mode
+// Where to cache objects, how large the cache can grow and whether to report its statistics
+// Whether to write a make dependency file, where, and whether with phony targets
+// Where to look for included files
+// How many threads load included files ahead of the parse
+// How many errors to report before giving up
+// Whether to only check the sources, without generating or writing anything
+// Whether to assemble in two passes over the source, a chunk at a time
+
+// Part of the object cache keys, objects from another version are never reused
+#define ARXSM_VERSION "1.0.0"
+
+// Errors reported before giving up, unless told otherwise
+#define DEFAULT_ERROR_LIMIT 20
 
 typedef uint8_t FLAGS8;
 
@@ -21,6 +38,22 @@ typedef struct Config {
 	const char* outbin;
 	FLAGS8 warnings;
 	FLAGS8 enhancedFeatures;
+	bool showMemStats;
+	const char* traceOut;
+	bool perfCounters;
+	int jobs;
+	const char* cacheDir; // NULL when not caching
+	int cacheSize; // MiB
+	bool cacheStats;
+	bool makeDeps;
+	const char* depFile; // NULL for the object's name with `.d` in place of `.ao`
+	bool phonyDeps;
+	const char** includePaths; // `-I` directories, searched in order after the current directory
+	int includePathCount;
+	int includeThreads; // 0 for one per cpu, or none in batch mode
+	int errorLimit; // The parse goes on past errors until there are this many, 0 for no limit
+	bool syntaxOnly; // Stop after the parse, nothing is generated or written
+	bool stream; // Lex, parse and generate a chunk at a time, keeping only the symbols (see stream.h)
 } Config;
 
 typedef enum {
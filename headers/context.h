@@ -0,0 +1,114 @@
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <stdbool.h>
+#include <setjmp.h>
+
+#include "config.h"
+#include "diagnostics.h"
+#include "allocator.h"
+#include "depfile.h"
+#include "SourceMap.h"
+
+
+// An assembler context owns what used to be process wide: the configuration, where diagnostics go and the memory of an assembly
+// Contexts are independent of each other, several assemblies can run at once on different threads
+// A single context must only be used by one thread at a time
+//
+// The entry points taking a context (initLexer, lexLine, initParser, parse, initCodeGenerator, gencode, writeBinary)
+// run inside a frame: an error reported in the frame returns from the entry point with ARX_FAILED instead of exiting
+// Frames nest, an error always returns from the outermost one so that a failure deep in an include unwinds everything
+// Once an entry point failed, the structures of that assembly are in an unknown state and must not be used or deinitialized,
+// `deinitAssembler` releases all the memory that was allocated while the context ran
+// The exception is the parse, which sets a recovery point: while under `config.errorLimit`, an error resumes the parse at its next line
+// instead of returning, and the parse returns ARX_FAILED once it reaches the end
+// A context can be given allocation hooks, the context itself and everything allocated while it is current then comes from them
+
+typedef enum {
+	ARX_OK,
+	ARX_FAILED
+} arxStatus;
+
+typedef struct ArxFrame {
+	jmp_buf env;
+	struct ArxAssembler* as;
+	volatile arxStatus status; // Set by an error, after setjmp
+	bool outermost;
+	int traceDepth; // The spans open when entering, the ones an error leaves open are closed when leaving
+	struct ArxAssembler* previous; // The context that was current when entering
+	mem_owner_t* previousOwner;
+} ArxFrame;
+
+typedef struct ArxAssembler {
+	Config config;
+
+	diagSink sink; // NULL prints to stderr
+	void* sinkCtx;
+	const char* filename; // Prefixed to diagnostics, NULL for none
+
+	mem_owner_t memory; // Everything allocated while the context is current, along with the hooks it is allocated with
+
+	dep_list_t dependencies; // The files opened by `.include`, only recorded with `config.makeDeps`
+	SourceMap sources; // The lines and names of the assembly, which outlive its tokens
+
+	ArxFrame* frame; // The outermost frame running, NULL when idle
+	jmp_buf* recovery; // Where an error resumes while the context can go on past it, NULL outside of a parse
+	errType error; // The last error reported
+	int errorCount;
+	int warningCount;
+} ArxAssembler;
+
+
+/**
+ * Creates a context.
+ * @param config The configuration of the assemblies ran with the context
+ * @param hooks Where the memory of the context comes from, NULL for malloc. Must outlive the context.
+ * @return The context, NULL on failure
+ */
+ArxAssembler* initAssembler(Config config, const mem_hooks_t* hooks);
+/**
+ * Frees the context along with any memory still allocated under it.
+ * Structures created with the context must not be used afterwards.
+ * @param as The context
+ */
+void deinitAssembler(ArxAssembler* as);
+/**
+ * Sends the errors and warnings of the context to a function instead of stderr.
+ * @param as The context
+ * @param sink The function receiving each diagnostic, NULL for stderr
+ * @param ctx Passed to the sink
+ */
+void setDiagnosticSink(ArxAssembler* as, diagSink sink, void* ctx);
+
+/**
+ * Gets the context the calling thread is running in.
+ * @return The context, NULL outside of any frame
+ */
+ArxAssembler* arxCurrent();
+
+/**
+ * Enters a frame, making the context current for the thread. Must be followed by `setjmp(frame->env)`.
+ * @param as The context
+ * @param frame The frame, living on the caller's stack
+ */
+void arxEnter(ArxAssembler* as, ArxFrame* frame);
+/**
+ * Leaves a frame, on both the normal path and after an error.
+ * @param frame The frame given to `arxEnter`
+ * @return ARX_FAILED if an error was reported in the frame
+ */
+arxStatus arxLeave(ArxFrame* frame);
+/**
+ * Whether an assembly can go on past its errors so far: under the error limit, and the last error was not a lack of memory or an internal one.
+ * @param as The context
+ * @return True if the assembly can go on
+ */
+bool arxRecoverable(ArxAssembler* as);
+/**
+ * Returns to the outermost frame of the current context with ARX_FAILED, or to its recovery point while it can go on.
+ * Exits the process when no frame is running.
+ * @param err The error that was reported
+ */
+void arxFail(errType err);
+
+#endif
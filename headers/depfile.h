@@ -0,0 +1,58 @@
+#ifndef _DEPFILE_H_
+#define _DEPFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Make dependency files (`-MD`, `-MF file`, `-MP`)
+// The rule has the object as its target and the source along with every ADECL file the assembly opened as prerequisites
+// `-MP` adds an empty rule for each ADECL file, so that make does not stop when one of them is deleted
+
+// A set of paths that keeps their order, also what include-once and the object cache keep track of files with
+typedef struct DepList {
+	char** paths; // sds, in the order they were added, without duplicates
+	int count;
+	int capacity;
+	uint32_t* slots; // Position + 1 of a path in each slot, 0 for an empty slot, so that adding does not compare against every path
+	uint32_t slotCount; // A power of two, at least twice `count`
+} dep_list_t;
+
+
+/**
+ * Adds a path to a list, unless it is already there.
+ * @param deps The list
+ * @param path The path
+ * @return True if the path was added, false if it was already there or memory ran out
+ */
+bool addDependency(dep_list_t* deps, const char* path);
+/**
+ * Finds a path in a list.
+ * @param deps The list
+ * @param path The path
+ * @return Its position in `paths`, -1 if it is not there
+ */
+int findDependency(const dep_list_t* deps, const char* path);
+/**
+ * Empties a list, keeping its storage.
+ * @param deps The list
+ */
+void clearDependencies(dep_list_t* deps);
+/**
+ * Empties a list and frees its storage.
+ * @param deps The list
+ */
+void freeDependencies(dep_list_t* deps);
+
+/**
+ * Writes the dependency file of an object.
+ * @param depfile Where to write
+ * @param target The object
+ * @param source The source the object was assembled from
+ * @param deps The files the source included
+ * @param phony Whether to add an empty rule for each included file
+ * @return False if the file could not be written
+ */
+bool writeDepFile(const char* depfile, const char* target, const char* source, const dep_list_t* deps, bool phony);
+
+#endif
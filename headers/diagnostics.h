@@ -1,6 +1,8 @@
 #ifndef _DIAGNOSTICS_H
 #define _DIAGNOSTICS_H
 
+#include <stdbool.h>
+
 #define RESET "\033[0m"
 #define RED "\033[31m"
 #define GREEN "\033[32m"
@@ -46,9 +48,56 @@ typedef struct LineData {
 } linedata_ctx;
 
 
+typedef struct Diagnostic {
+	bool isError;
+	int type; // errType or warnType
+	const char* name; // Display name of the type
+	const char* filename; // NULL unless the context has one
+	const char* source; // NULL when there is no line
+	int linenum;
+	const char* message;
+} Diagnostic;
+
+/**
+ * Receives the errors and warnings of an assembler context.
+ * @param diag The diagnostic, only valid for the duration of the call
+ * @param ctx The context given with the sink
+ */
+typedef void (*diagSink)(const Diagnostic* diag, void* ctx);
+
+// Diagnostics kept to be printed later, in the order they were reported
+// The list is not under any owner, so it outlives the context that reported to it
+typedef struct DiagnosticList {
+	Diagnostic* entries; // With copies of their strings
+	int count;
+	int capacity;
+} diag_list_t;
+
+
+/**
+ * Reports an error to the current assembler context, then returns to its outermost frame.
+ * Outside of any context, the error is printed and the process exits.
+ */
 void emitError(errType err, linedata_ctx* linedata, const char* fmsg, ...);
 void emitWarning(warnType warn, linedata_ctx* linedata, const char* fmsg, ...);
 
+/**
+ * Prints a diagnostic to stderr, the way it is printed when the context has no sink.
+ * @param diag The diagnostic
+ */
+void printDiagnostic(const Diagnostic* diag);
+/**
+ * A sink adding each diagnostic to a list.
+ * @param diag The diagnostic
+ * @param ctx The `diag_list_t`
+ */
+void collectDiagnostic(const Diagnostic* diag, void* ctx);
+/**
+ * Prints the diagnostics of a list to stderr, then empties it and frees its storage.
+ * @param list The list
+ */
+void printDiagnostics(diag_list_t* list);
+
 typedef enum {
 	DEBUG_BASIC,
 	DEBUG_DETAIL,
@@ -57,8 +106,8 @@ typedef enum {
 
 void initScope(const char* fxnName);
 
-void debug(debugLvl lvl, const char* fmsg, ...);
-void rdebug(debugLvl lvl, const char* fmsg, ...);
+void debug(debugLvl lvl, const char* fmsg, ...) __attribute__((format(printf, 2, 3)));
+void rdebug(debugLvl lvl, const char* fmsg, ...) __attribute__((format(printf, 2, 3)));
 
 #define log(fmt, ...) debug(DEBUG_BASIC, fmt, ##__VA_ARGS__)
 #define detail(fmt, ...) debug(DEBUG_DETAIL, fmt, ##__VA_ARGS__)
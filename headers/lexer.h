@@ -4,16 +4,20 @@
 #include <stdbool.h>
 
 #include "token.h"
+#include "context.h"
+#include "Vector.h"
 
 typedef struct LineData linedata_ctx;
 
 typedef struct Lexer {
 	sds line;
 	int linenum;
+	uint32_t file; // The number of the file in the source map of the context, 0 until its first line
+	srcloc_t loc; // The location of the line being lexed
 
 	Token** tokens;
-	int tokenCount;
-	int tokenCap;
+	size_t tokenCount;
+	size_t tokenCap;
 
 	char currentChar;
 	int currentPos;
@@ -22,26 +26,45 @@ typedef struct Lexer {
 	Token* prevToken;
 
 	bool inScope;
+
+	ArxAssembler* as;
 } Lexer;
 
+DEFINE_VECTOR(Tokens, Token*, MEM_TOKENS)
+
+// A low estimate of the tokens in a source, capped so a large file does not take the whole array up front
+// Sources average a token every 3 to 8 bytes, the doubling of the array covers what the estimate leaves out
+#define SOURCE_BYTES_PER_TOKEN 16
+#define SOURCE_RESERVE_MAX_TOKENS (1 << 16)
+
 
 /**
  * Initializes the lexer.
- * @return The lexer
+ * @param as The assembler context the lexer reports to
+ * @return The lexer, NULL on failure
  */
-Lexer* initLexer();
+Lexer* initLexer(ArxAssembler* as);
 /**
- * Frees the lexer.
+ * Frees the lexer along with its tokens. Nothing of the parse points into the tokens, so it can be freed as soon as they are parsed.
  * @param lexer The lexer to deinitialize
  */
 void deinitLexer(Lexer* lexer);
 
+/**
+ * Makes room in the token list for the tokens of a source, from its size.
+ * @param lexer The lexer
+ * @param size The size of the source in bytes
+ * @return ARX_FAILED if the memory could not be allocated
+ */
+arxStatus reserveSource(Lexer* lexer, size_t size);
+
 /**
  * Lexes a line of code, producing tokens, and adding them to the lexer's token list.
  * @param lexer The lexer
  * @param line The line to lex
+ * @return ARX_FAILED if the line has an error
  */
-void lexLine(Lexer* lexer, const char* line);
+arxStatus lexLine(Lexer* lexer, const char* line);
 
 /**
  * Retrieves the next token from the source line. The state of the lexer is updated via
@@ -65,11 +88,11 @@ void printToken(Token* token);
  * @param index The index of the token to get
  * @return The token at the given index
  */
-Token* getToken(Lexer* lexer, int index);
+Token* getToken(Lexer* lexer, size_t index);
 
 /**
  * Resets the lexer state, clearing the token list and resetting position.
- * This is only useful for testing purposes. Do not use in actual assembler run.
+ * The token array keeps its capacity, batch mode uses this to lex the next file with the same lexer, which is another file of the source map.
  * @param lexer The lexer to reset
  */
 void resetLexer(Lexer* lexer);
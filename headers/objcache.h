@@ -0,0 +1,72 @@
+#ifndef _OBJCACHE_H_
+#define _OBJCACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "depfile.h"
+
+
+// Object cache (`--cache-dir`), the object of a file is reused while nothing that went into it changed
+// The key is the SHA-256 of the assembler version, the flags that change the output (`-g`, `-F`, warnings, enhanced features),
+// the source and every file it `.include`s, directly or through other includes
+// Includes are found with a plain scan for `.include "file"`, anything looking like one counts even inside a comment,
+// so the key can only be stricter than what the assembler actually reads. Each is looked for in the `-I` directories like `.include` does
+// Only files that assembled without any diagnostic are stored, a hit then looks exactly like a run
+// Entries are `<dir>/<2 hex>/<62 hex>.ao`, the statistics are in `<dir>/stats`, both updated under a lock on `<dir>/lock`
+// so that several processes and batch workers can share a directory
+// Once the entries go over the size limit, the least recently used ones are removed
+// Any failure of the cache itself only makes it miss, it never fails an assembly
+// Not available on Windows
+
+#define CACHE_KEY_LEN 64 // Hex digits
+
+typedef struct CacheStats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long stores;
+	unsigned long long evictions;
+	unsigned long long files;
+	unsigned long long size; // Bytes
+} cache_stats_t;
+
+
+/**
+ * Computes the key of a file.
+ * @param config The configuration the file is assembled with
+ * @param infile The source
+ * @param key Receives the key, null terminated
+ * @param includes Receives the files the scan found, which can only be more than what the assembly opens. NULL if not needed.
+ * @return False if the source cannot be read, the file then bypasses the cache
+ */
+bool cacheKey(const Config* config, const char* infile, char key[CACHE_KEY_LEN + 1], dep_list_t* includes);
+/**
+ * Copies the cached object of a key to the output, counting a hit or a miss.
+ * @param dir The cache directory
+ * @param key The key from `cacheKey`
+ * @param outfile Where the object goes
+ * @return True on a hit
+ */
+bool cacheFetch(const char* dir, const char* key, const char* outfile);
+/**
+ * Stores an object, then evicts the least recently used entries while the cache is over its limit.
+ * @param dir The cache directory, created if missing (its parent must exist)
+ * @param maxSize The limit in bytes
+ * @param key The key from `cacheKey`
+ * @param outfile The object that was just written
+ */
+void cacheStore(const char* dir, size_t maxSize, const char* key, const char* outfile);
+/**
+ * Reads the statistics of a cache directory. A directory without statistics reads as all zeros.
+ * @param dir The cache directory
+ * @return The statistics
+ */
+cache_stats_t getCacheStats(const char* dir);
+/**
+ * Prints the statistics of a cache directory to stderr.
+ * @param dir The cache directory
+ */
+void displayCacheStats(const char* dir);
+
+#endif
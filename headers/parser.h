@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include "config.h"
+#include "context.h"
 #include "SymbolTable.h"
 #include "SectionTable.h"
 #include "StructTable.h"
@@ -21,18 +22,27 @@ typedef struct ParserConfiguration {
 	bool warningAsFatal;
 	FLAGS8 warnings;
 	FLAGS8 enhancedFeatures;
+	// ADECL files: only declaration directives are accepted, anything else is an error as soon as it is seen,
+	// and there are no sections, data or ld decompositions to keep track of
+	bool declarationsOnly;
+	// `-fsyntax-only` and the first pass of `--stream`: nothing is generated from the parse, so the data table is not built
+	bool syntaxOnly;
+	// `--stream`: the pass over the source being parsed a chunk at a time, 0 when it is parsed whole (see stream.h)
+	// The first pass has no ld decompositions, the second one defines no symbols and skips the declarations
+	int streamPass;
 } ParserConfig;
 
 typedef struct Parser {
 	Token** tokens; // Array of tokens to parse, borrowed from lexer
-	int tokenCount;
-	int currentTokenIndex;
+	size_t tokenCount;
+	size_t currentTokenIndex;
+	size_t statementStart; // First token of the statement being parsed, an error skips at least to the line after it
 
 	// The parser owns the ASTs, all other references to its ASTs should not free them
 	// For example, the data table will hold references to the ASTs of the data in its entries, but these references are borrowed
 	Node** asts; // The top-level ASTs, each representing a logical line
-	int astCount;
-	int astCapacity;
+	size_t astCount;
+	size_t astCapacity;
 
 	ParserConfig config;
 
@@ -46,17 +56,58 @@ typedef struct Parser {
 	StructTable* structTable;
 	DataTable* dataTable;
 	RelocTable* relocTable;
+
+	dep_list_t included; // Canonical paths of the files included so far, each one is only included once
+	struct Prefetch* prefetch; // Included files being loaded ahead by workers, NULL when there are none (see prefetch.h)
+
+	ArxAssembler* as;
 } Parser;
 
 
-Parser* initParser(Token** tokens, int tokenCount, ParserConfig config);
+/**
+ * Initializes the parser, taking its configuration from the context.
+ * @param as The assembler context the parser reports to
+ * @param tokens The tokens to parse, borrowed from the lexer
+ * @param tokenCount The number of tokens
+ * @return The parser, NULL on failure
+ */
+Parser* initParser(ArxAssembler* as, Token** tokens, size_t tokenCount);
 void deinitParser(Parser* parser);
+/**
+ * Frees the ASTs and points the parser at a new token stream, keeping the memory of its AST array.
+ * The configuration and tables stay, the tables are expected to be reset separately.
+ * @param parser The parser
+ * @param tokens The tokens to parse next
+ * @param tokenCount The number of tokens
+ */
+void resetParser(Parser* parser, Token** tokens, size_t tokenCount);
+/**
+ * Frees the ASTs of a chunk of a streamed source and points the parser at the next chunk (see stream.h).
+ * Unlike `resetParser`, the files included so far stay included.
+ * @param parser The parser
+ * @param tokens The tokens of the next chunk
+ * @param tokenCount The number of tokens
+ */
+void resetParserChunk(Parser* parser, Token** tokens, size_t tokenCount);
 void setTables(Parser* parser, SectionTable* sectionTable, SymbolTable* symbolTable, StructTable* structTable, DataTable* dataTable, RelocTable* relocTable);
 
-void parse(Parser* parser);
+/**
+ * Parses the tokens into ASTs, filling the tables.
+ * Unless it runs inside another entry point, the parse goes on at the line after an error while under the context's error limit.
+ * @param parser The parser
+ * @return ARX_FAILED if the source has an error
+ */
+arxStatus parse(Parser* parser);
 
 void showParserConfig(Parser* parser);
 
+/**
+ * Gets the section that symbols and directives are being placed in.
+ * @param parser The parser
+ * @return The active section, data for a parser of declarations only, which has no sections
+ */
+sect_table_n currentSection(Parser* parser);
+
 /**
  * Adds an ld immediate/move instruction decomposition to the parser's list for quick access.
  * This allows the parser to keep track of all such instructions that may need to be decomposed later.
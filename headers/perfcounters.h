@@ -0,0 +1,64 @@
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <stdbool.h>
+
+
+// Per-phase hardware/software counters (`--perf-counters`), Linux only through perf_event_open
+// When hardware counters cannot be opened (virtual machines, perf_event_paranoid, ...),
+// the software counters (task-clock, page-faults) are still recorded
+// Counters are per thread, batch mode workers open their own with `initThreadPerfCounters` and all add to the same totals
+// All functions do nothing unless `initPerfCounters` succeeded
+
+typedef enum {
+	PHASE_LEX,
+	PHASE_PARSE,
+	PHASE_CODEGEN,
+	PHASE_WRITE,
+	PHASE_TEARDOWN,
+	PHASE_COUNT
+} asmPhase;
+
+/**
+ * Gets the display name of a phase.
+ * @param phase The phase
+ * @return The name of the phase
+ */
+const char* phaseName(asmPhase phase);
+
+/**
+ * Opens the counters for the calling thread.
+ * @return True if at least one counter could be opened
+ */
+bool initPerfCounters();
+/**
+ * Closes the counters of the calling thread and stops recording.
+ */
+void deinitPerfCounters();
+
+/**
+ * Opens the counters for a thread other than the one that called `initPerfCounters`.
+ */
+void initThreadPerfCounters();
+/**
+ * Closes the counters of the calling thread.
+ */
+void deinitThreadPerfCounters();
+
+/**
+ * Starts counting for a phase.
+ * @param phase The phase
+ */
+void perfBegin(asmPhase phase);
+/**
+ * Stops counting for a phase, adding what was counted since `perfBegin` to the phase's totals.
+ * @param phase The phase
+ */
+void perfEnd(asmPhase phase);
+
+/**
+ * Prints the totals of every phase to stderr.
+ */
+void displayPerfCounters();
+
+#endif
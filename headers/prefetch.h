@@ -0,0 +1,44 @@
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+#include <stdbool.h>
+
+#include "parser.h"
+#include "adecl.h"
+
+
+// Loading of included files ahead of the `.include` that needs them (`--include-threads`)
+// Before a source is parsed, its tokens are scanned for `.include "file"`, and the distinct files found are loaded
+// the way `loadADECL` does by worker threads, in the order they appear, while the source is parsed
+// Each file is loaded in a context of its own, which holds its diagnostics instead of reporting them
+// When the parse reaches the `.include`, it waits for the file if a worker is on it, loads it in place if no worker got to it yet,
+// or takes it over: the held diagnostics are reported then and there, and the memory of the file moves to the parse's context
+// The declarations and diagnostics are then the same as loading every file in place, in the same order
+// Files the parse never gets to (an error came first, a `.end`) are dropped along with their diagnostics
+// Only sources with several distinct includes are prefetched, and not with allocation hooks, which may not be safe from other threads
+// Not available on Windows
+
+
+/**
+ * Starts loading the files included by the parser's tokens, when there are enough of them and threads for them.
+ * Must be followed by `finishPrefetch` once the parse is done, whether it failed or not.
+ * @param parser The parser of a source, about to parse
+ */
+void startPrefetch(Parser* parser);
+/**
+ * Takes the declarations of an included file that was prefetched.
+ * Reports the diagnostics loading the file gave, an error returns to the outermost frame as if it happened while loading in place.
+ * @param parser The parser
+ * @param canonical The canonical path of the file
+ * @param context Receives the tables of the file, the way `loadADECL` fills them
+ * @param found Set to false if the file could not be opened
+ * @return False if the file was not loaded ahead, it is then up to the caller to load it in place
+ */
+bool takePrefetched(Parser* parser, const char* canonical, ADECL_ctx* context, bool* found);
+/**
+ * Waits for the workers and drops the files the parse did not take. Reports nothing, so it can be called after an error.
+ * @param parser The parser
+ */
+void finishPrefetch(Parser* parser);
+
+#endif
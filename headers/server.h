@@ -0,0 +1,39 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+
+// Persistent assembler process (`arxsm --server sock`) and the client forwarding command lines to it (`arxsm --client sock ...`)
+// The server listens on a Unix domain socket and runs the requests one after another, in the same process,
+// so that whatever the assembler keeps between assemblies stays warm
+// A request carries the working directory and the arguments of the client, along with its stdout and stderr as file descriptors
+// The server runs the command line in that directory, writing to those, then answers with the exit status
+// Nothing else of the client is forwarded, in particular not its environment
+// Not available on Windows
+
+/**
+ * Runs one forwarded command line.
+ * @param argc The number of arguments
+ * @param argv The arguments, argv[0] included
+ * @return The exit status of the command line
+ */
+typedef int (*requestHandler)(int argc, char const* argv[]);
+
+
+/**
+ * Serves requests until interrupted by SIGINT or SIGTERM, then removes the socket.
+ * A stale socket left by a server that is gone is replaced, a socket a server is still listening on is an error.
+ * @param path The path of the socket
+ * @param handler Runs each request
+ * @return The exit status of the server
+ */
+int runServer(const char* path, requestHandler handler);
+/**
+ * Forwards a command line to a server and waits for it to be ran.
+ * @param path The path of the server's socket
+ * @param argc The number of arguments
+ * @param argv The arguments as given to the client, argv[0] included
+ * @return The exit status of the request
+ */
+int runClient(const char* path, int argc, char const* argv[]);
+
+#endif
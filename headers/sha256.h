@@ -0,0 +1,40 @@
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// SHA-256 (FIPS 180-4), used to key the object cache (`--cache-dir`)
+// Data can be fed in pieces of any size, the digest only depends on the concatenation
+
+#define SHA256_DIGEST_LEN 32
+
+typedef struct SHA256 {
+	uint32_t state[8];
+	uint64_t length; // Bytes fed so far
+	uint8_t block[64]; // Bytes waiting for a full block
+	size_t blockLen;
+} sha256_t;
+
+
+/**
+ * Starts a new digest.
+ * @param sha The digest state
+ */
+void initSHA256(sha256_t* sha);
+/**
+ * Feeds data to a digest.
+ * @param sha The digest state
+ * @param data The data
+ * @param len The number of bytes
+ */
+void updateSHA256(sha256_t* sha, const void* data, size_t len);
+/**
+ * Finishes a digest. The state must be initialized again before reuse.
+ * @param sha The digest state
+ * @param digest Receives the digest
+ */
+void finalSHA256(sha256_t* sha, uint8_t digest[SHA256_DIGEST_LEN]);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+
+
+// Streaming of very large sources (`--stream`), the memory is bounded by the symbols rather than by the lines
+// The source is mapped and lexed a chunk of lines at a time, and the tokens and ASTs of a chunk are freed before the next one is lexed
+// The first pass only lays the source out: each chunk is parsed the way `-fsyntax-only` does, without the ld decompositions,
+// which gives the section sizes and every symbol. Only the ASTs and lines of the `.set` and `.def` statements outlive their chunk, the symbols and structs point into them
+// The second pass lexes the source again, and parses each chunk against the complete symbol table without declaring anything,
+// then generates its code and moves it out to temporary files, since the header that comes first needs the sizes and relocations
+// The object is the same as without `--stream`, and so are the diagnostics, except that:
+// the second pass does not repeat the warnings of the first, symbols only keep their first reference,
+// and the chunks before a line that fails to lex have already been parsed and reported on
+// A chunk does not end inside of a `.def`. After an error, nothing is freed until the end
+// Not available on Windows
+
+#define STREAM_CHUNK_LINES 4096
+
+
+/**
+ * Assembles a source in two passes, a chunk at a time.
+ * @param lexer A lexer without tokens
+ * @param parser A parser with its tables set, whose symbol table owns its sources (`ownsSources`)
+ * @param codegen The code generator of the same tables
+ * @param infile The source
+ * @param outfile The object to write
+ * @return ARX_FAILED if the source could not be assembled, the errors were reported through the context
+ */
+arxStatus streamFile(Lexer* lexer, Parser* parser, CodeGen* codegen, const char* infile, const char* outfile);
+
+#endif
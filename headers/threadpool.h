@@ -0,0 +1,107 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <stdbool.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+
+// Work-stealing pool used by batch mode (`arxsm -jN a.s b.s ...`)
+// Tasks are plain indices submitted before the pool runs, spread round robin over one deque per worker
+// A worker takes from the back of its own deque and, once it is empty, steals from the front of the others'
+// The pool returns once every task is done, there is no submitting while running
+// On Windows there are no workers, every task is ran on the calling thread
+
+#ifndef _WIN32
+typedef pthread_mutex_t mutex_t;
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define mutexInit(mutex) pthread_mutex_init(mutex, NULL)
+#define mutexDestroy(mutex) pthread_mutex_destroy(mutex)
+#define mutexLock(mutex) pthread_mutex_lock(mutex)
+#define mutexUnlock(mutex) pthread_mutex_unlock(mutex)
+typedef pthread_cond_t cond_t;
+#define condInit(cond) pthread_cond_init(cond, NULL)
+#define condDestroy(cond) pthread_cond_destroy(cond)
+#define condWait(cond, mutex) pthread_cond_wait(cond, mutex)
+#define condBroadcast(cond) pthread_cond_broadcast(cond)
+#else
+typedef int mutex_t;
+#define MUTEX_INITIALIZER 0
+#define mutexInit(mutex) ((void) (mutex))
+#define mutexDestroy(mutex) ((void) (mutex))
+#define mutexLock(mutex) ((void) (mutex))
+#define mutexUnlock(mutex) ((void) (mutex))
+typedef int cond_t;
+#define condInit(cond) ((void) (cond))
+#define condDestroy(cond) ((void) (cond))
+#define condWait(cond, mutex) ((void) (cond), (void) (mutex))
+#define condBroadcast(cond) ((void) (cond))
+#endif
+
+/**
+ * Runs a task.
+ * @param worker The index of the worker running the task, from 0 to the worker count
+ * @param task The task index that was submitted
+ * @param ctx The context given to `initThreadPool`
+ */
+typedef void (*taskFn)(int worker, int task, void* ctx);
+/**
+ * Called once on each worker's thread, before it runs its first task and after its last.
+ * @param worker The index of the worker
+ * @param ctx The context given to `initThreadPool`
+ */
+typedef void (*workerFn)(int worker, void* ctx);
+
+typedef struct TaskDeque {
+	int* tasks;
+	int head; // Next task to steal
+	int tail; // One past the next task to take
+	int capacity;
+	mutex_t lock;
+} TaskDeque;
+
+typedef struct ThreadPool {
+	int workerCount;
+	TaskDeque* deques;
+	int nextDeque; // Where the next submitted task goes
+
+	taskFn task;
+	workerFn workerStart;
+	workerFn workerEnd;
+	void* ctx;
+} ThreadPool;
+
+
+/**
+ * Initializes a pool of workers. No threads are started until `runThreadPool`.
+ * @param workerCount The number of workers, at least 1
+ * @param task The function running each task
+ * @param workerStart Called on each worker before its first task, can be NULL
+ * @param workerEnd Called on each worker after its last task, can be NULL
+ * @param ctx Passed to all of the above
+ * @return The pool
+ */
+ThreadPool* initThreadPool(int workerCount, taskFn task, workerFn workerStart, workerFn workerEnd, void* ctx);
+/**
+ * Frees the pool. It must not be running.
+ * @param pool The pool
+ */
+void deinitThreadPool(ThreadPool* pool);
+
+/**
+ * Queues a task to be ran by the next `runThreadPool`.
+ * @param pool The pool
+ * @param task The task index passed to the task function
+ */
+void submitTask(ThreadPool* pool, int task);
+
+/**
+ * Starts the workers and waits until all submitted tasks are done.
+ * The calling thread acts as worker 0.
+ * @param pool The pool
+ */
+void runThreadPool(ThreadPool* pool);
+
+#endif
@@ -1,8 +1,9 @@
 #ifndef _TOKEN_H_
 #define _TOKEN_H_
 
-#include "../common/lib/securedstring/libsecuredstring.h"
 #include "../common/lib/sds/sds.h"
+#include "allocator.h"
+#include "SourceMap.h"
 
 typedef enum {
 	TK_EOF,
@@ -82,14 +83,13 @@ typedef struct Token {
 	sds lexeme;
 	tokenType type;
 	int linenum;
-	SString* sstring;
+	srcloc_t loc; // The line of the token, its text is in the source map of the context
 } Token;
 
 static inline void deleteToken(Token* token);
 static inline void deleteToken(Token* token) {
 	if (token->lexeme) sdsfree(token->lexeme);
-	if (token->sstring) ssDestroySecuredString(token->sstring);
-	free(token);
+	memFree(token);
 }
 
 #endif
\ No newline at end of file
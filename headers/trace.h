@@ -0,0 +1,59 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdbool.h>
+
+
+// Timeline of the assembler's work in the Trace Event Format (`--trace-out`)
+// The output can be loaded in chrome://tracing or Perfetto
+// Spans are nested by calling `traceBegin`/`traceEnd` in pairs
+// An error going past a `traceEnd` leaves its span open, the frame or recovery point it returns to closes it (`traceUnwind`)
+// Every span belongs to the current track, each input being assembled gets its own track
+// The current track is per thread, so batch mode workers can record at the same time
+// All functions do nothing unless `initTrace` has been called
+
+/**
+ * Starts recording a trace to the given file.
+ * The file is finalized on `deinitTrace` or when the process exits.
+ * @param filename The file to write the trace to
+ */
+void initTrace(const char* filename);
+/**
+ * Finalizes and closes the trace file.
+ */
+void deinitTrace();
+
+/**
+ * Whether a trace is being recorded.
+ * @return True if `initTrace` was called
+ */
+bool traceEnabled();
+
+/**
+ * Starts a new track and makes it the current one of the calling thread. Spans it records afterwards appear under it.
+ * @param name The name to show for the track, usually the input file
+ */
+void traceSetTrack(const char* name);
+
+/**
+ * Opens a span on the current track.
+ * @param category The category of the span (phase, adecl, section, ...)
+ * @param fname The format string of the span name
+ */
+void traceBegin(const char* category, const char* fname, ...);
+/**
+ * Closes the most recently opened span on the current track.
+ */
+void traceEnd();
+/**
+ * Gets the number of spans open on the current thread.
+ * @return The depth, 0 when not recording
+ */
+int traceDepth();
+/**
+ * Closes the spans opened on the current thread past a depth.
+ * @param depth A depth from `traceDepth`
+ */
+void traceUnwind(int depth);
+
+#endif
@@ -4,37 +4,40 @@
 
 #include "DataTable.h"
 #include "diagnostics.h"
+#include "allocator.h"
 
 
 DataTable* initDataTable() {
-	DataTable* dataTable = (DataTable*) malloc(sizeof(DataTable));
+	DataTable* dataTable = (DataTable*) memAlloc(MEM_DATATAB, sizeof(DataTable));
 	if (!dataTable) emitError(ERR_MEM, NULL, "Could not allocate memory for data table!\n");
 
-	dataTable->dataEntries = (data_entry_t**) malloc(sizeof(data_entry_t*) * 5);
+	// The entries of a section are allocated with its first one
+
+	dataTable->dataEntries = NULL;
 	dataTable->dSize = 0;
-	dataTable->dCapacity = 5;
+	dataTable->dCapacity = 0;
 
-	dataTable->constEntries = (data_entry_t**) malloc(sizeof(data_entry_t*) * 5);
+	dataTable->constEntries = NULL;
 	dataTable->cSize = 0;
-	dataTable->cCapacity = 5;
+	dataTable->cCapacity = 0;
 
-	dataTable->bssEntries = (data_entry_t**) malloc(sizeof(data_entry_t*) * 5);
+	dataTable->bssEntries = NULL;
 	dataTable->bSize = 0;
-	dataTable->bCapacity = 5;
+	dataTable->bCapacity = 0;
 
-	dataTable->evtEntries = (data_entry_t**) malloc(sizeof(data_entry_t*) * 5);
+	dataTable->evtEntries = NULL;
 	dataTable->eSize = 0;
-	dataTable->eCapacity = 5;
+	dataTable->eCapacity = 0;
 
-	dataTable->ivtEntries = (data_entry_t**) malloc(sizeof(data_entry_t*) * 5);
+	dataTable->ivtEntries = NULL;
 	dataTable->iSize = 0;
-	dataTable->iCapacity = 5;
+	dataTable->iCapacity = 0;
 
 	return dataTable;
 }
 
-data_entry_t* initDataEntry(data_t type, uint32_t addr, uint32_t size, Node** data, int dataCount, int dataCapacity) {
-	data_entry_t* dataEntry = (data_entry_t*) malloc(sizeof(data_entry_t));
+data_entry_t* initDataEntry(data_t type, uint32_t addr, uint32_t size, Node** data, size_t dataCount, size_t dataCapacity) {
+	data_entry_t* dataEntry = (data_entry_t*) memAlloc(MEM_DATATAB, sizeof(data_entry_t));
 	if (!dataEntry) emitError(ERR_MEM, NULL, "Could not allocate space for data entry!\n");
 
 	dataEntry->type = type;
@@ -45,21 +48,20 @@ data_entry_t* initDataEntry(data_t type, uint32_t addr, uint32_t size, Node** da
 	dataEntry->dataCount = dataCount;
 	dataEntry->dataCapacity = dataCapacity;
 
-	// The source line string and line number is in a node, get it from the first node
+	// The location of the line is in a node, get it from the first node
 	Node* firstNode = data[0];
 	// This should not happen as the array must always be at least of size 1
 	if (!firstNode) emitError(ERR_INTERNAL, NULL, "Data entry has no data nodes!\n");
 
-	dataEntry->source = ssCreateSecuredString(ssGetString(firstNode->token->sstring));
-	dataEntry->linenum = firstNode->token->linenum;
+	dataEntry->loc = firstNode->loc;
 
 	return dataEntry;
 }
 
 void addDataEntry(DataTable* dataTable, data_entry_t* dataEntry, data_sect_t sectType) {
 	data_entry_t*** entries = NULL;
-	uint32_t* size = 0;
-	uint32_t* capacity = 0;
+	size_t* size = NULL;
+	size_t* capacity = NULL;
 
 	trace("Detected section to add for: %d\n", sectType);
 	if (sectType == DATA_SECT) {
@@ -84,23 +86,12 @@ void addDataEntry(DataTable* dataTable, data_entry_t* dataEntry, data_sect_t sec
 		capacity = &dataTable->iCapacity;
 	}	else return;
 
-	if (*size == *capacity) {
-		*capacity *= 2;
-
-		data_entry_t** temp = (data_entry_t**) realloc(*entries, sizeof(data_entry_t*) * (*capacity));
-		if (!temp) emitError(ERR_MEM, NULL, "Could not reallocate memory for data entries!\n");
-
-		*entries = temp;
-	}
-
-	int idx = *size;
-	(*entries)[idx] = dataEntry;
-	*size = *size + 1;
+	pushDataEntries(entries, size, capacity, dataEntry);
 }
 
 data_entry_t* getDataEntry(DataTable* dataTable, data_sect_t sectType, uint32_t addr) {
 	data_entry_t** entries = NULL;
-	uint32_t size = 0;
+	size_t size = 0;
 
 	if (sectType == DATA_SECT) { entries = dataTable->dataEntries; size = dataTable->dSize; }
 	else if (sectType == CONST_SECT) { entries = dataTable->constEntries; size = dataTable->cSize; }
@@ -110,7 +101,7 @@ data_entry_t* getDataEntry(DataTable* dataTable, data_sect_t sectType, uint32_t
 	else return NULL;
 
 
-	for (int i = 0; i < size; i++) {
+	for (size_t i = 0; i < size; i++) {
 		data_entry_t* entry = entries[i];
 
 		if (entry->addr == addr) return entry;
@@ -139,9 +130,10 @@ static void displayDataEntry(data_entry_t* dataEntry) {
 	rtrace("Addr:   0x%08x", dataEntry->addr);
 	rtrace("Size:   %-6u bytes", dataEntry->size);
 	rtrace("Type:   %-8s", typeToString(dataEntry->type));
-	rtrace("Line:   %-5d", dataEntry->linenum);
-	rtrace("Source: %s", ssGetString(dataEntry->source));
-	rtrace("Data count: %d", dataEntry->dataCount);
+	const char* source = sourceLine(dataEntry->loc);
+	rtrace("Line:   %-5d", lineNumber(dataEntry->loc));
+	rtrace("Source: %s", source ? source : "(unknown)");
+	rtrace("Data count: %zu", dataEntry->dataCount);
 	rtrace("--------------------------------------------\n");
 	// TODO: Print the actual data represented by the AST nodes
 	// This can only be done when the AST nodes are evaluated/resolved into actual values
@@ -157,17 +149,18 @@ void displayDataTable(DataTable* dataTable) {
 	data_entry_t** entriesArr[] = {
 		dataTable->dataEntries, dataTable->constEntries, dataTable->bssEntries, dataTable->evtEntries, dataTable->ivtEntries
 	};
-	uint32_t sizes[] = {dataTable->dSize, dataTable->cSize, dataTable->bSize, dataTable->eSize, dataTable->iSize};
+	size_t sizes[] = {dataTable->dSize, dataTable->cSize, dataTable->bSize, dataTable->eSize, dataTable->iSize};
 
 	for (int s = 0; s < 5; ++s) {
 		rtrace("\n==================== %-5s Section ====================", sectionNames[s]);
-		rtrace("Total Entries: %u", sizes[s]);
+		rtrace("Total Entries: %zu", sizes[s]);
 		rtrace("-----------------------------------------------------------------------------------------------------");
 		rtrace("| %-4s | %-10s | %-12s | %-10s | %-6s | %-40s |", "#", "Address", "Size (bytes)", "Type", "Line", "Source");
 		rtrace("-----------------------------------------------------------------------------------------------------");
-		for (uint32_t i = 0; i < sizes[s]; ++i) {
+		for (size_t i = 0; i < sizes[s]; ++i) {
 			data_entry_t* entry = entriesArr[s][i];
-			const char* src = ssGetString(entry->source);
+			const char* src = sourceLine(entry->loc);
+			if (!src) src = "(unknown)";
 			char truncated[41];
 			int len = strlen(src);
 			if (len > 40) {
@@ -178,56 +171,58 @@ void displayDataTable(DataTable* dataTable) {
 				truncated[40] = '\0';
 				src = truncated;
 			}
-			rtrace("| %-4u | 0x%08x | %-12u | %-10s | %-6d | %-40s |", i, entry->addr, entry->size, typeToString(entry->type), entry->linenum, src);
+			rtrace("| %-4zu | 0x%08x | %-12u | %-10s | %-6d | %-40s |", i, entry->addr, entry->size, typeToString(entry->type), lineNumber(entry->loc), src);
 		}
 		rtrace("-----------------------------------------------------------------------------------------------------\n");
 		// Print details for each entry after the overview table
-		for (uint32_t i = 0; i < sizes[s]; ++i) {
+		for (size_t i = 0; i < sizes[s]; ++i) {
 			displayDataEntry(entriesArr[s][i]);
 		}
 	}
 }
 
-void deinitDataTable(DataTable* dataTable) {
-	for (int i = 0; i < dataTable->dSize; i++) {
-		data_entry_t* entry = dataTable->dataEntries[i];
+// The entries own their data array, the nodes in it belong to the parser
+static void freeDataEntries(data_entry_t** entries, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		data_entry_t* entry = entries[i];
 
-		if (entry->source) free(entry->source);
-		free(entry);
+		freeNodeArray(entry->data);
+		memFree(entry);
 	}
-	free(dataTable->dataEntries);
+}
 
-	for (int i = 0; i < dataTable->cSize; i++) {
-		data_entry_t* entry = dataTable->constEntries[i];
+void deinitDataTable(DataTable* dataTable) {
+	freeDataEntries(dataTable->dataEntries, dataTable->dSize);
+	memFree(dataTable->dataEntries);
 
-		if (entry->source) free(entry->source);
-		free(entry);
-	}
-	free(dataTable->constEntries);
+	freeDataEntries(dataTable->constEntries, dataTable->cSize);
+	memFree(dataTable->constEntries);
 
-	for (int i = 0; i < dataTable->bSize; i++) {
-		data_entry_t* entry = dataTable->bssEntries[i];
+	freeDataEntries(dataTable->bssEntries, dataTable->bSize);
+	memFree(dataTable->bssEntries);
 
-		if (entry->source) free(entry->source);
-		free(entry);
-	}
-	free(dataTable->bssEntries);
+	freeDataEntries(dataTable->evtEntries, dataTable->eSize);
+	memFree(dataTable->evtEntries);
 
-	for (int i = 0; i < dataTable->eSize; i++) {
-		data_entry_t* entry = dataTable->evtEntries[i];
+	freeDataEntries(dataTable->ivtEntries, dataTable->iSize);
+	memFree(dataTable->ivtEntries);
 
-		if (entry->source) free(entry->source);
-		free(entry);
-	}
-	free(dataTable->evtEntries);
+	memFree(dataTable);
+}
 
-	for (int i = 0; i < dataTable->iSize; i++) {
-		data_entry_t* entry = dataTable->ivtEntries[i];
+void resetDataTable(DataTable* dataTable) {
+	freeDataEntries(dataTable->dataEntries, dataTable->dSize);
+	dataTable->dSize = 0;
 
-		if (entry->source) free(entry->source);
-		free(entry);
-	}
-	free(dataTable->ivtEntries);
+	freeDataEntries(dataTable->constEntries, dataTable->cSize);
+	dataTable->cSize = 0;
 
-	free(dataTable);
+	freeDataEntries(dataTable->bssEntries, dataTable->bSize);
+	dataTable->bSize = 0;
+
+	freeDataEntries(dataTable->evtEntries, dataTable->eSize);
+	dataTable->eSize = 0;
+
+	freeDataEntries(dataTable->ivtEntries, dataTable->iSize);
+	dataTable->iSize = 0;
 }
\ No newline at end of file
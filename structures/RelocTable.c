@@ -2,40 +2,65 @@
 
 #include "RelocTable.h"
 #include "diagnostics.h"
+#include "allocator.h"
 
 
 RelocTable* initRelocTable() {
-	RelocTable* relocTable = (RelocTable*) malloc(sizeof(RelocTable));
+	RelocTable* relocTable = (RelocTable*) memAlloc(MEM_RELOC, sizeof(RelocTable));
 	if (!relocTable) emitError(ERR_MEM, NULL, "Failed to allocate memory for relocation table.");
 
-	relocTable->textRelocTable.entries = (RelocEnt**) malloc(sizeof(RelocEnt*) * 4);
-	if (!relocTable->textRelocTable.entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for text relocation entries.");
+	// Most sections have no relocations, their entries are allocated with the first one
+
+	relocTable->textRelocTable.entries = NULL;
 	relocTable->textRelocTable.entryCount = 0;
-	relocTable->textRelocTable.entryCapacity = 4;
+	relocTable->textRelocTable.entryCapacity = 0;
 
-	relocTable->dataRelocTable.entries = (RelocEnt**) malloc(sizeof(RelocEnt*) * 4);
-	if (!relocTable->dataRelocTable.entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for data relocation entries.");
+	relocTable->dataRelocTable.entries = NULL;
 	relocTable->dataRelocTable.entryCount = 0;
-	relocTable->dataRelocTable.entryCapacity = 4;
+	relocTable->dataRelocTable.entryCapacity = 0;
 
-	relocTable->constRelocTable.entries = (RelocEnt**) malloc(sizeof(RelocEnt*) * 4);
-	if (!relocTable->constRelocTable.entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for const relocation entries.");
+	relocTable->constRelocTable.entries = NULL;
 	relocTable->constRelocTable.entryCount = 0;
-	relocTable->constRelocTable.entryCapacity = 4;
+	relocTable->constRelocTable.entryCapacity = 0;
 
-	relocTable->evtRelocTable.entries = (RelocEnt**) malloc(sizeof(RelocEnt*) * 4);
-	if (!relocTable->evtRelocTable.entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for evt relocation entries.");
+	relocTable->evtRelocTable.entries = NULL;
 	relocTable->evtRelocTable.entryCount = 0;
-	relocTable->evtRelocTable.entryCapacity = 4;
+	relocTable->evtRelocTable.entryCapacity = 0;
 
 	return relocTable;
 }
+static void freeRelocEntries(RelocEnt** entries, size_t entryCount) {
+	for (size_t i = 0; i < entryCount; i++) {
+		memFree(entries[i]);
+	}
+}
+
 void deinitRelocTable(RelocTable* relocTable) {
+	resetRelocTable(relocTable);
+
+	memFree(relocTable->textRelocTable.entries);
+	memFree(relocTable->dataRelocTable.entries);
+	memFree(relocTable->constRelocTable.entries);
+	memFree(relocTable->evtRelocTable.entries);
+	memFree(relocTable);
+}
+
+void resetRelocTable(RelocTable* relocTable) {
+	freeRelocEntries(relocTable->textRelocTable.entries, relocTable->textRelocTable.entryCount);
+	relocTable->textRelocTable.entryCount = 0;
+
+	freeRelocEntries(relocTable->dataRelocTable.entries, relocTable->dataRelocTable.entryCount);
+	relocTable->dataRelocTable.entryCount = 0;
 
+	freeRelocEntries(relocTable->constRelocTable.entries, relocTable->constRelocTable.entryCount);
+	relocTable->constRelocTable.entryCount = 0;
+
+	freeRelocEntries(relocTable->evtRelocTable.entries, relocTable->evtRelocTable.entryCount);
+	relocTable->evtRelocTable.entryCount = 0;
 }
 
 RelocEnt* initRelocEntry(uint32_t offset, uint32_t symbolIdx, reloc_type_t type, int32_t addend) {
-	RelocEnt* entry = (RelocEnt*) malloc(sizeof(RelocEnt));
+	RelocEnt* entry = (RelocEnt*) memAlloc(MEM_RELOC, sizeof(RelocEnt));
 	if (!entry) emitError(ERR_MEM, NULL, "Failed to allocate memory for relocation entry.");
 
 	entry->offset = offset;
@@ -48,8 +73,8 @@ RelocEnt* initRelocEntry(uint32_t offset, uint32_t symbolIdx, reloc_type_t type,
 
 void addRelocEntry(RelocTable* relocTable, uint8_t section, RelocEnt* entry) {
 	RelocEnt*** entries = NULL;
-	uint32_t* entryCount = NULL;
-	uint32_t* entryCapacity = NULL;
+	size_t* entryCount = NULL;
+	size_t* entryCapacity = NULL;
 
 	switch (section) {
 		case 0: // Data section
@@ -77,14 +102,7 @@ void addRelocEntry(RelocTable* relocTable, uint8_t section, RelocEnt* entry) {
 			break;
 	}
 
-	if (*entryCount == *entryCapacity) {
-		*entryCapacity = (*entryCapacity == 0) ? 4 : (*entryCapacity * 2);
-		RelocEnt** temp = (RelocEnt**) realloc(*entries, sizeof(RelocEnt*) * (*entryCapacity));
-		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for relocation entries.");
-		*entries = temp;
-	}
-	(*entries)[*entryCount] = entry;
-	(*entryCount)++;
+	pushRelocEntries(entries, entryCount, entryCapacity, entry);
 	log("Added relocation entry at offset 0x%08x in section %d", entry->offset, section);
 }
 
@@ -111,7 +129,7 @@ void displayRelocTable(RelocTable* relocTable) {
 		relocTable->textRelocTable.entries,
 		relocTable->evtRelocTable.entries
 	};
-	uint32_t sizes[] = {
+	size_t sizes[] = {
 		relocTable->dataRelocTable.entryCount,
 		relocTable->constRelocTable.entryCount,
 		relocTable->textRelocTable.entryCount,
@@ -120,20 +138,20 @@ void displayRelocTable(RelocTable* relocTable) {
 
 	for (int s = 0; s < 4; ++s) {
 		rtrace("\n================== %-5s Relocation Section ==================", sectionNames[s]);
-		rtrace("Total Entries: %u", sizes[s]);
+		rtrace("Total Entries: %zu", sizes[s]);
 		rtrace("--------------------------------------------------------------------");
 		rtrace("| %-4s | %-12s | %-10s | %-8s | %-8s |", "#", "Offset", "SymbolIdx", "Type", "Addend");
 		rtrace("--------------------------------------------------------------------");
-		for (uint32_t i = 0; i < sizes[s]; ++i) {
+		for (size_t i = 0; i < sizes[s]; ++i) {
 			RelocEnt* entry = entriesArr[s][i];
-			rtrace("| %-4u | 0x%08x  | %-10u | %-8s | %-8d |",
+			rtrace("| %-4zu | 0x%08x  | %-10u | %-8s | %-8d |",
 				i, entry->offset, entry->symbolIdx, relocTypeToString(entry->type), entry->addend);
 		}
 		rtrace("--------------------------------------------------------------------\n");
 
-		for (uint32_t i = 0; i < sizes[s]; ++i) {
+		for (size_t i = 0; i < sizes[s]; ++i) {
 			RelocEnt* e = entriesArr[s][i];
-			rtrace("Reloc #%u -> Offset: 0x%08x, SymbolIdx: %u, Type: %s, Addend: %d",
+			rtrace("Reloc #%zu -> Offset: 0x%08x, SymbolIdx: %u, Type: %s, Addend: %d",
 				i, e->offset, e->symbolIdx, relocTypeToString(e->type), e->addend);
 		}
 	}
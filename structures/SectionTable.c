@@ -3,10 +3,11 @@
 
 #include "SectionTable.h"
 #include "diagnostics.h"
+#include "allocator.h"
 
 
 SectionTable* initSectionTable() {
-	SectionTable* sectTable = (SectionTable*) malloc(sizeof(SectionTable));
+	SectionTable* sectTable = (SectionTable*) memAlloc(MEM_SYMTAB, sizeof(SectionTable));
 	if (!sectTable) emitError(ERR_MEM, NULL, "Could not allocate memory for section table!\n");
 
 	for (int i = 0; i < IVT_SECT_N+1; i++) {
@@ -45,5 +46,20 @@ void displaySectionTable(SectionTable* sectTable) {
 }
 
 void deinitSectionTable(SectionTable* sectTable) {
-	free(sectTable);
-}
\ No newline at end of file
+	memFree(sectTable);
+}
+
+void resetSectionTable(SectionTable* sectTable) {
+	for (int i = 0; i < IVT_SECT_N+1; i++) {
+		sectTable->entries[i].lp = 0x00000000;
+		sectTable->entries[i].size = 0x00000000;
+	}
+	sectTable->activeSection = 0;
+}
+
+void advanceLP(SectionTable* sectTable, size_t size, linedata_ctx* linedata) {
+	section_entry_t* entry = &sectTable->entries[sectTable->activeSection];
+	if (size > UINT32_MAX - entry->lp) emitError(ERR_INVALID_SIZE, linedata, "The section goes past the 4 GiB an AOEFF section can hold.");
+
+	entry->lp += (uint32_t) size;
+}
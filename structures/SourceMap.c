@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "SourceMap.h"
+#include "context.h"
+#include "allocator.h"
+
+// Most lines and names are short, a block holds a few hundred of them
+#define SRC_BLOCK_SIZE 16384
+
+
+static void freeBlocks(src_block_t* block) {
+	while (block) {
+		src_block_t* next = block->next;
+		memFree(block);
+		block = next;
+	}
+}
+
+static const char* copyText(src_block_t** blocks, const char* text) {
+	uint32_t len = (uint32_t) strlen(text) + 1;
+
+	src_block_t* block = *blocks;
+	if (!block || block->size - block->used < len) {
+		uint32_t size = len > SRC_BLOCK_SIZE ? len : SRC_BLOCK_SIZE;
+		block = (src_block_t*) memAlloc(MEM_STRINGS, sizeof(src_block_t) + size);
+		if (!block) emitError(ERR_MEM, NULL, "Failed to allocate memory for source text.");
+		block->used = 0;
+		block->size = size;
+		block->next = *blocks;
+		*blocks = block;
+	}
+
+	char* copy = block->text + block->used;
+	memcpy(copy, text, len);
+	block->used += len;
+
+	return copy;
+}
+
+static void freeFile(src_file_t* file) {
+	memFree(file->lines);
+	memFree(file->segments);
+	freeBlocks(file->blocks);
+	memFree(file);
+}
+
+void resetSourceMap(SourceMap* map) {
+	for (uint32_t i = 0; i < map->fileCapacity; i++) {
+		if (map->files[i]) freeFile(map->files[i]);
+	}
+	memFree(map->files);
+	memFree(map->segments);
+	memFree(map->kept);
+	memFree(map->names);
+	freeBlocks(map->blocks);
+
+	*map = (SourceMap) { .numbering = map->numbering };
+}
+
+void shareSourceNumbering(SourceMap* map, SourceMap* numbering) {
+	map->numbering = numbering;
+}
+
+static void reserveFiles(SourceMap* map, uint32_t number) {
+	if (number < map->fileCapacity) return;
+
+	uint32_t capacity = map->fileCapacity ? map->fileCapacity : 4;
+	while (capacity <= number) capacity *= 2;
+	src_file_t** temp = (src_file_t**) memRealloc(MEM_STRINGS, map->files, sizeof(src_file_t*) * capacity);
+	if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for source files.");
+	memset(temp + map->fileCapacity, 0, sizeof(src_file_t*) * (capacity - map->fileCapacity));
+	map->files = temp;
+	map->fileCapacity = capacity;
+}
+
+static void reserveSegments(SourceMap* map, uint32_t number) {
+	if (number < map->segmentCapacity) return;
+
+	uint32_t capacity = map->segmentCapacity ? map->segmentCapacity : 16;
+	while (capacity <= number) capacity *= 2;
+	src_segment_t* temp = (src_segment_t*) memRealloc(MEM_STRINGS, map->segments, sizeof(src_segment_t) * capacity);
+	if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for source segments.");
+	memset(temp + map->segmentCapacity, 0, sizeof(src_segment_t) * (capacity - map->segmentCapacity));
+	map->segments = temp;
+	map->segmentCapacity = capacity;
+}
+
+uint32_t addSourceFile(SourceMap* map) {
+	SourceMap* numbering = map->numbering ? map->numbering : map;
+	uint32_t number = __atomic_add_fetch(&numbering->lastFile, 1, __ATOMIC_RELAXED);
+
+	reserveFiles(map, number);
+
+	src_file_t* file = (src_file_t*) memCalloc(MEM_STRINGS, 1, sizeof(src_file_t));
+	if (!file) emitError(ERR_MEM, NULL, "Failed to allocate memory for a source file.");
+	map->files[number] = file;
+
+	return number;
+}
+
+srcloc_t sourceLoc(SourceMap* map, uint32_t number, int line) {
+	if (line < 0) return NO_LOC;
+
+	src_file_t* file = map->files[number];
+	int index = line >> SRC_SEGMENT_BITS;
+	if (index >= file->segmentCount) {
+		int count = index + 1;
+		uint32_t* temp = (uint32_t*) memRealloc(MEM_STRINGS, file->segments, sizeof(uint32_t) * count);
+		if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for source segments.");
+		memset(temp + file->segmentCount, 0, sizeof(uint32_t) * (count - file->segmentCount));
+		file->segments = temp;
+		file->segmentCount = count;
+	}
+
+	if (!file->segments[index]) {
+		SourceMap* numbering = map->numbering ? map->numbering : map;
+		uint32_t segment = __atomic_add_fetch(&numbering->lastSegment, 1, __ATOMIC_RELAXED);
+		if (segment > SRC_MAX_SEGMENTS) emitError(ERR_UNSUPPORTED, NULL, "The sources of an assembly cannot have more than %u segments of %d lines.", SRC_MAX_SEGMENTS, SRC_SEGMENT_LINES);
+
+		reserveSegments(map, segment);
+		map->segments[segment] = (src_segment_t) { .file = number, .firstLine = index << SRC_SEGMENT_BITS };
+		file->segments[index] = segment;
+	}
+
+	return (file->segments[index] << SRC_SEGMENT_BITS) | ((uint32_t) line & (SRC_SEGMENT_LINES - 1));
+}
+
+srcloc_t addSourceLine(SourceMap* map, uint32_t number, int line, const char* text) {
+	srcloc_t loc = sourceLoc(map, number, line);
+
+	src_file_t* file = map->files[number];
+	if (file->lineCount == 0) file->firstLine = line;
+
+	// Lines going back are only kept on their own
+	int index = line - file->firstLine;
+	if (index < 0) {
+		keepSourceLine(map, loc, text);
+		return loc;
+	}
+
+	if (index >= file->lineCapacity) {
+		int capacity = file->lineCapacity ? file->lineCapacity : 256;
+		while (capacity <= index) capacity *= 2;
+		const char** temp = (const char**) memRealloc(MEM_STRINGS, file->lines, sizeof(const char*) * capacity);
+		if (!temp) emitError(ERR_MEM, NULL, "Failed to allocate memory for source lines.");
+		file->lines = temp;
+		file->lineCapacity = capacity;
+	}
+	for (int i = file->lineCount; i < index; i++) file->lines[i] = NULL;
+
+	file->lines[index] = copyText(&file->blocks, text);
+	if (index >= file->lineCount) file->lineCount = index + 1;
+
+	return loc;
+}
+
+static uint32_t hashLoc(srcloc_t loc) {
+	return loc * 2654435761u;
+}
+
+static kept_line_t* findKept(SourceMap* map, srcloc_t loc) {
+	if (!map->kept) return NULL;
+
+	uint32_t mask = map->keptCapacity - 1;
+	for (uint32_t slot = hashLoc(loc) & mask; map->kept[slot].loc; slot = (slot + 1) & mask) {
+		if (map->kept[slot].loc == loc) return &map->kept[slot];
+	}
+
+	return NULL;
+}
+
+static void insertKept(SourceMap* map, srcloc_t loc, const char* text) {
+	if ((map->keptCount + 1) * 2 > map->keptCapacity) {
+		uint32_t capacity = map->keptCapacity ? map->keptCapacity * 2 : 64;
+		kept_line_t* kept = (kept_line_t*) memCalloc(MEM_STRINGS, capacity, sizeof(kept_line_t));
+		if (!kept) emitError(ERR_MEM, NULL, "Failed to allocate memory for kept source lines.");
+
+		for (uint32_t i = 0; i < map->keptCapacity; i++) {
+			if (!map->kept[i].loc) continue;
+			uint32_t slot = hashLoc(map->kept[i].loc) & (capacity - 1);
+			while (kept[slot].loc) slot = (slot + 1) & (capacity - 1);
+			kept[slot] = map->kept[i];
+		}
+		memFree(map->kept);
+		map->kept = kept;
+		map->keptCapacity = capacity;
+	}
+
+	uint32_t mask = map->keptCapacity - 1;
+	uint32_t slot = hashLoc(loc) & mask;
+	while (map->kept[slot].loc) slot = (slot + 1) & mask;
+	map->kept[slot] = (kept_line_t) { .loc = loc, .text = text };
+	map->keptCount++;
+}
+
+static src_segment_t* findSegment(SourceMap* map, srcloc_t loc) {
+	uint32_t segment = loc >> SRC_SEGMENT_BITS;
+	if (segment >= map->segmentCapacity || !map->segments[segment].file) return NULL;
+
+	return &map->segments[segment];
+}
+
+static int segmentLine(src_segment_t* segment, srcloc_t loc) {
+	return segment->firstLine + (int) (loc & (SRC_SEGMENT_LINES - 1));
+}
+
+static const char* fileLine(SourceMap* map, srcloc_t loc) {
+	src_segment_t* segment = findSegment(map, loc);
+	if (!segment || segment->file >= map->fileCapacity || !map->files[segment->file]) return NULL;
+
+	src_file_t* file = map->files[segment->file];
+	int index = segmentLine(segment, loc) - file->firstLine;
+	if (index < 0 || index >= file->lineCount) return NULL;
+
+	return file->lines[index];
+}
+
+void keepSourceLine(SourceMap* map, srcloc_t loc, const char* text) {
+	if (loc == NO_LOC || findKept(map, loc)) return;
+
+	if (!text) text = fileLine(map, loc);
+	if (!text) return;
+
+	insertKept(map, loc, copyText(&map->blocks, text));
+}
+
+void dropSourceLines(SourceMap* map, uint32_t number) {
+	src_file_t* file = map->files[number];
+
+	// The first block is reused
+	src_block_t* block = file->blocks;
+	if (block) {
+		freeBlocks(block->next);
+		block->next = NULL;
+		block->used = 0;
+	}
+	file->lineCount = 0;
+}
+
+void adoptSourceMap(SourceMap* map, SourceMap* from) {
+	for (uint32_t i = 0; i < from->fileCapacity; i++) {
+		if (!from->files[i]) continue;
+
+		reserveFiles(map, i);
+		map->files[i] = from->files[i];
+	}
+	for (uint32_t i = 0; i < from->segmentCapacity; i++) {
+		if (!from->segments[i].file) continue;
+
+		reserveSegments(map, i);
+		map->segments[i] = from->segments[i];
+	}
+
+	// The text stays in the blocks it is in, which come along
+	for (uint32_t i = 0; i < from->keptCapacity; i++) {
+		if (from->kept[i].loc && !findKept(map, from->kept[i].loc)) insertKept(map, from->kept[i].loc, from->kept[i].text);
+	}
+	if (from->blocks) {
+		src_block_t* last = from->blocks;
+		while (last->next) last = last->next;
+		last->next = map->blocks;
+		map->blocks = from->blocks;
+	}
+
+	memFree(from->files);
+	memFree(from->segments);
+	memFree(from->kept);
+	memFree(from->names);
+	*from = (SourceMap) { .numbering = from->numbering };
+}
+
+const char* sourceLine(srcloc_t loc) {
+	ArxAssembler* as = arxCurrent();
+	if (!as || loc == NO_LOC) return NULL;
+
+	const char* text = fileLine(&as->sources, loc);
+	if (text) return text;
+
+	kept_line_t* kept = findKept(&as->sources, loc);
+	return kept ? kept->text : NULL;
+}
+
+int lineNumber(srcloc_t loc) {
+	ArxAssembler* as = arxCurrent();
+	if (!as || loc == NO_LOC) return 0;
+
+	src_segment_t* segment = findSegment(&as->sources, loc);
+	return segment ? segmentLine(segment, loc) : 0;
+}
+
+linedata_ctx lineAt(srcloc_t loc) {
+	return (linedata_ctx) {
+		.linenum = lineNumber(loc),
+		.source = sourceLine(loc)
+	};
+}
+
+static uint32_t hashName(const char* name) {
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619u;
+
+	return hash;
+}
+
+const char* internName(const char* name) {
+	SourceMap* map = &arxCurrent()->sources;
+
+	if ((map->nameCount + 1) * 2 > map->nameCapacity) {
+		uint32_t capacity = map->nameCapacity ? map->nameCapacity * 2 : 256;
+		const char** names = (const char**) memCalloc(MEM_STRINGS, capacity, sizeof(const char*));
+		if (!names) emitError(ERR_MEM, NULL, "Failed to allocate memory for names.");
+
+		for (uint32_t i = 0; i < map->nameCapacity; i++) {
+			if (!map->names[i]) continue;
+			uint32_t slot = hashName(map->names[i]) & (capacity - 1);
+			while (names[slot]) slot = (slot + 1) & (capacity - 1);
+			names[slot] = map->names[i];
+		}
+		memFree(map->names);
+		map->names = names;
+		map->nameCapacity = capacity;
+	}
+
+	uint32_t mask = map->nameCapacity - 1;
+	uint32_t slot = hashName(name) & mask;
+	while (map->names[slot]) {
+		if (strcmp(map->names[slot], name) == 0) return map->names[slot];
+		slot = (slot + 1) & mask;
+	}
+
+	const char* copy = copyText(&map->blocks, name);
+	map->names[slot] = copy;
+	map->nameCount++;
+
+	return copy;
+}
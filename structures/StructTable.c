@@ -3,13 +3,14 @@
 
 #include "StructTable.h"
 #include "diagnostics.h"
+#include "allocator.h"
 
 
 StructTable* initStructTable() {
-	StructTable* structTable = (StructTable*) malloc(sizeof(StructTable));
+	StructTable* structTable = (StructTable*) memAlloc(MEM_SYMTAB, sizeof(StructTable));
 	if (!structTable) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct table.");
 
-	structTable->structs = (struct_root_t**) malloc(sizeof(struct_root_t*) * 4);
+	structTable->structs = (struct_root_t**) memAlloc(MEM_SYMTAB, sizeof(struct_root_t*) * 4);
 	if (!structTable->structs) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct table entries.");
 
 	structTable->size = 0;
@@ -22,20 +23,27 @@ void deinitStructTable(StructTable* structTable) {
 	for (int i = 0; i < structTable->size; i++) {
 		deinitStruct(structTable->structs[i]);
 	}
-	free(structTable->structs);
-	free(structTable);
+	memFree(structTable->structs);
+	memFree(structTable);
+}
+
+void resetStructTable(StructTable* structTable) {
+	for (int i = 0; i < structTable->size; i++) {
+		deinitStruct(structTable->structs[i]);
+	}
+	structTable->size = 0;
 }
 
 struct_root_t* initStruct(const char* name) {
-	struct_root_t* structDef = (struct_root_t*) malloc(sizeof(struct_root_t));
+	struct_root_t* structDef = (struct_root_t*) memAlloc(MEM_SYMTAB, sizeof(struct_root_t));
 	if (!structDef) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct definition.");
 
-	structDef->name = strdup(name);
+	structDef->name = memStrdup(MEM_SYMTAB, name);
 	if (!structDef->name) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct name.");
 
 	structDef->size = 0;
 
-	structDef->fields = (struct_field_t**) malloc(sizeof(struct_field_t*) * 4);
+	structDef->fields = (struct_field_t**) memAlloc(MEM_SYMTAB, sizeof(struct_field_t*) * 4);
 	if (!structDef->fields) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct fields.");
 	structDef->fieldCount = 0;
 	structDef->fieldCapacity = 4;
@@ -47,16 +55,16 @@ void deinitStruct(struct_root_t* structDef) {
 	for (int i = 0; i < structDef->fieldCount; i++) {
 		deinitStructField(structDef->fields[i]);
 	}
-	free(structDef->fields);
-	free(structDef->name);
-	free(structDef);
+	memFree(structDef->fields);
+	memFree(structDef->name);
+	memFree(structDef);
 }
 
 struct_field_t* initStructField(const char* name, structFieldType type, int size, int offset, int structTypeIdx) {
-	struct_field_t* field = (struct_field_t*) malloc(sizeof(struct_field_t));
+	struct_field_t* field = (struct_field_t*) memAlloc(MEM_SYMTAB, sizeof(struct_field_t));
 	if (!field) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct field.");
 
-	field->name = strdup(name);
+	field->name = memStrdup(MEM_SYMTAB, name);
 	if (!field->name) emitError(ERR_MEM, NULL, "Failed to allocate memory for struct field name.");
 	field->type = type;
 	field->size = size;
@@ -67,14 +75,14 @@ struct_field_t* initStructField(const char* name, structFieldType type, int size
 }
 
 void deinitStructField(struct_field_t* field) {
-	free(field->name);
-	free(field);
+	memFree(field->name);
+	memFree(field);
 }
 
 int addStruct(StructTable* structTable, struct_root_t* structDef) {
 	if (structTable->size == structTable->capacity) {
 		structTable->capacity += 2;
-		struct_root_t** temp = (struct_root_t**) realloc(structTable->structs, sizeof(struct_root_t*) * structTable->capacity);
+		struct_root_t** temp = (struct_root_t**) memRealloc(MEM_SYMTAB, structTable->structs, sizeof(struct_root_t*) * structTable->capacity);
 		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for struct table entries.");
 		structTable->structs = temp;
 	}
@@ -104,7 +112,7 @@ bool addStructField(struct_root_t* structDef, struct_field_t* field) {
 
 	if (structDef->fieldCount == structDef->fieldCapacity) {
 		structDef->fieldCapacity += 2;
-		struct_field_t** temp = (struct_field_t**) realloc(structDef->fields, sizeof(struct_field_t*) * structDef->fieldCapacity);
+		struct_field_t** temp = (struct_field_t**) memRealloc(MEM_SYMTAB, structDef->fields, sizeof(struct_field_t*) * structDef->fieldCapacity);
 		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for struct fields.");
 		structDef->fields = temp;
 	}
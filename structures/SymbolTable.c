@@ -3,45 +3,63 @@
 
 #include "SymbolTable.h"
 #include "diagnostics.h"
+#include "allocator.h"
+#include "context.h"
 
 
 SymbolTable* initSymbolTable() {
-	SymbolTable* symbTable = (SymbolTable*) malloc(sizeof(SymbolTable));
+	SymbolTable* symbTable = (SymbolTable*) memAlloc(MEM_SYMTAB, sizeof(SymbolTable));
 	if (!symbTable) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol table.");
 
-	symbTable->entries = (symb_entry_t**) malloc(sizeof(symb_entry_t*) * 10);
-	if (!symbTable->entries) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol table entries.");
+	symbTable->entries = NULL;
 	symbTable->size = 0;
-	symbTable->capacity = 10;
+	symbTable->capacity = 0;
+	reserveSymbolEntries(&symbTable->entries, &symbTable->capacity, 16);
+	symbTable->index = NULL;
+	symbTable->indexSize = 0;
+	symbTable->ownsSources = false;
 
 	return symbTable;
 }
 
+static void keepSource(SymbolTable* table, srcloc_t loc) {
+	if (table->ownsSources) keepSourceLine(&arxCurrent()->sources, loc, NULL);
+}
+
 void deinitSymbolTable(SymbolTable* table) {
-	for (uint32_t i = 0; i < table->size; ++i) {
+	for (size_t i = 0; i < table->size; ++i) {
+		deinitSymbolEntry(table->entries[i]);
+	}
+	memFree(table->entries);
+	memFree(table->index);
+	memFree(table);
+}
+
+void resetSymbolTable(SymbolTable* table) {
+	for (size_t i = 0; i < table->size; ++i) {
 		deinitSymbolEntry(table->entries[i]);
 	}
-	free(table->entries);
-	free(table);
+	table->size = 0;
+	if (table->index) memset(table->index, 0, sizeof(uint32_t) * table->indexSize);
 }
 
-symb_entry_t* initSymbolEntry(const char* name, SYMBFLAGS flags, Node* expr, uint32_t val, SString* source, int linenum) {
-	symb_entry_t* entry = (symb_entry_t*)malloc(sizeof(symb_entry_t));
+symb_entry_t* initSymbolEntry(const char* name, SYMBFLAGS flags, Node* expr, uint32_t val, srcloc_t loc) {
+	symb_entry_t* entry = (symb_entry_t*)memAlloc(MEM_SYMTAB, sizeof(symb_entry_t));
 	if (!entry) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol entry.");
 
-	entry->name = strdup(name);
+	entry->name = memStrdup(MEM_SYMTAB, name);
 	entry->flags = flags;
 	entry->size = 0;
-	entry->source = source; // Maybe have the entry use its own copy of SString
-	entry->linenum = linenum;
+	entry->loc = loc;
 
+	// The value shares its storage with the expression, clear it so a constant does not leave part of a pointer behind
+	entry->value.expr = expr;
 	if (!expr) entry->value.val = val;
-	else entry->value.expr = expr;
 
-	entry->references.refs = (symb_entry_ref_t**) malloc(sizeof(symb_entry_ref_t*) * 4);
-	if (!entry->references.refs) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol entry references.");
+	// Allocated with the first reference, a symbol may have none
+	entry->references.refs = NULL;
 	entry->references.refcount = 0;
-	entry->references.refcap = 4;
+	entry->references.refcap = 0;
 
 	entry->structTypeIdx = -1;
 
@@ -51,43 +69,90 @@ symb_entry_t* initSymbolEntry(const char* name, SYMBFLAGS flags, Node* expr, uin
 }
 
 void deinitSymbolEntry(symb_entry_t* entry) {
-	// If entry has its own copy of SString, free it here; if not, it is managed in the Token struct
+	// The line of the entry is in the source map of the context
 	// If the entry still contains the expression AST, that is managed by the parser
 
-	for (int i = 0; i < entry->references.refcount; ++i) {
-		if (entry->references.refs[i]) free(entry->references.refs[i]);
+	for (size_t i = 0; i < entry->references.refcount; ++i) {
+		if (entry->references.refs[i]) memFree(entry->references.refs[i]);
 	}
-	free(entry->references.refs);
-	free(entry->name);
-	free(entry);
+	memFree(entry->references.refs);
+	memFree(entry->name);
+	memFree(entry);
+}
+
+static uint32_t hashName(const char* name) {
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619u;
+
+	return hash;
+}
+
+// Positions are 32 bits in the index and in symbol nodes, and the index is twice the size of the table
+#define SYMBOL_MAX (1u << 30)
+
+static void indexEntry(SymbolTable* table, uint32_t position) {
+	uint32_t mask = table->indexSize - 1;
+	uint32_t slot = hashName(table->entries[position]->name) & mask;
+	while (table->index[slot]) slot = (slot + 1) & mask;
+	table->index[slot] = position + 1;
+}
+
+static void growIndex(SymbolTable* table) {
+	uint32_t indexSize = table->indexSize ? table->indexSize * 2 : 32;
+	uint32_t* index = (uint32_t*) memCalloc(MEM_SYMTAB, indexSize, sizeof(uint32_t));
+	if (!index) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol table index.");
+
+	memFree(table->index);
+	table->index = index;
+	table->indexSize = indexSize;
+	for (size_t i = 0; i < table->size; i++) indexEntry(table, (uint32_t) i);
 }
 
 void addSymbolEntry(SymbolTable* table, symb_entry_t* entry) {
-	if (table->size == table->capacity) {
-		table->capacity += 5;
-		table->entries = (symb_entry_t**)realloc(table->entries, sizeof(symb_entry_t*) * table->capacity);
+	if (table->size == SYMBOL_MAX) emitError(ERR_UNSUPPORTED, NULL, "More than %u symbols.", SYMBOL_MAX);
+
+	pushSymbolEntries(&table->entries, &table->size, &table->capacity, entry);
+	entry->symbTableIndex = (int) (table->size - 1);
+
+	// An entry moved over from another table brings its lines along
+	if (table->ownsSources) {
+		keepSource(table, entry->loc);
+		for (size_t i = 0; i < entry->references.refcount; ++i) {
+			if (i == 0) keepSource(table, entry->references.refs[i]->loc);
+			else memFree(entry->references.refs[i]);
+		}
+		if (entry->references.refcount > 1) entry->references.refcount = 1;
+		shrinkSymbolRefs(&entry->references.refs, entry->references.refcount, &entry->references.refcap);
 	}
-	table->entries[table->size++] = entry;
-	entry->symbTableIndex = table->size - 1;
+
+	if (table->size * 2 > table->indexSize) growIndex(table);
+	else indexEntry(table, (uint32_t) (table->size - 1));
 }
 
-void addSymbolReference(symb_entry_t* entry, SString* source, int linenum) {
-	if (entry->references.refcount == entry->references.refcap) {
-		entry->references.refcap += 5;
-		symb_entry_ref_t** temp = (symb_entry_ref_t**) realloc(entry->references.refs, sizeof(symb_entry_ref_t*) * entry->references.refcap);
-		if (!temp) emitError(ERR_MEM, NULL, "Failed to reallocate memory for symbol entry references.");
-		entry->references.refs = temp;
-	}
+void addSymbolReference(SymbolTable* table, symb_entry_t* entry, srcloc_t loc) {
+	if (table->ownsSources && entry->references.refcount > 0) return;
 
-	symb_entry_ref_t* ref = (symb_entry_ref_t*) malloc(sizeof(symb_entry_ref_t));
-	ref->source = source; // Maybe have the references keep its own copy of SString
-	ref->linenum = linenum;
-	entry->references.refs[entry->references.refcount++] = ref;
+	symb_entry_ref_t* ref = (symb_entry_ref_t*) memAlloc(MEM_SYMTAB, sizeof(symb_entry_ref_t));
+	if (!ref) emitError(ERR_MEM, NULL, "Failed to allocate memory for a symbol entry reference.");
+	ref->loc = loc;
+	keepSource(table, loc);
+	// Such a table keeps a single reference
+	if (table->ownsSources) reserveSymbolRefs(&entry->references.refs, &entry->references.refcap, 1);
+	pushSymbolRefs(&entry->references.refs, &entry->references.refcount, &entry->references.refcap, ref);
+}
+
+void setSymbolSource(SymbolTable* table, symb_entry_t* entry, srcloc_t loc) {
+	entry->loc = loc;
+	keepSource(table, loc);
 }
 
 symb_entry_t* getSymbolEntry(SymbolTable* table, const char* name) {
-	for (uint32_t i = 0; i < table->size; ++i) {
-		if (strcmp(table->entries[i]->name, name) == 0) return table->entries[i];
+	if (!table->index) return NULL;
+
+	uint32_t mask = table->indexSize - 1;
+	for (uint32_t slot = hashName(name) & mask; table->index[slot]; slot = (slot + 1) & mask) {
+		symb_entry_t* entry = table->entries[table->index[slot] - 1];
+		if (strcmp(entry->name, name) == 0) return entry;
 	}
 
 	return NULL;
@@ -99,7 +164,7 @@ void updateSymbolEntry(symb_entry_t* entry, SYMBFLAGS flags, uint32_t value) {
 }
 
 static char* flagToString(SYMBFLAGS flags) {
-	static char buffer[64];
+	static _Thread_local char buffer[64];
 	buffer[0] = '\0';
 
 	// Main type
@@ -158,18 +223,18 @@ void displaySymbolTable(SymbolTable* table) {
 		return;
 	}
 	rtrace("\n=================== Symbol Table ====================");
-	rtrace("Total Symbols: %u (capacity: %u)", table->size, table->capacity);
+	rtrace("Total Symbols: %zu (capacity: %zu)", table->size, table->capacity);
 	rtrace("-----------------------------------------------------------------------------------------------------------------");
 	rtrace("| %-3s | %-20s | %-45s | %-12s | %-8s | %-6s |", "#", "Name", "Flags", "Size (bytes)", "Line", "Refs");
 	rtrace("-----------------------------------------------------------------------------------------------------------------");
-	for (uint32_t i = 0; i < table->size; ++i) {
+	for (size_t i = 0; i < table->size; ++i) {
 		symb_entry_t* entry = table->entries[i];
-		rtrace("| %-3u | %-20s | %-45s | %-12u | %-8d | %-6d |",
-			i, entry->name, flagToString(entry->flags), entry->size, entry->linenum, entry->references.refcount);
+		rtrace("| %-3zu | %-20s | %-45s | %-12u | %-8d | %-6zu |",
+			i, entry->name, flagToString(entry->flags), entry->size, lineNumber(entry->loc), entry->references.refcount);
 	}
 	rtrace("-----------------------------------------------------------------------------------------------------------------\n");
 
-	for (uint32_t i = 0; i < table->size; ++i) {
+	for (size_t i = 0; i < table->size; ++i) {
 		displaySymbolEntry(table->entries[i]);
 	}
 }
@@ -180,20 +245,21 @@ void displaySymbolEntry(symb_entry_t* entry) {
 	rtrace("Name:   %s", entry->name);
 	rtrace("Flags:  %s", flagToString(entry->flags));
 	rtrace("Size:   %u bytes", entry->size);
-	rtrace("Line:   %d", entry->linenum);
-	rtrace("Source: %s", (entry->source) ? ssGetString(entry->source) : "(unknown)");
+	const char* source = sourceLine(entry->loc);
+	rtrace("Line:   %d", lineNumber(entry->loc));
+	rtrace("Source: %s", source ? source : "(unknown)");
 	if (GET_EXPRESSION(entry->flags)) {
 		// Maybe have an option to print the AST in a nice format
 		rtrace("Value:  [Expression AST]");
 	} else {
 		rtrace("Value:  0x%x", entry->value.val);
 	}
-	rtrace("References (%d):", entry->references.refcount);
+	rtrace("References (%zu):", entry->references.refcount);
 	if (entry->references.refcount > 0) {
 		rtrace("  | %-3s | %-6s |", "#", "Line");
-		for (int j = 0; j < entry->references.refcount; ++j) {
+		for (size_t j = 0; j < entry->references.refcount; ++j) {
 			symb_entry_ref_t* ref = entry->references.refs[j];
-			rtrace("  | %-3d | %-6d |", j, ref->linenum);
+			rtrace("  | %-3zu | %-6d |", j, lineNumber(ref->loc));
 		}
 	}
 	rtrace("----------------------------------------------------\n");
@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+#include "Vector.h"
+#include "diagnostics.h"
+
+
+void* growVector(memTag tag, void* items, size_t* capacity, size_t itemSize, size_t needed) {
+	if (needed <= *capacity) return items;
+
+	size_t grown = *capacity * 2;
+	if (grown < needed) grown = needed;
+	if (grown > SIZE_MAX / itemSize) emitError(ERR_MEM, NULL, "An array of %zu items is too large.", grown);
+
+	void* temp = memRealloc(tag, items, itemSize * grown);
+	if (!temp) emitError(ERR_MEM, NULL, "Failed to grow an array to %zu items.", grown);
+	*capacity = grown;
+
+	return temp;
+}
+
+void* shrinkVector(memTag tag, void* items, size_t count, size_t* capacity, size_t itemSize) {
+	if (count == *capacity) return items;
+
+	if (count == 0) {
+		memFree(items);
+		*capacity = 0;
+		return NULL;
+	}
+
+	// Giving memory back is not needed, the array stays as it was when it cannot be moved
+	void* temp = memRealloc(tag, items, itemSize * count);
+	if (!temp) return items;
+	*capacity = count;
+
+	return temp;
+}
@@ -2,14 +2,18 @@
 
 #include "ast.h"
 #include "diagnostics.h"
+#include "allocator.h"
 
 
 Node* initASTNode(astNode_t astNodeType, node_t nodeType, Token* token, Node* parent) {
-	Node* node = (Node*) malloc(sizeof(Node));
+	Node* node = (Node*) memAlloc(MEM_AST, sizeof(Node));
 	if (!node) emitError(ERR_MEM, NULL, "Failed to allocate memory for AST node.");
 
 	node->astNodeType = astNodeType;
-	node->token = token;
+	node->type = token ? token->type : TK_UNKNOWN;
+	node->loc = token ? token->loc : NO_LOC;
+	// Strings can be long and are rarely the same, their value is all that is used
+	node->lexeme = token && nodeType != ND_STRING ? internName(token->lexeme) : NULL;
 	node->nodeType = nodeType;
 
 	node->nodeData.generic = NULL;
@@ -89,7 +93,7 @@ void freeAST(Node* root) {
 			break;
 	}
 
-	free(root);
+	memFree(root);
 }
 
 void printAST(Node* root) {
@@ -143,7 +147,7 @@ void printAST(Node* root) {
 	}
 
 	// Print the current node
-	rlog("Node(type=%s, astNodeType=%s, token=`%s`)", nodeTypeStr, astNodeTypeStr, root->token ? root->token->lexeme : "NULL");
+	rlog("Node(type=%s, astNodeType=%s, token=`%s`)", nodeTypeStr, astNodeTypeStr, root->lexeme ? root->lexeme : "NULL");
 
 	// Recursively print children based on node type
 	switch (root->nodeType) {
@@ -290,7 +294,7 @@ void printAST(Node* root) {
 			}
 			if (dirNode->nary.exprCount > 0) {
 				rlog("  N-ary Directive Expressions:{");
-				for (int i = 0; i < dirNode->nary.exprCount; i++) {
+				for (size_t i = 0; i < dirNode->nary.exprCount; i++) {
 					printAST(dirNode->nary.exprs[i]);
 				}
 				rlog("}");
@@ -371,37 +375,13 @@ void printAST(Node* root) {
 }
 
 
-Node** newNodeArray(int initialCapacity) {
-	Node** array = (Node**) malloc(sizeof(Node*) * initialCapacity);
-	if (!array) return NULL;
-
-	return array;
-}
-
 void freeNodeArray(Node** array) {
-	free(array);
-}
-
-Node** nodeArrayInsert(Node** array, int* capacity, int* count, Node* node) {
-	int cap = *capacity;
-	int cnt = *count;
-
-	if (cnt == cap) {
-		cap += 2;
-		Node** temp = (Node**) realloc(array, sizeof(Node*) * cap);
-		if (!temp) return NULL;
-		array = temp;
-		*capacity = cap;
-	}
-	array[cnt] = node;
-	*count = cnt + 1;
-
-	return array;
+	memFree(array);
 }
 
 
 InstrNode* initInstructionNode(enum Instructions instruction, uint8_t section) {
-	InstrNode* instrNode = (InstrNode*) malloc(sizeof(InstrNode));
+	InstrNode* instrNode = (InstrNode*) memAlloc(MEM_AST, sizeof(InstrNode));
 	if (!instrNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for instruction node.");
 
 	instrNode->instruction = instruction;
@@ -467,11 +447,11 @@ void deinitInstructionNode(InstrNode* instrNode) {
 			emitError(ERR_INTERNAL, NULL, "Invalid instruction type in deinitInstructionNode.");
 			break;
 	}
-	free(instrNode);
+	memFree(instrNode);
 }
 
 RegNode* initRegisterNode(int regNumber) {
-	RegNode* regNode = (RegNode*) malloc(sizeof(RegNode));
+	RegNode* regNode = (RegNode*) memAlloc(MEM_AST, sizeof(RegNode));
 	if (!regNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for register node.");
 
 	regNode->regNumber = regNumber;
@@ -480,11 +460,11 @@ RegNode* initRegisterNode(int regNumber) {
 }
 
 void deinitRegisterNode(RegNode* regNode) {
-	free(regNode);
+	memFree(regNode);
 }
 
 DirctvNode* initDirectiveNode() {
-	DirctvNode* node = (DirctvNode*) malloc(sizeof(DirctvNode));
+	DirctvNode* node = (DirctvNode*) memAlloc(MEM_AST, sizeof(DirctvNode));
 	if (!node) emitError(ERR_MEM, NULL, "Failed to allocate memory for directive node.");
 	
 	node->unary.data = NULL;
@@ -494,10 +474,10 @@ DirctvNode* initDirectiveNode() {
 
 	// Initialize the array in case the directive is n-ary
 	// `addNaryDirectiveData` depends that exprs is initialized
-	node->nary.exprs = newNodeArray(2);
-	if (!node->nary.exprs) emitError(ERR_MEM, NULL, "Failed to allocate memory for n-ary directive expressions.");
-	node->nary.exprCapacity = 2;
+	node->nary.exprs = NULL;
+	node->nary.exprCapacity = 0;
 	node->nary.exprCount = 0;
+	reserveNodes(&node->nary.exprs, &node->nary.exprCapacity, 2);
 
 	node->section = 0xFF; // Invalid section by default
 
@@ -510,12 +490,12 @@ void deinitDirectiveNode(DirctvNode* dirctvNode) {
 	if (dirctvNode->unary.data) freeAST(dirctvNode->unary.data);
 	if (dirctvNode->binary.symb) freeAST(dirctvNode->binary.symb);
 	if (dirctvNode->binary.data) freeAST(dirctvNode->binary.data);
-	for (int i = 0; i < dirctvNode->nary.exprCount; i++) {
+	for (size_t i = 0; i < dirctvNode->nary.exprCount; i++) {
 		freeAST(dirctvNode->nary.exprs[i]);
 	}
-	free(dirctvNode->nary.exprs);
+	memFree(dirctvNode->nary.exprs);
 
-	free(dirctvNode);
+	memFree(dirctvNode);
 }
 
 void setUnaryDirectiveData(DirctvNode* dirctvNode, Node* data) {
@@ -528,13 +508,12 @@ void setBinaryDirectiveData(DirctvNode* dirctvNode, Node* symb, Node* data) {
 }
 
 void addNaryDirectiveData(DirctvNode* dirctvNode, Node* expr) {
-	dirctvNode->nary.exprs = nodeArrayInsert(dirctvNode->nary.exprs, &dirctvNode->nary.exprCapacity, &dirctvNode->nary.exprCount, expr);
-	if (!dirctvNode->nary.exprs) emitError(ERR_MEM, NULL, "Failed to reallocate memory for n-ary directive expressions.");
+	pushNodes(&dirctvNode->nary.exprs, &dirctvNode->nary.exprCount, &dirctvNode->nary.exprCapacity, expr);
 }
 
 
 SymbNode* initSymbolNode(int symbTableIndex, uint32_t value) {
-	SymbNode* symbNode = (SymbNode*) malloc(sizeof(SymbNode));
+	SymbNode* symbNode = (SymbNode*) memAlloc(MEM_AST, sizeof(SymbNode));
 	if (!symbNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for symbol node.");
 
 	symbNode->symbTableIndex = symbTableIndex;
@@ -545,12 +524,12 @@ SymbNode* initSymbolNode(int symbTableIndex, uint32_t value) {
 }
 
 void deinitSymbolNode(SymbNode* symbNode) {
-	free(symbNode);
+	memFree(symbNode);
 }
 
 
 NumNode* initNumberNode(NumType type, int32_t intValue, float floatValue) {
-	NumNode* numNode = (NumNode*) malloc(sizeof(NumNode));
+	NumNode* numNode = (NumNode*) memAlloc(MEM_AST, sizeof(NumNode));
 	if (!numNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for number node.");
 
 	numNode->value.int32Value = 0; // Default to 0
@@ -593,12 +572,12 @@ NumNode* initNumberNode(NumType type, int32_t intValue, float floatValue) {
 }
 
 void deinitNumberNode(NumNode* numNode) {
-	free(numNode);
+	memFree(numNode);
 }
 
 
 StrNode* initStringNode(sds value, int length) {
-	StrNode* strNode = (StrNode*) malloc(sizeof(StrNode));
+	StrNode* strNode = (StrNode*) memAlloc(MEM_AST, sizeof(StrNode));
 	if (!strNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for string node.");
 
 	// Since value is the lexeme itself, the surrounding quotes need to be stripped
@@ -612,12 +591,12 @@ StrNode* initStringNode(sds value, int length) {
 
 void deinitStringNode(StrNode* strNode) {
 	sdsfree(strNode->value);
-	free(strNode);
+	memFree(strNode);
 }
 
 
 OpNode* initOperatorNode() {
-	OpNode* opNode = (OpNode*) malloc(sizeof(OpNode));
+	OpNode* opNode = (OpNode*) memAlloc(MEM_AST, sizeof(OpNode));
 	if (!opNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for operator node.");
 
 	opNode->data.binary.left = NULL;
@@ -631,7 +610,7 @@ void deinitOperatorNode(OpNode* opNode) {
 	// This very likely might lead to a segfault :(
 	if (opNode->data.binary.left) freeAST(opNode->data.binary.left);
 	if (opNode->data.binary.right) freeAST(opNode->data.binary.right);
-	free(opNode);
+	memFree(opNode);
 }
 
 void setUnaryOperand(OpNode* opNode, Node* operand) {
@@ -645,7 +624,7 @@ void setBinaryOperands(OpNode* opNode, Node* left, Node* right) {
 
 
 TypeNode* initTypeNode() {
-	TypeNode* typeNode = (TypeNode*) malloc(sizeof(TypeNode));
+	TypeNode* typeNode = (TypeNode*) memAlloc(MEM_AST, sizeof(TypeNode));
 	if (!typeNode) emitError(ERR_MEM, NULL, "Failed to allocate memory for type node.");
 
 	typeNode->child = NULL;
@@ -657,7 +636,7 @@ TypeNode* initTypeNode() {
 }
 
 void deinitTypeNode(TypeNode* typeNode) {
-	free(typeNode);
+	memFree(typeNode);
 }
 
 void setUnaryTypeData(TypeNode* typeNode, Node* typeData) {
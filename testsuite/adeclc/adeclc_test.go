@@ -0,0 +1,134 @@
+package adeclcTests
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"cli"
+)
+
+const defs = "% Shared declarations\n.set BASE, #0x100\n.set LIMIT, BASE + #0x40\n" +
+	".def Node {\n  val:8.\n  next:32.\n}\n.def LL{\n  start::Node.\n  count:8.\n}\n.type mLL, $object.struct.LL\n"
+
+const src = ".include \"defs.adecl\"\n.text\n_start:\n\tld x0, =LIMIT\n\tld x1, =BASE\n\tret\n"
+
+func setup(t *testing.T) string {
+	return cli.Setup(t, map[string]string{"defs.adecl": defs, "a.s": src})
+}
+
+func TestMatchesLexed(t *testing.T) {
+	dir := setup(t)
+
+	expected, err := assemble(dir, "lexed.ao", "-t", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if _, err := cli.Run(dir, "-t", "--precompile", "defs.adecl"); err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+
+	image, err := assemble(dir, "precompiled.ao", "-t", "-MD", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if !bytes.Equal(image, expected) {
+		t.Errorf("%sObject assembled with defs.adeclc differs from the lexed one%s", cli.RED, cli.RESET)
+	}
+
+	// Being listed as a dependency shows the precompiled file was the one used
+	deps, err := os.ReadFile(filepath.Join(dir, "precompiled.d"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !strings.Contains(string(deps), "defs.adeclc") {
+		t.Errorf("%sExpected defs.adeclc in the dependencies, got\n%s%s", cli.RED, deps, cli.RESET)
+	}
+}
+
+func TestStale(t *testing.T) {
+	dir := setup(t)
+
+	if _, err := cli.Run(dir, "-t", "--precompile", "defs.adecl"); err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if err := cli.WriteFile(dir, "defs.adecl", strings.Replace(defs, "#0x100", "#0x200", 1)); err != nil {
+		t.Fatal(err)
+	}
+
+	// The old defs.adeclc is left alone, the changed ADECL file is lexed
+	image, err := assemble(dir, "stale.ao", "-t", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	os.Remove(filepath.Join(dir, "defs.adeclc"))
+	expected, err := assemble(dir, "lexed.ao", "-t", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if !bytes.Equal(image, expected) {
+		t.Errorf("%sAn out of date defs.adeclc was used%s", cli.RED, cli.RESET)
+	}
+
+	// Without the same enhanced features the ADECL file is lexed, and fails without types
+	if _, err := cli.Run(dir, "-t", "--precompile", "defs.adecl"); err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if _, err := assemble(dir, "untyped.ao", "a.s"); err == nil {
+		t.Errorf("%sExpected a precompiled file made with -t to be ignored without it%s", cli.RED, cli.RESET)
+	}
+}
+
+func TestDirectInclude(t *testing.T) {
+	dir := setup(t)
+
+	if _, err := cli.Run(dir, "-t", "--precompile", "-o", "types.adeclc", "defs.adecl"); err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	expected, err := assemble(dir, "lexed.ao", "-t", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+
+	if err := cli.WriteFile(dir, "b.s", strings.Replace(src, "defs.adecl", "types.adeclc", 1)); err != nil {
+		t.Fatal(err)
+	}
+	image, err := assemble(dir, "direct.ao", "-t", "b.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	if !bytes.Equal(image, expected) {
+		t.Errorf("%sObject assembled with types.adeclc differs from the lexed one%s", cli.RED, cli.RESET)
+	}
+
+	// A damaged file given directly is an error rather than a crash
+	content, err := os.ReadFile(filepath.Join(dir, "types.adeclc"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, size := range []int{0, 16, len(content) / 2, len(content) - 1} {
+		if err := os.WriteFile(filepath.Join(dir, "types.adeclc"), content[:size], 0644); err != nil {
+			t.Fatal(err)
+		}
+		if _, err := assemble(dir, "direct.ao", "-t", "b.s"); err == nil {
+			t.Errorf("%sExpected a truncated types.adeclc (%d bytes) to fail%s", cli.RED, size, cli.RESET)
+		}
+	}
+}
+
+func TestOutsideSymbols(t *testing.T) {
+	dir := setup(t)
+
+	// The value of A depends on a symbol the includer would define
+	if err := cli.WriteFile(dir, "outside.adecl", ".set A, B + #1\n"); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := cli.Run(dir, "--precompile", "outside.adecl"); err == nil {
+		t.Errorf("%sExpected outside.adecl not to be precompiled%s", cli.RED, cli.RESET)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "outside.adeclc")); err == nil {
+		t.Errorf("%sA failed precompile left outside.adeclc behind%s", cli.RED, cli.RESET)
+	}
+}
@@ -0,0 +1,23 @@
+package adeclcTests
+
+import (
+	"os"
+	"path/filepath"
+
+	"cli"
+)
+
+
+// These tests run `out/arxsm --precompile` in a temporary directory, then assemble with and without the precompiled files
+
+
+// Runs the binary in `dir`, returning the object it wrote to `out`
+func assemble(dir string, out string, args ...string) ([]byte, error) {
+	os.Remove(filepath.Join(dir, out))
+
+	if _, err := cli.Run(dir, append([]string{"-o", out}, args...)...); err != nil {
+		return nil, err
+	}
+
+	return os.ReadFile(filepath.Join(dir, out))
+}
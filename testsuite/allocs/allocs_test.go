@@ -0,0 +1,71 @@
+package allocsTests
+
+import (
+	"fmt"
+	"strings"
+	"testing"
+)
+
+
+// Allocations allowed per line of plain instructions once the fixed startup cost is taken out
+// The startup cost cancels out by assembling N and 2N lines and looking only at the difference
+// Lower this as the hot paths stop allocating, the goal is 0
+const allocBudgetPerLine = 40
+
+const lines = 10000
+
+// `n` lines of register-only instructions
+func genRType(n int) string {
+	var sb strings.Builder
+	sb.WriteString(".text\n")
+	for i := 0; i < n; i++ {
+		fmt.Fprintf(&sb, "\tadd x%d, x%d, x%d\n", i%16, (i+1)%16, (i+2)%16)
+	}
+	return sb.String()
+}
+
+// `n` lines of instructions with an immediate
+func genIType(n int) string {
+	var sb strings.Builder
+	sb.WriteString(".text\n")
+	for i := 0; i < n; i++ {
+		fmt.Fprintf(&sb, "\tsub x%d, x%d, #%d\n", i%16, (i+1)%16, i%100)
+	}
+	return sb.String()
+}
+
+func TestAllocationBudget(t *testing.T) {
+	if err := buildsExist(); err != nil {
+		t.Fatalf("%v, build them first with `make arxsm malloccount`", err)
+	}
+
+	tests := []struct {
+		name string
+		gen func(n int) string
+	}{
+		{"RType", genRType},
+		{"IType", genIType},
+	}
+
+	for _, tc := range tests {
+		t.Run(tc.name, func(t *testing.T) {
+			small, err := countAllocs(t.TempDir(), tc.gen(lines))
+			if err != nil {
+				t.Fatalf("Assembling %d lines failed: %v", lines, err)
+			}
+			large, err := countAllocs(t.TempDir(), tc.gen(2*lines))
+			if err != nil {
+				t.Fatalf("Assembling %d lines failed: %v", 2*lines, err)
+			}
+
+			perLine := float64(large.allocs-small.allocs) / float64(lines)
+			bytesPerLine := float64(large.bytes-small.bytes) / float64(lines)
+			t.Logf("%s%d lines: %d allocs; %d lines: %d allocs; %.2f allocs/line, %.0f bytes/line%s",
+				YELLOW, lines, small.allocs, 2*lines, large.allocs, perLine, bytesPerLine, RESET)
+
+			if perLine > allocBudgetPerLine {
+				t.Errorf("%s%.2f allocations per line, over the budget of %d%s", RED, perLine, allocBudgetPerLine, RESET)
+			}
+		})
+	}
+}
@@ -0,0 +1,3 @@
+module allocsTests
+
+go 1.24.3
@@ -0,0 +1,72 @@
+package allocsTests
+
+import (
+	"fmt"
+	"os"
+	"os/exec"
+	"path/filepath"
+)
+
+
+// These tests run the assembler binary with the allocation counter preloaded (see bench/malloccount.c)
+// Both are built with `make arxsm malloccount`
+var (
+	arxsm = filepath.Join("..", "..", "out", "arxsm")
+	malloccount = filepath.Join("..", "..", "out", "libmalloccount.so")
+)
+
+const (
+	RESET = "\033[0m"
+	RED = "\033[31m"
+	YELLOW = "\033[33m"
+)
+
+type allocCount struct {
+	allocs uint64
+	bytes uint64
+}
+
+// Assembles `src` and returns every malloc/calloc/realloc the process made
+func countAllocs(dir string, src string) (allocCount, error) {
+	var count allocCount
+
+	bin, err := filepath.Abs(arxsm)
+	if err != nil {
+		return count, err
+	}
+	shim, err := filepath.Abs(malloccount)
+	if err != nil {
+		return count, err
+	}
+
+	input := filepath.Join(dir, "input.s")
+	if err := os.WriteFile(input, []byte(src), 0644); err != nil {
+		return count, err
+	}
+	report := filepath.Join(dir, "allocs.txt")
+
+	cmd := exec.Command(bin, "-o", filepath.Join(dir, "out.ao"), input)
+	cmd.Env = append(os.Environ(), "LD_PRELOAD="+shim, "MALLOCCOUNT_OUT="+report)
+	if output, err := cmd.CombinedOutput(); err != nil {
+		return count, fmt.Errorf("%v: %s", err, output)
+	}
+
+	data, err := os.ReadFile(report)
+	if err != nil {
+		return count, err
+	}
+	if _, err := fmt.Sscanf(string(data), "%d %d", &count.allocs, &count.bytes); err != nil {
+		return count, fmt.Errorf("malformed allocation report `%s`: %v", data, err)
+	}
+
+	return count, nil
+}
+
+func buildsExist() error {
+	for _, path := range []string{arxsm, malloccount} {
+		if _, err := os.Stat(path); err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -0,0 +1,164 @@
+package arxsmTests
+
+import (
+	"bytes"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+// Samples that assemble cleanly, their images must be byte for byte what the binary writes
+var samples = []string{"br.s", "evt.s", "imms.s", "simpleRel.s"}
+
+func TestMatchesBinary(t *testing.T) {
+	if _, err := os.Stat(arxsm); err != nil {
+		t.Skipf("%s%s is not built%s", YELLOW, arxsm, RESET)
+	}
+
+	for _, sample := range samples {
+		t.Run(sample, func(t *testing.T) {
+			path := filepath.Join("..", "..", "samples", sample)
+			src, err := os.ReadFile(path)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			out := filepath.Join(t.TempDir(), "out.ao")
+			if output, err := exec.Command(arxsm, "-o", out, path).CombinedOutput(); err != nil {
+				t.Fatalf("%s%v: %s%s", RED, err, output, RESET)
+			}
+			expected, err := os.ReadFile(out)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			res, err := assemble(string(src))
+			if err != nil {
+				t.Fatalf("%s%v%s", RED, err, RESET)
+			}
+			if !bytes.Equal(res.image, expected) {
+				t.Errorf("%sImage of %d bytes differs from the %d bytes written by arxsm%s", RED, len(res.image), len(expected), RESET)
+			}
+		})
+	}
+}
+
+func TestNoTrailingNewline(t *testing.T) {
+	withNewline, err := assemble(".text\n_start:\n\tadd x1, x2, x3\n\tret\n")
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+	without, err := assemble(".text\n_start:\n\tadd x1, x2, x3\n\tret")
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+
+	if !bytes.Equal(withNewline.image, without.image) {
+		t.Errorf("%sThe last line without a newline changed the image%s", RED, RESET)
+	}
+}
+
+func TestErrors(t *testing.T) {
+	res, err := assemble(".text\nfoo:\n\tret\nfoo:\n\tret\n")
+	if err == nil {
+		t.Fatalf("%sExpected the redefined label to fail%s", RED, RESET)
+	}
+	if res.image != nil {
+		t.Errorf("%sExpected no image on failure%s", RED, RESET)
+	}
+	if res.errors != 1 {
+		t.Errorf("%sExpected 1 error, got %d%s", RED, res.errors, RESET)
+	}
+	if !strings.Contains(res.diagnostics, "REDEFINITION") {
+		t.Errorf("%sExpected the redefinition to reach the sink, got `%s`%s", RED, res.diagnostics, RESET)
+	}
+
+	// A failure does not leave anything behind for the next call
+	if _, err := assemble(".text\nfoo:\n\tret\n"); err != nil {
+		t.Errorf("%sAssembly after a failed one: %v%s", RED, err, RESET)
+	}
+}
+
+func TestConcurrent(t *testing.T) {
+	src := ".text\n_start:\n\tadd x1, x2, x3\n\tld x0, =value\n\tret\n.data\nvalue: .word 0x1234\n"
+	expected, err := assemble(src)
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+
+	images := make(chan []byte)
+	for i := 0; i < 8; i++ {
+		go func() {
+			res, _ := assemble(src)
+			images <- res.image
+		}()
+	}
+
+	for i := 0; i < 8; i++ {
+		if image := <-images; !bytes.Equal(image, expected.image) {
+			t.Errorf("%sConcurrent assembly produced a different image%s", RED, RESET)
+		}
+	}
+}
+
+func TestAllocatorHooks(t *testing.T) {
+	counter := newCounter()
+	defer counter.free()
+
+	src := ".text\n_start:\n\tadd x1, x2, x3\n\tld x0, =value\n\tret\n.data\nvalue: .word 0x1234\n"
+	expected, err := assemble(src)
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+
+	res, err := assembleWith(src, counter.hooks())
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+	if !bytes.Equal(res.image, expected.image) {
+		t.Errorf("%sThe hooks changed the image%s", RED, RESET)
+	}
+	if counter.allocs() == 0 {
+		t.Errorf("%sNothing was allocated through the hooks%s", RED, RESET)
+	}
+	// The image was freed through the hooks as well, after the context was gone
+	if counter.live() != 0 {
+		t.Errorf("%s%d blocks were not given back to the hooks%s", RED, counter.live(), RESET)
+	}
+
+	// A failure releases the strings and structures of the assembly through the hooks too
+	if _, err := assembleWith(".text\nfoo:\n\tret\nfoo:\n\tret\n", counter.hooks()); err == nil {
+		t.Fatalf("%sExpected the redefined label to fail%s", RED, RESET)
+	}
+	if counter.live() != 0 {
+		t.Errorf("%s%d blocks were not given back to the hooks after a failure%s", RED, counter.live(), RESET)
+	}
+}
+
+func TestArena(t *testing.T) {
+	src, err := os.ReadFile(filepath.Join("..", "..", "samples", "simpleRel.s"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	expected, err := assemble(string(src))
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+
+	// Frees do nothing, the arena is dropped as a whole afterwards
+	arena := newArena(64 << 20)
+	defer arena.drop()
+
+	res, err := assembleWith(string(src), arena.hooks())
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+	if !bytes.Equal(res.image, expected.image) {
+		t.Errorf("%sThe arena changed the image%s", RED, RESET)
+	}
+	if arena.allocs() == 0 {
+		t.Errorf("%sNothing was allocated from the arena%s", RED, RESET)
+	}
+}
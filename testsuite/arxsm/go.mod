@@ -0,0 +1,3 @@
+module arxsmTests
+
+go 1.24.3
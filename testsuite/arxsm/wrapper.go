@@ -0,0 +1,222 @@
+package arxsmTests
+
+/*
+#cgo CFLAGS: -I../../headers -I../../common/lib/sds -I../../common/lib/securedstring
+#cgo LDFLAGS: -L../../out -larxsm
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arxsm.h"
+
+// Collects the diagnostics of one call as `[NAME] message` lines
+typedef struct Collected {
+	char text[4096];
+	size_t len;
+} Collected;
+
+static void collect(const Diagnostic* diag, void* ctx) {
+	Collected* collected = (Collected*) ctx;
+	size_t room = sizeof(collected->text) - collected->len;
+	int n = snprintf(collected->text + collected->len, room, "[%s] %s\n", diag->name, diag->message);
+	if (n > 0) collected->len += (size_t) n < room ? (size_t) n : room - 1;
+}
+
+static diagSink collectSink() {
+	return collect;
+}
+
+// A bump arena, freeing does nothing and everything goes away when the arena is dropped
+// Each block is prefixed with its size so that reallocation knows how much to copy
+typedef struct Arena {
+	mem_hooks_t hooks;
+	char* base;
+	size_t used;
+	size_t capacity;
+	size_t allocs;
+} Arena;
+
+static void* arenaAlloc(size_t size, void* userData) {
+	Arena* arena = (Arena*) userData;
+	size_t need = (16 + size + 15) & ~(size_t) 15;
+	if (arena->used + need > arena->capacity) return NULL;
+
+	char* block = arena->base + arena->used;
+	arena->used += need;
+	arena->allocs++;
+	*(size_t*) block = size;
+
+	return block + 16;
+}
+
+static void* arenaRealloc(void* ptr, size_t size, void* userData) {
+	void* moved = arenaAlloc(size, userData);
+	if (!moved || !ptr) return moved;
+
+	size_t oldSize = *(size_t*) ((char*) ptr - 16);
+	memcpy(moved, ptr, oldSize < size ? oldSize : size);
+
+	return moved;
+}
+
+static void arenaFree(void* ptr, void* userData) {
+	(void) ptr;
+	(void) userData;
+}
+
+static Arena* newArena(size_t capacity) {
+	Arena* arena = (Arena*) calloc(1, sizeof(Arena));
+	arena->base = (char*) malloc(capacity);
+	arena->capacity = capacity;
+	arena->hooks = (mem_hooks_t) {arenaAlloc, arenaRealloc, arenaFree, arena};
+	return arena;
+}
+
+static void dropArena(Arena* arena) {
+	free(arena->base);
+	free(arena);
+}
+
+// Hooks over malloc counting the blocks still allocated
+typedef struct Counter {
+	mem_hooks_t hooks;
+	size_t allocs;
+	size_t live;
+} Counter;
+
+static void* countedAlloc(size_t size, void* userData) {
+	Counter* counter = (Counter*) userData;
+	void* ptr = malloc(size);
+	if (ptr) {
+		counter->allocs++;
+		counter->live++;
+	}
+	return ptr;
+}
+
+static void* countedRealloc(void* ptr, size_t size, void* userData) {
+	Counter* counter = (Counter*) userData;
+	void* moved = realloc(ptr, size);
+	if (moved && !ptr) {
+		counter->allocs++;
+		counter->live++;
+	}
+	return moved;
+}
+
+static void countedFree(void* ptr, void* userData) {
+	((Counter*) userData)->live--;
+	free(ptr);
+}
+
+static Counter* newCounter() {
+	Counter* counter = (Counter*) calloc(1, sizeof(Counter));
+	counter->hooks = (mem_hooks_t) {countedAlloc, countedRealloc, countedFree, counter};
+	return counter;
+}
+*/
+import "C"
+import (
+	"fmt"
+	"path/filepath"
+	"unsafe"
+)
+
+// The binary the in-memory images are compared against, built with `make`
+var arxsm = filepath.Join("..", "..", "out", "arxsm")
+
+const (
+	RESET = "\033[0m"
+	RED = "\033[31m"
+	YELLOW = "\033[33m"
+)
+
+type result struct {
+	image []byte
+	errors int
+	warnings int
+	diagnostics string
+}
+
+// Allocation hooks counting the blocks still allocated
+type counter struct {
+	c *C.Counter
+}
+
+func newCounter() counter {
+	return counter{C.newCounter()}
+}
+
+func (c counter) hooks() *C.mem_hooks_t {
+	return &c.c.hooks
+}
+
+func (c counter) allocs() int {
+	return int(c.c.allocs)
+}
+
+func (c counter) live() int {
+	return int(c.c.live)
+}
+
+func (c counter) free() {
+	C.free(unsafe.Pointer(c.c))
+}
+
+// Allocation hooks taking from a bump arena
+type arena struct {
+	a *C.Arena
+}
+
+func newArena(capacity int) arena {
+	return arena{C.newArena(C.size_t(capacity))}
+}
+
+func (a arena) hooks() *C.mem_hooks_t {
+	return &a.a.hooks
+}
+
+func (a arena) allocs() int {
+	return int(a.a.allocs)
+}
+
+func (a arena) drop() {
+	C.dropArena(a.a)
+}
+
+// Assembles `src` with the library, copying the image out of C memory
+func assemble(src string) (result, error) {
+	return assembleWith(src, nil)
+}
+
+// Same as `assemble`, with the memory of the call coming from `allocator`
+func assembleWith(src string, allocator *C.mem_hooks_t) (result, error) {
+	cSrc := C.CString(src)
+	defer C.free(unsafe.Pointer(cSrc))
+
+	collected := (*C.Collected)(C.calloc(1, C.sizeof_Collected))
+	defer C.free(unsafe.Pointer(collected))
+
+	options := C.ArxOptions{
+		warnings: C.FLAGS8(C.WARN_FLAG_ALL),
+		enhancedFeatures: C.FLAGS8(C.FEATURE_NONE),
+		sink: C.collectSink(),
+		sinkCtx: unsafe.Pointer(collected),
+		allocator: allocator,
+	}
+
+	var output C.ArxOutput
+	status := C.arxsm_assemble(cSrc, C.size_t(len(src)), &options, &output)
+	defer C.arxsm_free_output(&output)
+
+	res := result{
+		errors: int(output.errorCount),
+		warnings: int(output.warningCount),
+		diagnostics: C.GoStringN(&collected.text[0], C.int(collected.len)),
+	}
+	if status != C.ARX_OK {
+		return res, fmt.Errorf("assembly failed: %s", res.diagnostics)
+	}
+
+	res.image = C.GoBytes(unsafe.Pointer(output.image), C.int(output.size))
+	return res, nil
+}
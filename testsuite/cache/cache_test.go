@@ -0,0 +1,169 @@
+package cacheTests
+
+import (
+	"bytes"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"cli"
+)
+
+// Uses every symbol it defines, a file with warnings would not be stored
+const src = ".text\n_start:\n\tadd x1, x2, x3\n\tld x0, =value\n\tret\n.data\nvalue: .word 0x1234\n"
+
+func TestHit(t *testing.T) {
+	cli.SkipUnbuilt(t)
+	dir := t.TempDir()
+	if err := cli.WriteFile(dir, "a.s", src); err != nil {
+		t.Fatal(err)
+	}
+
+	expected, _, err := assemble(dir, "plain.ao", "a.s")
+	if err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+	for i := 0; i < 2; i++ {
+		image, _, err := assemble(dir, "cached.ao", "--cache-dir", "cache", "a.s")
+		if err != nil {
+			t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+		}
+		if !bytes.Equal(image, expected) {
+			t.Errorf("%sRun %d: cached object differs from a plain run%s", cli.RED, i, cli.RESET)
+		}
+	}
+
+	stats, err := cacheStats(filepath.Join(dir, "cache"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if stats["hits"] != 1 || stats["misses"] != 1 || stats["stores"] != 1 {
+		t.Errorf("%sExpected 1 hit, 1 miss and 1 store, got %v%s", cli.RED, stats, cli.RESET)
+	}
+}
+
+func TestKeyChanges(t *testing.T) {
+	cli.SkipUnbuilt(t)
+	dir := t.TempDir()
+	if err := cli.WriteFile(dir, "defs.adecl", ".set VALUE, #5\n"); err != nil {
+		t.Fatal(err)
+	}
+	if err := cli.WriteFile(dir, "a.s", ".include \"defs.adecl\"\n"+src); err != nil {
+		t.Fatal(err)
+	}
+
+	// Each step must miss: first run, changed include, another flag
+	steps := []struct {
+		name string
+		change func() error
+		args []string
+	}{
+		{"first", func() error { return nil }, nil},
+		{"include", func() error { return cli.WriteFile(dir, "defs.adecl", ".set VALUE, #6\n") }, nil},
+		{"flags", func() error { return nil }, []string{"-g"}},
+	}
+
+	for _, step := range steps {
+		if err := step.change(); err != nil {
+			t.Fatal(err)
+		}
+		args := append(append([]string{}, step.args...), "a.s")
+
+		expected, _, err := assemble(dir, "plain.ao", args...)
+		if err != nil {
+			t.Fatalf("%s%s: %v%s", cli.RED, step.name, err, cli.RESET)
+		}
+		image, _, err := assemble(dir, "cached.ao", append([]string{"--cache-dir", "cache"}, args...)...)
+		if err != nil {
+			t.Fatalf("%s%s: %v%s", cli.RED, step.name, err, cli.RESET)
+		}
+		if !bytes.Equal(image, expected) {
+			t.Errorf("%s%s: cached object differs from a plain run%s", cli.RED, step.name, cli.RESET)
+		}
+	}
+
+	stats, err := cacheStats(filepath.Join(dir, "cache"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if stats["hits"] != 0 || stats["misses"] != uint64(len(steps)) {
+		t.Errorf("%sExpected every step to miss, got %v%s", cli.RED, stats, cli.RESET)
+	}
+}
+
+func TestWarningsNotStored(t *testing.T) {
+	cli.SkipUnbuilt(t)
+	dir := t.TempDir()
+	if err := cli.WriteFile(dir, "a.s", ".set UNUSED, #1\n"+src); err != nil {
+		t.Fatal(err)
+	}
+
+	for i := 0; i < 2; i++ {
+		_, stderr, err := assemble(dir, "a.ao", "--cache-dir", "cache", "a.s")
+		if err != nil {
+			t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+		}
+		if !strings.Contains(stderr, "UNUSED") {
+			t.Errorf("%sRun %d: the warning was not printed%s", cli.RED, i, cli.RESET)
+		}
+	}
+
+	stats, err := cacheStats(filepath.Join(dir, "cache"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if stats["stores"] != 0 || stats["hits"] != 0 {
+		t.Errorf("%sExpected nothing stored, got %v%s", cli.RED, stats, cli.RESET)
+	}
+}
+
+func TestEviction(t *testing.T) {
+	cli.SkipUnbuilt(t)
+	dir := t.TempDir()
+
+	// Around 16 KiB of data each, well over the 1 MiB limit altogether
+	var files []string
+	for i := 0; i < 100; i++ {
+		var b strings.Builder
+		b.WriteString(".data\nvalues:\n")
+		for j := 0; j < 64; j++ {
+			b.WriteString("\t.word ")
+			for k := 0; k < 64; k++ {
+				if k > 0 {
+					b.WriteString(", ")
+				}
+				fmt.Fprintf(&b, "%d", i*64+j+k)
+			}
+			b.WriteString("\n")
+		}
+
+		name := fmt.Sprintf("f%d.s", i)
+		if err := cli.WriteFile(dir, name, b.String()); err != nil {
+			t.Fatal(err)
+		}
+		files = append(files, name)
+	}
+	if err := os.Mkdir(filepath.Join(dir, "out"), 0755); err != nil {
+		t.Fatal(err)
+	}
+
+	if _, err := cli.Run(dir, append([]string{"--cache-dir", "cache", "--cache-size", "1", "-o", "out/"}, files...)...); err != nil {
+		t.Fatalf("%s%v%s", cli.RED, err, cli.RESET)
+	}
+
+	stats, err := cacheStats(filepath.Join(dir, "cache"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if stats["evictions"] == 0 {
+		t.Errorf("%sExpected evictions, got %v%s", cli.RED, stats, cli.RESET)
+	}
+	if stats["size"] > 1<<20 {
+		t.Errorf("%sCache is %d bytes, over its 1 MiB limit%s", cli.RED, stats["size"], cli.RESET)
+	}
+	if stats["files"] != stats["stores"]-stats["evictions"] {
+		t.Errorf("%sFile count does not add up: %v%s", cli.RED, stats, cli.RESET)
+	}
+}
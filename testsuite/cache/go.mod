@@ -0,0 +1,7 @@
+module cacheTests
+
+go 1.24.3
+
+require cli v0.0.0
+
+replace cli => ../cli
@@ -0,0 +1,53 @@
+package cacheTests
+
+import (
+	"bufio"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+
+	"cli"
+)
+
+
+// These tests run `out/arxsm --cache-dir` in a temporary directory and look at the objects and the cache statistics
+
+
+// Runs the binary in `dir`, returning the object it wrote to `out`
+func assemble(dir string, out string, args ...string) ([]byte, string, error) {
+	os.Remove(filepath.Join(dir, out))
+
+	stderr, err := cli.Run(dir, append([]string{"-o", out}, args...)...)
+	if err != nil {
+		return nil, stderr, err
+	}
+
+	image, err := os.ReadFile(filepath.Join(dir, out))
+	return image, stderr, err
+}
+
+// Reads `<cache>/stats` into a map of counter names to values
+func cacheStats(cache string) (map[string]uint64, error) {
+	file, err := os.Open(filepath.Join(cache, "stats"))
+	if err != nil {
+		return nil, err
+	}
+	defer file.Close()
+
+	stats := map[string]uint64{}
+	scanner := bufio.NewScanner(file)
+	for scanner.Scan() {
+		fields := strings.Fields(scanner.Text())
+		if len(fields) != 2 {
+			continue
+		}
+		value, err := strconv.ParseUint(fields[1], 10, 64)
+		if err != nil {
+			return nil, err
+		}
+		stats[fields[0]] = value
+	}
+
+	return stats, scanner.Err()
+}
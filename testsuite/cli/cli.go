@@ -0,0 +1,81 @@
+package cli
+
+import (
+	"bytes"
+	"fmt"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"testing"
+)
+
+
+// What the packages testing the `out/arxsm` binary share: running it in a temporary directory laid out by the test
+// Each package requires this module through a `replace` of its go.mod, paths are relative to the package's directory
+var Arxsm = filepath.Join("..", "..", "out", "arxsm")
+
+const (
+	RESET = "\033[0m"
+	RED = "\033[31m"
+	YELLOW = "\033[33m"
+)
+
+// Skips the test when the binary was not built
+func SkipUnbuilt(t *testing.T) {
+	if _, err := os.Stat(Arxsm); err != nil {
+		t.Skipf("%s%s is not built%s", YELLOW, Arxsm, RESET)
+	}
+}
+
+// Lays the files out in a new temporary directory, skipping the test when the binary was not built
+func Setup(t *testing.T, files map[string]string) string {
+	SkipUnbuilt(t)
+
+	dir := t.TempDir()
+	if err := WriteFiles(dir, files); err != nil {
+		t.Fatal(err)
+	}
+
+	return dir
+}
+
+// Runs the binary in `dir`, returning what it printed to stderr
+func Run(dir string, args ...string) (string, error) {
+	bin, err := filepath.Abs(Arxsm)
+	if err != nil {
+		return "", err
+	}
+
+	var stderr bytes.Buffer
+	cmd := exec.Command(bin, args...)
+	cmd.Dir = dir
+	cmd.Stderr = &stderr
+	if err := cmd.Run(); err != nil {
+		return stderr.String(), fmt.Errorf("%v: %s", err, stderr.String())
+	}
+
+	return stderr.String(), nil
+}
+
+func WriteFile(dir string, name string, content string) error {
+	return os.WriteFile(filepath.Join(dir, name), []byte(content), 0644)
+}
+
+// Writes the files, creating the directories in their names
+func WriteFiles(dir string, files map[string]string) error {
+	for name, content := range files {
+		path := filepath.Join(dir, name)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			return err
+		}
+		if err := WriteFile(dir, name, content); err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+func ReadFile(dir string, name string) ([]byte, error) {
+	return os.ReadFile(filepath.Join(dir, name))
+}
@@ -0,0 +1,3 @@
+module codegenTests
+
+go 1.24.3
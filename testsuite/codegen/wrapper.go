@@ -0,0 +1,117 @@
+package codegenTests
+
+/*
+#cgo CFLAGS: -I../../headers -I../../common/lib/sds -I../../common/lib/securedstring -I../../common/defs -I../../common/defs/instr
+#cgo LDFLAGS: -L../../out -lcodegen
+#include <stdlib.h>
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "allocator.h"
+#include "context.h"
+*/
+import "C"
+import (
+	"strings"
+	"unsafe"
+)
+
+
+// Source lines already converted to C strings, so that benchmarks only measure the C side
+type cLines struct {
+	lines []*C.char
+}
+
+func newCLines(src string) *cLines {
+	l := &cLines{}
+	for _, line := range strings.SplitAfter(src, "\n") {
+		if line == "" {
+			continue
+		}
+		l.lines = append(l.lines, C.CString(line))
+	}
+	return l
+}
+
+func (l *cLines) free() {
+	for _, line := range l.lines {
+		C.free(unsafe.Pointer(line))
+	}
+	l.lines = nil
+}
+
+// Everything needed to parse and generate code for one source, set up the same way `main` does
+type assembly struct {
+	as *C.ArxAssembler
+	lexer *C.Lexer
+	parser *C.Parser
+	symbolTable *C.SymbolTable
+	sectionTable *C.SectionTable
+	structTable *C.StructTable
+	dataTable *C.DataTable
+	relocTable *C.RelocTable
+	codegen *C.CodeGen
+}
+
+// Lexes the source and prepares a parser over its tokens
+func newAssembly(l *cLines) *assembly {
+	a := &assembly{}
+
+	a.as = C.initAssembler(C.Config{
+		warningAsFatal: false,
+		warnings: C.FLAGS8(C.WARN_FLAG_ALL),
+		enhancedFeatures: C.FLAGS8(C.FEATURE_NONE),
+	}, nil)
+	a.lexer = C.initLexer(a.as)
+	for _, line := range l.lines {
+		C.lexLine(a.lexer, line)
+	}
+
+	a.symbolTable = C.initSymbolTable()
+	a.sectionTable = C.initSectionTable()
+	a.structTable = C.initStructTable()
+	a.dataTable = C.initDataTable()
+	a.relocTable = C.initRelocTable()
+
+	a.parser = C.initParser(a.as, a.lexer.tokens, a.lexer.tokenCount)
+	C.setTables(a.parser, a.sectionTable, a.symbolTable, a.structTable, a.dataTable, a.relocTable)
+
+	return a
+}
+
+func (a *assembly) parse() {
+	C.parse(a.parser)
+}
+
+func (a *assembly) gencode() {
+	a.codegen = C.initCodeGenerator(a.as, a.sectionTable, a.symbolTable, a.relocTable)
+	C.gencode(a.parser, a.codegen)
+}
+
+// Size of the text section in bytes
+func (a *assembly) textSize() int {
+	return int(a.codegen.text.instructionCount) * 4
+}
+
+func (a *assembly) free() {
+	if a.codegen != nil {
+		C.deinitCodeGenerator(a.codegen)
+	}
+	C.deinitLexer(a.lexer)
+	C.deinitParser(a.parser)
+	C.deinitStructTable(a.structTable)
+	C.deinitSectionTable(a.sectionTable)
+	C.deinitSymbolTable(a.symbolTable)
+	C.deinitDataTable(a.dataTable)
+	C.deinitRelocTable(a.relocTable)
+	C.deinitAssembler(a.as)
+}
+
+// Number of allocations the C side has made through the assembler's allocator
+func cAllocCount() uint64 {
+	var total uint64
+	for tag := 0; tag < int(C.MEM_TAG_COUNT); tag++ {
+		total += uint64(C.getMemStats(C.memTag(tag)).allocs)
+	}
+	return total
+}
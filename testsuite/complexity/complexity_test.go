@@ -0,0 +1,168 @@
+package complexityTests
+
+import (
+	"bufio"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+
+// Each case assembles a generated input at a small and a large size and compares the time per element
+// With linear scaling the time per element stays about the same, a quadratic path multiplies it by large/small
+// The fixed startup cost only makes the small size look slower, so it never causes a false failure
+
+// How much slower per element the large size may be before it counts as superlinear
+const maxGrowth = 2.5
+
+// Runs per size, the fastest is kept
+const runs = 3
+
+type complexityCase struct {
+	name  string
+	small int
+	large int
+	// Writes the input for `n` elements into `dir` and returns the name of the file to assemble
+	gen func(dir string, n int) (string, error)
+	// Known superlinear paths are skipped with the reason until they are fixed
+	// Set ARXSM_COMPLEXITY_ALL=1 to run them anyway
+	superlinear string
+}
+
+var cases = []complexityCase{
+	{
+		name: "Symbols", small: 100000, large: 1000000, gen: genSymbols,
+	},
+	{
+		name: "References", small: 100000, large: 1000000, gen: genReferences,
+	},
+	{
+		name: "Instructions", small: 100000, large: 1000000, gen: genInstructions,
+	},
+	{
+		name: "WordElements", small: 100000, large: 1000000, gen: genWords,
+	},
+	{
+		name: "Includes", small: 1000, large: 10000, gen: genIncludes,
+	},
+}
+
+
+func writeSource(path string, write func(w *bufio.Writer)) error {
+	f, err := os.Create(path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	w := bufio.NewWriter(f)
+	write(w)
+	return w.Flush()
+}
+
+// `n` distinct labels, each referenced once
+func genSymbols(dir string, n int) (string, error) {
+	return "symbols.s", writeSource(filepath.Join(dir, "symbols.s"), func(w *bufio.Writer) {
+		w.WriteString(".text\n")
+		for i := 0; i < n; i++ {
+			fmt.Fprintf(w, "L_%d:\n\tub L_%d\n", i, i)
+		}
+	})
+}
+
+// `n` references to the same label
+func genReferences(dir string, n int) (string, error) {
+	return "references.s", writeSource(filepath.Join(dir, "references.s"), func(w *bufio.Writer) {
+		w.WriteString(".text\nL_0:\n")
+		for i := 0; i < n; i++ {
+			w.WriteString("\tub L_0\n")
+		}
+	})
+}
+
+// `n` plain R-type instructions, no symbols
+func genInstructions(dir string, n int) (string, error) {
+	return "instructions.s", writeSource(filepath.Join(dir, "instructions.s"), func(w *bufio.Writer) {
+		w.WriteString(".text\n")
+		for i := 0; i < n; i++ {
+			fmt.Fprintf(w, "\tadd x%d, x%d, x%d\n", i%16, (i+1)%16, (i+2)%16)
+		}
+	})
+}
+
+// A single `.word` directive with `n` elements
+func genWords(dir string, n int) (string, error) {
+	return "words.s", writeSource(filepath.Join(dir, "words.s"), func(w *bufio.Writer) {
+		w.WriteString(".data\ntab_0: .word ")
+		for i := 0; i < n; i++ {
+			if i > 0 {
+				w.WriteString(", ")
+			}
+			fmt.Fprintf(w, "0x%x", i&0xffff)
+		}
+		w.WriteString("\n.text\n\tld x0, =tab_0\n")
+	})
+}
+
+// `n` ADECL files, each declaring a constant, all included by the main file
+func genIncludes(dir string, n int) (string, error) {
+	for i := 0; i < n; i++ {
+		decl := fmt.Sprintf(".set C_%d, #%d\n", i, i%100)
+		if err := os.WriteFile(filepath.Join(dir, fmt.Sprintf("decl_%d.adecl", i)), []byte(decl), 0644); err != nil {
+			return "", err
+		}
+	}
+	return "includes.s", writeSource(filepath.Join(dir, "includes.s"), func(w *bufio.Writer) {
+		for i := 0; i < n; i++ {
+			fmt.Fprintf(w, ".include \"decl_%d.adecl\"\n", i)
+		}
+		w.WriteString(".text\n\tadd x0, x0, #1\n")
+	})
+}
+
+
+func TestComplexity(t *testing.T) {
+	if !binaryExists() {
+		t.Fatalf("%s not found, build the assembler first with `make`", arxsm)
+	}
+
+	runAll := os.Getenv("ARXSM_COMPLEXITY_ALL") != ""
+
+	for _, tc := range cases {
+		t.Run(tc.name, func(t *testing.T) {
+			if tc.superlinear != "" && !runAll {
+				t.Skipf("Known superlinear: %s", tc.superlinear)
+			}
+
+			small, large := tc.small, tc.large
+			if testing.Short() {
+				small, large = small/10, large/10
+			}
+
+			perElement := make([]float64, 2)
+			for i, n := range []int{small, large} {
+				dir := t.TempDir()
+				input, err := tc.gen(dir, n)
+				if err != nil {
+					t.Fatalf("Failed to generate input of size %d: %v", n, err)
+				}
+
+				elapsed, err := bestOf(runs, dir, input)
+				if err != nil {
+					t.Fatalf("Assembling input of size %d failed: %v", n, err)
+				}
+
+				perElement[i] = float64(elapsed.Nanoseconds()) / float64(n)
+				t.Logf("%sn=%d: %v (%.1f ns/element)%s", YELLOW, n, elapsed, perElement[i], RESET)
+			}
+
+			growth := perElement[1] / perElement[0]
+			if growth > maxGrowth {
+				t.Errorf("%sTime per element grew %.2fx from n=%d to n=%d (limit %.1fx), %s is no longer linear%s",
+					RED, growth, small, large, maxGrowth, strings.ToLower(tc.name), RESET)
+			}
+		})
+	}
+}
@@ -0,0 +1,3 @@
+module complexityTests
+
+go 1.24.3
@@ -0,0 +1,74 @@
+package complexityTests
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"time"
+)
+
+
+// Unlike the other packages, these tests drive the assembler binary itself, since what is measured is the whole pipeline
+var arxsm = filepath.Join("..", "..", "out", "arxsm")
+
+const (
+	RESET = "\033[0m"
+	RED = "\033[31m"
+	YELLOW = "\033[33m"
+)
+
+// How long a single run may take before it is considered hung
+const runTimeout = 10 * time.Minute
+
+// Assembles `input` from within `dir` (includes are opened relative to the working directory) and returns the wall time
+func assemble(dir string, input string) (time.Duration, error) {
+	bin, err := filepath.Abs(arxsm)
+	if err != nil {
+		return 0, err
+	}
+
+	ctx, cancel := context.WithTimeout(context.Background(), runTimeout)
+	defer cancel()
+
+	cmd := exec.CommandContext(ctx, bin, "-t", "-o", filepath.Join(dir, "out.ao"), input)
+	cmd.Dir = dir
+
+	start := time.Now()
+	output, err := cmd.CombinedOutput()
+	elapsed := time.Since(start)
+
+	if ctx.Err() == context.DeadlineExceeded {
+		return elapsed, fmt.Errorf("timed out after %v", runTimeout)
+	}
+	if err != nil {
+		// Warnings are fine, but a failing run means the generated input is wrong
+		if len(output) > 512 {
+			output = output[:512]
+		}
+		return elapsed, fmt.Errorf("%v: %s", err, output)
+	}
+
+	return elapsed, nil
+}
+
+// Runs the assembler `runs` times and keeps the fastest, which is the least disturbed by noise
+func bestOf(runs int, dir string, input string) (time.Duration, error) {
+	var best time.Duration
+	for i := 0; i < runs; i++ {
+		elapsed, err := assemble(dir, input)
+		if err != nil {
+			return 0, err
+		}
+		if i == 0 || elapsed < best {
+			best = elapsed
+		}
+	}
+	return best, nil
+}
+
+func binaryExists() bool {
+	_, err := os.Stat(arxsm)
+	return err == nil
+}
@@ -0,0 +1,86 @@
+package depsTests
+
+import (
+	"os"
+	"testing"
+
+	"cli"
+)
+
+// Uses both included symbols, so that it also goes through the cache
+const src = ".include \"my defs.adecl\"\n.include \"inner.adecl\"\n% .include \"gone.adecl\"\n" +
+	".text\n_start:\n\tld x0, =VALUE\n\tld x1, =OTHER\n\tret\n"
+
+const rule = "a.ao: a.s \\\n  my\\ defs.adecl \\\n  inner.adecl\n"
+const phony = "\nmy\\ defs.adecl:\n\ninner.adecl:\n"
+
+func setup(t *testing.T) string {
+	return cli.Setup(t, map[string]string{
+		"inner.adecl": ".set VALUE, #5\n",
+		"my defs.adecl": ".set OTHER, #6\n",
+		"a.s": src,
+	})
+}
+
+func TestDepFile(t *testing.T) {
+	dir := setup(t)
+
+	tests := []struct {
+		name string
+		args []string
+		depfile string
+		expected string
+	}{
+		{"default name", []string{"-MD", "-o", "a.ao", "a.s"}, "a.d", rule},
+		{"-MF", []string{"-MD", "-MF", "deps.d", "-o", "a.ao", "a.s"}, "deps.d", rule},
+		{"-MFfile", []string{"-MD", "-MFjoined.d", "-o", "a.ao", "a.s"}, "joined.d", rule},
+		{"-MP", []string{"-MD", "-MP", "-MF", "phony.d", "-o", "a.ao", "a.s"}, "phony.d", rule + phony},
+	}
+
+	for _, test := range tests {
+		if _, err := cli.Run(dir, test.args...); err != nil {
+			t.Fatalf("%s%s: %v%s", cli.RED, test.name, err, cli.RESET)
+		}
+		content, err := cli.ReadFile(dir, test.depfile)
+		if err != nil {
+			t.Fatalf("%s%s: %v%s", cli.RED, test.name, err, cli.RESET)
+		}
+		if string(content) != test.expected {
+			t.Errorf("%s%s: expected\n%s\ngot\n%s%s", cli.RED, test.name, test.expected, content, cli.RESET)
+		}
+	}
+}
+
+// A hit does not open the includes, the rule must still list them
+func TestCacheHit(t *testing.T) {
+	dir := setup(t)
+
+	for i := 0; i < 2; i++ {
+		os.Remove(dir + "/a.d")
+		if _, err := cli.Run(dir, "-MD", "-MP", "--cache-dir", "cache", "-o", "a.ao", "a.s"); err != nil {
+			t.Fatalf("%sRun %d: %v%s", cli.RED, i, err, cli.RESET)
+		}
+		content, err := cli.ReadFile(dir, "a.d")
+		if err != nil {
+			t.Fatalf("%sRun %d: %v%s", cli.RED, i, err, cli.RESET)
+		}
+		if string(content) != rule + phony {
+			t.Errorf("%sRun %d: expected\n%s\ngot\n%s%s", cli.RED, i, rule + phony, content, cli.RESET)
+		}
+	}
+}
+
+func TestBadFlags(t *testing.T) {
+	dir := setup(t)
+
+	bad := [][]string{
+		{"-MF", "deps.d", "a.s"},
+		{"-MP", "a.s"},
+		{"-MD", "-MF", "deps.d", "-o", ".", "a.s", "inner.adecl"},
+	}
+	for _, args := range bad {
+		if _, err := cli.Run(dir, args...); err == nil {
+			t.Errorf("%sExpected %v to fail%s", cli.RED, args, cli.RESET)
+		}
+	}
+}
@@ -0,0 +1,197 @@
+package diagnosticsTests
+
+import (
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+
+	"cli"
+)
+
+// An error on every other line, each at its own line number
+func source(errors int) string {
+	src := ".text\n_start:\n"
+	for i := 0; i < errors; i++ {
+		src += "\tbogus x" + strconv.Itoa(i) + "\n\tadd x0, x0, x0\n"
+	}
+
+	return src + "\tret\n"
+}
+
+
+func TestErrorLimit(t *testing.T) {
+	dir := cli.Setup(t, map[string]string{"a.s": source(30)})
+
+	tests := []struct {
+		name string
+		args []string
+		errors int
+	}{
+		{"Default", nil, 20},
+		{"Flag", []string{"-ferror-limit=3"}, 3},
+		{"Option", []string{"--error-limit", "5"}, 5},
+		{"No limit", []string{"-ferror-limit=0"}, 30},
+	}
+
+	for _, test := range tests {
+		stderr, err := cli.Run(dir, append(test.args, "-o", "a.ao", "a.s")...)
+		if err == nil {
+			t.Errorf("%s%s: a source with errors was accepted%s", cli.RED, test.name, cli.RESET)
+		}
+		if count := strings.Count(stderr, "Unknown instruction"); count != test.errors {
+			t.Errorf("%s%s: %d errors reported, expected %d%s", cli.RED, test.name, count, test.errors, cli.RESET)
+		}
+		// Each error is at its own line, the lines after it were still parsed
+		if test.errors > 1 && !strings.Contains(stderr, "bogus x1` (5)") {
+			t.Errorf("%s%s: the second error is not at its line: %s%s", cli.RED, test.name, stderr, cli.RESET)
+		}
+		if _, err := os.Stat(filepath.Join(dir, "a.ao")); err == nil {
+			t.Errorf("%s%s: an object was written%s", cli.RED, test.name, cli.RESET)
+		}
+	}
+
+	if _, err := cli.Run(dir, "-ferror-limit=x", "-o", "a.ao", "a.s"); err == nil {
+		t.Errorf("%sAn invalid limit was accepted%s", cli.RED, cli.RESET)
+	}
+}
+
+// Errors in an included file stop at its `.include`, the rest of the source goes on
+func TestIncludedErrors(t *testing.T) {
+	dir := cli.Setup(t, map[string]string{
+		"a.s": ".include \"defs.adecl\"\n" + source(2),
+		"defs.adecl": ".set VALUE, #5\n.text\n.data\n",
+	})
+
+	stderr, err := cli.Run(dir, "-o", "a.ao", "a.s")
+	if err == nil {
+		t.Fatalf("%sA source with errors was accepted%s", cli.RED, cli.RESET)
+	}
+	if !strings.Contains(stderr, "(2)") || strings.Contains(stderr, "(3)") {
+		t.Errorf("%sOnly the first error of the included file is reported: %s%s", cli.RED, stderr, cli.RESET)
+	}
+	if count := strings.Count(stderr, "Unknown instruction"); count != 2 {
+		t.Errorf("%sThe source was not parsed after the include: %s%s", cli.RED, stderr, cli.RESET)
+	}
+}
+
+// Batch workers finish in any order, the diagnostics still come in the order of the files
+func TestBatchOrder(t *testing.T) {
+	files := map[string]string{}
+	names := []string{}
+	for i := 0; i < 6; i++ {
+		name := "f" + strconv.Itoa(i) + ".s"
+		// Sizes vary so that workers do not finish in order
+		files[name] = source(1 + (5-i)*3)
+		names = append(names, name)
+	}
+	dir := cli.Setup(t, files)
+	if err := os.Mkdir(filepath.Join(dir, "out"), 0755); err != nil {
+		t.Fatal(err)
+	}
+
+	serial, _ := cli.Run(dir, append([]string{"-j", "1", "-ferror-limit=0", "-o", "out/"}, names...)...)
+	for i := 0; i < 5; i++ {
+		stderr, err := cli.Run(dir, append([]string{"-j", "3", "-ferror-limit=0", "-o", "out/"}, names...)...)
+		if err == nil {
+			t.Fatalf("%sFiles with errors were accepted%s", cli.RED, cli.RESET)
+		}
+		if stderr != serial {
+			t.Fatalf("%sThe diagnostics are not in the order of the files:\n%s\n%s%s", cli.RED, stderr, serial, cli.RESET)
+		}
+	}
+
+	// No file is interleaved with another
+	last := -1
+	for _, line := range strings.Split(strings.TrimSpace(serial), "\n") {
+		index := strings.Index(line, "f")
+		file, _ := strconv.Atoi(line[index+1 : index+2])
+		if file < last {
+			t.Fatalf("%sf%d.s is reported after f%d.s%s", cli.RED, file, last, cli.RESET)
+		}
+		last = file
+	}
+}
+
+// A syntax check reports what the assembly would, without writing anything
+func TestSyntaxOnly(t *testing.T) {
+	files := map[string]string{
+		"ok.s": ".extern EXT\n.text\n_start:\n\tadd x0, x0, EXT\n\tld x1, =EXT\n\tret\n.data\nd: .word d, d + 4\n.byte 1, 2\n.float 1.5\n",
+		"parse.s": source(3),
+		// Only found by the checks of codegen
+		"range.s": ".text\n_start:\n\tld x0, [x1, #300]\n\tret\n.data\n.byte 300\n.hword 70000\n",
+		"extern.s": ".text\n_start:\n\tadd x0, x0, UNDEF\n\tret\n",
+		"unused.s": ".set AA, #3\n.set BB, CC + 1\n.text\n_start:\n\tret\n",
+	}
+	dir := cli.Setup(t, files)
+	if err := os.Mkdir(filepath.Join(dir, "out"), 0755); err != nil {
+		t.Fatal(err)
+	}
+
+	for name := range files {
+		expected, expectedErr := cli.Run(dir, "-o", "out/"+name+".ao", name)
+		stderr, err := cli.Run(dir, "-fsyntax-only", "-o", "out/"+name+".check", name)
+		if (err == nil) != (expectedErr == nil) || stderr != expected {
+			t.Errorf("%s%s: the check differs from the assembly:\n%s\n%s%s", cli.RED, name, stderr, expected, cli.RESET)
+		}
+		if _, err := os.Stat(filepath.Join(dir, "out", name+".check")); err == nil {
+			t.Errorf("%s%s: the check wrote an object%s", cli.RED, name, cli.RESET)
+		}
+	}
+
+	// Nothing is written, so nothing is named either: several files can share a name and no directory is needed
+	if _, err := cli.Run(dir, "-fsyntax-only", "-j", "2", "-o", "missing/", "ok.s", "ok.s"); err != nil {
+		t.Errorf("%sSeveral files: %v%s", cli.RED, err, cli.RESET)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "out.ao")); err == nil {
+		t.Errorf("%sThe check wrote an object%s", cli.RED, cli.RESET)
+	}
+	if _, err := cli.Run(dir, "-fsyntax-only", "-MD", "ok.s"); err == nil {
+		t.Errorf("%s-MD was accepted with -fsyntax-only%s", cli.RED, cli.RESET)
+	}
+}
+
+// A section can fill the 32 bits of an AOEFF object, one byte more is an error rather than an address that wraps
+func TestSectionLimit(t *testing.T) {
+	bss := func(last string) string {
+		return ".bss\nbig: .zero #0xFFFFFFF0\nlast: .zero " + last + "\n.text\n_start:\n\tret\n"
+	}
+	dir := cli.Setup(t, map[string]string{"full.s": bss("#0xF"), "over.s": bss("#0x10")})
+
+	if stderr, err := cli.Run(dir, "-o", "full.ao", "full.s"); err != nil {
+		t.Errorf("%sA full section was rejected: %s%s", cli.RED, stderr, cli.RESET)
+	}
+
+	stderr, err := cli.Run(dir, "-o", "over.ao", "over.s")
+	if err == nil {
+		t.Errorf("%sA section past 4 GiB was accepted%s", cli.RED, cli.RESET)
+	}
+	if !strings.Contains(stderr, "4 GiB") || !strings.Contains(stderr, "(3)") {
+		t.Errorf("%sThe error is not at the line that goes past: %s%s", cli.RED, stderr, cli.RESET)
+	}
+}
+
+// A `.set` using a symbol that is never defined is reported, its value is not taken for the expression
+// The entry of the symbol reuses freed memory, the comment of the line before changes what was there
+func TestUndefinedInSet(t *testing.T) {
+	dir := cli.Setup(t, nil)
+
+	for length := 0; length < 64; length++ {
+		src := ".set VALUE, #10 % " + strings.Repeat("x", length) + "\n.set SUM, 20 + UNDEFINED\n"
+		if err := cli.WriteFile(dir, "a.s", src); err != nil {
+			t.Fatal(err)
+		}
+
+		stderr, err := cli.Run(dir, "-o", "a.ao", "a.s")
+		if err == nil {
+			t.Fatalf("%sA source using an undefined symbol was accepted%s", cli.RED, cli.RESET)
+		}
+		if strings.Contains(err.Error(), "signal") {
+			t.Fatalf("%sThe assembler crashed after a comment of %d bytes: %v%s", cli.RED, length, err, cli.RESET)
+		}
+		if !strings.Contains(stderr, "Could not evaluate expression") || !strings.Contains(stderr, "`SUM`") {
+			t.Fatalf("%sThe symbol that could not be evaluated is not reported: %s%s", cli.RED, stderr, cli.RESET)
+		}
+	}
+}
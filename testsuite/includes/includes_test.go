@@ -0,0 +1,260 @@
+package includesTests
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"cli"
+)
+
+const src = ".include \"defs.adecl\"\n.text\n_start:\n\tld x0, =VALUE\n\tret\n"
+
+
+// The object of `src` with `defs.adecl` next to it
+func reference(t *testing.T, defs string) []byte {
+	dir := cli.Setup(t, map[string]string{"a.s": src, "defs.adecl": defs})
+	if _, err := cli.Run(dir, "-o", "a.ao", "a.s"); err != nil {
+		t.Fatalf("%sReference: %v%s", cli.RED, err, cli.RESET)
+	}
+	expected, err := cli.ReadFile(dir, "a.ao")
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	return expected
+}
+
+func expectObject(t *testing.T, name string, dir string, object string, expected []byte) {
+	content, err := cli.ReadFile(dir, object)
+	if err != nil {
+		t.Fatalf("%s%s: %v%s", cli.RED, name, err, cli.RESET)
+	}
+	if !bytes.Equal(content, expected) {
+		t.Errorf("%s%s: the object differs from the one with the file next to the source%s", cli.RED, name, cli.RESET)
+	}
+}
+
+func TestIncludePath(t *testing.T) {
+	expected := reference(t, ".set VALUE, #5\n")
+	dir := cli.Setup(t, map[string]string{
+		"a.s": src,
+		"first/defs.adecl": ".set VALUE, #5\n",
+		"second/defs.adecl": ".set VALUE, #7\n",
+	})
+
+	if _, err := cli.Run(dir, "-o", "a.ao", "a.s"); err == nil {
+		t.Errorf("%sThe file was found without -I%s", cli.RED, cli.RESET)
+	}
+
+	// The directories are searched in order, with or without a trailing slash
+	if _, err := cli.Run(dir, "-I", "first/", "-Isecond", "-o", "a.ao", "a.s"); err != nil {
+		t.Fatalf("%s-I: %v%s", cli.RED, err, cli.RESET)
+	}
+	expectObject(t, "-I", dir, "a.ao", expected)
+
+	// The current directory comes first
+	if err := cli.WriteFiles(dir, map[string]string{"defs.adecl": ".set VALUE, #5\n", "first/defs.adecl": ".set VALUE, #9\n"}); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := cli.Run(dir, "-I", "first", "-o", "b.ao", "a.s"); err != nil {
+		t.Fatalf("%sCurrent directory: %v%s", cli.RED, err, cli.RESET)
+	}
+	expectObject(t, "Current directory", dir, "b.ao", expected)
+}
+
+func TestIncludeOnce(t *testing.T) {
+	expected := reference(t, ".set VALUE, #5\n")
+	dir := cli.Setup(t, map[string]string{
+		"a.s": ".include \"defs.adecl\"\n.include \"./defs.adecl\"\n.include \"sub/../inc/defs.adecl\"\n" +
+			".include \"inc/defs.adecl\"\n.include \"link.adecl\"\n" + src,
+		"inc/defs.adecl": ".set VALUE, #5\n",
+		"sub/empty.adecl": "",
+	})
+	if err := os.Symlink(filepath.Join("inc", "defs.adecl"), filepath.Join(dir, "link.adecl")); err != nil {
+		t.Skipf("%sSymbolic links are not available: %v%s", cli.YELLOW, err, cli.RESET)
+	}
+	// `defs.adecl` itself is the one in `inc`, reached through `-I`
+	if _, err := cli.Run(dir, "-I", "inc", "-o", "a.ao", "a.s"); err != nil {
+		t.Fatalf("%sIncluding the same file several ways: %v%s", cli.RED, err, cli.RESET)
+	}
+	expectObject(t, "Include once", dir, "a.ao", expected)
+
+	// Two different files defining the same symbol are still a redefinition
+	if err := cli.WriteFiles(dir, map[string]string{"other.adecl": ".set VALUE, #5\n", "b.s": ".include \"other.adecl\"\n" + src}); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := cli.Run(dir, "-I", "inc", "-o", "b.ao", "b.s"); err == nil {
+		t.Errorf("%sA symbol defined by two different files was accepted%s", cli.RED, cli.RESET)
+	}
+}
+
+// Every file of a batch includes the same header, it is only lexed by the first one
+func TestBatchReuse(t *testing.T) {
+	expected := reference(t, ".set VALUE, #5\n")
+	dir := cli.Setup(t, map[string]string{
+		"a.s": src,
+		"b.s": src,
+		"c.s": src,
+		"defs.adecl": ".set VALUE, #5\n",
+		"out/.keep": "",
+	})
+
+	if _, err := cli.Run(dir, "-j", "1", "--trace-out", "trace.json", "-o", "out/", "a.s", "b.s", "c.s"); err != nil {
+		t.Fatalf("%sBatch: %v%s", cli.RED, err, cli.RESET)
+	}
+	for _, name := range []string{"a.ao", "b.ao", "c.ao"} {
+		expectObject(t, name, filepath.Join(dir, "out"), name, expected)
+	}
+
+	trace, err := cli.ReadFile(dir, "trace.json")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if lexed := strings.Count(string(trace), "\"name\":\"lex\",\"cat\":\"adecl\""); lexed != 1 {
+		t.Errorf("%sThe header was lexed %d times, expected once%s", cli.RED, lexed, cli.RESET)
+	}
+	if reused := strings.Count(string(trace), "\"name\":\"reuse defs.adecl\""); reused != 2 {
+		t.Errorf("%sThe header was reused %d times, expected twice%s", cli.RED, reused, cli.RESET)
+	}
+}
+
+// A header using symbols of the file including it cannot be evaluated on its own, each file lexes it
+func TestOutsideSymbols(t *testing.T) {
+	defs := ".set VALUE, OFFSET + #1\n"
+	src := ".set OFFSET, #4\n" + src
+	dir := cli.Setup(t, map[string]string{"a.s": src, "b.s": src, "defs.adecl": defs, "out/.keep": ""})
+
+	_, errA := cli.Run(dir, "-o", "a.ao", "a.s")
+	if _, err := cli.Run(dir, "-j", "1", "--trace-out", "trace.json", "-o", "out/", "a.s", "b.s"); (err == nil) != (errA == nil) {
+		t.Fatalf("%sThe batch and a single run disagree: %v / %v%s", cli.RED, err, errA, cli.RESET)
+	}
+
+	trace, err := cli.ReadFile(dir, "trace.json")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if strings.Contains(string(trace), "\"name\":\"reuse ") {
+		t.Errorf("%sA header using outside symbols was reused%s", cli.RED, cli.RESET)
+	}
+}
+
+// ADECL files only take declarations, anything else is an error at its own line
+func TestDeclarationsOnly(t *testing.T) {
+	cases := map[string]struct {
+		defs string
+		line string
+	}{
+		"Label": {".set VALUE, #5\nvalue:\n", "(2)"},
+		"Instruction": {".set VALUE, #5\n\tadd x0, x0, x0\n", "(2)"},
+		"Section": {".set VALUE, #5\n.data\n", "(2)"},
+		"Data": {".set VALUE, #5\n\n.word 1\n", "(3)"},
+		"Location pointer": {".set VALUE, @\n", "(1)"},
+	}
+
+	for name, c := range cases {
+		dir := cli.Setup(t, map[string]string{"a.s": src, "defs.adecl": c.defs})
+		stderr, err := cli.Run(dir, "-o", "a.ao", "a.s")
+		if err == nil {
+			t.Errorf("%s%s: accepted in an ADECL file%s", cli.RED, name, cli.RESET)
+			continue
+		}
+		if !strings.Contains(stderr, c.line) {
+			t.Errorf("%s%s: the error is not at line %s: %s%s", cli.RED, name, c.line, stderr, cli.RESET)
+		}
+	}
+}
+
+// Declarations of a file included by an ADECL file reach the source, but that file cannot be precompiled
+func TestNestedInclude(t *testing.T) {
+	expected := reference(t, ".set VALUE, #5\n")
+	dir := cli.Setup(t, map[string]string{
+		"a.s": src,
+		"defs.adecl": ".include \"inner.adecl\"\n",
+		"inner.adecl": ".set VALUE, #5\n",
+	})
+
+	if _, err := cli.Run(dir, "-o", "a.ao", "a.s"); err != nil {
+		t.Fatalf("%sNested include: %v%s", cli.RED, err, cli.RESET)
+	}
+	expectObject(t, "Nested include", dir, "a.ao", expected)
+
+	if _, err := cli.Run(dir, "--precompile", "defs.adecl"); err == nil {
+		t.Errorf("%sA file including others was precompiled%s", cli.RED, cli.RESET)
+	}
+}
+
+// Headers loaded ahead by workers give the same object, diagnostics and dependencies as headers loaded in place, in the same order
+func TestPrefetch(t *testing.T) {
+	files := map[string]string{"out/.keep": ""}
+	main := ""
+	for _, name := range []string{"alpha", "beta", "gamma", "delta", "epsilon", "zeta"} {
+		files[name+".adecl"] = ".set " + strings.ToUpper(name) + ", #1\n.sizeof\n"
+		main += ".include \"" + name + ".adecl\"\n"
+	}
+	files["a.s"] = main + ".text\n_start:\n\tld x0, =ZETA\n\tret\n"
+	// The fifth header has an error between two warnings, loading it stops at the error
+	files["epsilon.adecl"] = ".set EPSILON, #1\n.sizeof\n.text\n.sizeof\n"
+	files["b.s"] = strings.Replace(files["a.s"], "\"epsilon.adecl\"", "\"delta.adecl\"", 1)
+	dir := cli.Setup(t, files)
+
+	assemble := func(source string, threads string) (string, []byte, []byte, error) {
+		object := "out/" + threads + ".ao"
+		stderr, err := cli.Run(dir, "--include-threads", threads, "-MD", "-MF", "out/"+threads+".d", "-o", object, source)
+		content, _ := cli.ReadFile(dir, object)
+		deps, _ := cli.ReadFile(dir, "out/"+threads+".d")
+		return stderr, content, deps, err
+	}
+
+	expectedStderr, expectedObject, expectedDeps, err := assemble("b.s", "1")
+	if err != nil {
+		t.Fatalf("%sIn place: %v%s", cli.RED, err, cli.RESET)
+	}
+	if strings.Count(expectedStderr, "not yet implemented") != 5 {
+		t.Fatalf("%sExpected a warning per header: %s%s", cli.RED, expectedStderr, cli.RESET)
+	}
+	failedStderr, _, _, err := assemble("a.s", "1")
+	if err == nil {
+		t.Fatalf("%sThe header with an error was accepted%s", cli.RED, cli.RESET)
+	}
+	// The parse goes on past the error, to the last header
+	if strings.Count(failedStderr, "not yet implemented") != 6 || strings.Contains(failedStderr, "Failed to load") {
+		t.Fatalf("%sExpected a warning per header but after the error, and the error alone: %s%s", cli.RED, failedStderr, cli.RESET)
+	}
+
+	// Workers finish in any order, a few runs give them the chance to
+	for i := 0; i < 10; i++ {
+		stderr, object, deps, err := assemble("b.s", "4")
+		if err != nil {
+			t.Fatalf("%sPrefetched: %v%s", cli.RED, err, cli.RESET)
+		}
+		if stderr != expectedStderr {
+			t.Fatalf("%sThe diagnostics differ from loading in place:\n%s\n%s%s", cli.RED, stderr, expectedStderr, cli.RESET)
+		}
+		if !bytes.Equal(object, expectedObject) {
+			t.Fatalf("%sThe object differs from loading in place%s", cli.RED, cli.RESET)
+		}
+		if !bytes.Equal(deps, bytes.ReplaceAll(expectedDeps, []byte("out/1.ao"), []byte("out/4.ao"))) {
+			t.Fatalf("%sThe dependencies differ from loading in place:\n%s%s", cli.RED, deps, cli.RESET)
+		}
+
+		stderr, _, _, err = assemble("a.s", "4")
+		if err == nil || stderr != failedStderr {
+			t.Fatalf("%sThe error differs from loading in place:\n%s\n%s%s", cli.RED, stderr, failedStderr, cli.RESET)
+		}
+	}
+
+	// The workers record their loads on a track of their own
+	if _, err := cli.Run(dir, "--include-threads", "4", "--trace-out", "trace.json", "-o", "out/b.ao", "b.s"); err != nil {
+		t.Fatal(err)
+	}
+	trace, err := cli.ReadFile(dir, "trace.json")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !strings.Contains(string(trace), "\"args\":{\"name\":\"includes\"}") {
+		t.Errorf("%sNo header was loaded by a worker%s", cli.RED, cli.RESET)
+	}
+}
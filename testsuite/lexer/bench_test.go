@@ -0,0 +1,64 @@
+package lexerTests
+
+import (
+	"fmt"
+	"strings"
+	"testing"
+)
+
+// Generates roughly `lines` lines of assembly covering labels, the instruction formats, expressions and data
+func genBenchSource(lines int) string {
+	var sb strings.Builder
+
+	sb.WriteString(".set K_0, #1\n")
+	sb.WriteString(".text\n")
+
+	blocks := max(1, lines/14)
+	for i := 0; i < blocks; i++ {
+		next := (i + 1) % blocks
+		fmt.Fprintf(&sb, "fn_%d:\n", i)
+		fmt.Fprintf(&sb, "\tadd x%d, x%d, x%d\n", i%16, (i+1)%16, (i+2)%16)
+		fmt.Fprintf(&sb, "\tsub x%d, x%d, #%d %% immediate\n", (i+3)%16, (i+4)%16, i%100)
+		sb.WriteString("\tlsl x1, x2, #3\n")
+		fmt.Fprintf(&sb, "\tld x3, [x4, #%d]\n", (i%32)*4)
+		sb.WriteString("\tstr x3, [x5, #8]\n")
+		sb.WriteString("\tmul x6, x7, x8\n")
+		sb.WriteString("\tadd x9, x9, K_0\n")
+		sb.WriteString("\tcmp x1, x2\n")
+		fmt.Fprintf(&sb, "\tbeq fn_%d\n", next)
+		fmt.Fprintf(&sb, "\tld x0, =tab_%d\n", i)
+		fmt.Fprintf(&sb, "\tub fn_%d\n", next)
+		sb.WriteString("\tret\n")
+	}
+
+	sb.WriteString(".data\n")
+	for i := 0; i < blocks; i++ {
+		fmt.Fprintf(&sb, "tab_%d: .word 0x%x, 0x%x\n", i, i, i*7)
+	}
+
+	return sb.String()
+}
+
+func BenchmarkLexer(b *testing.B) {
+	for _, size := range []int{1000, 10000, 100000} {
+		b.Run(fmt.Sprintf("lines=%d", size), func(b *testing.B) {
+			src := genBenchSource(size)
+			lines := newCLines(src)
+			defer lines.free()
+
+			b.SetBytes(int64(len(src)))
+			b.ReportAllocs()
+
+			allocs := cAllocCount()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				lexer := lexerInitLexer()
+				lines.lexInto(lexer)
+				lexerDeinitLexer(lexer)
+			}
+			b.StopTimer()
+
+			b.ReportMetric(float64(cAllocCount()-allocs)/float64(b.N), "C-allocs/op")
+		})
+	}
+}
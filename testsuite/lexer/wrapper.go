@@ -6,23 +6,27 @@ package lexerTests
 #include "../../headers/lexer.h"
 #include "../../headers/diagnostics.h"
 #include "../../headers/token.h"
-#include "../../common/libsecuredstring.h"
-#include "../../common/sds.h"
+#include "../../headers/allocator.h"
 */
 import "C"
 import (
 	"fmt"
+	"strings"
 	"unsafe"
 )
 
 
+// Each lexer gets its own assembler context, freed along with it
 func lexerInitLexer() *C.Lexer {
-	lexer := C.initLexer()
+	as := C.initAssembler(C.Config{}, nil)
+	lexer := C.initLexer(as)
 	return lexer
 }
 
 func lexerDeinitLexer(lexer *C.Lexer) {
+	as := lexer.as
 	C.deinitLexer(lexer)
+	C.deinitAssembler(as)
 }
 
 func lexerLexLine(lexer *C.Lexer, line string) {
@@ -32,11 +36,11 @@ func lexerLexLine(lexer *C.Lexer, line string) {
 }
 
 func lexerGetNextToken(lexer *C.Lexer) *C.Token {
-	return C.getNextToken(lexer)
+	return C.getNextToken(lexer, nil)
 }
 
 func lexerGetToken(lexer *C.Lexer, index int) *C.Token {
-	return C.getToken(lexer, C.int(index))
+	return C.getToken(lexer, C.size_t(index))
 }
 
 func lexerResetLexer(lexer *C.Lexer) {
@@ -44,6 +48,45 @@ func lexerResetLexer(lexer *C.Lexer) {
 }
 
 
+// Source lines already converted to C strings, so that benchmarks only measure the lexer
+type cLines struct {
+	lines []*C.char
+}
+
+func newCLines(src string) *cLines {
+	l := &cLines{}
+	for _, line := range strings.SplitAfter(src, "\n") {
+		if line == "" {
+			continue
+		}
+		l.lines = append(l.lines, C.CString(line))
+	}
+	return l
+}
+
+func (l *cLines) free() {
+	for _, line := range l.lines {
+		C.free(unsafe.Pointer(line))
+	}
+	l.lines = nil
+}
+
+func (l *cLines) lexInto(lexer *C.Lexer) {
+	for _, line := range l.lines {
+		C.lexLine(lexer, line)
+	}
+}
+
+// Number of allocations the C side has made through the assembler's allocator
+func cAllocCount() uint64 {
+	var total uint64
+	for tag := 0; tag < int(C.MEM_TAG_COUNT); tag++ {
+		total += uint64(C.getMemStats(C.memTag(tag)).allocs)
+	}
+	return total
+}
+
+
 func assertToken(t *C.Token, expectedType C.tokenType, expectedLexeme string) bool {
 	if t._type != expectedType {
 		return false
@@ -111,8 +154,8 @@ func tokenTypeToString(t C.tokenType) string {
 			return "TK_DIVIDE"
 		case C.TK_COMMENT:
 			return "TK_COMMENT"
-		case C.TK_LD_IMM:
-			return "TK_LD_IMM"
+		case C.TK_LITERAL:
+			return "TK_LITERAL"
 		case C.TK_BITWISE_AND:
 			return "TK_BITWISE_AND"
 		case C.TK_BITWISE_OR:
@@ -195,7 +238,7 @@ var (
 	TK_ASTERISK      int
 	TK_DIVIDE        int
 	TK_COMMENT       int
-	TK_LD_IMM        int
+	TK_LITERAL       int
 	TK_BITWISE_AND   int
 	TK_BITWISE_OR    int
 	TK_BITWISE_XOR   int
@@ -238,7 +281,7 @@ func tokenTypeInit() {
 	TK_ASTERISK      = int(C.tokenType(C.TK_ASTERISK))
 	TK_DIVIDE        = int(C.tokenType(C.TK_DIVIDE))
 	TK_COMMENT       = int(C.tokenType(C.TK_COMMENT))
-	TK_LD_IMM        = int(C.tokenType(C.TK_LD_IMM))
+	TK_LITERAL       = int(C.tokenType(C.TK_LITERAL))
 	TK_BITWISE_AND   = int(C.tokenType(C.TK_BITWISE_AND))
 	TK_BITWISE_OR    = int(C.tokenType(C.TK_BITWISE_OR))
 	TK_BITWISE_XOR   = int(C.tokenType(C.TK_BITWISE_XOR))
@@ -0,0 +1,65 @@
+package parserTests
+
+import (
+	"testing"
+)
+
+func TestErrorReturns(t *testing.T) {
+	bad := newCLines(".text\nfoo:\n\tret\nfoo:\n\tret\n")
+	defer bad.free()
+
+	a := newAssembly(bad)
+	if a.tryParse() {
+		t.Errorf("%sExpected the redefined label to fail the parse%s", RED, RESET)
+	}
+	if a.errorCount() != 1 {
+		t.Errorf("%sExpected 1 error, got %d%s", RED, a.errorCount(), RESET)
+	}
+	a.discard()
+
+	// The process is still alive and the next assembly starts clean
+	good := newCLines(genBenchSource(100))
+	defer good.free()
+
+	b := newAssembly(good)
+	if !b.tryParse() {
+		t.Fatalf("%sExpected the assembly after a failed one to parse%s", RED, RESET)
+	}
+	if b.errorCount() != 0 {
+		t.Errorf("%sExpected 0 errors, got %d%s", RED, b.errorCount(), RESET)
+	}
+	b.free()
+}
+
+func TestConcurrentAssemblies(t *testing.T) {
+	src := newCLines(genBenchSource(1000))
+	defer src.free()
+
+	// Each goroutine has its own context, one of them failing must not affect the others
+	bad := newCLines(".text\nfoo:\n\tret\nfoo:\n\tret\n")
+	defer bad.free()
+
+	done := make(chan bool)
+	for i := 0; i < 8; i++ {
+		go func(fail bool) {
+			if fail {
+				a := newAssembly(bad)
+				ok := a.tryParse()
+				a.discard()
+				done <- !ok
+				return
+			}
+
+			a := newAssembly(src)
+			ok := a.tryParse()
+			a.free()
+			done <- ok
+		}(i%4 == 0)
+	}
+
+	for i := 0; i < 8; i++ {
+		if !<-done {
+			t.Errorf("%sAn assembly did not end as expected%s", RED, RESET)
+		}
+	}
+}
@@ -0,0 +1,3 @@
+module parserTests
+
+go 1.24.3
@@ -0,0 +1,3 @@
+module serverTests
+
+go 1.24.3
@@ -0,0 +1,126 @@
+package serverTests
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+// Samples that assemble and samples that fail, both must come out of the server as they do out of a one-shot run
+var samples = []string{"br.s", "evt.s", "imms.s", "simpleRel.s", "rel.s", "test.s"}
+
+func TestMatchesOneShot(t *testing.T) {
+	if _, err := os.Stat(arxsm); err != nil {
+		t.Skipf("%s%s is not built%s", YELLOW, arxsm, RESET)
+	}
+
+	dir := t.TempDir()
+	s, err := startServer(dir)
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+	defer s.stop()
+
+	samplesDir, err := filepath.Abs(filepath.Join("..", "..", "samples"))
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	// Twice, so that the second round runs on a server that already assembled everything once
+	for round := 0; round < 2; round++ {
+		for _, sample := range samples {
+			path := filepath.Join(samplesDir, sample)
+
+			expected, err := runArxsm(dir, "out.ao", "-o", "out.ao", path)
+			if err != nil {
+				t.Fatal(err)
+			}
+			got, err := runArxsm(dir, "out.ao", "--client", s.sock, "-o", "out.ao", path)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			if got.status != expected.status {
+				t.Errorf("%s%s: exit status %d, one-shot run gave %d%s", RED, sample, got.status, expected.status, RESET)
+			}
+			if got.stderr != expected.stderr || got.stdout != expected.stdout {
+				t.Errorf("%s%s: output `%s%s`, one-shot run gave `%s%s`%s", RED, sample, got.stdout, got.stderr, expected.stdout, expected.stderr, RESET)
+			}
+			if !bytes.Equal(got.image, expected.image) {
+				t.Errorf("%s%s: image of %d bytes, one-shot run wrote %d%s", RED, sample, len(got.image), len(expected.image), RESET)
+			}
+		}
+	}
+}
+
+func TestBadArguments(t *testing.T) {
+	if _, err := os.Stat(arxsm); err != nil {
+		t.Skipf("%s%s is not built%s", YELLOW, arxsm, RESET)
+	}
+
+	dir := t.TempDir()
+	s, err := startServer(dir)
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+
+	expected, err := runArxsm(dir, "out.ao", "notassembly.txt")
+	if err != nil {
+		t.Fatal(err)
+	}
+	got, err := runArxsm(dir, "out.ao", "--client", s.sock, "notassembly.txt")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if got.status != expected.status || got.stderr != expected.stderr {
+		t.Errorf("%sGot %d `%s`, one-shot run gave %d `%s`%s", RED, got.status, got.stderr, expected.status, expected.stderr, RESET)
+	}
+
+	// The server is still there afterwards
+	src := filepath.Join(dir, "ok.s")
+	if err := os.WriteFile(src, []byte(".text\n_start:\n\tret\n"), 0644); err != nil {
+		t.Fatal(err)
+	}
+	if res, err := runArxsm(dir, "out.ao", "--client", s.sock, "-o", "out.ao", src); err != nil || res.status != 0 || res.image == nil {
+		t.Errorf("%sRequest after a bad one: %v %d `%s`%s", RED, err, res.status, res.stderr, RESET)
+	}
+
+	if !s.stop() {
+		t.Errorf("%sThe server left its socket behind%s", RED, RESET)
+	}
+}
+
+// A client that does not check the command line itself must not take the server down with arguments that end the run early
+func TestUncheckedRequests(t *testing.T) {
+	if _, err := os.Stat(arxsm); err != nil {
+		t.Skipf("%s%s is not built%s", YELLOW, arxsm, RESET)
+	}
+
+	dir := t.TempDir()
+	s, err := startServer(dir)
+	if err != nil {
+		t.Fatalf("%s%v%s", RED, err, RESET)
+	}
+	defer s.stop()
+
+	requests := []struct {
+		args []string
+		status int
+		output string
+	}{
+		{[]string{"arxsm", "-v"}, 0, "version"},
+		{[]string{"arxsm", "-h"}, 0, "Usage"},
+		{[]string{"arxsm"}, -1, "No input file specified."},
+	}
+	for _, req := range requests {
+		got, err := sendRequest(s.sock, dir, req.args...)
+		if err != nil {
+			t.Fatalf("%s%v: %v%s", RED, req.args, err, RESET)
+		}
+		if got.status != req.status || !strings.Contains(got.stdout+got.stderr, req.output) {
+			t.Errorf("%s%v: got %d `%s%s`, expected %d with `%s`%s", RED, req.args, got.status, got.stdout, got.stderr, req.status, req.output, RESET)
+		}
+	}
+}
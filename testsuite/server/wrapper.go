@@ -0,0 +1,150 @@
+package serverTests
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"syscall"
+	"time"
+)
+
+
+// These tests start `out/arxsm --server` and compare what `--client` produces against one-shot runs of the same binary
+var arxsm = filepath.Join("..", "..", "out", "arxsm")
+
+const (
+	RESET = "\033[0m"
+	RED = "\033[31m"
+	YELLOW = "\033[33m"
+)
+
+type run struct {
+	status int
+	stdout string
+	stderr string
+	image []byte // nil when nothing was written
+}
+
+// Runs the binary in `dir`, reading back the object written to `out`
+func runArxsm(dir string, out string, args ...string) (run, error) {
+	bin, err := filepath.Abs(arxsm)
+	if err != nil {
+		return run{}, err
+	}
+	os.Remove(filepath.Join(dir, out))
+
+	var stdout, stderr bytes.Buffer
+	cmd := exec.Command(bin, args...)
+	cmd.Dir = dir
+	cmd.Stdout = &stdout
+	cmd.Stderr = &stderr
+
+	res := run{}
+	if err := cmd.Run(); err != nil {
+		exitErr, ok := err.(*exec.ExitError)
+		if !ok {
+			return res, err
+		}
+		res.status = exitErr.ExitCode()
+	}
+	res.stdout = stdout.String()
+	res.stderr = stderr.String()
+	if image, err := os.ReadFile(filepath.Join(dir, out)); err == nil {
+		res.image = image
+	}
+
+	return res, nil
+}
+
+type server struct {
+	cmd *exec.Cmd
+	sock string
+}
+
+// Starts a server on a socket in `dir`, waiting for the socket to show up
+func startServer(dir string) (*server, error) {
+	bin, err := filepath.Abs(arxsm)
+	if err != nil {
+		return nil, err
+	}
+
+	s := &server{sock: filepath.Join(dir, "arxsm.sock")}
+	s.cmd = exec.Command(bin, "--server", s.sock)
+	s.cmd.Stderr = os.Stderr
+	if err := s.cmd.Start(); err != nil {
+		return nil, err
+	}
+
+	for i := 0; i < 100; i++ {
+		if _, err := os.Stat(s.sock); err == nil {
+			return s, nil
+		}
+		time.Sleep(20 * time.Millisecond)
+	}
+	s.stop()
+
+	return nil, fmt.Errorf("the server did not create %s", s.sock)
+}
+
+// Stops the server the way a user would, returning whether it removed its socket
+func (s *server) stop() bool {
+	s.cmd.Process.Signal(os.Interrupt)
+	s.cmd.Wait()
+
+	_, err := os.Stat(s.sock)
+	return os.IsNotExist(err)
+}
+
+// Sends a command line to the server the way `--client` does, but without checking it first
+// The answer is the exit status and what the request wrote to its stdout and stderr
+func sendRequest(sock string, dir string, args ...string) (run, error) {
+	conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: sock, Net: "unix"})
+	if err != nil {
+		return run{}, err
+	}
+	defer conn.Close()
+
+	outR, outW, err := os.Pipe()
+	if err != nil {
+		return run{}, err
+	}
+	errR, errW, err := os.Pipe()
+	if err != nil {
+		return run{}, err
+	}
+
+	var strings bytes.Buffer
+	for _, str := range append([]string{dir}, args...) {
+		strings.WriteString(str)
+		strings.WriteByte(0)
+	}
+	header := make([]byte, 12)
+	binary.LittleEndian.PutUint32(header[0:], 0x41525853)
+	binary.LittleEndian.PutUint32(header[4:], uint32(len(args)))
+	binary.LittleEndian.PutUint32(header[8:], uint32(strings.Len()))
+
+	_, _, err = conn.WriteMsgUnix(header, syscall.UnixRights(int(outW.Fd()), int(errW.Fd())), nil)
+	// The server has its own copies now, the pipes end when it closes them
+	outW.Close()
+	errW.Close()
+	if err != nil {
+		return run{}, err
+	}
+	if _, err := conn.Write(strings.Bytes()); err != nil {
+		return run{}, err
+	}
+
+	var status int32
+	if err := binary.Read(conn, binary.LittleEndian, &status); err != nil {
+		return run{}, fmt.Errorf("the server did not answer: %v", err)
+	}
+	stdout, _ := io.ReadAll(outR)
+	stderr, _ := io.ReadAll(errR)
+
+	return run{status: int(status), stdout: string(stdout), stderr: string(stderr)}, nil
+}
@@ -0,0 +1,142 @@
+package streamTests
+
+import (
+	"bytes"
+	"fmt"
+	"regexp"
+	"strconv"
+	"strings"
+	"testing"
+
+	"cli"
+)
+
+// A chunk is 4096 lines (`STREAM_CHUNK_LINES`), the sources go over several
+const chunkLines = 4096
+
+
+// Forward and backward branches, ld of labels in other chunks and of `.set` symbols defined after their use, data between instructions
+func generate(blocks int) string {
+	var src strings.Builder
+	src.WriteString(".include \"defs.adecl\"\n.set BASE, #16\n.text\n_start:\n")
+	for i := 0; i < blocks; i++ {
+		fmt.Fprintf(&src, "L%d:\n\tadd x0, x0, #%d\n", i, i%200)
+		if i%7 == 0 {
+			fmt.Fprintf(&src, "\tub L%d\n", (i+blocks/2)%blocks)
+		}
+		if i%50 == 0 {
+			fmt.Fprintf(&src, "\tld x1, =DV%d\n\tld x2, =LATE\n", i/500*500)
+		}
+		if i%500 == 0 {
+			fmt.Fprintf(&src, ".data\nDV%d: .word #%d, #%d\n.byte #1, #2\n.string \"s%d\"\n.text\n", i, i, i+1, i)
+		}
+	}
+	src.WriteString("\tld x3, =HDR\n\tret\n.set LATE, BASE + #4\n")
+
+	return src.String()
+}
+
+// Runs the same arguments with and without `--stream`, both must give the same object and diagnostics
+func expectSame(t *testing.T, name string, dir string, args ...string) string {
+	stderr, err := cli.Run(dir, append(args, "-o", "whole.ao", "a.s")...)
+	streamed, streamErr := cli.Run(dir, append(args, "--stream", "-o", "streamed.ao", "a.s")...)
+	if (err == nil) != (streamErr == nil) {
+		t.Fatalf("%s%s: the stream and the whole file disagree: %v / %v%s", cli.RED, name, streamErr, err, cli.RESET)
+	}
+	if streamed != stderr {
+		t.Errorf("%s%s: the diagnostics differ:\n%s\n%s%s", cli.RED, name, streamed, stderr, cli.RESET)
+	}
+	if err != nil {
+		return stderr
+	}
+
+	whole, _ := cli.ReadFile(dir, "whole.ao")
+	object, _ := cli.ReadFile(dir, "streamed.ao")
+	if len(whole) == 0 || !bytes.Equal(object, whole) {
+		t.Errorf("%s%s: the object differs from the one of the whole file%s", cli.RED, name, cli.RESET)
+	}
+
+	return stderr
+}
+
+func TestSameObject(t *testing.T) {
+	dir := cli.Setup(t, map[string]string{"a.s": generate(5000), "defs.adecl": ".set HDR, #100\n.set UNUSED, #3\n"})
+	if lines := strings.Count(generate(5000), "\n"); lines < 2*chunkLines {
+		t.Fatalf("Only %d lines, not enough for several chunks", lines)
+	}
+
+	stderr := expectSame(t, "Chunks", dir)
+	if !strings.Contains(stderr, "UNUSED") {
+		t.Errorf("%sThe unused symbol of the header was not reported: %s%s", cli.RED, stderr, cli.RESET)
+	}
+}
+
+// A `.def` across the end of a chunk, and lines after `.end` that would not parse
+func TestScopesAndEnd(t *testing.T) {
+	src := ".text\n_start:\n" + strings.Repeat("\tadd x0, x0, #1\n", chunkLines-4) +
+		".def Node {\n  val:8.\n  nxt:32.\n}\n.def LL{\n  start::Node.\n  cnt:8.\n}\n.type mLL, $object.struct.LL\n" +
+		strings.Repeat("\tld x1, =AA\n", chunkLines) + ".set AA, #5\n.end\nnot an instruction\n"
+	dir := cli.Setup(t, map[string]string{"a.s": src})
+
+	expectSame(t, "Scopes", dir, "-t")
+}
+
+// Errors in several chunks are reported the same, and nothing is written
+func TestErrors(t *testing.T) {
+	src := generate(5000)
+	src = strings.Replace(src, "L10:\n", "L10:\n\tfoo x0\n", 1)
+	src = strings.Replace(src, "L4000:\n", "L4000:\nL10:\n", 1)
+	dir := cli.Setup(t, map[string]string{"a.s": src, "defs.adecl": ".set HDR, #100\n"})
+
+	stderr := expectSame(t, "Errors", dir)
+	if strings.Count(stderr, "\n") < 2 {
+		t.Errorf("%sExpected an error per chunk: %s%s", cli.RED, stderr, cli.RESET)
+	}
+	if _, err := cli.ReadFile(dir, "streamed.ao"); err == nil {
+		t.Errorf("%sAn object was written after an error%s", cli.RED, cli.RESET)
+	}
+
+	if _, err := cli.Run(dir, "--stream", "-fsyntax-only", "a.s"); err == nil {
+		t.Errorf("%s`--stream` was accepted with `-fsyntax-only`%s", cli.RED, cli.RESET)
+	}
+}
+
+var peakRE = regexp.MustCompile(`(?m)^\s*total\s+\d+\s+(\d+)`)
+
+func peakMemory(t *testing.T, dir string, lines int) int {
+	var src strings.Builder
+	src.WriteString(".text\n_start:\n")
+	for i := 0; i < lines; i++ {
+		fmt.Fprintf(&src, "\tadd x0, x1, #%d\n", i%200)
+	}
+	if err := cli.WriteFiles(dir, map[string]string{"big.s": src.String()}); err != nil {
+		t.Fatal(err)
+	}
+
+	stderr, err := cli.Run(dir, "--stream", "--mem-stats", "-o", "big.ao", "big.s")
+	if err != nil {
+		t.Fatalf("%s%d lines: %v%s", cli.RED, lines, err, cli.RESET)
+	}
+	match := peakRE.FindStringSubmatch(stderr)
+	if match == nil {
+		t.Fatalf("No memory statistics: %s", stderr)
+	}
+	peak, _ := strconv.Atoi(match[1])
+
+	return peak
+}
+
+// The peak memory goes with the symbols, there are none here
+func TestBoundedMemory(t *testing.T) {
+	dir := cli.Setup(t, map[string]string{})
+	lines := 10 * chunkLines
+	if testing.Short() {
+		lines = 3 * chunkLines
+	}
+
+	small := peakMemory(t, dir, lines)
+	large := peakMemory(t, dir, 4*lines)
+	if float64(large) > 1.25*float64(small) {
+		t.Errorf("%sThe peak went from %d bytes for %d lines to %d bytes for %d%s", cli.RED, small, lines, large, 4*lines, cli.RESET)
+	}
+}